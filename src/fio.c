@@ -24,14 +24,91 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include "fio.h"
-#include "xpad-app.h"
+#include "xpad-metrics.h"
+#include "xpad-trace.h"
 
-/* Sets filename to full path of filename (prepends xpad_app_get_config_dir ()
+/* Text at least this long is stored gzipped by fio_set_file_compressed.
+   Below it, the few kilobytes saved are not worth the CPU. */
+#define COMPRESS_THRESHOLD (64 * 1024)
+
+/* Fastest zlib level; pasted logs still shrink several times over */
+#define COMPRESS_LEVEL 1
+
+/* Bytes decompressed per read */
+#define READ_CHUNK (64 * 1024)
+
+/* Files at least this big are mapped instead of read, see fio_load */
+#define MAP_THRESHOLD (256 * 1024)
+
+/* Every gzip stream starts with these bytes.  No UTF-8 text can, so they
+   are all the marking a compressed file needs. */
+static const guchar gzip_magic[] = { 0x1f, 0x8b };
+
+/* Stamp of every file as xpad last wrote it, keyed by the name it was
+   written under.  See fio_query_stamp and fio_is_own_write. */
+static GHashTable *own_stamps = NULL;
+
+/* Open fio_begin_batch calls */
+static gint batch_depth = 0;
+
+/* Paths written since the outermost fio_begin_batch */
+static GHashTable *batch_paths = NULL;
+
+/* Where relative names are looked up */
+static gchar *config_dir = NULL;
+
+/* The thread the config dir was set from; no other maps files */
+static GThread *main_thread = NULL;
+
+static void
+fio_print_error (const gchar *message)
+{
+	g_printerr ("%s\n", message);
+}
+
+static FioErrorFunc error_func = fio_print_error;
+
+/* Sets the directory relative names are taken from, the config dir */
+void
+fio_set_config_dir (const gchar *dir)
+{
+	g_free (config_dir);
+	config_dir = g_strdup (dir);
+	main_thread = g_thread_self ();
+}
+
+const gchar *
+fio_get_config_dir (void)
+{
+	return config_dir;
+}
+
+/* Failed writes are reported through func, g_printerr by default */
+void
+fio_set_error_func (FioErrorFunc func)
+{
+	error_func = func ? func : fio_print_error;
+}
+
+static void
+fio_remember_stamp (const gchar *name, gchar *stamp)
+{
+	if (!own_stamps)
+		own_stamps = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	
+	if (stamp)
+		g_hash_table_insert (own_stamps, g_strdup (name), stamp);
+	else
+		g_hash_table_remove (own_stamps, name);
+}
+
+/* Sets filename to full path of filename (prepends the config dir
    to it).  Returns a GFile representing the file. */
 static GFile *
 fio_fill_filename (const gchar *filename)
@@ -42,7 +119,7 @@ fio_fill_filename (const gchar *filename)
 		gchar *full_path;
 		GFile *file;
 		
-		full_path = g_build_filename (xpad_app_get_config_dir (), filename, NULL);
+		full_path = g_build_filename (config_dir, filename, NULL);
 		file = g_file_new_for_path (full_path);
 		
 		g_free (full_path);
@@ -50,6 +127,39 @@ fio_fill_filename (const gchar *filename)
 	}
 }
 
+/**
+ * Returns what tells this version of the file from others, or NULL if it
+ * can't be read.  Must be g_free'd.  The etag alone is the modification
+ * time, which the kernel only keeps to the tick, so a write by another
+ * program right after ours could pass for ours.  The size and inode are
+ * in it too: every write of ours renames a new file into place, so
+ * another program's write changes the inode or, written in place, most
+ * likely the size.
+ */
+static gchar *
+fio_query_stamp (const gchar *name)
+{
+	GFile *file;
+	GFileInfo *info;
+	gchar *stamp = NULL;
+	
+	file = fio_fill_filename (name);
+	info = g_file_query_info (file,
+		G_FILE_ATTRIBUTE_ETAG_VALUE "," G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_UNIX_INODE,
+		G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	
+	if (info)
+	{
+		stamp = g_strdup_printf ("%s/%" G_GOFFSET_FORMAT "/%" G_GUINT64_FORMAT,
+			g_file_info_get_etag (info), g_file_info_get_size (info),
+			g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE));
+		g_object_unref (info);
+	}
+	
+	g_object_unref (file);
+	return stamp;
+}
+
 /* This function returns 'string' with all instances
    of 'obj' replaced with instances of 'replacement'
    It modifies string and re-allocs it.
@@ -77,84 +187,481 @@ memmove (p + rsize, p + osize, strlen (p + osize) + 1);
 	return *string;
 }
 
-gchar *
-fio_unique_name (const gchar *prefix)
+/* Until the matching fio_end_batch, new files are written without a sync
+   each; the files written are then synced together.  Meant for files
+   nothing refers to yet, which a crash can't leave half-replaced. */
+void fio_begin_batch (void)
 {
-	int fd;
-	gchar *name, *base, *pattern;
+	if (!batch_paths)
+		batch_paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	
+	batch_depth++;
+}
+
+/* Returns FALSE if path could not be opened, say because it has been
+   removed since it was written */
+static gboolean
+fio_sync_path (const gchar *path, gint flags)
+{
+	gint fd = g_open (path, O_RDONLY | flags, 0);
+	
+	if (fd < 0)
+		return FALSE;
 	
-	pattern = g_strconcat (prefix, "XXXXXX", NULL);
-	name = g_build_filename (xpad_app_get_config_dir (), pattern, NULL);
-	g_free (pattern);
-	fd = g_mkstemp (name);
-	if (fd == -1)
+	fsync (fd);
+	close (fd);
+	
+	return TRUE;
+}
+
+void fio_end_batch (void)
+{
+	GHashTable *dirs;
+	GHashTableIter iter;
+	gpointer path;
+	gint64 begin;
+	guint syncs = 0;
+	
+	g_return_if_fail (batch_depth > 0);
+	
+	if (--batch_depth > 0)
+		return;
+	
+	begin = g_get_monotonic_time ();
+	
+	/* The files first, then the directories that now name them */
+	dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_iter_init (&iter, batch_paths);
+	while (g_hash_table_iter_next (&iter, &path, NULL))
 	{
-		g_free (name);
-		return NULL;
+		syncs += fio_sync_path (path, 0);
+		g_hash_table_add (dirs, g_path_get_dirname (path));
 	}
 	
-	close (fd);
-	base = g_path_get_basename (name);
+	g_hash_table_iter_init (&iter, dirs);
+	while (g_hash_table_iter_next (&iter, &path, NULL))
+		syncs += fio_sync_path (path, O_DIRECTORY);
 	
-	g_free (name);
+	g_hash_table_destroy (dirs);
+	g_hash_table_remove_all (batch_paths);
 	
-	return base;
+	xpad_metrics_record (XPAD_HISTOGRAM_SAVE_LATENCY, g_get_monotonic_time () - begin);
+	xpad_trace_end (begin, "sync batch", NULL);
+	xpad_metrics_add (XPAD_METRIC_FSYNCS, syncs);
 }
 
-/* This callously overwrites name~ -- but this is fine since this function is for
-   our private .xpad directory anyway */
 gboolean fio_set_file (const gchar *name, const gchar *value)
+{
+	return fio_set_file_data (name, value, strlen (value));
+}
+
+/* Passes a failed write to error_func, and frees error */
+static void
+fio_report_write_error (GFile *file, GError *error)
+{
+	gchar *usertext;
+	gchar *parse_name;
+	
+	parse_name = g_file_get_parse_name (file);
+	usertext = g_strdup_printf (_("Could not write to file %s: %s"), parse_name, error->message);
+	
+	error_func (usertext);
+	
+	g_error_free (error);
+	g_free (usertext);
+	g_free (parse_name);
+}
+
+/* The new contents go to a temporary file that is renamed over name.
+   Outside a batch, or always if durable is set, it is synced first, so a
+   crash in the middle of a write never leaves a truncated file behind. */
+static gboolean
+fio_write (const gchar *name, gconstpointer data, gsize size, gboolean durable)
 {
 	GFile *file;
-	GFileOutputStream *stream;
 	GError *error = NULL;
+	gchar *stamp = NULL;
+	gboolean batched = batch_depth > 0 && !durable;
+	gboolean replacing;
+	gint64 begin;
 	
 	file = fio_fill_filename (name);
 	
-	stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL, &error);
+	/* g_file_replace_contents syncs before renaming over an existing
+	   file, both are part of the measured time */
+	replacing = !batched && g_file_query_exists (file, NULL);
+	begin = g_get_monotonic_time ();
+	if (batched)
+	{
+		gchar *path = g_file_get_path (file);
+		
+		/* Renamed into place all the same, so nothing reading the old file
+		   sees it cut short, but only an existing file is synced first */
+		g_file_set_contents_full (path, data, size,
+		                          G_FILE_SET_CONTENTS_CONSISTENT | G_FILE_SET_CONTENTS_ONLY_EXISTING,
+		                          0600, &error);
+		g_hash_table_add (batch_paths, path);
+	}
+	else
+		g_file_replace_contents (file, data, size, NULL, FALSE,
+		                         G_FILE_CREATE_PRIVATE, NULL, NULL, &error);
+	if (!error)
+		stamp = fio_query_stamp (name);
+	xpad_metrics_record (XPAD_HISTOGRAM_SAVE_LATENCY, g_get_monotonic_time () - begin);
+	xpad_trace_end (begin, batched ? "write" : "write and sync", name);
+	fio_remember_stamp (name, stamp);
 	
-	if (stream)
+	xpad_metrics_add (XPAD_METRIC_SAVES_ISSUED, 1);
+	if (!error)
 	{
-		g_output_stream_write_all (G_OUTPUT_STREAM (stream), value, strlen (value),
-		                           NULL, NULL, &error);
-		g_object_unref (stream);
+		xpad_metrics_add (XPAD_METRIC_BYTES_WRITTEN, size);
+		if (replacing)
+			xpad_metrics_add (XPAD_METRIC_FSYNCS, 1);
 	}
 	
 	if (error)
+		fio_report_write_error (file, error);
+	
+	g_object_unref (file);
+	return !error;
+}
+
+/**
+ * Writes a file that must not be there yet, straight into place: if it
+ * is, nothing is written and exists is set.  A new file has nothing to
+ * keep from a crash, so no temporary file is needed, but it is synced
+ * all the same, at the end of the batch if there is one.
+ */
+static gboolean
+fio_create (const gchar *name, gconstpointer data, gsize size, gboolean *exists)
+{
+	GFile *file;
+	GFileOutputStream *output;
+	GError *error = NULL;
+	gchar *path;
+	gint64 begin;
+	
+	*exists = FALSE;
+	file = fio_fill_filename (name);
+	path = g_file_get_path (file);
+	
+	begin = g_get_monotonic_time ();
+	output = g_file_create (file, G_FILE_CREATE_PRIVATE, NULL, &error);
+	if (output)
 	{
-		gchar *usertext;
-		gchar *parse_name;
-		
-		parse_name = g_file_get_parse_name (file);
-		usertext = g_strdup_printf (_("Could not write to file %s: %s"), parse_name, error->message);
-		
-		xpad_app_error (NULL, usertext, NULL);
-		
-		g_error_free (error);
-		g_free (usertext);
-		g_free (parse_name);
+		if (!g_output_stream_write_all (G_OUTPUT_STREAM (output), data, size, NULL, NULL, &error) ||
+		    !g_output_stream_close (G_OUTPUT_STREAM (output), NULL, &error))
+			g_file_delete (file, NULL, NULL);
+		g_object_unref (output);
 	}
 	
+	if (error && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+	{
+		*exists = TRUE;
+		g_clear_error (&error);
+		g_free (path);
+		g_object_unref (file);
+		return FALSE;
+	}
+	
+	if (!error && batch_depth > 0)
+		g_hash_table_add (batch_paths, g_strdup (path));
+	else if (!error && fio_sync_path (path, 0))
+		xpad_metrics_add (XPAD_METRIC_FSYNCS, 1);
+	xpad_metrics_record (XPAD_HISTOGRAM_SAVE_LATENCY, g_get_monotonic_time () - begin);
+	xpad_trace_end (begin, "create", name);
+	fio_remember_stamp (name, error ? NULL : fio_query_stamp (name));
+	
+	xpad_metrics_add (XPAD_METRIC_SAVES_ISSUED, 1);
+	if (!error)
+		xpad_metrics_add (XPAD_METRIC_BYTES_WRITTEN, size);
+	else
+		fio_report_write_error (file, error);
+	
+	g_free (path);
 	g_object_unref (file);
 	return !error;
 }
 
+gboolean fio_set_file_data (const gchar *name, gconstpointer data, gsize size)
+{
+	return fio_write (name, data, size, FALSE);
+}
+
+/* Like fio_set_file, but never written in place, even during a batch.
+   For files the others depend on, which must survive a crash whole. */
+gboolean fio_set_file_durable (const gchar *name, const gchar *value)
+{
+	return fio_write (name, value, strlen (value), TRUE);
+}
+
+/* Like fio_set_file, but only writes a file that is not there yet.  If
+   it is, returns FALSE without reporting an error and sets exists. */
+gboolean fio_create_file (const gchar *name, const gchar *value, gboolean *exists)
+{
+	return fio_create (name, value, strlen (value), exists);
+}
+
+
+/* Writes data by fio_create if exists is given, else by fio_write */
+static gboolean
+fio_store (const gchar *name, gconstpointer data, gsize size, gboolean *exists)
+{
+	return exists ? fio_create (name, data, size, exists) : fio_write (name, data, size, FALSE);
+}
+
+static gboolean
+fio_store_compressed (const gchar *name, const gchar *value, gboolean *exists)
+{
+	GZlibCompressor *compressor;
+	GOutputStream *memory, *output;
+	gsize size = strlen (value);
+	gboolean ok;
+	
+	if (size < COMPRESS_THRESHOLD)
+		return fio_store (name, value, size, exists);
+	
+	memory = g_memory_output_stream_new_resizable ();
+	compressor = g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, COMPRESS_LEVEL);
+	output = g_converter_output_stream_new (memory, G_CONVERTER (compressor));
+	g_object_unref (compressor);
+	
+	/* Closing flushes the compressor; the memory stream keeps its data */
+	if (g_output_stream_write_all (output, value, size, NULL, NULL, NULL) &&
+	    g_output_stream_close (output, NULL, NULL))
+		ok = fio_store (name,
+			g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (memory)),
+			g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (memory)),
+			exists);
+	else
+		ok = fio_store (name, value, size, exists);
+	
+	g_object_unref (output);
+	g_object_unref (memory);
+	
+	return ok;
+}
+
+/* Like fio_set_file, but text of COMPRESS_THRESHOLD bytes or more is
+   stored gzipped.  fio_get_file reads either form back. */
+gboolean fio_set_file_compressed (const gchar *name, const gchar *value)
+{
+	return fio_store_compressed (name, value, NULL);
+}
+
+/* fio_set_file_compressed for a file that must not be there yet, see
+   fio_create_file */
+gboolean fio_create_file_compressed (const gchar *name, const gchar *value, gboolean *exists)
+{
+	return fio_store_compressed (name, value, exists);
+}
+
+/* Reads all of input, NUL-terminated, or returns NULL on error.  size,
+   if given, is set to the length without the NUL. */
+static gchar *
+fio_read_all (GInputStream *input, gsize *size)
+{
+	GByteArray *bytes = g_byte_array_new ();
+	GError *error = NULL;
+	gssize n;
+	
+	do
+	{
+		guint len = bytes->len;
+		
+		g_byte_array_set_size (bytes, len + READ_CHUNK);
+		n = g_input_stream_read (input, bytes->data + len, READ_CHUNK, NULL, &error);
+		g_byte_array_set_size (bytes, len + MAX (n, 0));
+	}
+	while (n > 0);
+	
+	if (error)
+	{
+		g_error_free (error);
+		g_byte_array_free (bytes, TRUE);
+		return NULL;
+	}
+	
+	if (size)
+		*size = bytes->len;
+	g_byte_array_append (bytes, (const guint8 *) "", 1);
+	return (gchar *) g_byte_array_free (bytes, FALSE);
+}
 
 /**
- * Returned gchar * must be g_free'd.
+ * The contents of name as stored, and whether they are a gzip stream.
+ *
+ * Big files read from the main thread are mapped.  xpad never writes a
+ * file in place, it renames new ones over the old, so a mapping can't see
+ * one of its own writes.  Anyone else truncating a mapped file would
+ * make reading it fault, though, so everything else is read into memory:
+ * small files, which gain little from a mapping, and any file read from
+ * another thread, such as the search worker's, which could be in the
+ * middle of one for a long time.
  */
-gchar *fio_get_file (const gchar *name)
+static GBytes *
+fio_load (const gchar *name, gboolean *compressed)
 {
 	GFile *file;
-	gchar *contents = NULL;
+	GBytes *bytes = NULL;
+	GStatBuf st;
+	gchar *path, *contents;
+	gconstpointer data;
+	gsize size;
 	
 	file = fio_fill_filename (name);
-	g_file_load_contents (file, NULL, &contents, NULL, NULL, NULL);
+	path = g_file_get_path (file);
 	g_object_unref (file);
+	if (!path)
+		return NULL;
+	
+	if (g_thread_self () == main_thread && g_stat (path, &st) == 0 && st.st_size >= MAP_THRESHOLD)
+	{
+		GMappedFile *mapped = g_mapped_file_new (path, FALSE, NULL);
+		
+		if (mapped)
+		{
+			bytes = g_mapped_file_get_bytes (mapped);
+			g_mapped_file_unref (mapped);
+		}
+	}
+	
+	if (!bytes && g_file_get_contents (path, &contents, &size, NULL))
+		bytes = g_bytes_new_take (contents, size);
+	g_free (path);
+	if (!bytes)
+		return NULL;
+	
+	data = g_bytes_get_data (bytes, &size);
+	*compressed = size >= sizeof gzip_magic && memcmp (data, gzip_magic, sizeof gzip_magic) == 0;
+	
+	/* What the file takes on disk, whichever form it is in */
+	xpad_metrics_add (XPAD_METRIC_BYTES_READ, size);
+	
+	return bytes;
+}
+
+/* Decompresses a gzip file a chunk at a time, see fio_read_all */
+static gchar *
+fio_inflate (GBytes *bytes, gsize *size)
+{
+	GZlibDecompressor *decompressor;
+	GInputStream *memory, *input;
+	gchar *contents;
+	
+	memory = g_memory_input_stream_new_from_bytes (bytes);
+	
+	decompressor = g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP);
+	input = g_converter_input_stream_new (memory, G_CONVERTER (decompressor));
+	g_object_unref (decompressor);
+	
+	contents = fio_read_all (input, size);
+	
+	g_object_unref (input);
+	g_object_unref (memory);
 	
 	return contents;
 }
 
+/**
+ * Returned gchar * must be g_free'd.  Files written gzipped come back
+ * decompressed.
+ */
+gchar *fio_get_file (const gchar *name)
+{
+	GBytes *bytes;
+	gboolean compressed;
+	gchar *contents;
+	gsize size;
+	
+	bytes = fio_load (name, &compressed);
+	if (!bytes)
+		return NULL;
+	
+	if (compressed)
+		contents = fio_inflate (bytes, NULL);
+	else
+	{
+		const gchar *data = g_bytes_get_data (bytes, &size);
+		
+		contents = g_malloc (size + 1);
+		if (size)
+			memcpy (contents, data, size);
+		contents[size] = '\0';
+	}
+	
+	g_bytes_unref (bytes);
+	
+	return contents;
+}
+
+/**
+ * Like fio_get_file, but plain files are handed out as they were loaded,
+ * which for big ones is a read-only view of their mapping, instead of a
+ * copy.  The data is not NUL-terminated.  Returns NULL if the file can't
+ * be read.
+ */
+GBytes *fio_get_file_bytes (const gchar *name)
+{
+	GBytes *bytes;
+	gboolean compressed;
+	gchar *contents;
+	gsize size;
+	
+	bytes = fio_load (name, &compressed);
+	if (!bytes || !compressed)
+		return bytes;
+	
+	contents = fio_inflate (bytes, &size);
+	g_bytes_unref (bytes);
+	
+	return contents ? g_bytes_new_take (contents, size) : NULL;
+}
+
+/**
+ * Every "key value" line of the file, as a table from key to value, or
+ * NULL if the file can't be read.  The key ends at the first space and
+ * the value runs to the end of the line; lines without a space are
+ * skipped.  A key that comes twice keeps its first value.
+ */
+GHashTable *fio_get_values (const gchar *filename)
+{
+	GHashTable *values;
+	GBytes *bytes;
+	const gchar *data, *end, *line, *line_end, *space;
+	gchar *key;
+	gsize len;
+	
+	bytes = fio_get_file_bytes (filename);
+	if (!bytes)
+		return NULL;
+	
+	/* Split in place, only keys and values are copied out */
+	data = g_bytes_get_data (bytes, &len);
+	end = data + len;
+	values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	
+	for (line = data; line < end; line = line_end + 1)
+	{
+		line_end = memchr (line, '\n', end - line);
+		if (!line_end)
+			line_end = end;
+		
+		space = memchr (line, ' ', line_end - line);
+		if (!space)
+			continue;
+		
+		key = g_strndup (line, space - line);
+		if (g_hash_table_contains (values, key))
+			g_free (key);
+		else
+			g_hash_table_insert (values, key, g_strndup (space + 1, line_end - space - 1));
+	}
+	
+	g_bytes_unref (bytes);
+	
+	return values;
+}
 
 /* list is a variable number of (gchar *) / (gchar ** or gint *) groups, 
 	terminated by a NULL variable */
@@ -163,51 +670,30 @@ gchar *fio_get_file (const gchar *name)
  */
 gint fio_get_values_from_file (const gchar *filename, ...)
 {
-	gchar *buf;
+	GHashTable *values;
 	const gchar *item;
 	va_list ap;
-	size_t len;
 	
-	buf = fio_get_file (filename);
+	values = fio_get_values (filename);
 	
-	if (!buf)
+	if (!values)
 		return 1;
 	
-	/* because of the way we look for a matching variable name, which is
-		to look for an endline, the variable name, and a space, we insert a
-		newline at the beginning, so that the first variable name is caught. */
-	len = strlen (buf);
-	buf = g_realloc (buf, len + 2);
-	memmove (buf + 1, buf, len + 1);
-	buf[0] = '\n';
-	
 	va_start (ap, filename);
 
 	while ((item = va_arg (ap, gchar *)))
 	{
-		gchar *fullitem;
 		gint *value;
-		gchar *where;
-		gint size;
+		const gchar *temp;
 		gchar type;
 		
 		type = item[0];
 		item = &item[2]; /* skip type and '|' */
-		fullitem = g_strdup_printf ("\n%s ", item);
 		value = va_arg (ap, void *);
-		where  = strstr (buf, fullitem);
+		temp = g_hash_table_lookup (values, item);
 		
-		if (where)
+		if (temp)
 		{
-			gchar *temp;
-
-			where = strstr (where, " ") + 1;
-			size = strcspn (where, "\n");
-		
-			temp = g_malloc (size + 1);
-			strncpy (temp, where, size);
-			temp[size] = '\0';
-			
 			switch (type)
 			{
 			case 'i':
@@ -219,6 +705,9 @@ gint fio_get_values_from_file (const gchar *filename, ...)
 			case 'h':
 				*((guint16 *) value) = (guint16) strtoul (temp, NULL, 0);
 				break;
+			case 't':
+				*((guint64 *) value) = g_ascii_strtoull (temp, NULL, 10);
+				break;
 			case 's':
 				g_free (*((gchar **) value));
 				*((gchar **) value) = g_strdup (temp);
@@ -230,30 +719,24 @@ gint fio_get_values_from_file (const gchar *filename, ...)
 				g_warning ("Bad type to fio_get_values_from_file: %c\n", type);
 				break;
 			}
-		
-			g_free (temp);
 		}
-		g_free (fullitem);
 	}
 
 	va_end (ap);
-	g_free (buf);
+	g_hash_table_destroy (values);
 
 	return 0;
 }
 
-/* list is a variable number of (gchar *) / (gchar ** or gint *) groups, 
-	terminated by a NULL variable */
-gint fio_set_values_to_file (const gchar *filename, ...)
+/* Formats item and the (gchar *) / value pairs after it in ap as
+   "key value" lines */
+static gchar *
+fio_format_values_va (const gchar *item, va_list ap)
 {
 	gchar *buf, *tmpbuf;
-	const gchar *item;
-	va_list ap;
-	
-	va_start (ap, filename);
 	
 	buf = g_strdup ("");
-	while ((item = va_arg (ap, gchar *)))
+	for (; item; item = va_arg (ap, gchar *))
 	{
 		gchar *final_string;
 		gchar *value_string;
@@ -275,6 +758,9 @@ gint fio_set_values_to_file (const gchar *filename, ...)
 		case 'u':
 			value_string = g_strdup_printf ("%u", va_arg (ap, guint));
 			break;
+		case 't':
+			value_string = g_strdup_printf ("%" G_GUINT64_FORMAT, va_arg (ap, guint64));
+			break;
 		case 's':
 			value_string = g_strdup_printf ("%s", va_arg (ap, gchar *));
 			break;
@@ -293,12 +779,38 @@ gint fio_set_values_to_file (const gchar *filename, ...)
 		g_free (final_string);
 	}
 	
-	va_end (ap);
-	
 	tmpbuf = buf;
 	buf = g_strconcat (buf, "\n", NULL);
 	g_free (tmpbuf);
 	
+	return buf;
+}
+
+/* The file fio_set_values_to_file would write, as a string.  Must be
+   g_free'd. */
+gchar *fio_format_values (const gchar *first_key, ...)
+{
+	gchar *buf;
+	va_list ap;
+	
+	va_start (ap, first_key);
+	buf = fio_format_values_va (first_key, ap);
+	va_end (ap);
+	
+	return buf;
+}
+
+/* list is a variable number of (gchar *) / (gchar ** or gint *) groups, 
+	terminated by a NULL variable */
+gint fio_set_values_to_file (const gchar *filename, ...)
+{
+	gchar *buf;
+	va_list ap;
+	
+	va_start (ap, filename);
+	buf = fio_format_values_va (va_arg (ap, gchar *), ap);
+	va_end (ap);
+	
 	if (!fio_set_file (filename, buf))
 	{
 		g_free (buf);
@@ -315,5 +827,33 @@ void fio_remove_file (const gchar *filename)
 	file = fio_fill_filename (filename);
 	g_file_delete (file, NULL, NULL);
 	g_object_unref (file);
+	fio_remember_stamp (filename, NULL);
+}
+
+/**
+ * Whether the file still holds what xpad itself last wrote to it.  Only
+ * the stamps of fio_query_stamp are compared, so telling our own writes
+ * from other programs' costs a stat, not a read.
+ */
+gboolean
+fio_is_own_write (const gchar *name)
+{
+	const gchar *stamp;
+	gchar *current;
+	gboolean own;
+	
+	stamp = own_stamps ? g_hash_table_lookup (own_stamps, name) : NULL;
+	if (!stamp)
+		return FALSE;
+	
+	/* Gone again; there is nothing new to read */
+	current = fio_query_stamp (name);
+	if (!current)
+		return TRUE;
+	
+	own = strcmp (stamp, current) == 0;
+	g_free (current);
+	
+	return own;
 }
 
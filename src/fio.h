@@ -21,19 +21,34 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #ifndef _FIO_H_
 #define _FIO_H_
 
-#include <gtk/gtk.h>
+#include <glib.h>
+
+typedef void (*FioErrorFunc) (const gchar *message);
+
+void fio_set_config_dir (const gchar *dir);
+const gchar *fio_get_config_dir (void);
+void fio_set_error_func (FioErrorFunc func);
 
 gchar *fio_get_file (const gchar *name);
+GBytes *fio_get_file_bytes (const gchar *name);
 gboolean fio_set_file (const gchar *name, const gchar *value);
+gboolean fio_set_file_data (const gchar *name, gconstpointer data, gsize size);
+gboolean fio_set_file_compressed (const gchar *name, const gchar *value);
+gboolean fio_set_file_durable (const gchar *name, const gchar *value);
+gboolean fio_create_file (const gchar *name, const gchar *value, gboolean *exists);
+gboolean fio_create_file_compressed (const gchar *name, const gchar *value, gboolean *exists);
 void fio_remove_file (const gchar *filename);
+gboolean fio_is_own_write (const gchar *name);
+void fio_begin_batch (void);
+void fio_end_batch (void);
 
+GHashTable *fio_get_values (const gchar *filename);
 gint fio_get_values_from_file (const gchar *filename, ...);
 gint fio_set_values_to_file (const gchar *filename, ...);
+gchar *fio_format_values (const gchar *first_key, ...);
 
 gchar *str_replace_tokens (gchar **string, gchar obj, gchar *replacement);
 
-gchar *fio_unique_name (const gchar *prefix);
-
 #endif /* _FIO_H_ */
 
 
@@ -17,46 +17,69 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
-/* required by socket stuff */
-/* define _GNU_SOURCE here because that makes our sockets work nice
- Unfortunately, we lose portability... */
-#define _GNU_SOURCE	1
 #include <stdio.h>
-#include <unistd.h>
-#include <sys/un.h>
-#include <sys/socket.h>
-#include <sys/select.h>
-
 #include <string.h>
+#include <unistd.h>
 #include <stdlib.h> /* for exit */
 
 #include "../config.h"
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
+#include <gio/gunixinputstream.h>
 
 #include "fio.h" /* for fio_get_info_from_file */
 #include "help.h"
 #include "prefix.h"
 #include "xpad-app.h"
+#include "xpad-config-monitor.h"
+#include "xpad-import.h"
+#include "xpad-metrics.h"
 #include "xpad-pad.h"
 #include "xpad-pad-group.h"
+#include "xpad-protocol.h"
 #include "xpad-session-manager.h"
+#include "xpad-settings.h"
+#include "xpad-snapshot.h"
+#include "xpad-store.h"
+#include "xpad-trace.h"
 #include "xpad-tray.h"
 
-/* Seems that some systems (sun-sparc-solaris2.8 at least), need the following three #defines. 
-   These were provided by Alan Mizrahi <alan@cesma.usb.ve>.
-*/
-#ifndef PF_LOCAL
-#define PF_LOCAL PF_UNIX
-#endif
+/* Hidden pads are built in idle slices of about this many microseconds */
+#define LOAD_SLICE_USEC 8000
 
-#ifndef AF_LOCAL
-#define AF_LOCAL AF_UNIX
-#endif
+/* An export looks at this many saved pads per part of its answer, so one
+   that matches little still hands the main loop back regularly */
+#define EXPORT_PADS_PER_PART 64
 
-#ifndef SUN_LEN
-#define SUN_LEN(sunp) ((size_t)((struct sockaddr_un *)0)->sun_path + strlen((sunp)->sun_path))
-#endif
+/* and sends the part early once it holds this many bytes */
+#define EXPORT_PART_SIZE 65536
+
+/* File lists for an import are split into requests of about this size */
+#define IMPORT_REQUEST_SIZE (256 * 1024)
+
+/* Notes saved by one XPAD_COMMAND_IMPORT, shared by their queued pads */
+typedef struct
+{
+	GPtrArray *notes;
+	XpadPadInfo info;
+} PendingImport;
+
+typedef struct
+{
+	gchar *name;
+	gint x, y;
+	gboolean show;
+	PendingImport *import; /* NULL unless note is to be built from memory */
+	XpadImportNote *note;
+} PendingPad;
+
+/* A running XPAD_COMMAND_EXPORT */
+typedef struct
+{
+	XpadStore *store;
+	GRegex *regex;
+	gchar *target;
+} ExportState;
 
 
 static gint xpad_argc;
@@ -68,28 +91,49 @@ static gboolean option_show;
 static gboolean option_toggle;
 static gboolean option_version;
 static gboolean option_quit;
+static gchar *option_stats;
+static gchar *option_export;
 static gchar **option_files;
+static gchar **option_follow;
+static gchar *option_import;
 static gchar *option_smid;
+static gchar *option_append;
+static gchar *option_prepend;
+static gchar *option_replace;
+static gchar *option_pad;
+static gint option_max_lines;
+static gboolean option_stream_stdin;
+static gchar *option_trace;
 static gchar *config_dir;
 static gchar *program_path;
 static gchar *server_filename;
-static gint server_fd;
-static FILE *output;
 static gboolean xpad_translucent = FALSE;
 static XpadPadGroup *pad_group;
 static gint pads_loaded_on_start = 0;
+static GArray *pending_pads = NULL;
+static guint next_pending_pad = 0;
+static XpadSnapshot *startup_snapshot = NULL;
+static gboolean loading_startup_pads = FALSE;
+static gint64 load_pads_begin = 0;
+static XpadAppLoadedFunc pads_loaded_func = NULL;
+static gpointer pads_loaded_data = NULL;
 
 static gboolean  process_local_args         (gint *argc, gchar **argv[]);
-static gboolean  process_remote_args        (gint *argc, gchar **argv[], gboolean have_gtk);
+static GArray   *process_remote_args        (gint *argc, gchar **argv[]);
 
 static gboolean  config_dir_exists          (void);
 static gchar    *make_config_dir            (void);
 static void      register_stock_icons       (void);
-static gint      xpad_app_load_pads         (void);
 static gboolean  xpad_app_quit_if_no_pads   (XpadPadGroup *group);
 static gboolean  xpad_app_first_idle_check  (XpadPadGroup *group);
-static gboolean  xpad_app_pass_args         (void);
-static gboolean  xpad_app_open_proc_file    (void);
+static void      xpad_app_pad_added         (XpadPadGroup *group, XpadPad *pad);
+static void      xpad_app_startup_finished  (gpointer data);
+static void      xpad_app_report_error      (const gchar *message);
+static gboolean  xpad_app_pass_args         (GArray *requests, gint *status);
+static void      xpad_app_run_requests      (GArray *requests);
+static gboolean  xpad_app_export_only       (GArray *requests);
+static XpadStatus xpad_app_run_command      (const XpadRequest *request, GString *output, XpadReply *reply, gpointer data);
+static void      update_pad_metrics         (void);
 
 typedef struct
 {
@@ -101,25 +145,69 @@ static void     xpad_dialog_response_cb     (GtkDialog *dialog, gint response_id
 static gboolean xpad_dialog_close_request_cb(GtkWindow *window, gpointer user_data);
 static void     xpad_dialog_emit_response   (GtkWidget *widget, gpointer user_data);
 
-static void
-xpad_app_init (int argc, char **argv)
+/* --trace is looked for before the options are parsed, so that the
+   phases leading up to the parse are traced too */
+static const gchar *
+find_trace_option (gint argc, gchar **argv)
+{
+	gint i;
+	
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp (argv[i], "--trace") && i + 1 < argc)
+			return argv[i + 1];
+		if (g_str_has_prefix (argv[i], "--trace="))
+			return argv[i] + strlen ("--trace=");
+	}
+	
+	return NULL;
+}
+
+void
+xpad_app_init (gint argc, gchar **argv)
 {
 	gboolean first_time;
+	GArray *requests;
+	GError *error = NULL;
+	gint64 span;
+	gint status;
+
+	xpad_trace_init (find_trace_option (argc, argv));
+
+	xpad_argc = argc;
+	xpad_argv = argv;
+
+	process_local_args (&xpad_argc, &xpad_argv);
+	requests = process_remote_args (&xpad_argc, &xpad_argv);
+
+	/* Most runs only hand their arguments to the instance that is already
+	   running, so that is tried before anything touches the display or
+	   the disk.  If the config dir isn't there yet, nobody is listening. */
+	span = xpad_trace_begin ();
+	server_filename = g_build_filename (g_get_user_config_dir (), PACKAGE, "server", NULL);
+	if (xpad_app_pass_args (requests, &status))
+		exit (status);
+	xpad_trace_end (span, "xpad_app_pass_args", NULL);
+
+	/* With nobody running, an export only needs the files */
+	if (xpad_app_export_only (requests))
+		exit (0);
 
 	/* GTK4: gtk_init_check takes no arguments; returns FALSE if init fails */
+	span = xpad_trace_begin ();
 	if (!gtk_init_check ())
 	{
 		fprintf (stderr, "%s\n", "Xpad is a graphical program.  Please run it from your desktop.");
 		exit (1);
 	}
-	xpad_argc = argc;
-	xpad_argv = argv;
-	output = stdout;
+	xpad_trace_end (span, "gtk_init", NULL);
 
+	span = xpad_trace_begin ();
 	first_time = !config_dir_exists ();
 	config_dir = make_config_dir ();
-
-	server_filename = g_build_filename (xpad_app_get_config_dir (), "server", NULL);
+	fio_set_config_dir (config_dir);
+	fio_set_error_func (xpad_app_report_error);
+	xpad_trace_end (span, "make_config_dir", NULL);
 
 	g_set_application_name (_("Xpad"));
 
@@ -130,23 +218,28 @@ xpad_app_init (int argc, char **argv)
 	else
 		program_path = NULL;
 
-	process_local_args (&xpad_argc, &xpad_argv);
-
-	if (xpad_app_pass_args ())
-		exit (0);
-
-	xpad_app_open_proc_file ();
+	/* Requests name pads, which are only all there once startup is done,
+	   see xpad_app_startup_finished */
+	xpad_protocol_hold (TRUE);
+	if (!xpad_protocol_serve (server_filename, xpad_app_run_command, NULL, &error))
+	{
+		g_warning ("%s", error->message);
+		g_error_free (error);
+	}
 
 	register_stock_icons ();
 	gtk_window_set_default_icon_name (PACKAGE);
 
+	span = xpad_trace_begin ();
 	pad_group = xpad_pad_group_new ();
-	process_remote_args (&xpad_argc, &xpad_argv, TRUE);
+	g_signal_connect (pad_group, "pad-added", G_CALLBACK (xpad_app_pad_added), NULL);
 
 	xpad_tray_open ();
 	xpad_session_manager_init ();
+	xpad_trace_end (span, "tray and session", NULL);
 
-	pads_loaded_on_start = xpad_app_load_pads ();
+	/* Run once the pads are there, as edits name a pad */
+	pads_loaded_on_start = xpad_app_load_pads (xpad_app_startup_finished, requests);
 	if (pads_loaded_on_start == 0 && !option_new)
 	{
 		if (!option_nonew)
@@ -156,8 +249,6 @@ xpad_app_init (int argc, char **argv)
 		}
 	}
 
-	g_idle_add ((GSourceFunc) xpad_app_first_idle_check, pad_group);
-
 	if (first_time)
 		show_help ();
 
@@ -165,23 +256,34 @@ xpad_app_init (int argc, char **argv)
 	server_filename = NULL;
 }
 
-
-gint main (gint argc, gchar **argv)
+/**
+ * Sets up only the config dir and an empty pad group, for programs that
+ * drive pads without the rest of xpad, like xpad-bench.  May be called
+ * again to switch to another config dir, which drops the old group and
+ * its pads.
+ */
+void
+xpad_app_init_headless (const gchar *dir)
 {
-	GMainLoop *loop;
+	g_free (config_dir);
+	config_dir = g_strdup (dir);
+	fio_set_config_dir (config_dir);
 	
-	xpad_app_init (argc, argv);
-	
-	loop = g_main_loop_new (NULL, FALSE);
-	g_main_loop_run (loop);
-	g_main_loop_unref (loop);
-	
-	return 0;
+	if (pad_group)
+		g_object_unref (pad_group);
+	pad_group = xpad_pad_group_new ();
 }
 
 
 
 
+/* Errors from below the GUI, as from fio */
+static void
+xpad_app_report_error (const gchar *message)
+{
+	xpad_app_error (NULL, message, NULL);
+}
+
 /* parent and secondary may be NULL.
  * Returns when user dismisses error.
  */
@@ -278,6 +380,22 @@ xpad_dialog_run (GtkDialog *dialog)
 
 
 
+/* Every clean exit goes through here: whatever is still waiting on a
+   timer is written, then the startup snapshot. */
+void
+xpad_app_quit (void)
+{
+	if (pad_group)
+	{
+		xpad_pad_group_flush_pending (pad_group);
+		xpad_snapshot_save (pad_group);
+	}
+	xpad_settings_flush (xpad_settings ());
+	
+	exit (0);
+}
+
+
 const gchar *
 xpad_app_get_config_dir (void)
 {
@@ -475,7 +593,7 @@ xpad_app_quit_if_no_pads (XpadPadGroup *group)
 		gint num_pads = xpad_pad_group_num_visible_pads (group);
 		if (num_pads == 0)
 		{
-			exit (0);
+			xpad_app_quit ();
 		}
 	}
 	
@@ -486,8 +604,9 @@ xpad_app_quit_if_no_pads (XpadPadGroup *group)
 static gboolean
 xpad_app_first_idle_check (XpadPadGroup *group)
 {
-	/* We do this check at the first idle rather than immediately during
-	   start because we want to give the tray time to become embedded. */
+	/* We do this check at the first idle after every pad is loaded rather
+	   than immediately during start because we want to give the tray time
+	   to become embedded. */
 	if (!xpad_tray_is_open () &&
 	    xpad_pad_group_num_visible_pads (group) == 0)
 	{
@@ -517,15 +636,167 @@ xpad_app_pad_added (XpadPadGroup *group, XpadPad *pad)
 }
 
 
-/* Scans config directory for pad files and loads them. */
+static void
+pending_import_clear (PendingImport *import)
+{
+	g_ptr_array_unref (import->notes);
+}
+
+static void
+pending_pad_clear (PendingPad *pending)
+{
+	g_free (pending->name);
+	if (pending->import)
+		g_rc_box_release_full (pending->import, (GDestroyNotify) pending_import_clear);
+}
+
+/* Shown pads first, then top to bottom and left to right */
 static gint
-xpad_app_load_pads (void)
+pending_pad_compare (const PendingPad *a, const PendingPad *b)
+{
+	if (a->show != b->show)
+		return a->show ? -1 : 1;
+	if (a->y != b->y)
+		return a->y < b->y ? -1 : 1;
+	if (a->x != b->x)
+		return a->x < b->x ? -1 : 1;
+	return 0;
+}
+
+static void
+xpad_app_load_pad (const PendingPad *pending)
+{
+	const gchar *name = pending->name;
+	gboolean show = TRUE;
+	gint64 span = xpad_trace_begin ();
+	GtkWidget *pad;
+	
+	if (pending->import)
+	{
+		XpadPadInfo info = pending->import->info;
+		
+		info.id = pending->note->id;
+		info.contentname = pending->note->contentname;
+		xpad_pad_new_with_cached_info (pad_group, name, &info, pending->note->text, pending->note->spans, &show);
+		xpad_trace_end (span, "import pad", name);
+		return;
+	}
+	
+	pad = xpad_snapshot_restore_pad (startup_snapshot, pad_group, name, &show);
+	
+	if (pad)
+	{
+		xpad_trace_end (span, "restore pad", name);
+		xpad_metrics_add (XPAD_METRIC_PADS_RESTORED, 1);
+	}
+	else
+	{
+		span = xpad_trace_begin ();
+		pad = xpad_pad_new_with_info (pad_group, name, &show);
+		xpad_trace_end (span, "load pad", name);
+	}
+	
+	span = xpad_trace_begin ();
+	if ((show || option_show) && !option_hide)
+		gtk_widget_set_visible (pad, TRUE);
+	else if (show) /* pad thought it would show, we should save that it didn't */
+		xpad_pad_save_info (XPAD_PAD (pad));
+	xpad_trace_end (span, "show pad", name);
+}
+
+static void
+xpad_app_load_pads_finished (void)
+{
+	g_array_free (pending_pads, TRUE);
+	pending_pads = NULL;
+	
+	if (!loading_startup_pads)
+		return;
+	
+	loading_startup_pads = FALSE;
+	xpad_snapshot_free (startup_snapshot);
+	startup_snapshot = NULL;
+	xpad_trace_end (load_pads_begin, "xpad_app_load_pads", NULL);
+	
+	if (pads_loaded_func)
+		pads_loaded_func (pads_loaded_data);
+}
+
+/* Everything that waits until the last pad is built */
+static void
+xpad_app_startup_finished (gpointer data)
+{
+	GArray *requests = data;
+	
+	xpad_app_run_requests (requests);
+	g_array_unref (requests);
+	xpad_protocol_hold (FALSE);
+	
+	if (option_stream_stdin)
+		fprintf (stderr, "%s\n", _("Reading from standard input needs xpad to be running already."));
+	
+	xpad_config_monitor_start (pad_group);
+	
+	g_idle_add ((GSourceFunc) xpad_app_first_idle_check, pad_group);
+}
+
+static gboolean
+xpad_app_load_hidden_pads (gpointer data)
+{
+	gint64 deadline = g_get_monotonic_time () + LOAD_SLICE_USEC;
+	
+	do
+	{
+		if (next_pending_pad >= pending_pads->len)
+		{
+			xpad_app_load_pads_finished ();
+			return G_SOURCE_REMOVE;
+		}
+		
+		xpad_app_load_pad (&g_array_index (pending_pads, PendingPad, next_pending_pad++));
+	}
+	while (g_get_monotonic_time () < deadline);
+	
+	return G_SOURCE_CONTINUE;
+}
+
+/* One pad per iteration, so each one gets painted before the next is built */
+static gboolean
+xpad_app_load_visible_pads (gpointer data)
+{
+	if (next_pending_pad < pending_pads->len &&
+	    g_array_index (pending_pads, PendingPad, next_pending_pad).show)
+	{
+		xpad_app_load_pad (&g_array_index (pending_pads, PendingPad, next_pending_pad++));
+		return G_SOURCE_CONTINUE;
+	}
+	
+	g_idle_add_full (G_PRIORITY_LOW, xpad_app_load_hidden_pads, NULL, NULL);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * Scans config directory for pad files and queues them for loading.
+ * Returns the number of pads queued; loaded is called once the last of
+ * them is built.
+ *
+ * Nothing is built here.  The queue is ordered from where each pad was
+ * and whether it showed, as the snapshot remembers it or, for pads it
+ * doesn't know, as the info file says.  Shown pads are then built one per
+ * idle iteration and hidden ones in time-boxed slices at low priority, so
+ * the first pad is on screen after the same work no matter how many pads
+ * there are.
+ */
+gint
+xpad_app_load_pads (XpadAppLoadedFunc loaded, gpointer user_data)
 {
-	gint opened = 0;
 	GDir *dir;
 	const gchar *name;
+	gint64 span;
 	
-	g_signal_connect (pad_group, "pad-added", G_CALLBACK (xpad_app_pad_added), NULL);
+	load_pads_begin = xpad_trace_begin ();
+	pads_loaded_func = loaded;
+	pads_loaded_data = user_data;
 	
 	dir = g_dir_open (xpad_app_get_config_dir (), 0, NULL);
 	
@@ -542,26 +813,58 @@ xpad_app_load_pads (void)
 		exit (1);
 	}
 	
+	/* Pads whose files didn't change since the last clean exit come from
+	   here, without being parsed again */
+	span = xpad_trace_begin ();
+	startup_snapshot = xpad_snapshot_load ();
+	xpad_trace_end (span, "xpad_snapshot_load", NULL);
+	
+	span = xpad_trace_begin ();
+	pending_pads = g_array_new (FALSE, FALSE, sizeof (PendingPad));
+	g_array_set_clear_func (pending_pads, (GDestroyNotify) pending_pad_clear);
+	next_pending_pad = 0;
+	loading_startup_pads = TRUE;
+	
 	while ((name = g_dir_read_name (dir)))
 	{
 		/* if it's an info file, but not a backup info file... */
 		if (!strncmp (name, "info-", 5) &&
 		    name[strlen (name) - 1] != '~')
 		{
-			gboolean show = TRUE;
-			GtkWidget *pad = xpad_pad_new_with_info (pad_group, name, &show);
-			if ((show || option_show) && !option_hide)
-				gtk_widget_set_visible (pad, TRUE);
-		  else if (show) /* pad thought it would show, we should save that it didn't */
-		    xpad_pad_save_info (XPAD_PAD (pad));
+			PendingPad pending;
+			gboolean hidden = FALSE;
+			
+			pending.name = g_strdup (name);
+			pending.x = pending.y = 0;
+			pending.import = NULL;
+			pending.note = NULL;
 			
-			opened ++;
+			if (!xpad_snapshot_peek (startup_snapshot, name, &pending.x, &pending.y, &hidden))
+			{
+				XpadPadInfo info;
+				
+				xpad_pad_info_init (&info);
+				if (xpad_pad_info_read (name, &info))
+				{
+					pending.x = info.x;
+					pending.y = info.y;
+					hidden = info.hidden;
+				}
+				xpad_pad_info_clear (&info);
+			}
+			
+			pending.show = (!hidden || option_show) && !option_hide;
+			g_array_append_val (pending_pads, pending);
 		}
 	}
 	
 	g_dir_close (dir);
 	
-	return opened;
+	g_array_sort (pending_pads, (GCompareFunc) pending_pad_compare);
+	xpad_trace_end (span, "scan pads", NULL);
+	g_idle_add (xpad_app_load_visible_pads, NULL);
+	
+	return pending_pads->len;
 }
 
 
@@ -575,268 +878,397 @@ xpad_app_load_pads (void)
 
 
 
-/*
-converts main program arguments into one long string.
-puts allocated string in dest, and returns size
-*/
-static gint
-args_to_string (int argc, char **argv, char **dest)
+/* Pads are named by ID or info file, which never change, or by title */
+static XpadPad *
+xpad_app_find_pad (const gchar *name)
 {
-	gint i;
-	gint size = 0;
-	gchar *p;
+	GSList *pads, *l;
+	XpadPad *found = NULL, *by_title = NULL;
+	guint64 id;
 	
-	for (i = 0; i < argc; i++)
-		size += strlen (argv[i]) + 1;
+	if (!name)
+		return NULL;
 	
-	*dest = g_malloc (size);
+	if (xpad_pad_id_parse (name, &id) && (found = XPAD_PAD (xpad_pad_group_lookup (pad_group, id))))
+		return found;
 	
-	p = *dest;
+	pads = xpad_pad_group_get_pads (pad_group);
+	for (l = pads; l && !found; l = l->next)
+	{
+		if (!g_strcmp0 (xpad_pad_get_info_filename (XPAD_PAD (l->data)), name))
+			found = XPAD_PAD (l->data);
+		else if (!by_title && !g_strcmp0 (gtk_window_get_title (GTK_WINDOW (l->data)), name))
+			by_title = XPAD_PAD (l->data);
+	}
+	g_slist_free (pads);
 	
-	for (i = 0; i < argc; i++)
+	return found ? found : by_title;
+}
+
+/* Returns NULL, with the reason in output, if the pattern is no good */
+static ExportState *
+export_state_new (const XpadRequest *request, GString *output)
+{
+	ExportState *export;
+	GRegex *regex = NULL;
+	GError *error = NULL;
+	
+	if (request->arg)
 	{
-		strcpy (p, argv[i]);
-		p += strlen (argv[i]);
-		p[0] = ' ';
-		p += 1;
+		regex = g_regex_new (request->arg, G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &error);
+		if (!regex)
+		{
+			g_string_append_printf (output, "%s\n", error->message);
+			g_error_free (error);
+			return NULL;
+		}
 	}
 	
-	p --;
-	p[0] = '\0';
+	export = g_new (ExportState, 1);
+	export->store = xpad_store_open ();
+	export->regex = regex;
+	export->target = g_strdup (request->target);
 	
-	return size;
+	return export;
 }
 
+static void
+export_state_free (ExportState *export)
+{
+	xpad_store_close (export->store);
+	if (export->regex)
+		g_regex_unref (export->regex);
+	g_free (export->target);
+	g_free (export);
+}
 
-/*
-returns number of strings in newly allocated argv
-*/
-static gint
-string_to_args (const char *string, char ***argv)
+/* Appends the next few matching pads as JSON lines.  Returns FALSE once
+   every pad was looked at. */
+static gboolean
+export_state_next (GString *output, ExportState *export)
 {
-	gint num, i;
-	const gchar *tmp;
-	char **list;
-	
-	/* first, find out how many arguments we have */
-	num = 1;
-	for (tmp = strchr (string, ' '); tmp; tmp = strchr (tmp+1, ' '))
-	  num++;
-	
-	list = (char **) g_malloc (sizeof (char *) * (num + 1));
+	XpadStorePad pad;
+	gint i;
 	
-	for (i = 0; i < num; i++)
+	for (i = 0; i < EXPORT_PADS_PER_PART && output->len < EXPORT_PART_SIZE; i++)
 	{
-		size_t len;
+		gchar *title, *text = NULL;
+		XpadPad *live;
 		
-		/* string points to beginning of current arg */
-		tmp = strchr (string, ' '); /* NULL or end of this arg */
+		if (!export->store || !xpad_store_next (export->store, &pad))
+			return FALSE;
 		
-		if (tmp) len = tmp - string;
-		else   len = strlen (string);
-		
-		list[i] = g_malloc (len + 1);
-		strncpy (list[i], string, len);
-		list[i][len] = '\0';
+		/* Followed pads keep their text in memory only */
+		if (pad.info.followname && pad_group && (live = xpad_app_find_pad (pad.infoname)))
+		{
+			text = xpad_pad_get_text (live);
+			pad.text = text;
+		}
 		
-		/* make string point to beginning of next arg */
-		string = tmp + 1;
+		title = xpad_store_get_title (&pad);
+		if ((!export->target || xpad_store_pad_matches (&pad, export->target)) &&
+		    (!export->regex || g_regex_match (export->regex, title, 0, NULL) ||
+		     g_regex_match (export->regex, pad.text, 0, NULL)))
+			xpad_store_append_json (output, &pad);
+		g_free (title);
+		g_free (text);
 	}
 	
-	list[i] = NULL;	/* null terminate list */
-	
-	*argv = list;
-	
-	return num;
+	return TRUE;
 }
 
-#include <errno.h>
-/* This reads a line from the proc file.  This line will contain arguments to process. */
+/**
+ * Turns the notes read for XPAD_COMMAND_IMPORT into hidden pads, none
+ * of which is realized until it is shown.
+ *
+ * The files are all written here, but the pads are queued behind any
+ * still loading and built in the same low priority slices as hidden pads
+ * at startup, so a large import doesn't stall the pads already open.
+ */
 static void
-xpad_app_read_from_proc_file (void)
-{
-	gint client_fd, size;
-	gint argc;
-	gchar **argv;
-	gchar *args;
-	struct sockaddr_un client;
-	socklen_t client_len;
-	size_t bytes;
-	
-	/* accept waiting connection */
-	client_len = sizeof (client);
-	client_fd = accept (server_fd, (struct sockaddr *) &client, &client_len);
-	if (client_fd == -1)
-		return;
-	
-	/* get size of args */
-	bytes = read (client_fd, &size, sizeof (size));
-	if (bytes != sizeof(size))
-		goto close_client_fd;
-	
-	/* alloc memory */
-	args = (gchar *) g_malloc (size);
-	if (!args)
-		goto close_client_fd;
-	
-	/* read args */
-	bytes = read (client_fd, args, size);
-	if (bytes < size)
-		goto close_client_fd;
+xpad_app_import_done (GPtrArray *notes, guint n_failed, gpointer data)
+{
+	PendingImport *import;
+	gint64 span = xpad_trace_begin ();
+	gboolean loading = pending_pads != NULL;
+	guint i;
 	
-	argc = string_to_args (args, &argv);
+	if (n_failed > 0)
+		g_warning ("Could not read %u of the files to import", n_failed);
 	
-	g_free (args);
+	import = g_rc_box_new (PendingImport);
+	import->notes = g_ptr_array_ref (notes);
+	xpad_pad_info_init_new (&import->info);
+	import->info.hidden = TRUE;
+	xpad_import_save (notes, &import->info);
 	
-	/* here we redirect singleton->priv->output to the socket */
-	output = fdopen (client_fd, "w");
+	if (!pending_pads)
+	{
+		pending_pads = g_array_new (FALSE, FALSE, sizeof (PendingPad));
+		g_array_set_clear_func (pending_pads, (GDestroyNotify) pending_pad_clear);
+		next_pending_pad = 0;
+	}
 	
-	if (!process_remote_args (&argc, &argv, TRUE))
+	for (i = 0; i < notes->len; i++)
 	{
-		/* if there were no non-local arguments, insert --new as argument */
-		gint c = 2;
-		gchar **v = g_malloc (sizeof (gchar *) * c);
-		v[0] = PACKAGE;
-		v[1] = "--new";
+		XpadImportNote *note = g_ptr_array_index (notes, i);
+		PendingPad pending;
 		
-		process_remote_args (&c, &v, TRUE);
+		if (!note->infoname)
+			continue;
 		
-		g_free (v);
+		pending.name = g_strdup (note->infoname);
+		pending.x = pending.y = 0;
+		pending.show = FALSE;
+		pending.import = g_rc_box_acquire (import);
+		pending.note = note;
+		g_array_append_val (pending_pads, pending);
 	}
 	
-	/* restore standard singleton->priv->output */
-	fclose (output);
-	output = stdout;
+	g_rc_box_release_full (import, (GDestroyNotify) pending_import_clear);
 	
-	g_strfreev (argv);
-	return;
+	/* Otherwise the loader already running gets to them */
+	if (!loading)
+		g_idle_add_full (G_PRIORITY_LOW, xpad_app_load_hidden_pads, NULL, NULL);
 	
-close_client_fd:
-	close (client_fd);
+	xpad_trace_end (span, "import", NULL);
 }
 
+/* Runs one request from another xpad, or from our own command line */
+static XpadStatus
+xpad_app_run_command (const XpadRequest *request, GString *output, XpadReply *reply, gpointer data)
+{
+	const gchar *arg = request->arg;
+	GtkWidget *pad;
+	XpadPad *target;
+	ExportState *export;
+	gchar *stats;
+	
+	switch (request->command)
+	{
+	case XPAD_COMMAND_NEW:
+		pad = xpad_pad_new (pad_group);
+		gtk_widget_set_visible (pad, TRUE);
+		break;
+	case XPAD_COMMAND_NEW_FROM_FILE:
+		pad = arg ? xpad_pad_new_from_file (pad_group, arg) : NULL;
+		if (!pad)
+			return XPAD_STATUS_FAILED;
+		gtk_widget_set_visible (pad, TRUE);
+		break;
+	case XPAD_COMMAND_FOLLOW:
+		if (!arg)
+			return XPAD_STATUS_FAILED;
+		pad = xpad_pad_new_following (pad_group, arg, request->max_lines);
+		gtk_widget_set_visible (pad, TRUE);
+		break;
+	case XPAD_COMMAND_SHOW:
+		xpad_pad_group_show_all (pad_group);
+		break;
+	case XPAD_COMMAND_HIDE:
+		xpad_pad_group_close_all (pad_group);
+		break;
+	case XPAD_COMMAND_TOGGLE:
+		xpad_pad_group_toggle_hide (pad_group);
+		break;
+	case XPAD_COMMAND_QUIT:
+		xpad_app_quit ();
+		break;
+	case XPAD_COMMAND_SESSION_ID:
+		if (arg)
+			xpad_session_manager_set_id (arg);
+		break;
+	case XPAD_COMMAND_STATS:
+		update_pad_metrics ();
+		stats = xpad_metrics_to_string (!g_strcmp0 (arg, "json"));
+		g_string_append (output, stats);
+		g_free (stats);
+		break;
+	case XPAD_COMMAND_APPEND:
+	case XPAD_COMMAND_PREPEND:
+	case XPAD_COMMAND_REPLACE:
+		target = xpad_app_find_pad (request->target);
+		if (!target)
+		{
+			g_string_append_printf (output, _("No pad is called \"%s\"."), request->target ? request->target : "");
+			g_string_append (output, "\n");
+			return XPAD_STATUS_FAILED;
+		}
+		xpad_pad_queue_edit (target,
+			request->command == XPAD_COMMAND_APPEND ? XPAD_PAD_EDIT_APPEND :
+			request->command == XPAD_COMMAND_PREPEND ? XPAD_PAD_EDIT_PREPEND : XPAD_PAD_EDIT_REPLACE,
+			arg ? arg : "", request->max_lines);
+		break;
+	case XPAD_COMMAND_IMPORT:
+		if (arg)
+		{
+			gchar **files = g_strsplit (arg, "\n", -1);
+			xpad_import_files (files, xpad_app_import_done, NULL);
+			g_strfreev (files);
+		}
+		break;
+	case XPAD_COMMAND_EXPORT:
+		/* The files are read rather than the pads, so they must be current */
+		if (pad_group)
+			xpad_pad_group_flush_pending (pad_group);
+		export = export_state_new (request, output);
+		if (!export)
+			return XPAD_STATUS_FAILED;
+		if (reply)
+		{
+			xpad_reply_stream (reply, (XpadReplyFunc) export_state_next, export, (GDestroyNotify) export_state_free);
+			break;
+		}
+		/* Our own command line, straight to the terminal part by part */
+		while (export_state_next (output, export))
+		{
+			fputs (output->str, stdout);
+			g_string_truncate (output, 0);
+		}
+		export_state_free (export);
+		break;
+	default:
+		return XPAD_STATUS_UNKNOWN_COMMAND;
+	}
+	
+	return XPAD_STATUS_OK;
+}
 
-static gboolean
-can_read_from_server_fd (GIOChannel *source, GIOCondition condition, gpointer data)
+static void
+xpad_app_run_requests (GArray *requests)
 {
-	xpad_app_read_from_proc_file ();
+	GString *output = g_string_new (NULL);
+	guint i;
 	
-	return TRUE;
+	for (i = 0; i < requests->len; i++)
+	{
+		xpad_app_run_command (&g_array_index (requests, XpadRequest, i), output, NULL, NULL);
+	}
+	
+	fputs (output->str, stdout);
+	g_string_free (output, TRUE);
 }
 
+/* Sends requests, printing what goes wrong if the running xpad cannot
+   answer them all */
 static gboolean
-xpad_app_open_proc_file (void)
+xpad_app_call (XpadProtocolClient *client, const XpadRequest *requests, guint n_requests)
 {
-	GIOChannel *channel;
-	struct sockaddr_un master;
+	GError *error = NULL;
 	
-	g_unlink (server_filename);
+	if (xpad_protocol_client_call (client, requests, n_requests, stdout, &error))
+		return TRUE;
 	
-	/* create the socket */
-	server_fd = socket (PF_LOCAL, SOCK_STREAM, 0);
-	bzero (&master, sizeof (master)); 
-	master.sun_family = AF_LOCAL;
-	strcpy (master.sun_path, server_filename);
+	fprintf (stderr, "%s\n", error->message);
+	g_error_free (error);
 	
-	if (bind (server_fd, (struct sockaddr *) &master, SUN_LEN (&master)))
-		return FALSE;
+	return FALSE;
+}
+
+/* Sends standard input on as it arrives, one append per read, so a fast
+   writer is batched and a slow one is not held back.  Only whole lines
+   go out until the end, unless a line grows longer than one message
+   holds; then the part of it read so far goes on ahead. */
+static gboolean
+xpad_app_stream_stdin (XpadProtocolClient *client)
+{
+	XpadRequest request = { XPAD_COMMAND_APPEND, option_pad, NULL, MAX (option_max_lines, 0) };
+	GInputStream *in = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+	GString *pending = g_string_new (NULL);
+	gchar buf[65536];
+	gssize n;
+	gboolean ok = TRUE;
+	
+	while (ok && (n = g_input_stream_read (in, buf, sizeof (buf), NULL, NULL)) > 0)
+	{
+		const gchar *newline;
+		gsize len;
+		
+		g_string_append_len (pending, buf, n);
+		newline = g_strrstr_len (pending->str, pending->len, "\n");
+		if (newline)
+			len = newline - pending->str + 1;
+		else if (pending->len >= XPAD_PROTOCOL_MAX_TEXT)
+			len = xpad_protocol_text_part (pending->str, pending->len);
+		else
+			continue;
+		
+		request.arg = g_strndup (pending->str, len);
+		g_string_erase (pending, 0, len);
+		ok = xpad_app_call (client, &request, 1);
+		g_free (request.arg);
+		fflush (stdout);
+	}
 	
-	/* listen for connections */
-	if (listen (server_fd, 5))
-		return FALSE;
+	if (ok && pending->len > 0)
+	{
+		request.arg = pending->str;
+		ok = xpad_app_call (client, &request, 1);
+	}
 	
-	/* set up input loop, waiting for read */
-	channel = g_io_channel_unix_new (server_fd);
-	g_io_add_watch (channel, G_IO_IN, can_read_from_server_fd, NULL);
-	g_io_channel_unref (channel);
+	g_string_free (pending, TRUE);
+	g_object_unref (in);
 	
-	return TRUE;
+	return ok;
 }
 
-
+/* Hands the requests to the running xpad and prints what it answers,
+   setting status to what this process should exit with.  Returns FALSE
+   if there is no running xpad. */
 static gboolean
-xpad_app_pass_args (void)
+xpad_app_pass_args (GArray *requests, gint *status)
 {
-	int client_fd;
-	struct sockaddr_un master;
-	fd_set fdset;
-	gchar buf [129];
-	gchar *args = NULL;
-	gint size;
-	gint bytesRead;
-	gboolean connected = FALSE;
-	
-	/* create master socket */
-	client_fd = socket (PF_LOCAL, SOCK_STREAM, 0);
-	master.sun_family = AF_LOCAL;
-	strcpy (master.sun_path, server_filename);
+	XpadRequest new_pad = { XPAD_COMMAND_NEW, NULL, NULL, 0 };
+	XpadProtocolClient *client;
+	gboolean ok = TRUE;
 	
-	/* connect to master socket */
-	if (connect (client_fd, (struct sockaddr *) &master, SUN_LEN (&master)))
-		goto done;
-	connected = TRUE;
+	client = xpad_protocol_client_new (server_filename);
+	if (!client)
+		return FALSE;
 	
-	size = args_to_string (xpad_argc, xpad_argv, &args) + 1;
+	/* Starting xpad again without arguments means another pad */
+	if (requests->len == 0 && !option_stream_stdin)
+		ok = xpad_app_call (client, &new_pad, 1);
+	else if (requests->len > 0)
+		ok = xpad_app_call (client, (XpadRequest *) requests->data, requests->len);
 	
-	/* first, write length of string */
-	write (client_fd, &size, sizeof (size));
+	if (ok && option_stream_stdin)
+	{
+		fflush (stdout);
+		ok = xpad_app_stream_stdin (client);
+	}
 	
-	/* now, write string */
-	write (client_fd, args, size);
+	xpad_protocol_client_free (client);
+	*status = ok ? 0 : 1;
 	
-	do
-	{
-		/* wait for response */
-		FD_ZERO (&fdset);
-		FD_SET (client_fd, &fdset);	
-		/* block until we are answered, or an error occurs */
-		select (client_fd + 1, &fdset, NULL, &fdset, NULL);
-		
-		do
-		{
-			bytesRead = read (client_fd, buf, 128);
-			
-			if (bytesRead < 0)
-			{
-			  goto done;
-			}
+	return TRUE;
+}
 
-			buf[bytesRead] = '\0';
-			printf ("%s", buf);
-		}
-		while (bytesRead > 0);
-	}
-	while (bytesRead > 0);
+/* Exports need nothing but the pad files, so when they are all that was
+   asked for they run here, without a display.  Returns FALSE if there is
+   more to do. */
+static gboolean
+xpad_app_export_only (GArray *requests)
+{
+	guint i;
+	
+	if (requests->len == 0 || option_stream_stdin)
+		return FALSE;
+	
+	for (i = 0; i < requests->len; i++)
+		if (g_array_index (requests, XpadRequest, i).command != XPAD_COMMAND_EXPORT)
+			return FALSE;
 	
-done:
-	close (client_fd);
+	if (!config_dir_exists ())
+		return TRUE;
 	
-	g_free (args);
+	config_dir = g_build_filename (g_get_user_config_dir (), PACKAGE, NULL);
+	fio_set_config_dir (config_dir);
+	xpad_app_run_requests (requests);
 	
-	return connected;
+	return TRUE;
 }
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
 /**
  * Here are the functions called when arguments are passed to us.
  */
@@ -845,9 +1277,61 @@ static GOptionEntry local_options[] =
 {
 	{"version", 'v', 0, G_OPTION_ARG_NONE, &option_version, N_("Show version number and quit"), NULL},
 	{"no-new", 'N', 0, G_OPTION_ARG_NONE, &option_nonew, N_("Don't create a new pad on startup if no previous pads exist"), NULL},
+	{"trace", 0, 0, G_OPTION_ARG_FILENAME, &option_trace, N_("Write where startup and saving spend their time to FILE, as a Chrome trace"), N_("FILE")},
 	{NULL}
 };
 
+/* --stats takes an optional format, plain text unless it is "json" */
+static gboolean
+parse_stats_option (const gchar *option_name, const gchar *value, gpointer data, GError **error)
+{
+	g_free (option_stats);
+	option_stats = g_strdup (value ? value : "text");
+	
+	if (strcmp (option_stats, "text") && strcmp (option_stats, "json"))
+	{
+		g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_BAD_VALUE,
+			_("Unknown format for %s: %s"), option_name, value);
+		return FALSE;
+	}
+	
+	return TRUE;
+}
+
+/* --export takes an optional pattern, and exports every pad without one */
+static gboolean
+parse_export_option (const gchar *option_name, const gchar *value, gpointer data, GError **error)
+{
+	g_free (option_export);
+	option_export = g_strdup (value ? value : "");
+	
+	return TRUE;
+}
+
+/* Brings the gauges that are cheaper to count than to track up to date */
+static void
+update_pad_metrics (void)
+{
+	GSList *pads, *l;
+	gssize shown = 0, hidden = 0, unrealized = 0;
+	
+	pads = xpad_pad_group_get_pads (pad_group);
+	for (l = pads; l; l = l->next)
+	{
+		if (gtk_widget_get_visible (GTK_WIDGET (l->data)))
+			shown++;
+		else if (gtk_widget_get_realized (GTK_WIDGET (l->data)))
+			hidden++;
+		else
+			unrealized++;
+	}
+	g_slist_free (pads);
+	
+	xpad_metrics_set (XPAD_METRIC_PADS_SHOWN, shown);
+	xpad_metrics_set (XPAD_METRIC_PADS_HIDDEN, hidden);
+	xpad_metrics_set (XPAD_METRIC_PADS_UNREALIZED, unrealized);
+}
+
 static GOptionEntry remote_options[] =
 {
 	{"new", 'n', 0, G_OPTION_ARG_NONE, &option_new, N_("Create a new pad on startup even if pads already exist"), NULL},
@@ -855,7 +1339,16 @@ static GOptionEntry remote_options[] =
 	{"show", 's', 0, G_OPTION_ARG_NONE, &option_show, N_("Show all pads"), NULL},
 	{"toggle", 't', 0, G_OPTION_ARG_NONE, &option_toggle, N_("Toggle between show and hide all pads"), NULL},
 	{"new-from-file", 'f', 0, G_OPTION_ARG_FILENAME_ARRAY, &option_files, N_("Create a new pad with the contents of a file"), N_("FILE")},
+	{"import", 0, 0, G_OPTION_ARG_FILENAME, &option_import, N_("Create hidden pads from every file in DIR, or from the files named on standard input if DIR is -"), N_("DIR")},
+	{"follow", 'F', 0, G_OPTION_ARG_FILENAME_ARRAY, &option_follow, N_("Create a pad that shows the end of a file or FIFO as it grows"), N_("FILE")},
 	{"quit", 'q', 0, G_OPTION_ARG_NONE, &option_quit, N_("Close all pads"), NULL},
+	{"pad", 'p', 0, G_OPTION_ARG_STRING, &option_pad, N_("Pad for --append, --prepend and --replace, by ID, info file name or title"), N_("PAD")},
+	{"append", 'a', 0, G_OPTION_ARG_STRING, &option_append, N_("Add a line to the end of a pad, or everything read from standard input if TEXT is -"), N_("TEXT")},
+	{"prepend", 0, 0, G_OPTION_ARG_STRING, &option_prepend, N_("Add a line to the start of a pad"), N_("TEXT")},
+	{"replace", 0, 0, G_OPTION_ARG_STRING, &option_replace, N_("Replace the text of a pad, with standard input if TEXT is -"), N_("TEXT")},
+	{"max-lines", 0, 0, G_OPTION_ARG_INT, &option_max_lines, N_("Keep only the newest N lines of a pad changed or followed by the above"), N_("N")},
+	{"export", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK, parse_export_option, N_("Print the pads, or those whose title or text matches PATTERN, as JSON lines; --pad picks one"), N_("PATTERN")},
+	{"stats", 0, G_OPTION_FLAG_OPTIONAL_ARG, G_OPTION_ARG_CALLBACK, parse_stats_option, N_("Print counters and timings of the running xpad, as text or json"), N_("FORMAT")},
 	{"sm-client-id", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &option_smid, NULL, NULL},
 	{NULL}
 };
@@ -886,14 +1379,14 @@ process_local_args (gint *argc, gchar **argv[])
 	{
 		if (option_version)
 		{
-			fprintf (output, _("Xpad %s"), PACKAGE_VERSION);
-			fprintf (output, "\n");
+			printf (_("Xpad %s"), PACKAGE_VERSION);
+			printf ("\n");
 			exit (0);
 		}
 	}
 	else
 	{
-		fprintf (output, "%s\n", error->message);
+		fprintf (stderr, "%s\n", error->message);
 		exit (1);
 	}
 	
@@ -903,19 +1396,164 @@ process_local_args (gint *argc, gchar **argv[])
 	return(option_version || option_nonew);
 }
 
-static gboolean
-process_remote_args (gint *argc, gchar **argv[], gboolean have_gtk)
+static void
+request_clear (XpadRequest *request)
+{
+	g_free (request->target);
+	g_free (request->arg);
+}
+
+static void
+add_request (GArray *requests, XpadCommand command, gchar *arg)
+{
+	XpadRequest request = { command, NULL, arg, 0 };
+	
+	g_array_append_val (requests, request);
+}
+
+/* Text for an edit of option_pad.  "-" stands for standard input, and
+   lines from the command line get the newline that echo would add. */
+static void
+add_edit_request (GArray *requests, XpadCommand command, const gchar *text)
+{
+	XpadRequest request = { command, g_strdup (option_pad), NULL, MAX (option_max_lines, 0) };
+	
+	if (!strcmp (text, "-"))
+	{
+		GInputStream *in = g_unix_input_stream_new (STDIN_FILENO, FALSE);
+		GString *input = g_string_new (NULL);
+		gchar buf[65536];
+		gssize n;
+		
+		while ((n = g_input_stream_read (in, buf, sizeof (buf), NULL, NULL)) > 0)
+			g_string_append_len (input, buf, n);
+		g_object_unref (in);
+		
+		request.arg = g_string_free (input, FALSE);
+	}
+	else if (command != XPAD_COMMAND_REPLACE && !g_str_has_suffix (text, "\n"))
+		request.arg = g_strconcat (text, "\n", NULL);
+	else
+		request.arg = g_strdup (text);
+	
+	g_array_append_val (requests, request);
+}
+
+static gint
+compare_paths (const gchar **a, const gchar **b)
+{
+	return strcmp (*a, *b);
+}
+
+static void
+add_import_chunk (GArray *requests, GString *files)
+{
+	XpadRequest request = { XPAD_COMMAND_IMPORT, NULL, g_strdup (files->str), 0 };
+	
+	if (files->len > 0)
+		g_array_append_val (requests, request);
+	g_string_truncate (files, 0);
+}
+
+/* The files of a directory, in name order, or the ones listed one per
+   line on standard input for "-".  The running xpad is sent absolute
+   paths, a few hundred kilobytes of them per request. */
+static void
+add_import_requests (GArray *requests, const gchar *source)
+{
+	GPtrArray *names = g_ptr_array_new_with_free_func (g_free);
+	GString *files = g_string_new (NULL);
+	guint i;
+	
+	if (!strcmp (source, "-"))
+	{
+		gchar line[4096];
+		
+		while (fgets (line, sizeof (line), stdin))
+		{
+			g_strchomp (line);
+			if (*line)
+				g_ptr_array_add (names, g_canonicalize_filename (line, NULL));
+		}
+	}
+	else
+	{
+		gchar *dirname = g_canonicalize_filename (source, NULL);
+		GDir *dir = g_dir_open (dirname, 0, NULL);
+		const gchar *name;
+		
+		while (dir && (name = g_dir_read_name (dir)))
+		{
+			gchar *path = g_build_filename (dirname, name, NULL);
+			
+			if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+				g_ptr_array_add (names, path);
+			else
+				g_free (path);
+		}
+		if (dir)
+			g_dir_close (dir);
+		else
+		{
+			gchar *errtext = g_strdup_printf (_("Could not open directory %s."), dirname);
+			fprintf (stderr, "%s\n", errtext);
+			g_free (errtext);
+		}
+		g_free (dirname);
+		
+		g_ptr_array_sort (names, (GCompareFunc) compare_paths);
+	}
+	
+	for (i = 0; i < names->len; i++)
+	{
+		if (files->len > 0)
+		{
+			if (files->len >= IMPORT_REQUEST_SIZE)
+				add_import_chunk (requests, files);
+			else
+				g_string_append_c (files, '\n');
+		}
+		g_string_append (files, g_ptr_array_index (names, i));
+	}
+	add_import_chunk (requests, files);
+	
+	g_string_free (files, TRUE);
+	g_ptr_array_unref (names);
+}
+
+/* Turns the remote options into requests, in the order they are run.
+   Files are made absolute here, since the running xpad may have been
+   started from anywhere. */
+static GArray *
+process_remote_args (gint *argc, gchar **argv[])
 {
 	GError *error = NULL;
 	GOptionContext *context;
+	GArray *requests;
+	gint i;
 	
 	option_new = FALSE;
 	option_files = NULL;
+	option_follow = NULL;
+	option_import = NULL;
 	option_quit = FALSE;
 	option_smid = NULL;
 	option_hide = FALSE;
 	option_show = FALSE;
 	option_toggle = FALSE;
+	option_append = NULL;
+	option_prepend = NULL;
+	option_replace = NULL;
+	option_pad = NULL;
+	option_max_lines = 0;
+	option_stream_stdin = FALSE;
+	g_free (option_stats);
+	option_stats = NULL;
+	g_free (option_export);
+	option_export = NULL;
+	
+	requests = g_array_new (FALSE, FALSE, sizeof (XpadRequest));
+	g_array_set_clear_func (requests, (GDestroyNotify) request_clear);
 	
 	context = g_option_context_new (NULL);
 	g_option_context_set_ignore_unknown_options (context, TRUE);
@@ -923,49 +1561,53 @@ process_remote_args (gint *argc, gchar **argv[], gboolean have_gtk)
 	g_option_context_add_main_entries (context, remote_options, GETTEXT_PACKAGE);
 	if (g_option_context_parse (context, argc, argv, &error))
 	{
-		if (have_gtk && option_smid)
-			xpad_session_manager_set_id (option_smid);
-		
-		if (have_gtk && option_new)
+		if (option_smid)
+			add_request (requests, XPAD_COMMAND_SESSION_ID, g_strdup (option_smid));
+		if (option_new)
+			add_request (requests, XPAD_COMMAND_NEW, NULL);
+		if (option_show)
+			add_request (requests, XPAD_COMMAND_SHOW, NULL);
+		if (option_hide)
+			add_request (requests, XPAD_COMMAND_HIDE, NULL);
+		if (option_toggle)
+			add_request (requests, XPAD_COMMAND_TOGGLE, NULL);
+		for (i = 0; option_files && option_files[i]; i++)
+			add_request (requests, XPAD_COMMAND_NEW_FROM_FILE, g_canonicalize_filename (option_files[i], NULL));
+		for (i = 0; option_follow && option_follow[i]; i++)
 		{
-			GtkWidget *pad = xpad_pad_new (pad_group);
-			gtk_widget_set_visible (pad, TRUE);
+			XpadRequest request = { XPAD_COMMAND_FOLLOW, NULL,
+				g_canonicalize_filename (option_follow[i], NULL), MAX (option_max_lines, 0) };
+			g_array_append_val (requests, request);
 		}
-
-		if (have_gtk && option_show)
-		  xpad_pad_group_show_all (pad_group);
-		
-		if (have_gtk && option_hide)
-		  xpad_pad_group_close_all (pad_group);
-		
-		if (have_gtk && option_toggle)
-		  xpad_pad_group_toggle_hide (pad_group);
-
-		if (have_gtk && option_files)
+		if (option_import)
+			add_import_requests (requests, option_import);
+		if (option_replace)
+			add_edit_request (requests, XPAD_COMMAND_REPLACE, option_replace);
+		if (option_prepend)
+			add_edit_request (requests, XPAD_COMMAND_PREPEND, option_prepend);
+		/* Piped input is streamed once we know someone is listening */
+		if (option_append && !strcmp (option_append, "-"))
+			option_stream_stdin = TRUE;
+		else if (option_append)
+			add_edit_request (requests, XPAD_COMMAND_APPEND, option_append);
+		if (option_export)
 		{
-			int i;
-			for (i = 0; option_files[i]; i++)
-			{
-				GtkWidget *pad = xpad_pad_new_from_file (pad_group, option_files[i]);
-				if (pad)
-					gtk_widget_set_visible (pad, TRUE);
-			}
+			XpadRequest request = { XPAD_COMMAND_EXPORT, g_strdup (option_pad),
+				*option_export ? g_strdup (option_export) : NULL, 0 };
+			g_array_append_val (requests, request);
 		}
-		
+		if (option_stats)
+			add_request (requests, XPAD_COMMAND_STATS, g_strdup (option_stats));
 		if (option_quit)
-		{
-			exit (0);
-		}
+			add_request (requests, XPAD_COMMAND_QUIT, NULL);
 	}
 	else
 	{
-		fprintf (output, "%s\n", error->message);
-		/* Don't quit.  Bad options passed to the main xpad program by other
-		   iterations shouldn't close the main one. */
+		fprintf (stderr, "%s\n", error->message);
+		g_error_free (error);
 	}
 	
 	g_option_context_free (context);
 	
-	return(option_new || option_quit || option_smid || option_files ||
-	       option_hide || option_show || option_toggle);
+	return requests;
 }
@@ -24,11 +24,19 @@
 
 G_BEGIN_DECLS
 
+typedef void (*XpadAppLoadedFunc) (gpointer user_data);
+
+void       xpad_app_init          (gint argc, gchar **argv);
+void       xpad_app_init_headless (const gchar *dir);
+gint       xpad_app_load_pads     (XpadAppLoadedFunc loaded, gpointer user_data);
+
 void       xpad_app_error     (GtkWindow *parent, const gchar *primary, const gchar *secondary);
 GtkWidget *xpad_app_alert_new (GtkWindow *parent, const gchar *stock, const gchar *primary, const gchar *secondary);
 
 gint       xpad_dialog_run    (GtkDialog *dialog);
 
+void       xpad_app_quit      (void);
+
 const gchar *xpad_app_get_config_dir (void);
 const gchar *xpad_app_get_program_path (void);
 XpadPadGroup         *xpad_app_get_pad_group (void);
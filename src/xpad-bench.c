@@ -0,0 +1,465 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "../config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "fio.h"
+#include "xpad-app.h"
+#include "xpad-metrics.h"
+#include "xpad-pad.h"
+#include "xpad-snapshot.h"
+#include "xpad-text-buffer.h"
+
+/**
+ * Benchmarks for the paths xpad spends its time on, run with 'make bench'.
+ *
+ * Micro benchmarks need no display: they drive fio and XpadTextBuffer
+ * (and with it XpadUndo) directly.  Macro benchmarks fill a scratch config
+ * dir with synthetic pads and time xpad_app_load_pads over it, first by
+ * parsing every file and then from the snapshot; they are skipped when
+ * there is no display to put pads on.  Everything is generated from a
+ * fixed seed, so runs compare.  Results go to stdout as one JSON object.
+ */
+
+/* Samples taken per micro benchmark, each one a batch of calls */
+#define SAMPLES 15
+
+/* A batch runs for about this long */
+#define BATCH_USEC 20000
+
+#define TAG_CHAR_UTF8 "\xee\x80\x80"
+
+typedef void (*BenchFunc) (gpointer data);
+
+static gchar *option_pads = NULL;
+static gboolean option_quick = FALSE;
+
+static GOptionEntry options[] =
+{
+	{"pads", 0, 0, G_OPTION_ARG_STRING, &option_pads, "Comma separated pad counts for the load benchmarks (default 10,100,1000)", "N,..."},
+	{"quick", 0, 0, G_OPTION_ARG_NONE, &option_quick, "Take fewer samples", NULL},
+	{NULL}
+};
+
+static gboolean first_result = TRUE;
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+	gdouble x = *(const gdouble *) a, y = *(const gdouble *) b;
+	
+	return x < y ? -1 : x > y;
+}
+
+static void
+print_separator (void)
+{
+	printf ("%s\n", first_result ? "" : ",");
+	first_result = FALSE;
+}
+
+/* Times func in batches and prints nanoseconds per call */
+static void
+bench_run (const gchar *name, BenchFunc func, gpointer data)
+{
+	gdouble samples[SAMPLES], sum = 0;
+	guint n_samples = option_quick ? 5 : SAMPLES;
+	guint batch = 1, i, j;
+	gint64 begin, elapsed;
+	
+	/* Find a batch size that runs long enough to time */
+	for (;;)
+	{
+		begin = g_get_monotonic_time ();
+		for (j = 0; j < batch; j++)
+			func (data);
+		elapsed = g_get_monotonic_time () - begin;
+		if (elapsed >= BATCH_USEC || batch >= (1 << 24))
+			break;
+		batch *= elapsed > 0 ? MAX (2, (guint) (BATCH_USEC / elapsed)) : 16;
+	}
+	
+	for (i = 0; i < n_samples; i++)
+	{
+		begin = g_get_monotonic_time ();
+		for (j = 0; j < batch; j++)
+			func (data);
+		samples[i] = (g_get_monotonic_time () - begin) * 1000.0 / batch;
+		sum += samples[i];
+	}
+	
+	qsort (samples, n_samples, sizeof (gdouble), compare_doubles);
+	
+	print_separator ();
+	printf ("    {\"name\": \"%s\", \"kind\": \"micro\", \"calls_per_sample\": %u, \"samples\": %u, "
+		"\"ns_per_call\": {\"min\": %.1f, \"median\": %.1f, \"mean\": %.1f}}",
+		name, batch, n_samples, samples[0], samples[n_samples / 2], sum / n_samples);
+}
+
+/* Text with a tag around roughly one word in every tag_every, as it is
+   stored in content files */
+static gchar *
+make_content (GRand *rand, gsize size, gint tag_every)
+{
+	static const gchar *words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "milk", "call", "back", "tomorrow", "todo"};
+	static const gchar *tags[] = {"bold", "italic", "underline", "strikethrough", "large"};
+	GString *text = g_string_sized_new (size + 64);
+	
+	while (text->len < size)
+	{
+		const gchar *word = words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+		
+		if (tag_every > 0 && g_rand_int_range (rand, 0, tag_every) == 0)
+		{
+			const gchar *tag = tags[g_rand_int_range (rand, 0, G_N_ELEMENTS (tags))];
+			g_string_append_printf (text, TAG_CHAR_UTF8 "%s" TAG_CHAR_UTF8 "%s" TAG_CHAR_UTF8 "/%s" TAG_CHAR_UTF8, tag, word, tag);
+		}
+		else
+			g_string_append (text, word);
+		
+		g_string_append_c (text, g_rand_int_range (rand, 0, 12) ? ' ' : '\n');
+	}
+	
+	return g_string_free (text, FALSE);
+}
+
+/* Micro benchmarks */
+
+static void
+bench_write_info (gpointer data)
+{
+	fio_set_values_to_file (data,
+		"i|width", 200,
+		"i|height", 200,
+		"i|x", 120,
+		"i|y", 340,
+		"b|follow_font", TRUE,
+		"b|follow_color", FALSE,
+		"b|sticky", FALSE,
+		"b|hidden", FALSE,
+		"h|back_red", 65535,
+		"h|back_green", 61166,
+		"h|back_blue", 43690,
+		"h|text_red", 0,
+		"h|text_green", 0,
+		"h|text_blue", 0,
+		"s|fontname", "Sans 10",
+		"s|content", "content-bench",
+		NULL);
+}
+
+static void
+bench_read_info (gpointer data)
+{
+	XpadPadInfo info;
+	
+	xpad_pad_info_init (&info);
+	xpad_pad_info_read (data, &info);
+	xpad_pad_info_clear (&info);
+}
+
+typedef struct
+{
+	XpadTextBuffer *buffer;
+	gchar *content;
+} TagBench;
+
+static void
+bench_tag_round_trip (gpointer data)
+{
+	TagBench *bench = data;
+	gchar *text;
+	
+	xpad_text_buffer_set_text_with_tags (bench->buffer, bench->content, -1);
+	text = xpad_text_buffer_get_text_with_tags (bench->buffer);
+	g_free (text);
+}
+
+/* Types text one character per user action, as the undo history sees
+   keystrokes, then drops the buffer */
+static void
+bench_undo_typing (gpointer data)
+{
+	XpadTextBuffer *buffer = xpad_text_buffer_new (NULL);
+	const gchar *p;
+	
+	for (p = data; *p; p = g_utf8_next_char (p))
+	{
+		gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (buffer));
+		gtk_text_buffer_insert_at_cursor (GTK_TEXT_BUFFER (buffer), p, g_utf8_next_char (p) - p);
+		gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (buffer));
+	}
+	
+	g_object_unref (buffer);
+}
+
+static void
+bench_undo_replay (gpointer data)
+{
+	XpadTextBuffer *buffer = data;
+	
+	while (xpad_text_buffer_undo_available (buffer))
+		xpad_text_buffer_undo (buffer);
+	while (xpad_text_buffer_redo_available (buffer))
+		xpad_text_buffer_redo (buffer);
+}
+
+static void
+run_micro_benchmarks (GRand *rand)
+{
+	TagBench tags;
+	XpadTextBuffer *typed;
+	gchar *typing;
+	gint i;
+	
+	bench_write_info ("info-bench");
+	bench_run ("fio_set_values_to_file", bench_write_info, "info-bench");
+	bench_run ("fio_get_values_from_file", bench_read_info, "info-bench");
+	
+	tags.buffer = xpad_text_buffer_new (NULL);
+	tags.content = make_content (rand, 4096, 8);
+	bench_run ("tag_round_trip_4k", bench_tag_round_trip, &tags);
+	g_object_unref (tags.buffer);
+	g_free (tags.content);
+	
+	/* Words and spaces, so merging stops at word boundaries as it does
+	   when someone types */
+	typing = make_content (rand, 1000, 0);
+	bench_run ("undo_typing_1k", bench_undo_typing, typing);
+	
+	typed = xpad_text_buffer_new (NULL);
+	for (i = 0; typing[i]; i++)
+	{
+		gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (typed));
+		gtk_text_buffer_insert_at_cursor (GTK_TEXT_BUFFER (typed), &typing[i], 1);
+		gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (typed));
+	}
+	bench_run ("undo_redo_replay_1k", bench_undo_replay, typed);
+	g_object_unref (typed);
+	g_free (typing);
+}
+
+/* Macro benchmarks */
+
+/* Most pads are short notes, a few are long documents */
+static gsize
+pick_content_size (GRand *rand)
+{
+	gdouble r = g_rand_double (rand);
+	
+	if (r < 0.80)
+		return g_rand_int_range (rand, 50, 500);
+	if (r < 0.95)
+		return g_rand_int_range (rand, 1024, 8192);
+	return g_rand_int_range (rand, 32768, 131072);
+}
+
+/* Most pads have no formatting at all */
+static gint
+pick_tag_every (GRand *rand)
+{
+	gdouble r = g_rand_double (rand);
+	
+	if (r < 0.70)
+		return 0;
+	if (r < 0.95)
+		return 50;
+	return 5;
+}
+
+static gsize
+fill_config_dir (const gchar *dir, GRand *rand, gint n_pads)
+{
+	gsize total = 0;
+	gint i;
+	
+	xpad_app_init_headless (dir);
+	
+	for (i = 0; i < n_pads; i++)
+	{
+		guint64 id = xpad_pad_id_new ();
+		gchar *infoname = xpad_pad_id_to_name ("info-", id);
+		gchar *contentname = xpad_pad_id_to_name ("content-", id);
+		gchar *content = make_content (rand, pick_content_size (rand), pick_tag_every (rand));
+		
+		/* As current xpad writes them, so loading has nothing to migrate
+		   and save, which would make the snapshot stale */
+		fio_set_values_to_file (infoname,
+			"t|id", id,
+			"i|width", 200,
+			"i|height", 200,
+			"i|x", g_rand_int_range (rand, 0, 1600),
+			"i|y", g_rand_int_range (rand, 0, 1000),
+			"b|follow_font", TRUE,
+			"b|follow_color", TRUE,
+			"b|sticky", FALSE,
+			"b|hidden", g_rand_double (rand) < 0.3,
+			"s|content", contentname,
+			NULL);
+		fio_set_file (contentname, content);
+		total += strlen (content);
+		
+		g_free (content);
+		g_free (contentname);
+		g_free (infoname);
+	}
+	
+	return total;
+}
+
+static void
+loaded (gpointer data)
+{
+	*(gboolean *) data = TRUE;
+}
+
+/* A fresh pad group loading every pad in dir, in milliseconds */
+static gdouble
+time_load_pads (const gchar *dir)
+{
+	gboolean done = FALSE;
+	gint64 begin;
+	
+	xpad_app_init_headless (dir);
+	
+	begin = g_get_monotonic_time ();
+	xpad_app_load_pads (loaded, &done);
+	while (!done)
+		g_main_context_iteration (NULL, TRUE);
+	
+	return (g_get_monotonic_time () - begin) / 1000.0;
+}
+
+static void
+remove_dir (const gchar *path)
+{
+	GDir *dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+	
+	while (dir && (name = g_dir_read_name (dir)))
+	{
+		gchar *file = g_build_filename (path, name, NULL);
+		g_unlink (file);
+		g_free (file);
+	}
+	if (dir)
+		g_dir_close (dir);
+	g_rmdir (path);
+}
+
+static void
+run_load_benchmark (GRand *rand, gint n_pads)
+{
+	gchar *dir = g_dir_make_tmp ("xpad-bench-XXXXXX", NULL);
+	gdouble parsed, restored;
+	gssize before;
+	gsize bytes;
+	
+	if (!dir)
+		return;
+	
+	bytes = fill_config_dir (dir, rand, n_pads);
+	
+	parsed = time_load_pads (dir);
+	/* Anything still to be written would leave the snapshot stale */
+	xpad_pad_group_flush_pending (xpad_app_get_pad_group ());
+	xpad_snapshot_save (xpad_app_get_pad_group ());
+	before = xpad_metrics_get (XPAD_METRIC_PADS_RESTORED);
+	restored = time_load_pads (dir);
+	if (xpad_metrics_get (XPAD_METRIC_PADS_RESTORED) - before != n_pads)
+	{
+		fprintf (stderr, "Only %" G_GSSIZE_FORMAT " of %d pads came from the snapshot\n",
+			xpad_metrics_get (XPAD_METRIC_PADS_RESTORED) - before, n_pads);
+		exit (1);
+	}
+	
+	/* Drops the last group with its pads */
+	xpad_app_init_headless (dir);
+	
+	print_separator ();
+	printf ("    {\"name\": \"xpad_app_load_pads\", \"kind\": \"macro\", \"pads\": %d, \"content_bytes\": %" G_GSIZE_FORMAT ", "
+		"\"ms\": {\"parsed\": %.2f, \"from_snapshot\": %.2f}}",
+		n_pads, bytes, parsed, restored);
+	
+	remove_dir (dir);
+	g_free (dir);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	GRand *rand;
+	gchar *dir, **counts;
+	gboolean have_display;
+	gint i;
+	
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		fprintf (stderr, "%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free (context);
+	
+	have_display = gtk_init_check ();
+	rand = g_rand_new_with_seed (20070101);
+	
+	/* The micro benchmarks write their files here */
+	dir = g_dir_make_tmp ("xpad-bench-XXXXXX", NULL);
+	if (!dir)
+	{
+		fprintf (stderr, "Could not create a scratch directory\n");
+		return 1;
+	}
+	xpad_app_init_headless (dir);
+	
+	printf ("{\n  \"version\": \"%s\",\n  \"results\": [", PACKAGE_VERSION);
+	
+	run_micro_benchmarks (rand);
+	remove_dir (dir);
+	g_free (dir);
+	
+	counts = g_strsplit (option_pads ? option_pads : (option_quick ? "10,100" : "10,100,1000"), ",", 0);
+	for (i = 0; counts[i]; i++)
+	{
+		gint n_pads = atoi (counts[i]);
+		
+		if (n_pads <= 0)
+			continue;
+		
+		if (have_display)
+			run_load_benchmark (rand, n_pads);
+		else
+		{
+			print_separator ();
+			printf ("    {\"name\": \"xpad_app_load_pads\", \"kind\": \"macro\", \"pads\": %d, \"skipped\": \"no display\"}", n_pads);
+		}
+	}
+	g_strfreev (counts);
+	
+	printf ("\n  ]\n}\n");
+	
+	g_rand_free (rand);
+	
+	return 0;
+}
@@ -0,0 +1,111 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "xpad-clipboard.h"
+
+/**
+ * One listener on the display clipboard for the whole application.
+ *
+ * Whether the clipboard holds text is worked out from the advertised
+ * formats, which GDK fetches asynchronously before emitting "changed",
+ * so nothing here ever blocks on the clipboard owner.  Pads read the
+ * cached answer when they show a menu, and only pads with a visible
+ * toolbar watch for changes.
+ */
+
+typedef struct
+{
+	XpadClipboardFunc func;
+	gpointer user_data;
+} ClipboardWatch;
+
+static GdkClipboard *clipboard = NULL;
+static gboolean has_text = FALSE;
+static GSList *watches = NULL;
+
+static void
+clipboard_changed (GdkClipboard *cb)
+{
+	GSList *l, *copy;
+	gboolean text;
+	
+	text = gdk_content_formats_contain_gtype (gdk_clipboard_get_formats (cb), G_TYPE_STRING);
+	if (text == has_text)
+		return;
+	has_text = text;
+	
+	/* A watcher may unwatch itself from its callback */
+	copy = g_slist_copy (watches);
+	for (l = copy; l; l = l->next)
+	{
+		if (g_slist_find (watches, l->data))
+		{
+			ClipboardWatch *watch = l->data;
+			watch->func (watch->user_data);
+		}
+	}
+	g_slist_free (copy);
+}
+
+static void
+clipboard_init (void)
+{
+	if (clipboard)
+		return;
+	
+	clipboard = gdk_display_get_clipboard (gdk_display_get_default ());
+	g_signal_connect (clipboard, "changed", G_CALLBACK (clipboard_changed), NULL);
+	has_text = gdk_content_formats_contain_gtype (gdk_clipboard_get_formats (clipboard), G_TYPE_STRING);
+}
+
+gboolean
+xpad_clipboard_has_text (void)
+{
+	clipboard_init ();
+	return has_text;
+}
+
+/* func is called whenever text becomes available or goes away */
+void
+xpad_clipboard_watch (XpadClipboardFunc func, gpointer user_data)
+{
+	ClipboardWatch *watch;
+	
+	clipboard_init ();
+	
+	watch = g_new (ClipboardWatch, 1);
+	watch->func = func;
+	watch->user_data = user_data;
+	watches = g_slist_prepend (watches, watch);
+}
+
+void
+xpad_clipboard_unwatch (XpadClipboardFunc func, gpointer user_data)
+{
+	GSList *l;
+	
+	for (l = watches; l; l = l->next)
+	{
+		ClipboardWatch *watch = l->data;
+		
+		if (watch->func == func && watch->user_data == user_data)
+		{
+			watches = g_slist_delete_link (watches, l);
+			g_free (watch);
+			return;
+		}
+	}
+}
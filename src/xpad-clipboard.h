@@ -0,0 +1,32 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_CLIPBOARD_H__
+#define __XPAD_CLIPBOARD_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+typedef void (*XpadClipboardFunc) (gpointer user_data);
+
+gboolean xpad_clipboard_has_text (void);
+void     xpad_clipboard_watch    (XpadClipboardFunc func, gpointer user_data);
+void     xpad_clipboard_unwatch  (XpadClipboardFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __XPAD_CLIPBOARD_H__ */
@@ -0,0 +1,189 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include <gio/gio.h>
+#include "fio.h"
+#include "xpad-app.h"
+#include "xpad-config-monitor.h"
+#include "xpad-pad.h"
+#include "xpad-settings.h"
+#include "xpad-timer.h"
+
+/**
+ * Watches the config dir for changes made by other programs, such as a
+ * sync tool or a text editor, and loads them into the running app.
+ *
+ * Events only collect file names; the names are handled together once the
+ * dir has been quiet for RELOAD_DELAY.  Files whose etag still matches
+ * what fio last wrote are xpad's own saves and are dropped without being
+ * read.
+ */
+
+/* Milliseconds of quiet in the config dir before changed files are read */
+#define RELOAD_DELAY 200
+
+#define DEFAULTS_FILENAME "default-style"
+
+static GFileMonitor *monitor = NULL;
+static GHashTable *pending = NULL;
+static XpadTimer reload_timer;
+static XpadPadGroup *monitor_group = NULL;
+
+static gboolean
+is_config_file (const gchar *name)
+{
+	/* Backups and the temporary files of atomic writes */
+	if (name[0] == '.' || g_str_has_suffix (name, "~"))
+		return FALSE;
+	
+	return strcmp (name, DEFAULTS_FILENAME) == 0 ||
+		g_str_has_prefix (name, "info-") ||
+		g_str_has_prefix (name, "content-");
+}
+
+static XpadPad *
+find_pad (const gchar *name, const gchar *(*get_name) (XpadPad *pad))
+{
+	GSList *pads, *l;
+	XpadPad *found = NULL;
+	
+	pads = xpad_pad_group_get_pads (monitor_group);
+	for (l = pads; l && !found; l = l->next)
+	{
+		if (g_strcmp0 (get_name (XPAD_PAD (l->data)), name) == 0)
+			found = XPAD_PAD (l->data);
+	}
+	g_slist_free (pads);
+	
+	return found;
+}
+
+static void
+reload_file (const gchar *name)
+{
+	XpadPad *pad;
+	
+	if (strcmp (name, DEFAULTS_FILENAME) == 0)
+	{
+		xpad_settings_reload (xpad_settings ());
+	}
+	else if (g_str_has_prefix (name, "info-"))
+	{
+		pad = find_pad (name, xpad_pad_get_info_filename);
+		if (pad)
+			xpad_pad_reload_info (pad);
+		else
+		{
+			/* A pad that was created somewhere else */
+			gboolean show = TRUE;
+			GtkWidget *new_pad = xpad_pad_new_with_info (monitor_group, name, &show);
+			
+			if (show)
+				gtk_widget_set_visible (new_pad, TRUE);
+		}
+	}
+	else
+	{
+		/* Content without a pad yet is read along with its info file */
+		pad = find_pad (name, xpad_pad_get_content_filename);
+		if (pad)
+			xpad_pad_reload_content (pad);
+	}
+}
+
+static void
+reload_pending (gpointer user_data)
+{
+	GHashTable *names = pending;
+	GHashTableIter iter;
+	gpointer name;
+	
+	/* Reloading may save, and those events start a new batch */
+	pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	
+	g_hash_table_iter_init (&iter, names);
+	while (g_hash_table_iter_next (&iter, &name, NULL))
+	{
+		if (!fio_is_own_write (name))
+			reload_file (name);
+	}
+	
+	g_hash_table_destroy (names);
+}
+
+static void
+monitor_changed (GFileMonitor *file_monitor, GFile *file, GFile *other_file,
+                 GFileMonitorEvent event, gpointer user_data)
+{
+	GFile *target;
+	gchar *name;
+	
+	switch (event)
+	{
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+	case G_FILE_MONITOR_EVENT_CREATED:
+	case G_FILE_MONITOR_EVENT_MOVED_IN:
+		target = file;
+		break;
+	case G_FILE_MONITOR_EVENT_RENAMED:
+		target = other_file;
+		break;
+	default:
+		/* Deleted files are left alone; pads are only closed from xpad */
+		return;
+	}
+	
+	if (!target)
+		return;
+	
+	name = g_file_get_basename (target);
+	if (!is_config_file (name))
+	{
+		g_free (name);
+		return;
+	}
+	
+	g_hash_table_add (pending, name);
+	xpad_timer_schedule (&reload_timer, RELOAD_DELAY);
+}
+
+void
+xpad_config_monitor_start (XpadPadGroup *group)
+{
+	GFile *dir;
+	GError *error = NULL;
+	
+	if (monitor)
+		return;
+	
+	dir = g_file_new_for_path (xpad_app_get_config_dir ());
+	monitor = g_file_monitor_directory (dir, G_FILE_MONITOR_WATCH_MOVES, NULL, &error);
+	g_object_unref (dir);
+	
+	if (!monitor)
+	{
+		g_warning ("Could not watch %s for changes: %s", xpad_app_get_config_dir (), error->message);
+		g_error_free (error);
+		return;
+	}
+	
+	monitor_group = group;
+	pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	xpad_timer_init (&reload_timer, reload_pending, NULL);
+	
+	g_signal_connect (monitor, "changed", G_CALLBACK (monitor_changed), NULL);
+}
@@ -0,0 +1,962 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "../config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "fio.h"
+#include "xpad-pad-info.h"
+#include "xpad-protocol.h"
+#include "xpad-ring.h"
+#include "xpad-store.h"
+
+/**
+ * Tests for libxpadcore, run by 'make check'.  Nothing here needs a
+ * display.  Tests that touch files get a scratch config dir of their own,
+ * and the ID tests each run in a process of their own, since the ID
+ * counter is only loaded once per process.
+ */
+
+/* Wraps tag names in content files, see xpad-store.c */
+#define T "\xee\x80\x80"
+
+static gchar *
+scratch_dir_new (void)
+{
+	gchar *dir = g_dir_make_tmp ("xpad-test-XXXXXX", NULL);
+	
+	g_assert_nonnull (dir);
+	fio_set_config_dir (dir);
+	
+	return dir;
+}
+
+static void
+scratch_dir_free (gchar *path)
+{
+	GDir *dir = g_dir_open (path, 0, NULL);
+	const gchar *name;
+	
+	while (dir && (name = g_dir_read_name (dir)))
+	{
+		gchar *file = g_build_filename (path, name, NULL);
+		g_unlink (file);
+		g_free (file);
+	}
+	if (dir)
+		g_dir_close (dir);
+	g_rmdir (path);
+	g_free (path);
+}
+
+/* Protocol */
+
+static gchar *socket_path = NULL;
+static gchar *last_arg = NULL;
+
+/* STATS answers with its argument max_lines times over, APPEND keeps its
+   argument in last_arg, anything else is not known */
+static XpadStatus
+test_command (const XpadRequest *request, GString *output, XpadReply *reply, gpointer user_data)
+{
+	guint i;
+	
+	switch (request->command)
+	{
+	case XPAD_COMMAND_STATS:
+		for (i = 0; i < request->max_lines; i++)
+			g_string_append (output, request->arg);
+		return XPAD_STATUS_OK;
+	case XPAD_COMMAND_APPEND:
+		g_free (last_arg);
+		last_arg = g_strdup (request->arg);
+		return XPAD_STATUS_OK;
+	default:
+		return XPAD_STATUS_UNKNOWN_COMMAND;
+	}
+}
+
+static void
+test_server_start (void)
+{
+	gchar *dir;
+	
+	if (socket_path)
+		return;
+	
+	dir = g_dir_make_tmp ("xpad-test-XXXXXX", NULL);
+	g_assert_nonnull (dir);
+	socket_path = g_build_filename (dir, "server", NULL);
+	g_assert_true (xpad_protocol_serve (socket_path, test_command, NULL, NULL));
+	g_free (dir);
+}
+
+typedef struct
+{
+	XpadRequest *requests;
+	guint n_requests;
+	gboolean ok;
+	GError *error;
+	gchar *out;
+	gint done;
+} Call;
+
+/* The client blocks, so it gets a thread while this one runs the server */
+static gpointer
+call_thread (gpointer data)
+{
+	Call *call = data;
+	XpadProtocolClient *client = xpad_protocol_client_new (socket_path);
+	gsize size;
+	FILE *out;
+	
+	g_assert_nonnull (client);
+	out = open_memstream (&call->out, &size);
+	call->ok = xpad_protocol_client_call (client, call->requests, call->n_requests, out, &call->error);
+	fclose (out);
+	xpad_protocol_client_free (client);
+	
+	g_atomic_int_set (&call->done, TRUE);
+	g_main_context_wakeup (NULL);
+	
+	return NULL;
+}
+
+static GThread *
+call_start (Call *call, XpadRequest *requests, guint n_requests)
+{
+	test_server_start ();
+	
+	memset (call, 0, sizeof (Call));
+	call->requests = requests;
+	call->n_requests = n_requests;
+	
+	return g_thread_new ("client", call_thread, call);
+}
+
+static void
+call_finish (Call *call, GThread *thread)
+{
+	while (!g_atomic_int_get (&call->done))
+		g_main_context_iteration (NULL, TRUE);
+	g_thread_join (thread);
+}
+
+static void
+call_run (Call *call, XpadRequest *requests, guint n_requests)
+{
+	call_finish (call, call_start (call, requests, n_requests));
+}
+
+static void
+call_clear (Call *call)
+{
+	g_clear_error (&call->error);
+	free (call->out);
+}
+
+static void
+test_protocol_text_part (void)
+{
+	gchar *text = g_malloc (XPAD_PROTOCOL_MAX_TEXT + 16);
+	
+	memset (text, 'x', XPAD_PROTOCOL_MAX_TEXT + 16);
+	g_assert_cmpuint (xpad_protocol_text_part (text, 10), ==, 10);
+	g_assert_cmpuint (xpad_protocol_text_part (text, XPAD_PROTOCOL_MAX_TEXT), ==, XPAD_PROTOCOL_MAX_TEXT);
+	g_assert_cmpuint (xpad_protocol_text_part (text, XPAD_PROTOCOL_MAX_TEXT + 16), ==, XPAD_PROTOCOL_MAX_TEXT);
+	
+	/* Never in the middle of a character */
+	memcpy (text + XPAD_PROTOCOL_MAX_TEXT - 1, "\xe2\x82\xac", 3);
+	g_assert_cmpuint (xpad_protocol_text_part (text, XPAD_PROTOCOL_MAX_TEXT + 16), ==, XPAD_PROTOCOL_MAX_TEXT - 1);
+	
+	g_free (text);
+}
+
+static void
+test_protocol_long_answer (void)
+{
+	gchar *chunk = g_strnfill (100 * 1024, 'a');
+	XpadRequest request = { XPAD_COMMAND_STATS, NULL, chunk, 30 };
+	Call call;
+	
+	/* Three times what one message may hold */
+	call_run (&call, &request, 1);
+	g_assert_no_error (call.error);
+	g_assert_true (call.ok);
+	g_assert_cmpuint (strlen (call.out), ==, 30 * strlen (chunk));
+	g_assert_cmpuint (strspn (call.out, "a"), ==, 30 * strlen (chunk));
+	
+	call_clear (&call);
+	g_free (chunk);
+}
+
+static void
+test_protocol_long_argument (void)
+{
+	GString *arg = g_string_new (NULL);
+	XpadRequest requests[] = {
+		{ XPAD_COMMAND_STATS, NULL, "before\n", 1 },
+		{ XPAD_COMMAND_APPEND, NULL, NULL, 0 },
+		{ XPAD_COMMAND_STATS, NULL, "after\n", 1 },
+	};
+	Call call;
+	
+	while (arg->len < 3 * XPAD_PROTOCOL_MAX_MESSAGE / 2)
+		g_string_append (arg, "line with \xe2\x82\xac in it\n");
+	requests[1].arg = arg->str;
+	
+	call_run (&call, requests, G_N_ELEMENTS (requests));
+	g_assert_no_error (call.error);
+	g_assert_true (call.ok);
+	g_assert_cmpstr (call.out, ==, "before\nafter\n");
+	g_assert_cmpstr (last_arg, ==, arg->str);
+	
+	call_clear (&call);
+	g_string_free (arg, TRUE);
+}
+
+static void
+test_protocol_too_long (void)
+{
+	gchar *target = g_strnfill (XPAD_PROTOCOL_MAX_MESSAGE + 1, 't');
+	XpadRequest request = { XPAD_COMMAND_APPEND, target, "text", 0 };
+	Call call;
+	
+	/* Only arguments are split up */
+	call_run (&call, &request, 1);
+	g_assert_false (call.ok);
+	g_assert_error (call.error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE);
+	
+	call_clear (&call);
+	g_free (target);
+}
+
+static void
+test_protocol_unknown (void)
+{
+	XpadRequest request = { XPAD_COMMAND_NEW, NULL, NULL, 0 };
+	Call call;
+	
+	call_run (&call, &request, 1);
+	g_assert_true (call.ok);
+	g_assert_nonnull (strstr (call.out, "does not know"));
+	
+	call_clear (&call);
+}
+
+static gboolean
+set_flag (gpointer data)
+{
+	*(gboolean *) data = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+test_protocol_hold (void)
+{
+	XpadRequest request = { XPAD_COMMAND_STATS, NULL, "held\n", 1 };
+	gboolean waited = FALSE;
+	GThread *thread;
+	Call call;
+	
+	test_server_start ();
+	xpad_protocol_hold (TRUE);
+	thread = call_start (&call, &request, 1);
+	
+	g_timeout_add (200, set_flag, &waited);
+	while (!waited)
+		g_main_context_iteration (NULL, TRUE);
+	g_assert_false (g_atomic_int_get (&call.done));
+	
+	xpad_protocol_hold (FALSE);
+	call_finish (&call, thread);
+	g_assert_true (call.ok);
+	g_assert_cmpstr (call.out, ==, "held\n");
+	
+	call_clear (&call);
+}
+
+/* Markup */
+
+static void
+assert_parse (const gchar *content, gssize len, const gchar *text, const gchar *spans)
+{
+	gchar *parsed_text;
+	GVariant *parsed_spans, *expected;
+	
+	xpad_store_parse_content (content, len, &parsed_text, &parsed_spans);
+	expected = g_variant_parse (G_VARIANT_TYPE ("a(sii)"), spans, NULL, NULL, NULL);
+	
+	g_assert_cmpstr (parsed_text, ==, text);
+	g_assert_true (g_variant_equal (parsed_spans, expected));
+	
+	g_variant_unref (expected);
+	g_variant_unref (parsed_spans);
+	g_free (parsed_text);
+}
+
+static void
+test_markup_parse (void)
+{
+	assert_parse ("no tags", -1, "no tags", "@a(sii) []");
+	assert_parse ("plain " T "bold" T "bold" T "/bold" T " and " T "italic" T "\xc3\xa9t" T "/ITALIC" T "!", -1,
+		"plain bold and \xc3\xa9t!", "[('bold', 6, 10), ('italic', 15, 17)]");
+	
+	/* Open tags run to the end, a tag with no end is dropped */
+	assert_parse ("a" T "bold" T "bc", -1, "abc", "[('bold', 1, 3)]");
+	assert_parse ("a" T "bo", -1, "a", "@a(sii) []");
+	
+	/* Empty tags name nothing */
+	assert_parse ("a" T T "b" T "/" T "c", -1, "abc", "@a(sii) []");
+	
+	/* Only len bytes are read */
+	assert_parse ("ab" T "bold" T "cd", 2 + 3 + 4, "ab", "@a(sii) []");
+	assert_parse (NULL, -1, "", "@a(sii) []");
+}
+
+typedef struct
+{
+	const gchar *content;
+	gsize len;
+	GString *text;
+	guint spans;
+} Runs;
+
+static void
+check_run (const gchar *text, gsize len, Runs *runs)
+{
+	/* Pieces of the content, not copies */
+	g_assert_true (text >= runs->content && text + len <= runs->content + runs->len);
+	g_string_append_len (runs->text, text, len);
+}
+
+static void
+check_span (const gchar *name, gint start, gint end, Runs *runs)
+{
+	/* Its text has been passed on already */
+	g_assert_cmpint (end, <=, g_utf8_strlen (runs->text->str, -1));
+	runs->spans++;
+}
+
+static void
+test_markup_runs (void)
+{
+	Runs runs;
+	
+	runs.content = "plain " T "bold" T "bold" T "/bold" T " " T "italic" T "\xc3\xa9t";
+	runs.len = strlen (runs.content);
+	runs.text = g_string_new (NULL);
+	runs.spans = 0;
+	
+	xpad_store_parse_content_runs (runs.content, runs.len,
+		(XpadStoreTextFunc) check_run, (XpadStoreSpanFunc) check_span, &runs);
+	g_assert_cmpstr (runs.text->str, ==, "plain bold \xc3\xa9t");
+	g_assert_cmpuint (runs.spans, ==, 2);
+	
+	g_string_free (runs.text, TRUE);
+}
+
+/* Writes text and spans back as markup, for spans that don't overlap */
+static gchar *
+markup_from_spans (const gchar *text, GVariant *spans)
+{
+	GString *out = g_string_new (NULL);
+	GVariantIter iter;
+	const gchar *name, *p = text;
+	gint on, off, offset = 0;
+	
+	g_variant_iter_init (&iter, spans);
+	while (g_variant_iter_next (&iter, "(&sii)", &name, &on, &off))
+	{
+		const gchar *start = g_utf8_offset_to_pointer (p, on - offset);
+		const gchar *end = g_utf8_offset_to_pointer (start, off - on);
+		
+		g_string_append_len (out, p, start - p);
+		g_string_append_printf (out, T "%s" T, name);
+		g_string_append_len (out, start, end - start);
+		g_string_append_printf (out, T "/%s" T, name);
+		p = end;
+		offset = off;
+	}
+	g_string_append (out, p);
+	
+	return g_string_free (out, FALSE);
+}
+
+static void
+test_markup_round_trip (void)
+{
+	const gchar *content = "\xc3\xa9" T "bold" T "one" T "/bold" T " two " T "underline" T "three" T "/underline" T "\n";
+	gchar *text, *again_text, *markup;
+	GVariant *spans, *again_spans;
+	
+	xpad_store_parse_content (content, -1, &text, &spans);
+	markup = markup_from_spans (text, spans);
+	g_assert_cmpstr (markup, ==, content);
+	
+	xpad_store_parse_content (markup, -1, &again_text, &again_spans);
+	g_assert_cmpstr (again_text, ==, text);
+	g_assert_true (g_variant_equal (again_spans, spans));
+	
+	g_variant_unref (again_spans);
+	g_variant_unref (spans);
+	g_free (again_text);
+	g_free (markup);
+	g_free (text);
+}
+
+/* Files */
+
+/* The sizes fio.c switches on */
+#define COMPRESS_THRESHOLD (64 * 1024)
+#define MAP_THRESHOLD (256 * 1024)
+
+static const guint8 gzip_magic[] = { 0x1f, 0x8b };
+
+/* Text of len bytes; random letters barely compress, lines of a pad do */
+static gchar *
+text_new (gsize len, gboolean random)
+{
+	GRand *rand = g_rand_new_with_seed (len);
+	gchar *text = g_malloc (len + 1);
+	gsize i;
+	
+	for (i = 0; i < len; i++)
+		if (random)
+			text[i] = g_rand_int_range (rand, 0, 13) ? 'a' + g_rand_int_range (rand, 0, 26) : '\n';
+		else
+			text[i] = "a line of a pad\n"[i % 16];
+	text[len] = '\0';
+	
+	g_rand_free (rand);
+	
+	return text;
+}
+
+/* The file as it is on disk */
+static GBytes *
+read_raw (const gchar *dir, const gchar *name)
+{
+	gchar *path = g_build_filename (dir, name, NULL);
+	gchar *contents;
+	gsize size;
+	
+	g_assert_true (g_file_get_contents (path, &contents, &size, NULL));
+	g_free (path);
+	
+	return g_bytes_new_take (contents, size);
+}
+
+static gboolean
+is_gzip (GBytes *bytes)
+{
+	gsize size;
+	const guint8 *data = g_bytes_get_data (bytes, &size);
+	
+	return size >= sizeof gzip_magic && memcmp (data, gzip_magic, sizeof gzip_magic) == 0;
+}
+
+/* Checks fio reads name back as text, in both forms */
+static void
+assert_file (const gchar *name, const gchar *text)
+{
+	gchar *contents = fio_get_file (name);
+	GBytes *bytes = fio_get_file_bytes (name);
+	gconstpointer data;
+	gsize size;
+	
+	g_assert_nonnull (contents);
+	g_assert_cmpuint (strlen (contents), ==, strlen (text));
+	g_assert_true (strcmp (contents, text) == 0);
+	
+	g_assert_nonnull (bytes);
+	data = g_bytes_get_data (bytes, &size);
+	g_assert_cmpmem (data, size, text, strlen (text));
+	
+	g_free (contents);
+	g_bytes_unref (bytes);
+}
+
+static void
+test_files_plain (void)
+{
+	gchar *dir = scratch_dir_new ();
+	gchar *text = text_new (COMPRESS_THRESHOLD - 1, FALSE);
+	GBytes *raw;
+	
+	/* Under the threshold stays as it is */
+	g_assert_true (fio_set_file_compressed ("small", "text\n"));
+	raw = read_raw (dir, "small");
+	g_assert_cmpmem (g_bytes_get_data (raw, NULL), g_bytes_get_size (raw), "text\n", 5);
+	g_bytes_unref (raw);
+	assert_file ("small", "text\n");
+	
+	g_assert_true (fio_set_file_compressed ("under", text));
+	raw = read_raw (dir, "under");
+	g_assert_false (is_gzip (raw));
+	g_assert_cmpuint (g_bytes_get_size (raw), ==, COMPRESS_THRESHOLD - 1);
+	g_bytes_unref (raw);
+	assert_file ("under", text);
+	
+	g_assert_true (fio_set_file_compressed ("empty", ""));
+	assert_file ("empty", "");
+	
+	g_assert_null (fio_get_file ("missing"));
+	g_assert_null (fio_get_file_bytes ("missing"));
+	
+	g_free (text);
+	scratch_dir_free (dir);
+}
+
+static void
+test_files_gzip (void)
+{
+	gchar *dir = scratch_dir_new ();
+	gchar *text = text_new (COMPRESS_THRESHOLD, FALSE);
+	GBytes *raw;
+	
+	/* From the threshold on, stored gzipped */
+	g_assert_true (fio_set_file_compressed ("at", text));
+	raw = read_raw (dir, "at");
+	g_assert_true (is_gzip (raw));
+	g_assert_cmpuint (g_bytes_get_size (raw), <, COMPRESS_THRESHOLD);
+	g_bytes_unref (raw);
+	assert_file ("at", text);
+	
+	/* Only the compressed writer compresses */
+	g_assert_true (fio_set_file ("kept", text));
+	raw = read_raw (dir, "kept");
+	g_assert_false (is_gzip (raw));
+	g_bytes_unref (raw);
+	assert_file ("kept", text);
+	
+	g_free (text);
+	scratch_dir_free (dir);
+}
+
+static void
+test_files_magic (void)
+{
+	gchar *dir = scratch_dir_new ();
+	
+	/* Only both magic bytes mark a gzip stream */
+	g_assert_true (fio_set_file ("one", "\x1f"));
+	assert_file ("one", "\x1f");
+	g_assert_true (fio_set_file ("half", "\x1f" "text"));
+	assert_file ("half", "\x1f" "text");
+	
+	scratch_dir_free (dir);
+}
+
+static gpointer
+read_bytes_thread (gpointer data)
+{
+	return fio_get_file_bytes (data);
+}
+
+/* Checks name reads back as text from the main thread, which maps it,
+   and from another, which reads it into memory */
+static void
+assert_file_threads (const gchar *name, const gchar *text)
+{
+	GBytes *bytes;
+	
+	assert_file (name, text);
+	
+	bytes = g_thread_join (g_thread_new ("read", read_bytes_thread, (gpointer) name));
+	g_assert_nonnull (bytes);
+	g_assert_cmpmem (g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes), text, strlen (text));
+	g_bytes_unref (bytes);
+}
+
+static void
+test_files_mapped (void)
+{
+	gchar *dir = scratch_dir_new ();
+	gchar *plain = text_new (MAP_THRESHOLD, FALSE);
+	gchar *random = text_new (4 * MAP_THRESHOLD, TRUE);
+	GBytes *raw;
+	
+	g_assert_true (fio_set_file ("plain", plain));
+	assert_file_threads ("plain", plain);
+	
+	/* Still past the threshold once compressed, so mapped too */
+	g_assert_true (fio_set_file_compressed ("random", random));
+	raw = read_raw (dir, "random");
+	g_assert_true (is_gzip (raw));
+	g_assert_cmpuint (g_bytes_get_size (raw), >=, MAP_THRESHOLD);
+	g_bytes_unref (raw);
+	assert_file_threads ("random", random);
+	
+	g_free (plain);
+	g_free (random);
+	scratch_dir_free (dir);
+}
+
+static void
+test_files_values (void)
+{
+	gchar *dir = scratch_dir_new ();
+	gchar *title = g_strdup ("kept"), *empty = NULL, *last = NULL, *missing = g_strdup ("kept");
+	gint width = 0, height = 0, wid = 7;
+	guint color = 0;
+	guint16 small = 0;
+	guint64 id = 0;
+	gboolean sticky = FALSE, hidden = TRUE;
+	
+	/* As read before fio_get_values: the first of a key wins, a key
+	   needs its space and a whole name, and the last line needs no
+	   newline */
+	g_assert_true (fio_set_file ("info",
+		"width 120\n"
+		"height -5\n"
+		"color 0x10\n"
+		"small 65535\n"
+		"sticky 1\n"
+		"hidden 0\n"
+		"width 999\n"
+		"title hello world\n"
+		"empty \n"
+		"wide 3\n"
+		"id 18446744073709551615\n"
+		"missing\n"
+		"last line"));
+	
+	g_assert_cmpint (fio_get_values_from_file ("info",
+		"i|width", &width,
+		"i|height", &height,
+		"u|color", &color,
+		"h|small", &small,
+		"b|sticky", &sticky,
+		"b|hidden", &hidden,
+		"s|title", &title,
+		"s|empty", &empty,
+		"i|wid", &wid,
+		"t|id", &id,
+		"s|missing", &missing,
+		"s|last", &last,
+		NULL), ==, 0);
+	
+	g_assert_cmpint (width, ==, 120);
+	g_assert_cmpint (height, ==, -5);
+	g_assert_cmpuint (color, ==, 16);
+	g_assert_cmpuint (small, ==, 65535);
+	g_assert_true (sticky);
+	g_assert_false (hidden);
+	g_assert_cmpstr (title, ==, "hello world");
+	g_assert_cmpstr (empty, ==, "");
+	g_assert_cmpint (wid, ==, 7);
+	g_assert_cmpuint (id, ==, G_MAXUINT64);
+	g_assert_cmpstr (missing, ==, "kept");
+	g_assert_cmpstr (last, ==, "line");
+	
+	g_assert_cmpint (fio_get_values_from_file ("none", "i|width", &width, NULL), ==, 1);
+	g_assert_cmpint (width, ==, 120);
+	
+	g_free (title);
+	g_free (empty);
+	g_free (last);
+	g_free (missing);
+	scratch_dir_free (dir);
+}
+
+/* Store */
+
+static void
+log_problem (const gchar *name, const gchar *problem, gpointer user_data)
+{
+	g_test_message ("%s: %s", name, problem);
+}
+
+static void
+write_pad (guint64 id, const gchar *contentname, const gchar *followname)
+{
+	XpadPadInfo info;
+	gchar *infoname = xpad_pad_id_to_name ("info-", id);
+	
+	xpad_pad_info_init (&info);
+	info.id = id;
+	info.contentname = (gchar *) contentname;
+	info.followname = (gchar *) followname;
+	g_assert_true (xpad_pad_info_write (infoname, &info));
+	
+	g_free (infoname);
+}
+
+static void
+test_store_verify (void)
+{
+	gchar *dir = scratch_dir_new ();
+	
+	write_pad (1, "content-0000000000000001", NULL);
+	g_assert_true (fio_set_file ("content-0000000000000001", "text"));
+	
+	/* Followed pads keep no content file, whether they name one or not */
+	write_pad (2, NULL, "/var/log/syslog");
+	write_pad (3, "content-0000000000000003", "/var/log/syslog");
+	g_assert_cmpuint (xpad_store_verify (log_problem, NULL), ==, 0);
+	
+	write_pad (4, "content-0000000000000004", NULL);
+	g_assert_cmpuint (xpad_store_verify (log_problem, NULL), ==, 1);
+	
+	scratch_dir_free (dir);
+}
+
+/* Ring */
+
+static gchar *
+ring_take_string (XpadRing *ring, gsize n)
+{
+	gchar *out = g_malloc0 (n + 1);
+	
+	xpad_ring_take (ring, (guint8 *) out, n);
+	
+	return out;
+}
+
+static void
+test_ring_wrap (void)
+{
+	XpadRing ring;
+	gchar *out;
+	
+	xpad_ring_init (&ring, 8);
+	
+	g_assert_false (xpad_ring_push (&ring, (const guint8 *) "abc", 3));
+	out = ring_take_string (&ring, 3);
+	g_assert_cmpstr (out, ==, "abc");
+	g_free (out);
+	
+	/* Starts three bytes in, so this wraps around the end */
+	g_assert_false (xpad_ring_push (&ring, (const guint8 *) "defghij", 7));
+	g_assert_cmpuint (ring.len, ==, 7);
+	out = ring_take_string (&ring, 7);
+	g_assert_cmpstr (out, ==, "defghij");
+	g_free (out);
+	g_assert_cmpuint (ring.len, ==, 0);
+	
+	xpad_ring_clear (&ring);
+}
+
+static void
+test_ring_overflow (void)
+{
+	XpadRing ring;
+	gchar *out;
+	
+	xpad_ring_init (&ring, 8);
+	
+	g_assert_false (xpad_ring_push (&ring, (const guint8 *) "12345", 5));
+	g_assert_true (xpad_ring_push (&ring, (const guint8 *) "6789", 4));
+	out = ring_take_string (&ring, ring.len);
+	g_assert_cmpstr (out, ==, "23456789");
+	g_free (out);
+	
+	/* More than fits in one go keeps the newest */
+	g_assert_true (xpad_ring_push (&ring, (const guint8 *) "abcdefghij", 10));
+	out = ring_take_string (&ring, ring.len);
+	g_assert_cmpstr (out, ==, "cdefghij");
+	g_free (out);
+	
+	/* Exactly filling an empty ring drops nothing */
+	g_assert_false (xpad_ring_push (&ring, (const guint8 *) "abcdefgh", 8));
+	
+	xpad_ring_clear (&ring);
+}
+
+static void
+test_ring_whole_lines (void)
+{
+	XpadRing ring;
+	
+	xpad_ring_init (&ring, 8);
+	
+	g_assert_cmpuint (xpad_ring_whole_lines (&ring), ==, 0);
+	xpad_ring_push (&ring, (const guint8 *) "one\ntw", 6);
+	g_assert_cmpuint (xpad_ring_whole_lines (&ring), ==, 4);
+	xpad_ring_push (&ring, (const guint8 *) "o\n", 2);
+	g_assert_cmpuint (xpad_ring_whole_lines (&ring), ==, 8);
+	
+	xpad_ring_clear (&ring);
+}
+
+/* IDs */
+
+static void
+touch (const gchar *dir, const gchar *name)
+{
+	gchar *path = g_build_filename (dir, name, NULL);
+	
+	g_assert_true (g_file_set_contents (path, "", 0, NULL));
+	g_free (path);
+}
+
+static void
+test_ids_fresh (void)
+{
+	gchar *dir, *contents;
+	guint64 first, second, reserved;
+	
+	if (!g_test_subprocess ())
+	{
+		g_test_trap_subprocess (NULL, 0, 0);
+		g_test_trap_assert_passed ();
+		return;
+	}
+	
+	dir = scratch_dir_new ();
+	
+	/* The high half is random, never left empty */
+	first = xpad_pad_id_new ();
+	second = xpad_pad_id_new ();
+	g_assert_cmpuint (first >> 32, !=, 0);
+	g_assert_cmpuint (second, ==, first + 1);
+	
+	/* The block handed out from is reserved on disk */
+	contents = fio_get_file ("next-id");
+	g_assert_nonnull (contents);
+	reserved = g_ascii_strtoull (contents, NULL, 10);
+	g_assert_cmpuint (reserved, >, second);
+	g_free (contents);
+	
+	xpad_pad_id_seen (reserved + 1000);
+	g_assert_cmpuint (xpad_pad_id_new (), ==, reserved + 1001);
+	
+	scratch_dir_free (dir);
+}
+
+static void
+test_ids_floor (void)
+{
+	gchar *dir, *name;
+	guint64 named = G_MAXUINT64 - 1000;
+	
+	if (!g_test_subprocess ())
+	{
+		g_test_trap_subprocess (NULL, 0, 0);
+		g_test_trap_assert_passed ();
+		return;
+	}
+	
+	dir = scratch_dir_new ();
+	
+	/* Above any counter, found by its name alone */
+	name = xpad_pad_id_to_name ("info-", named);
+	touch (dir, name);
+	g_free (name);
+	touch (dir, "info-Ab3xYz");
+	
+	g_assert_cmpuint (xpad_pad_id_new (), ==, named + 1);
+	
+	scratch_dir_free (dir);
+}
+
+static void
+test_ids_taken (void)
+{
+	XpadPadInfo info, read;
+	gchar *dir, *name;
+	guint64 first, second;
+	gboolean exists;
+	
+	if (!g_test_subprocess ())
+	{
+		g_test_trap_subprocess (NULL, 0, 0);
+		g_test_trap_assert_passed ();
+		return;
+	}
+	
+	dir = scratch_dir_new ();
+	
+	/* As if another program had handed out the next ID already.  It is
+	   handed out again, since nothing is looked up... */
+	first = xpad_pad_id_new ();
+	name = xpad_pad_id_to_name ("info-", first + 1);
+	touch (dir, name);
+	second = xpad_pad_id_new ();
+	g_assert_cmpuint (second, ==, first + 1);
+	
+	/* ...until the first file is written under it */
+	xpad_pad_info_init (&info);
+	info.id = second;
+	g_assert_false (xpad_pad_info_create (name, &info, &exists));
+	g_assert_true (exists);
+	g_free (name);
+	
+	info.id = xpad_pad_id_taken (second);
+	g_assert_cmpuint (info.id, ==, second + 1);
+	name = xpad_pad_id_to_name ("info-", info.id);
+	g_assert_true (xpad_pad_info_create (name, &info, &exists));
+	g_assert_false (exists);
+	
+	xpad_pad_info_init (&read);
+	g_assert_true (xpad_pad_info_read (name, &read));
+	g_assert_cmpuint (read.id, ==, info.id);
+	xpad_pad_info_clear (&read);
+	
+	g_free (name);
+	scratch_dir_free (dir);
+}
+
+static void
+test_ids_names (void)
+{
+	gchar *name = xpad_pad_id_to_name ("info-", 42);
+	guint64 id;
+	
+	g_assert_cmpstr (name, ==, "info-000000000000002a");
+	g_assert_true (xpad_pad_id_parse ("42", &id));
+	g_assert_cmpuint (id, ==, 42);
+	g_assert_false (xpad_pad_id_parse ("0", &id));
+	g_assert_false (xpad_pad_id_parse ("pad", &id));
+	g_assert_false (xpad_pad_id_parse (NULL, &id));
+	
+	g_free (name);
+}
+
+gint
+main (gint argc, gchar **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+	
+	g_test_add_func ("/protocol/text-part", test_protocol_text_part);
+	g_test_add_func ("/protocol/long-answer", test_protocol_long_answer);
+	g_test_add_func ("/protocol/long-argument", test_protocol_long_argument);
+	g_test_add_func ("/protocol/too-long", test_protocol_too_long);
+	g_test_add_func ("/protocol/unknown", test_protocol_unknown);
+	g_test_add_func ("/protocol/hold", test_protocol_hold);
+	g_test_add_func ("/markup/parse", test_markup_parse);
+	g_test_add_func ("/markup/runs", test_markup_runs);
+	g_test_add_func ("/markup/round-trip", test_markup_round_trip);
+	g_test_add_func ("/files/plain", test_files_plain);
+	g_test_add_func ("/files/gzip", test_files_gzip);
+	g_test_add_func ("/files/magic", test_files_magic);
+	g_test_add_func ("/files/mapped", test_files_mapped);
+	g_test_add_func ("/files/values", test_files_values);
+	g_test_add_func ("/store/verify", test_store_verify);
+	g_test_add_func ("/ring/wrap", test_ring_wrap);
+	g_test_add_func ("/ring/overflow", test_ring_overflow);
+	g_test_add_func ("/ring/whole-lines", test_ring_whole_lines);
+	g_test_add_func ("/ids/fresh", test_ids_fresh);
+	g_test_add_func ("/ids/floor", test_ids_floor);
+	g_test_add_func ("/ids/taken", test_ids_taken);
+	g_test_add_func ("/ids/names", test_ids_names);
+	
+	return g_test_run ();
+}
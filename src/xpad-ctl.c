@@ -0,0 +1,421 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "../config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "fio.h"
+#include "xpad-import.h"
+#include "xpad-pad-info.h"
+#include "xpad-protocol.h"
+#include "xpad-store.h"
+
+/**
+ * xpad-ctl works on the pad files themselves, for when no xpad is
+ * running or none can be, as on a machine without a display.  It links
+ * libxpadcore only, so it reads and writes the files exactly as xpad does
+ * but never touches GTK.
+ *
+ * Commands that change the files refuse to run next to a live xpad,
+ * which keeps its own view of them; xpad --import and --export talk to
+ * that one instead.
+ */
+
+typedef struct
+{
+	const gchar *name;
+	const gchar *args;
+	const gchar *help;
+	gint (*run) (gint argc, gchar **argv);
+	gboolean writes;
+} CtlCommand;
+
+static gchar *option_config_dir = NULL;
+
+static GOptionEntry options[] =
+{
+	{"config-dir", 'd', 0, G_OPTION_ARG_FILENAME, &option_config_dir, "Work on the pads in DIR instead of the user's", "DIR"},
+	{NULL}
+};
+
+static gboolean
+is_info_name (const gchar *name)
+{
+	return g_str_has_prefix (name, "info-") && !g_str_has_suffix (name, "~");
+}
+
+static gboolean
+is_content_name (const gchar *name)
+{
+	return g_str_has_prefix (name, "content-") && !g_str_has_suffix (name, "~");
+}
+
+/* What the output calls a pad: its ID, or its info file until it has one */
+static gchar *
+pad_name (const XpadStorePad *pad)
+{
+	return pad->info.id ? g_strdup_printf ("%" G_GUINT64_FORMAT, pad->info.id) : g_strdup (pad->infoname);
+}
+
+static gint
+ctl_list (gint argc, gchar **argv)
+{
+	XpadStore *store = xpad_store_open ();
+	XpadStorePad pad;
+
+	while (store && xpad_store_next (store, &pad))
+	{
+		gchar *title = xpad_store_get_title (&pad);
+		gchar *name = pad_name (&pad);
+
+		printf ("%s\t%s\t%s\t%s\n", name, pad.infoname, pad.info.hidden ? "hidden" : "shown", title);
+		g_free (name);
+		g_free (title);
+	}
+
+	xpad_store_close (store);
+
+	return 0;
+}
+
+static gint
+ctl_search (gint argc, gchar **argv)
+{
+	XpadStore *store;
+	XpadStorePad pad;
+	GRegex *regex;
+	GError *error = NULL;
+
+	if (argc != 1)
+		return 2;
+
+	regex = g_regex_new (argv[0], G_REGEX_CASELESS | G_REGEX_OPTIMIZE, 0, &error);
+	if (!regex)
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return 1;
+	}
+
+	store = xpad_store_open ();
+	while (store && xpad_store_next (store, &pad))
+	{
+		const gchar *line = pad.text;
+		gchar *name = pad_name (&pad);
+		gint n;
+
+		for (n = 1; line; n++)
+		{
+			const gchar *end = strchr (line, '\n');
+			gsize len = end ? (gsize) (end - line) : strlen (line);
+
+			if (g_regex_match_full (regex, line, len, 0, 0, NULL, NULL))
+				printf ("%s:%d: %.*s\n", name, n, (gint) len, line);
+			line = end ? end + 1 : NULL;
+		}
+		g_free (name);
+	}
+
+	xpad_store_close (store);
+	g_regex_unref (regex);
+
+	return 0;
+}
+
+static gint
+ctl_dump (gint argc, gchar **argv)
+{
+	XpadStore *store;
+	XpadStorePad pad;
+	GString *out;
+
+	if (argc > 1)
+		return 2;
+
+	out = g_string_new (NULL);
+	store = xpad_store_open ();
+	while (store && xpad_store_next (store, &pad))
+	{
+		if (argc && !xpad_store_pad_matches (&pad, argv[0]))
+			continue;
+
+		xpad_store_append_json (out, &pad);
+		fputs (out->str, stdout);
+		g_string_truncate (out, 0);
+	}
+
+	xpad_store_close (store);
+	g_string_free (out, TRUE);
+
+	return 0;
+}
+
+typedef struct
+{
+	GMainLoop *loop;
+	guint n_files;
+} ImportRun;
+
+static gint
+compare_paths (const gchar **a, const gchar **b)
+{
+	return strcmp (*a, *b);
+}
+
+static void
+import_done (GPtrArray *notes, guint n_failed, ImportRun *run)
+{
+	XpadPadInfo info;
+	guint saved;
+
+	xpad_pad_info_init (&info);
+	info.hidden = TRUE;
+	xpad_pad_id_scan ();
+	saved = xpad_import_save (notes, &info);
+
+	printf ("Imported %u of %u files\n", saved, run->n_files);
+	g_main_loop_quit (run->loop);
+}
+
+static gint
+ctl_import (gint argc, gchar **argv)
+{
+	GPtrArray *files;
+	ImportRun run;
+	gint i;
+
+	if (argc == 0)
+		return 2;
+
+	/* Directories stand for the files in them, in name order */
+	files = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < argc; i++)
+	{
+		GDir *dir = g_dir_open (argv[i], 0, NULL);
+		const gchar *name;
+		guint first = files->len;
+
+		if (!dir)
+		{
+			g_ptr_array_add (files, g_strdup (argv[i]));
+			continue;
+		}
+
+		while ((name = g_dir_read_name (dir)))
+		{
+			gchar *path = g_build_filename (argv[i], name, NULL);
+
+			if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+				g_ptr_array_add (files, path);
+			else
+				g_free (path);
+		}
+		g_dir_close (dir);
+
+		qsort (files->pdata + first, files->len - first, sizeof (gpointer), (GCompareFunc) compare_paths);
+	}
+	g_ptr_array_add (files, NULL);
+
+	run.loop = g_main_loop_new (NULL, FALSE);
+	run.n_files = files->len - 1;
+	xpad_import_files ((gchar **) files->pdata, (XpadImportDoneFunc) import_done, &run);
+	g_main_loop_run (run.loop);
+
+	g_main_loop_unref (run.loop);
+	g_ptr_array_unref (files);
+
+	return 0;
+}
+
+/**
+ * Removes what interrupted saves and older versions leave behind: backup
+ * files, content files no pad points to, and info files that never got as
+ * far as naming their content.
+ */
+static gint
+ctl_compact (gint argc, gchar **argv)
+{
+	GHashTable *used = xpad_store_get_content_names ();
+	GDir *dir = g_dir_open (fio_get_config_dir (), 0, NULL);
+	const gchar *name;
+	guint removed = 0;
+	goffset freed = 0;
+
+	while (dir && (name = g_dir_read_name (dir)))
+	{
+		gboolean remove = FALSE;
+
+		if ((g_str_has_prefix (name, "info-") || g_str_has_prefix (name, "content-")) &&
+		    g_str_has_suffix (name, "~"))
+			remove = TRUE;
+		else if (is_content_name (name))
+			remove = !g_hash_table_contains (used, name);
+		else if (is_info_name (name))
+		{
+			XpadPadInfo info;
+
+			xpad_pad_info_init (&info);
+			remove = !xpad_pad_info_read (name, &info) ||
+				((!info.contentname || !*info.contentname) && !info.followname);
+			xpad_pad_info_clear (&info);
+		}
+
+		if (remove)
+		{
+			gchar *path = g_build_filename (fio_get_config_dir (), name, NULL);
+			GStatBuf buf;
+
+			if (g_stat (path, &buf) == 0)
+				freed += buf.st_size;
+			g_free (path);
+
+			fio_remove_file (name);
+			removed++;
+		}
+	}
+
+	if (dir)
+		g_dir_close (dir);
+	g_hash_table_destroy (used);
+
+	printf ("Removed %u files, %" G_GOFFSET_FORMAT " bytes\n", removed, freed);
+
+	return 0;
+}
+
+static void
+report (const gchar *name, const gchar *problem, gpointer user_data)
+{
+	printf ("%s: %s\n", name, problem);
+}
+
+/* Prints every problem found and fails if there was any */
+static gint
+ctl_verify (gint argc, gchar **argv)
+{
+	guint problems = xpad_store_verify (report, NULL);
+
+	if (problems == 0)
+		printf ("No problems found\n");
+
+	return problems ? 1 : 0;
+}
+
+static const CtlCommand commands[] =
+{
+	{"list", "", "List the pads: ID, info file, hidden or shown, title", ctl_list, FALSE},
+	{"search", "PATTERN", "Print the lines of all pads that match PATTERN", ctl_search, FALSE},
+	{"dump", "[PAD]", "Print every pad, or PAD, as a line of JSON", ctl_dump, FALSE},
+	{"import", "FILE|DIR...", "Add a hidden pad for every file", ctl_import, TRUE},
+	{"compact", "", "Remove files no pad uses", ctl_compact, TRUE},
+	{"verify", "", "Check that every pad can be read", ctl_verify, FALSE},
+	{NULL}
+};
+
+static gchar *
+describe_commands (void)
+{
+	GString *text = g_string_new ("Commands:\n");
+	const CtlCommand *command;
+
+	for (command = commands; command->name; command++)
+	{
+		gchar *usage = g_strconcat (command->name, " ", command->args, NULL);
+
+		g_string_append_printf (text, "  %-22s%s\n", usage, command->help);
+		g_free (usage);
+	}
+
+	return g_string_free (text, FALSE);
+}
+
+/* Anyone listening on the server socket is a running xpad */
+static gboolean
+xpad_is_running (void)
+{
+	gchar *path = g_build_filename (fio_get_config_dir (), "server", NULL);
+	XpadProtocolClient *client = xpad_protocol_client_new (path);
+	gboolean running = client != NULL;
+
+	g_free (path);
+	xpad_protocol_client_free (client);
+
+	return running;
+}
+
+int
+main (int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	const CtlCommand *command;
+	gchar *description, *dir;
+	gint status;
+
+	context = g_option_context_new ("COMMAND [ARGUMENTS]");
+	g_option_context_set_summary (context, "Reads and maintains xpad's pads without running xpad.");
+	description = describe_commands ();
+	g_option_context_set_description (context, description);
+	g_free (description);
+	g_option_context_add_main_entries (context, options, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return 2;
+	}
+
+	for (command = commands; command->name && (argc < 2 || strcmp (command->name, argv[1])); command++)
+		;
+
+	if (!command->name)
+	{
+		gchar *help = g_option_context_get_help (context, TRUE, NULL);
+		g_printerr ("%s", help);
+		g_free (help);
+		g_option_context_free (context);
+		return 2;
+	}
+
+	dir = option_config_dir ? g_strdup (option_config_dir) : g_build_filename (g_get_user_config_dir (), PACKAGE, NULL);
+	if (!g_file_test (dir, G_FILE_TEST_IS_DIR))
+	{
+		g_printerr ("There are no pads in %s\n", dir);
+		g_free (dir);
+		g_option_context_free (context);
+		return 1;
+	}
+	fio_set_config_dir (dir);
+	g_free (dir);
+
+	if (command->writes && xpad_is_running ())
+	{
+		g_printerr ("xpad is running; close it before using %s\n", command->name);
+		g_option_context_free (context);
+		return 1;
+	}
+
+	status = command->run (argc - 2, argv + 2);
+	if (status == 2)
+		g_printerr ("Usage: xpad-ctl %s %s\n", command->name, command->args);
+
+	g_option_context_free (context);
+
+	return status;
+}
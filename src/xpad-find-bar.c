@@ -0,0 +1,418 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "../config.h"
+#include <glib/gi18n.h>
+#include <string.h>
+#include "xpad-find-bar.h"
+#include "xpad-search.h"
+#include "xpad-text-buffer.h"
+
+G_DEFINE_TYPE(XpadFindBar, xpad_find_bar, GTK_TYPE_BOX)
+#define XPAD_FIND_BAR_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), XPAD_TYPE_FIND_BAR, XpadFindBarPrivate))
+
+/* Characters pulled out of the buffer per matcher call */
+#define CHUNK_CHARS (256 * 1024)
+
+/* Time spent scanning before handing control back to the main loop */
+#define SLICE_USEC 4000
+
+struct XpadFindBarPrivate
+{
+	GtkTextView *view;
+	GtkTextBuffer *buffer;
+	GtkTextTag *tag;
+	gulong changed_handler;
+
+	GtkWidget *entry;
+	GtkWidget *match_case;
+	GtkWidget *status;
+
+	/* scan state, all offsets are in characters */
+	XpadSearchPattern *pattern;
+	guint scan_source;
+	gint scan_pos;
+	gint scan_end;
+	gint wrap_end;
+	gint last_match_end;
+	guint n_matches;
+};
+
+static void xpad_find_bar_dispose (GObject *object);
+static void xpad_find_bar_restart (XpadFindBar *bar);
+static void xpad_find_bar_stop (XpadFindBar *bar);
+static void xpad_find_bar_update_status (XpadFindBar *bar);
+
+GtkWidget *
+xpad_find_bar_new (GtkTextView *view)
+{
+	XpadFindBar *bar = XPAD_FIND_BAR (g_object_new (XPAD_TYPE_FIND_BAR,
+		"orientation", GTK_ORIENTATION_HORIZONTAL,
+		"spacing", 6,
+		NULL));
+
+	bar->priv->view = view;
+	bar->priv->buffer = gtk_text_view_get_buffer (view);
+	bar->priv->tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (bar->priv->buffer), XPAD_TEXT_BUFFER_SEARCH_TAG);
+	bar->priv->changed_handler = g_signal_connect_swapped (bar->priv->buffer, "changed", G_CALLBACK (xpad_find_bar_restart), bar);
+
+	return GTK_WIDGET (bar);
+}
+
+static void
+xpad_find_bar_class_init (XpadFindBarClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	gobject_class->dispose = xpad_find_bar_dispose;
+
+	g_type_class_add_private (gobject_class, sizeof (XpadFindBarPrivate));
+}
+
+static void
+xpad_find_bar_init (XpadFindBar *bar)
+{
+	GtkWidget *button;
+
+	bar->priv = XPAD_FIND_BAR_GET_PRIVATE (bar);
+
+	bar->priv->view = NULL;
+	bar->priv->buffer = NULL;
+	bar->priv->tag = NULL;
+	bar->priv->changed_handler = 0;
+	bar->priv->pattern = NULL;
+	bar->priv->scan_source = 0;
+	bar->priv->n_matches = 0;
+
+	bar->priv->entry = gtk_search_entry_new ();
+	gtk_widget_set_hexpand (bar->priv->entry, TRUE);
+	gtk_box_append (GTK_BOX (bar), bar->priv->entry);
+
+	button = gtk_button_new_from_icon_name ("go-up-symbolic");
+	gtk_widget_set_tooltip_text (button, _("Find previous"));
+	g_signal_connect_swapped (button, "clicked", G_CALLBACK (xpad_find_bar_previous), bar);
+	gtk_box_append (GTK_BOX (bar), button);
+
+	button = gtk_button_new_from_icon_name ("go-down-symbolic");
+	gtk_widget_set_tooltip_text (button, _("Find next"));
+	g_signal_connect_swapped (button, "clicked", G_CALLBACK (xpad_find_bar_next), bar);
+	gtk_box_append (GTK_BOX (bar), button);
+
+	bar->priv->match_case = gtk_check_button_new_with_mnemonic (_("Match _case"));
+	gtk_box_append (GTK_BOX (bar), bar->priv->match_case);
+
+	bar->priv->status = gtk_label_new (NULL);
+	gtk_box_append (GTK_BOX (bar), bar->priv->status);
+
+	button = gtk_button_new_from_icon_name ("window-close-symbolic");
+	gtk_widget_set_tooltip_text (button, _("Close find bar"));
+	g_signal_connect_swapped (button, "clicked", G_CALLBACK (xpad_find_bar_close), bar);
+	gtk_box_append (GTK_BOX (bar), button);
+
+	g_signal_connect_swapped (bar->priv->entry, "search-changed", G_CALLBACK (xpad_find_bar_restart), bar);
+	g_signal_connect_swapped (bar->priv->entry, "activate", G_CALLBACK (xpad_find_bar_next), bar);
+	g_signal_connect_swapped (bar->priv->entry, "next-match", G_CALLBACK (xpad_find_bar_next), bar);
+	g_signal_connect_swapped (bar->priv->entry, "previous-match", G_CALLBACK (xpad_find_bar_previous), bar);
+	g_signal_connect_swapped (bar->priv->entry, "stop-search", G_CALLBACK (xpad_find_bar_close), bar);
+	g_signal_connect_swapped (bar->priv->match_case, "toggled", G_CALLBACK (xpad_find_bar_restart), bar);
+}
+
+static void
+xpad_find_bar_dispose (GObject *object)
+{
+	XpadFindBar *bar = XPAD_FIND_BAR (object);
+
+	xpad_find_bar_stop (bar);
+
+	if (bar->priv->changed_handler)
+	{
+		g_signal_handler_disconnect (bar->priv->buffer, bar->priv->changed_handler);
+		bar->priv->changed_handler = 0;
+	}
+
+	G_OBJECT_CLASS (xpad_find_bar_parent_class)->dispose (object);
+}
+
+/* Cancels a running scan and drops all highlights */
+static void
+xpad_find_bar_stop (XpadFindBar *bar)
+{
+	GtkTextIter start, end;
+
+	if (bar->priv->scan_source)
+	{
+		g_source_remove (bar->priv->scan_source);
+		bar->priv->scan_source = 0;
+	}
+
+	if (bar->priv->pattern)
+	{
+		xpad_search_pattern_free (bar->priv->pattern);
+		bar->priv->pattern = NULL;
+
+		gtk_text_buffer_get_bounds (bar->priv->buffer, &start, &end);
+		gtk_text_buffer_remove_tag (bar->priv->buffer, bar->priv->tag, &start, &end);
+	}
+
+	bar->priv->n_matches = 0;
+}
+
+/**
+ * Scans the next chunk of the current range.  The buffer is searched from
+ * the top of the visible area to the end first, then wraps around to the
+ * start, so what the user is looking at is highlighted right away.
+ * Returns FALSE when there is nothing left to scan.
+ */
+static gboolean
+xpad_find_bar_scan_chunk (XpadFindBar *bar)
+{
+	XpadFindBarPrivate *priv = bar->priv;
+	GtkTextIter start, end;
+	glong n_chars = xpad_search_pattern_get_chars (priv->pattern);
+	gsize n_bytes = xpad_search_pattern_get_length (priv->pattern);
+	const gchar *p, *hit, *text_end, *counted;
+	gchar *text;
+	gint chunk_end, offset;
+
+	if (priv->scan_pos >= priv->scan_end)
+	{
+		if (priv->wrap_end <= 0)
+			return FALSE;
+
+		priv->scan_pos = 0;
+		priv->scan_end = priv->wrap_end;
+		priv->wrap_end = 0;
+		priv->last_match_end = 0;
+	}
+
+	chunk_end = MIN (priv->scan_pos + MAX (CHUNK_CHARS, 2 * n_chars), priv->scan_end);
+
+	gtk_text_buffer_get_iter_at_offset (priv->buffer, &start, priv->scan_pos);
+	gtk_text_buffer_get_iter_at_offset (priv->buffer, &end, chunk_end);
+	text = gtk_text_buffer_get_slice (priv->buffer, &start, &end, TRUE);
+	text_end = text + strlen (text);
+
+	/* Keep a running character offset so each hit costs only the distance
+	   from the previous one */
+	offset = priv->scan_pos;
+	counted = text;
+
+	for (p = text; (hit = xpad_search_find (priv->pattern, p, text_end - p)); p = hit + n_bytes)
+	{
+		offset += g_utf8_pointer_to_offset (counted, hit);
+
+		gtk_text_buffer_get_iter_at_offset (priv->buffer, &start, offset);
+		end = start;
+		gtk_text_iter_forward_chars (&end, n_chars);
+		gtk_text_buffer_apply_tag (priv->buffer, priv->tag, &start, &end);
+		priv->n_matches++;
+
+		offset += n_chars;
+		counted = hit + n_bytes;
+		priv->last_match_end = offset;
+	}
+
+	g_free (text);
+
+	/* Overlap the next chunk so matches crossing the boundary are found */
+	if (chunk_end < priv->scan_end)
+		priv->scan_pos = MAX (chunk_end - (gint) (n_chars - 1), priv->last_match_end);
+	else
+		priv->scan_pos = chunk_end;
+
+	return TRUE;
+}
+
+static gboolean
+xpad_find_bar_scan_slice (XpadFindBar *bar)
+{
+	gint64 deadline = g_get_monotonic_time () + SLICE_USEC;
+
+	while (xpad_find_bar_scan_chunk (bar))
+	{
+		if (g_get_monotonic_time () >= deadline)
+		{
+			xpad_find_bar_update_status (bar);
+			return TRUE;
+		}
+	}
+
+	bar->priv->scan_source = 0;
+	xpad_find_bar_update_status (bar);
+	return FALSE;
+}
+
+static void
+xpad_find_bar_restart (XpadFindBar *bar)
+{
+	XpadFindBarPrivate *priv = bar->priv;
+	const gchar *needle;
+	GdkRectangle rect;
+	GtkTextIter iter;
+	gint visible, length;
+
+	xpad_find_bar_stop (bar);
+
+	needle = gtk_editable_get_text (GTK_EDITABLE (priv->entry));
+	if (!gtk_widget_get_visible (GTK_WIDGET (bar)) || !needle || !*needle)
+	{
+		xpad_find_bar_update_status (bar);
+		return;
+	}
+
+	priv->pattern = xpad_search_pattern_new (needle, gtk_check_button_get_active (GTK_CHECK_BUTTON (priv->match_case)));
+
+	gtk_text_view_get_visible_rect (priv->view, &rect);
+	gtk_text_view_get_line_at_y (priv->view, &iter, rect.y, NULL);
+	visible = gtk_text_iter_get_offset (&iter);
+	length = gtk_text_buffer_get_char_count (priv->buffer);
+
+	priv->scan_pos = visible;
+	priv->scan_end = length;
+	priv->last_match_end = visible;
+	/* the wrapped pass only needs to reach matches that start above the fold */
+	priv->wrap_end = visible ? MIN (visible + (gint) xpad_search_pattern_get_chars (priv->pattern) - 1, length) : 0;
+
+	/* Do the first slice right away so the visible area never flickers */
+	if (xpad_find_bar_scan_slice (bar))
+		priv->scan_source = g_idle_add ((GSourceFunc) xpad_find_bar_scan_slice, bar);
+}
+
+static void
+xpad_find_bar_update_status (XpadFindBar *bar)
+{
+	gchar *text;
+
+	if (!bar->priv->pattern)
+		text = g_strdup ("");
+	else if (bar->priv->scan_source)
+		text = g_strdup_printf (ngettext ("%u match so far", "%u matches so far", bar->priv->n_matches), bar->priv->n_matches);
+	else if (bar->priv->n_matches == 0)
+		text = g_strdup (_("Not found"));
+	else
+		text = g_strdup_printf (ngettext ("%u match", "%u matches", bar->priv->n_matches), bar->priv->n_matches);
+
+	gtk_label_set_text (GTK_LABEL (bar->priv->status), text);
+	g_free (text);
+}
+
+static void
+xpad_find_bar_select (XpadFindBar *bar, GtkTextIter *start)
+{
+	GtkTextIter end = *start;
+
+	gtk_text_iter_forward_chars (&end, xpad_search_pattern_get_chars (bar->priv->pattern));
+	gtk_text_buffer_select_range (bar->priv->buffer, start, &end);
+	gtk_text_view_scroll_to_iter (bar->priv->view, start, 0.1, FALSE, 0.0, 0.0);
+}
+
+void
+xpad_find_bar_next (XpadFindBar *bar)
+{
+	GtkTextIter iter, sel_start;
+
+	if (!bar->priv->pattern || bar->priv->n_matches == 0)
+	{
+		gtk_widget_error_bell (GTK_WIDGET (bar));
+		return;
+	}
+
+	/* A match right at the cursor counts, unless it is already selected */
+	if (!gtk_text_buffer_get_selection_bounds (bar->priv->buffer, &sel_start, &iter) &&
+		 gtk_text_iter_starts_tag (&iter, bar->priv->tag))
+	{
+		xpad_find_bar_select (bar, &iter);
+		return;
+	}
+
+	while (gtk_text_iter_forward_to_tag_toggle (&iter, bar->priv->tag))
+	{
+		if (gtk_text_iter_starts_tag (&iter, bar->priv->tag))
+		{
+			xpad_find_bar_select (bar, &iter);
+			return;
+		}
+	}
+
+	/* wrap around */
+	gtk_text_buffer_get_start_iter (bar->priv->buffer, &iter);
+	if (gtk_text_iter_starts_tag (&iter, bar->priv->tag) ||
+		 gtk_text_iter_forward_to_tag_toggle (&iter, bar->priv->tag))
+		xpad_find_bar_select (bar, &iter);
+}
+
+void
+xpad_find_bar_previous (XpadFindBar *bar)
+{
+	GtkTextIter iter, sel_end;
+
+	if (!bar->priv->pattern || bar->priv->n_matches == 0)
+	{
+		gtk_widget_error_bell (GTK_WIDGET (bar));
+		return;
+	}
+
+	gtk_text_buffer_get_selection_bounds (bar->priv->buffer, &iter, &sel_end);
+
+	while (gtk_text_iter_backward_to_tag_toggle (&iter, bar->priv->tag))
+	{
+		if (gtk_text_iter_starts_tag (&iter, bar->priv->tag))
+		{
+			xpad_find_bar_select (bar, &iter);
+			return;
+		}
+	}
+
+	/* wrap around */
+	gtk_text_buffer_get_end_iter (bar->priv->buffer, &iter);
+	while (gtk_text_iter_backward_to_tag_toggle (&iter, bar->priv->tag))
+	{
+		if (gtk_text_iter_starts_tag (&iter, bar->priv->tag))
+		{
+			xpad_find_bar_select (bar, &iter);
+			return;
+		}
+	}
+}
+
+void
+xpad_find_bar_open (XpadFindBar *bar)
+{
+	GtkTextIter start, end;
+
+	/* Seed the entry with a short single-line selection */
+	if (gtk_text_buffer_get_selection_bounds (bar->priv->buffer, &start, &end) &&
+		 gtk_text_iter_get_line (&start) == gtk_text_iter_get_line (&end))
+	{
+		gchar *text = gtk_text_buffer_get_text (bar->priv->buffer, &start, &end, FALSE);
+		gtk_editable_set_text (GTK_EDITABLE (bar->priv->entry), text);
+		g_free (text);
+	}
+
+	gtk_widget_set_visible (GTK_WIDGET (bar), TRUE);
+	gtk_widget_grab_focus (bar->priv->entry);
+	gtk_editable_select_region (GTK_EDITABLE (bar->priv->entry), 0, -1);
+
+	xpad_find_bar_restart (bar);
+}
+
+void
+xpad_find_bar_close (XpadFindBar *bar)
+{
+	xpad_find_bar_stop (bar);
+	gtk_widget_set_visible (GTK_WIDGET (bar), FALSE);
+	gtk_widget_grab_focus (GTK_WIDGET (bar->priv->view));
+}
@@ -0,0 +1,59 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_FIND_BAR_H__
+#define __XPAD_FIND_BAR_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define XPAD_TYPE_FIND_BAR          (xpad_find_bar_get_type ())
+#define XPAD_FIND_BAR(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), XPAD_TYPE_FIND_BAR, XpadFindBar))
+#define XPAD_FIND_BAR_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), XPAD_TYPE_FIND_BAR, XpadFindBarClass))
+#define XPAD_IS_FIND_BAR(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), XPAD_TYPE_FIND_BAR))
+#define XPAD_IS_FIND_BAR_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), XPAD_TYPE_FIND_BAR))
+#define XPAD_FIND_BAR_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), XPAD_TYPE_FIND_BAR, XpadFindBarClass))
+
+typedef struct XpadFindBarClass XpadFindBarClass;
+typedef struct XpadFindBarPrivate XpadFindBarPrivate;
+typedef struct XpadFindBar XpadFindBar;
+
+struct XpadFindBar
+{
+	GtkBox parent;
+
+	/* private */
+	XpadFindBarPrivate *priv;
+};
+
+struct XpadFindBarClass
+{
+	GtkBoxClass parent_class;
+};
+
+GType xpad_find_bar_get_type (void);
+
+GtkWidget *xpad_find_bar_new (GtkTextView *view);
+
+void xpad_find_bar_open (XpadFindBar *bar);
+void xpad_find_bar_close (XpadFindBar *bar);
+void xpad_find_bar_next (XpadFindBar *bar);
+void xpad_find_bar_previous (XpadFindBar *bar);
+
+G_END_DECLS
+
+#endif /* __XPAD_FIND_BAR_H__ */
@@ -0,0 +1,323 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include <gio/gunixinputstream.h>
+#include "xpad-follow.h"
+#include "xpad-ring.h"
+#include "xpad-timer.h"
+
+/**
+ * Follows a file or FIFO the way tail -f does.
+ *
+ * Nothing ever waits on the file.  A FIFO is opened non-blocking, so
+ * there need not be a writer yet, and read whenever poll says it has
+ * something.  A regular file is read in idle slices up to its end, then
+ * again once the file monitor reports a change.  What is read waits in a
+ * ring of max_bytes until it is handed on, once per frame and in whole
+ * lines, so a writer that outruns the UI costs no more memory than the
+ * ring.  If the ring overflows, the oldest bytes are dropped and the next
+ * delivery asks the receiver to replace what it has.
+ */
+
+/* Bytes taken by one read */
+#define READ_SIZE 65536
+
+/* Milliseconds new text waits for more, about one frame */
+#define DELIVER_DELAY 16
+
+struct XpadFollow
+{
+	GFile *file;
+	GFileMonitor *monitor;
+	GInputStream *stream;
+	GSource *source;     /* reading stream, while there is more to read */
+	gboolean is_fifo;
+	gboolean opened_once;
+	
+	XpadRing ring;
+	gboolean overflowed;
+	XpadTimer deliver_timer;
+	
+	XpadFollowFunc func;
+	gpointer user_data;
+};
+
+static void follow_open (XpadFollow *follow);
+
+/* Hands on whole lines, or everything once the writer has paused */
+static void
+follow_deliver (XpadFollow *follow, gboolean all)
+{
+	guint8 *bytes;
+	gchar *text;
+	gsize n;
+	
+	xpad_timer_cancel (&follow->deliver_timer);
+	
+	n = all ? follow->ring.len : xpad_ring_whole_lines (&follow->ring);
+	
+	/* A line longer than the whole ring goes as it is */
+	if (n == 0 && follow->ring.len == follow->ring.capacity)
+		n = follow->ring.len;
+	if (n == 0)
+		return;
+	
+	bytes = g_malloc (n);
+	xpad_ring_take (&follow->ring, bytes, n);
+	text = g_utf8_make_valid ((const gchar *) bytes, n);
+	g_free (bytes);
+	
+	follow->func (text, follow->overflowed, follow->user_data);
+	follow->overflowed = FALSE;
+	
+	g_free (text);
+}
+
+static void
+follow_deliver_lines (XpadFollow *follow)
+{
+	follow_deliver (follow, FALSE);
+}
+
+static void
+follow_stop_reading (XpadFollow *follow)
+{
+	if (!follow->source)
+		return;
+	
+	g_source_destroy (follow->source);
+	g_source_unref (follow->source);
+	follow->source = NULL;
+}
+
+/* Drops the current stream */
+static void
+follow_close (XpadFollow *follow)
+{
+	follow_stop_reading (follow);
+	g_clear_object (&follow->stream);
+}
+
+/* Takes one read's worth, returning FALSE once there is nothing left
+   to wait for on this stream */
+static gboolean
+follow_read (gpointer data)
+{
+	XpadFollow *follow = data;
+	guint8 buf[READ_SIZE];
+	GError *error = NULL;
+	gssize n;
+	
+	if (follow->is_fifo)
+		n = g_pollable_input_stream_read_nonblocking (G_POLLABLE_INPUT_STREAM (follow->stream),
+			buf, sizeof (buf), NULL, &error);
+	else
+		n = g_input_stream_read (follow->stream, buf, sizeof (buf), NULL, &error);
+	
+	if (n < 0)
+	{
+		/* poll can wake us for nothing */
+		if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+		{
+			g_error_free (error);
+			return G_SOURCE_CONTINUE;
+		}
+		
+		g_warning ("%s", error->message);
+		g_error_free (error);
+		follow_stop_reading (follow);
+		return G_SOURCE_REMOVE;
+	}
+	
+	if (n == 0)
+	{
+		follow_deliver (follow, TRUE);
+		
+		/* The last writer of a FIFO went away, and it stays readable at
+		   its end until opened again for the next one.  A file waits for
+		   the monitor. */
+		if (follow->is_fifo)
+		{
+			follow_close (follow);
+			follow_open (follow);
+		}
+		else
+			follow_stop_reading (follow);
+		return G_SOURCE_REMOVE;
+	}
+	
+	if (xpad_ring_push (&follow->ring, buf, n))
+		follow->overflowed = TRUE;
+	
+	if (!xpad_timer_is_pending (&follow->deliver_timer))
+		xpad_timer_schedule (&follow->deliver_timer, DELIVER_DELAY);
+	
+	return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+follow_fifo_ready (GObject *stream, gpointer data)
+{
+	return follow_read (data);
+}
+
+static void
+follow_start_reading (XpadFollow *follow)
+{
+	if (follow->source || !follow->stream)
+		return;
+	
+	if (follow->is_fifo)
+	{
+		follow->source = g_pollable_input_stream_create_source (G_POLLABLE_INPUT_STREAM (follow->stream), NULL);
+		g_source_set_callback (follow->source, (GSourceFunc) follow_fifo_ready, follow, NULL);
+	}
+	else
+	{
+		follow->source = g_idle_source_new ();
+		g_source_set_callback (follow->source, follow_read, follow, NULL);
+	}
+	g_source_attach (follow->source, NULL);
+}
+
+static void
+follow_open (XpadFollow *follow)
+{
+	struct stat st;
+	gchar *path;
+	gint fd;
+	
+	if (follow->stream)
+		return;
+	
+	/* A missing file is waited for; the monitor reports it */
+	path = g_file_get_path (follow->file);
+	fd = path ? g_open (path, O_RDONLY | O_NONBLOCK | O_CLOEXEC, 0) : -1;
+	g_free (path);
+	if (fd < 0)
+		return;
+	
+	if (fstat (fd, &st) < 0)
+	{
+		close (fd);
+		return;
+	}
+	
+	follow->stream = g_unix_input_stream_new (fd, TRUE);
+	follow->is_fifo = !S_ISREG (st.st_mode) &&
+		g_pollable_input_stream_can_poll (G_POLLABLE_INPUT_STREAM (follow->stream));
+	
+	/* Of the file we start with only the tail matters; a file that shows
+	   up later, as after log rotation, is read from the start */
+	if (!follow->is_fifo && !follow->opened_once && st.st_size > (off_t) follow->ring.capacity)
+		lseek (fd, st.st_size - follow->ring.capacity, SEEK_SET);
+	follow->opened_once = TRUE;
+	
+	follow_start_reading (follow);
+}
+
+/* Starts over from the beginning if the file was cut short */
+static void
+follow_check_truncated (XpadFollow *follow)
+{
+	gint fd = g_unix_input_stream_get_fd (G_UNIX_INPUT_STREAM (follow->stream));
+	struct stat st;
+	
+	if (fstat (fd, &st) == 0 && st.st_size < lseek (fd, 0, SEEK_CUR))
+		lseek (fd, 0, SEEK_SET);
+}
+
+static void
+follow_monitor_changed (GFileMonitor *monitor, GFile *file, GFile *other_file,
+                        GFileMonitorEvent event, XpadFollow *follow)
+{
+	switch (event)
+	{
+	case G_FILE_MONITOR_EVENT_CHANGED:
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		if (follow->stream && !follow->source && !follow->is_fifo)
+		{
+			follow_check_truncated (follow);
+			follow_start_reading (follow);
+		}
+		else if (!follow->stream)
+			follow_open (follow);
+		break;
+	case G_FILE_MONITOR_EVENT_RENAMED:
+		if (!other_file || !g_file_equal (other_file, follow->file))
+			break;
+		/* fall through */
+	case G_FILE_MONITOR_EVENT_CREATED:
+	case G_FILE_MONITOR_EVENT_MOVED_IN:
+		/* A new file took the name; what is left of the old one is lost */
+		follow_close (follow);
+		follow_open (follow);
+		break;
+	default:
+		break;
+	}
+}
+
+XpadFollow *
+xpad_follow_new (const gchar *filename, gsize max_bytes, XpadFollowFunc func, gpointer user_data)
+{
+	XpadFollow *follow;
+	
+	g_return_val_if_fail (max_bytes > 0, NULL);
+	
+	follow = g_new0 (XpadFollow, 1);
+	follow->file = g_file_new_for_path (filename);
+	xpad_ring_init (&follow->ring, max_bytes);
+	follow->func = func;
+	follow->user_data = user_data;
+	xpad_timer_init (&follow->deliver_timer, (XpadTimerFunc) follow_deliver_lines, follow);
+	
+	follow->monitor = g_file_monitor_file (follow->file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+	if (follow->monitor)
+		g_signal_connect (follow->monitor, "changed", G_CALLBACK (follow_monitor_changed), follow);
+	
+	follow_open (follow);
+	
+	return follow;
+}
+
+/* Stops following.  Text still in the ring is dropped. */
+void
+xpad_follow_free (XpadFollow *follow)
+{
+	if (!follow)
+		return;
+	
+	xpad_timer_cancel (&follow->deliver_timer);
+	
+	if (follow->monitor)
+	{
+		g_signal_handlers_disconnect_by_data (follow->monitor, follow);
+		g_file_monitor_cancel (follow->monitor);
+		g_object_unref (follow->monitor);
+	}
+	
+	follow_close (follow);
+	
+	g_object_unref (follow->file);
+	xpad_ring_clear (&follow->ring);
+	g_free (follow);
+}
@@ -0,0 +1,227 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "fio.h"
+#include "xpad-import.h"
+#include "xpad-store.h"
+
+/**
+ * Reads many notes at once for a bulk import.
+ *
+ * Every file is one job on a shared thread pool, which reads it and
+ * splits its markup into text and spans, so nothing is left for the main
+ * context but building the pads.  Each job fills its own slot of the
+ * result array; whoever finishes last hands the whole array to the main
+ * context the import was started from.
+ */
+
+typedef struct
+{
+	gint pending;
+	gint failed;
+	GPtrArray *notes;
+	GMainContext *context;
+	XpadImportDoneFunc done_func;
+	gpointer user_data;
+} Import;
+
+typedef struct
+{
+	Import *import;
+	guint index;
+	gchar *filename;
+} ImportJob;
+
+static GThreadPool *import_pool = NULL;
+
+static void
+note_free (XpadImportNote *note)
+{
+	if (!note)
+		return;
+
+	g_free (note->filename);
+	g_free (note->content);
+	g_free (note->text);
+	g_free (note->contentname);
+	g_free (note->infoname);
+	if (note->spans)
+		g_variant_unref (note->spans);
+	g_free (note);
+}
+
+static gboolean
+import_deliver (gpointer data)
+{
+	Import *import = data;
+	guint i, n = 0;
+
+	/* Drop the slots of files that could not be read */
+	for (i = 0; i < import->notes->len; i++)
+	{
+		gpointer note = g_ptr_array_index (import->notes, i);
+
+		g_ptr_array_index (import->notes, i) = NULL;
+		if (note)
+			g_ptr_array_index (import->notes, n++) = note;
+	}
+	g_ptr_array_set_size (import->notes, n);
+
+	import->done_func (import->notes, g_atomic_int_get (&import->failed), import->user_data);
+
+	return FALSE;
+}
+
+static void
+import_free (Import *import)
+{
+	g_ptr_array_unref (import->notes);
+	g_main_context_unref (import->context);
+	g_free (import);
+}
+
+static void
+import_job_finished (Import *import)
+{
+	if (g_atomic_int_dec_and_test (&import->pending))
+		g_main_context_invoke_full (import->context, G_PRIORITY_DEFAULT,
+			import_deliver, import, (GDestroyNotify) import_free);
+}
+
+static void
+import_worker (gpointer data, gpointer user_data)
+{
+	ImportJob *job = data;
+	gchar *content;
+
+	if (g_file_get_contents (job->filename, &content, NULL, NULL))
+	{
+		XpadImportNote *note = g_new0 (XpadImportNote, 1);
+
+		/* Content files must be UTF-8, whatever the other tool wrote */
+		note->content = g_utf8_make_valid (content, -1);
+		g_free (content);
+		xpad_store_parse_content (note->content, -1, &note->text, &note->spans);
+		note->filename = job->filename;
+		job->filename = NULL;
+
+		g_ptr_array_index (job->import->notes, job->index) = note;
+	}
+	else
+		g_atomic_int_inc (&job->import->failed);
+
+	import_job_finished (job->import);
+	g_free (job->filename);
+	g_free (job);
+}
+
+/* done_func runs on the calling thread's main context, even for no files */
+void
+xpad_import_files (gchar **filenames, XpadImportDoneFunc done_func, gpointer user_data)
+{
+	Import *import;
+	guint i, n = filenames ? g_strv_length (filenames) : 0;
+
+	if (!import_pool)
+		import_pool = g_thread_pool_new (import_worker, NULL, g_get_num_processors (), FALSE, NULL);
+
+	import = g_new0 (Import, 1);
+	import->notes = g_ptr_array_new_full (n, (GDestroyNotify) note_free);
+	g_ptr_array_set_size (import->notes, n);
+	import->context = g_main_context_ref_thread_default ();
+	import->done_func = done_func;
+	import->user_data = user_data;
+
+	/* One extra count so delivery can't start before every job is queued */
+	g_atomic_int_set (&import->pending, n + 1);
+
+	for (i = 0; i < n; i++)
+	{
+		ImportJob *job = g_new (ImportJob, 1);
+		job->import = import;
+		job->index = i;
+		job->filename = g_strdup (filenames[i]);
+		g_thread_pool_push (import_pool, job, NULL);
+	}
+
+	import_job_finished (import);
+}
+
+/**
+ * Writes a content and an info file for every note, the info files
+ * saying what info does but for the content name.  Returns how many
+ * notes got both.
+ *
+ * Everything is written in two batches: all content files, then all info
+ * files.  Only info files make pads, so an import cut short leaves
+ * unused content files at worst, never a pad without its text.
+ */
+guint
+xpad_import_save (GPtrArray *notes, const XpadPadInfo *info)
+{
+	XpadPadInfo note_info = *info;
+	guint i, saved = 0;
+
+	fio_begin_batch ();
+	for (i = 0; i < notes->len; i++)
+	{
+		XpadImportNote *note = g_ptr_array_index (notes, i);
+		gboolean ok, exists;
+
+		/* Content files are written first, so they are the ones that show
+		   an ID another program handed out too */
+		note->id = xpad_pad_id_new ();
+		note->contentname = xpad_pad_id_to_name ("content-", note->id);
+		while (!(ok = fio_create_file_compressed (note->contentname, note->content, &exists)) && exists)
+		{
+			note->id = xpad_pad_id_taken (note->id);
+			g_free (note->contentname);
+			note->contentname = xpad_pad_id_to_name ("content-", note->id);
+		}
+		if (!ok)
+		{
+			g_free (note->contentname);
+			note->contentname = NULL;
+		}
+	}
+	fio_end_batch ();
+
+	fio_begin_batch ();
+	for (i = 0; i < notes->len; i++)
+	{
+		XpadImportNote *note = g_ptr_array_index (notes, i);
+
+		if (!note->contentname)
+			continue;
+
+		note->infoname = xpad_pad_id_to_name ("info-", note->id);
+		note_info.id = note->id;
+		note_info.contentname = note->contentname;
+		if (!xpad_pad_info_write (note->infoname, &note_info))
+		{
+			fio_remove_file (note->infoname);
+			fio_remove_file (note->contentname);
+			g_free (note->infoname);
+			note->infoname = NULL;
+			continue;
+		}
+		saved++;
+	}
+	fio_end_batch ();
+
+	return saved;
+}
@@ -0,0 +1,49 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_IMPORT_H__
+#define __XPAD_IMPORT_H__
+
+#include <gio/gio.h>
+#include "xpad-pad-info.h"
+
+G_BEGIN_DECLS
+
+/* One file read by xpad_import_files */
+typedef struct
+{
+	gchar *filename;
+	gchar *content;     /* as read, in content file markup */
+	gchar *text;        /* content without the markup */
+	GVariant *spans;    /* a(sii) tag spans of text */
+	guint64 id;         /* set by xpad_import_save */
+	gchar *contentname; /* set by xpad_import_save */
+	gchar *infoname;    /* set by xpad_import_save, NULL if it failed */
+} XpadImportNote;
+
+/**
+ * Gets the notes that could be read, in the order they were asked for,
+ * and how many could not.  The array owns the notes.
+ */
+typedef void (*XpadImportDoneFunc) (GPtrArray *notes, guint n_failed, gpointer user_data);
+
+void xpad_import_files (gchar **filenames, XpadImportDoneFunc done_func, gpointer user_data);
+guint xpad_import_save  (GPtrArray *notes, const XpadPadInfo *info);
+
+G_END_DECLS
+
+#endif /* __XPAD_IMPORT_H__ */
@@ -0,0 +1,36 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "xpad-json.h"
+
+/* Appends str as a quoted JSON string.  str is taken to be UTF-8, which
+   JSON allows as is outside of quotes, backslashes and control characters. */
+void
+xpad_json_append_string (GString *out, const gchar *str)
+{
+	g_string_append_c (out, '"');
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			g_string_append_printf (out, "\\%c", *str);
+		else if ((guchar) *str < 0x20)
+			g_string_append_printf (out, "\\u%04x", (guchar) *str);
+		else
+			g_string_append_c (out, *str);
+	}
+	g_string_append_c (out, '"');
+}
@@ -0,0 +1,189 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "xpad-metrics.h"
+
+/**
+ * Always-on counters and latency histograms, read with xpad --stats.
+ *
+ * Every value is a single word updated with atomic operations, so any
+ * thread may record without taking a lock and recording costs about as
+ * much as an increment.  A snapshot reads each word on its own; values
+ * may be a moment apart from one another, never torn.
+ *
+ * Histogram bucket i counts samples below 2^i microseconds, the last one
+ * everything slower.
+ */
+
+#define N_BUCKETS 24
+
+typedef struct
+{
+	const gchar *name;
+	const gchar *description;
+} MetricInfo;
+
+typedef struct
+{
+	gssize count;
+	gssize sum;
+	gssize buckets[N_BUCKETS];
+} Histogram;
+
+static const MetricInfo metric_info[XPAD_N_METRICS] =
+{
+	[XPAD_METRIC_SAVES_ISSUED] = {"saves_issued", "Files written"},
+	[XPAD_METRIC_SAVES_ELIDED] = {"saves_elided", "Deferred saves folded into a later one"},
+	[XPAD_METRIC_BYTES_WRITTEN] = {"bytes_written", "Bytes written"},
+	[XPAD_METRIC_BYTES_READ] = {"bytes_read", "Bytes read, as stored on disk"},
+	[XPAD_METRIC_FSYNCS] = {"fsyncs", "Writes synced to disk"},
+	[XPAD_METRIC_UNDO_BYTES] = {"undo_bytes", "Memory held by undo histories"},
+	[XPAD_METRIC_CSS_PROVIDERS] = {"css_providers", "CSS providers installed"},
+	[XPAD_METRIC_PADS_SHOWN] = {"pads_shown", "Pads on screen"},
+	[XPAD_METRIC_PADS_HIDDEN] = {"pads_hidden", "Pads hidden after being shown"},
+	[XPAD_METRIC_PADS_UNREALIZED] = {"pads_unrealized", "Pads never shown"},
+	[XPAD_METRIC_PADS_RESTORED] = {"pads_restored", "Pads loaded from the startup snapshot"},
+	[XPAD_METRIC_EDITS_QUEUED] = {"edits_queued", "Appends and replaces from scripts"},
+	[XPAD_METRIC_EDIT_BATCHES] = {"edit_batches", "Buffer updates those were folded into"},
+};
+
+static const MetricInfo histogram_info[XPAD_N_HISTOGRAMS] =
+{
+	[XPAD_HISTOGRAM_SAVE_LATENCY] = {"save_latency_us", "Time to write and sync a file"},
+	[XPAD_HISTOGRAM_SERIALIZE_TIME] = {"serialize_time_us", "Time to turn a pad or the settings into text"},
+};
+
+static gssize metrics[XPAD_N_METRICS];
+static Histogram histograms[XPAD_N_HISTOGRAMS];
+
+#define METRIC_GET(value) ((gssize) g_atomic_pointer_get (&(value)))
+
+void
+xpad_metrics_add (XpadMetric metric, gssize delta)
+{
+	g_atomic_pointer_add (&metrics[metric], delta);
+}
+
+void
+xpad_metrics_set (XpadMetric metric, gssize value)
+{
+	gssize old;
+	
+	do
+		old = METRIC_GET (metrics[metric]);
+	while (!g_atomic_pointer_compare_and_exchange (&metrics[metric], old, value));
+}
+
+gssize
+xpad_metrics_get (XpadMetric metric)
+{
+	return METRIC_GET (metrics[metric]);
+}
+
+void
+xpad_metrics_record (XpadHistogram histogram, gint64 usec)
+{
+	Histogram *h = &histograms[histogram];
+	guint bucket = 0;
+	
+	if (usec < 0)
+		usec = 0;
+	while (bucket < N_BUCKETS - 1 && usec >= ((gint64) 1 << bucket))
+		bucket++;
+	
+	g_atomic_pointer_add (&h->buckets[bucket], 1);
+	g_atomic_pointer_add (&h->sum, usec);
+	g_atomic_pointer_add (&h->count, 1);
+}
+
+static void
+append_text (GString *out)
+{
+	guint i, b;
+	
+	for (i = 0; i < XPAD_N_METRICS; i++)
+		g_string_append_printf (out, "%-20s %12" G_GSSIZE_FORMAT "  %s\n",
+			metric_info[i].name, METRIC_GET (metrics[i]), metric_info[i].description);
+	
+	for (i = 0; i < XPAD_N_HISTOGRAMS; i++)
+	{
+		Histogram *h = &histograms[i];
+		gssize count = METRIC_GET (h->count);
+		
+		g_string_append_printf (out, "\n%s  %s\n", histogram_info[i].name, histogram_info[i].description);
+		g_string_append_printf (out, "  count %" G_GSSIZE_FORMAT ", mean %" G_GSSIZE_FORMAT "\n",
+			count, count ? METRIC_GET (h->sum) / count : 0);
+		
+		for (b = 0; b < N_BUCKETS; b++)
+		{
+			gssize n = METRIC_GET (h->buckets[b]);
+			
+			if (!n)
+				continue;
+			if (b < N_BUCKETS - 1)
+				g_string_append_printf (out, "  < %-10" G_GINT64_FORMAT " %" G_GSSIZE_FORMAT "\n", (gint64) 1 << b, n);
+			else
+				g_string_append_printf (out, "  >= %-9" G_GINT64_FORMAT " %" G_GSSIZE_FORMAT "\n", (gint64) 1 << (b - 1), n);
+		}
+	}
+}
+
+static void
+append_json (GString *out)
+{
+	guint i, b;
+	
+	g_string_append (out, "{\"metrics\":{");
+	for (i = 0; i < XPAD_N_METRICS; i++)
+		g_string_append_printf (out, "%s\"%s\":%" G_GSSIZE_FORMAT,
+			i ? "," : "", metric_info[i].name, METRIC_GET (metrics[i]));
+	
+	g_string_append (out, "},\"histograms\":{");
+	for (i = 0; i < XPAD_N_HISTOGRAMS; i++)
+	{
+		Histogram *h = &histograms[i];
+		
+		g_string_append_printf (out, "%s\"%s\":{\"count\":%" G_GSSIZE_FORMAT ",\"sum\":%" G_GSSIZE_FORMAT ",\"buckets\":[",
+			i ? "," : "", histogram_info[i].name, METRIC_GET (h->count), METRIC_GET (h->sum));
+		
+		/* Upper bounds; the last bucket has none */
+		for (b = 0; b < N_BUCKETS; b++)
+		{
+			if (b < N_BUCKETS - 1)
+				g_string_append_printf (out, "%s{\"lt\":%" G_GINT64_FORMAT ",\"n\":%" G_GSSIZE_FORMAT "}",
+					b ? "," : "", (gint64) 1 << b, METRIC_GET (h->buckets[b]));
+			else
+				g_string_append_printf (out, ",{\"lt\":null,\"n\":%" G_GSSIZE_FORMAT "}", METRIC_GET (h->buckets[b]));
+		}
+		g_string_append (out, "]}");
+	}
+	g_string_append (out, "}}\n");
+}
+
+/* Returned gchar * must be g_free'd. */
+gchar *
+xpad_metrics_to_string (gboolean json)
+{
+	GString *out = g_string_new (NULL);
+	
+	if (json)
+		append_json (out);
+	else
+		append_text (out);
+	
+	return g_string_free (out, FALSE);
+}
@@ -0,0 +1,61 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_METRICS_H__
+#define __XPAD_METRICS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Counters only grow, gauges are set or moved both ways */
+typedef enum
+{
+	XPAD_METRIC_SAVES_ISSUED,
+	XPAD_METRIC_SAVES_ELIDED,
+	XPAD_METRIC_BYTES_WRITTEN,
+	XPAD_METRIC_BYTES_READ,
+	XPAD_METRIC_FSYNCS,
+	XPAD_METRIC_UNDO_BYTES,
+	XPAD_METRIC_CSS_PROVIDERS,
+	XPAD_METRIC_PADS_SHOWN,
+	XPAD_METRIC_PADS_HIDDEN,
+	XPAD_METRIC_PADS_UNREALIZED,
+	XPAD_METRIC_PADS_RESTORED,
+	XPAD_METRIC_EDITS_QUEUED,
+	XPAD_METRIC_EDIT_BATCHES,
+	XPAD_N_METRICS
+} XpadMetric;
+
+/* Latencies, in microseconds */
+typedef enum
+{
+	XPAD_HISTOGRAM_SAVE_LATENCY,
+	XPAD_HISTOGRAM_SERIALIZE_TIME,
+	XPAD_N_HISTOGRAMS
+} XpadHistogram;
+
+void   xpad_metrics_add       (XpadMetric metric, gssize delta);
+void   xpad_metrics_set       (XpadMetric metric, gssize value);
+void   xpad_metrics_record    (XpadHistogram histogram, gint64 usec);
+gssize xpad_metrics_get       (XpadMetric metric);
+
+gchar *xpad_metrics_to_string (gboolean json);
+
+G_END_DECLS
+
+#endif /* __XPAD_METRICS_H__ */
@@ -17,8 +17,12 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <string.h>
 #include "xpad-pad-group.h"
 #include "xpad-pad.h"
+#include "xpad-settings.h"
+#include "xpad-style.h"
+#include "xpad-toolbar.h"
 
 G_DEFINE_TYPE(XpadPadGroup, xpad_pad_group, G_TYPE_OBJECT)
 
@@ -27,9 +31,18 @@ G_DEFINE_TYPE(XpadPadGroup, xpad_pad_group, G_TYPE_OBJECT)
 struct XpadPadGroupPrivate
 {
 	GSList *pads;
+	GHashTable *ids;   /* guint64 * -> XpadPad *, for pads that have an ID */
+	
+	/* settings changes waiting for the next frame */
+	guint pending_changes;
+	guint flush_tick;
+	GtkWidget *flush_widget;
+	guint flush_idle;
 };
 
 static void     xpad_pad_group_dispose           (GObject *object);
+static void     xpad_pad_group_settings_notify   (XpadPadGroup *group, GParamSpec *pspec);
+static void     xpad_pad_group_change_buttons    (XpadPadGroup *group);
 
 static void     xpad_pad_group_destroy_pads      (XpadPadGroup *group);
 
@@ -89,7 +102,27 @@ xpad_pad_group_dispose (GObject *object)
 {
 	XpadPadGroup *group = XPAD_PAD_GROUP (object);
 
+	g_signal_handlers_disconnect_matched (xpad_settings (), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, group);
+	
+	if (group->priv->flush_tick)
+	{
+		gtk_widget_remove_tick_callback (group->priv->flush_widget, group->priv->flush_tick);
+		group->priv->flush_tick = 0;
+	}
+	if (group->priv->flush_idle)
+	{
+		g_source_remove (group->priv->flush_idle);
+		group->priv->flush_idle = 0;
+	}
+	group->priv->pending_changes = 0;
+	
 	xpad_pad_group_destroy_pads (group);
+	
+	if (group->priv->ids)
+	{
+		g_hash_table_destroy (group->priv->ids);
+		group->priv->ids = NULL;
+	}
 }
 
 static void
@@ -98,6 +131,125 @@ xpad_pad_group_init (XpadPadGroup *group)
 	group->priv = XPAD_PAD_GROUP_GET_PRIVATE (group);
 	
 	group->priv->pads = NULL;
+	group->priv->ids = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+	group->priv->pending_changes = 0;
+	group->priv->flush_tick = 0;
+	group->priv->flush_widget = NULL;
+	group->priv->flush_idle = 0;
+	
+	/* The group listens once for every pad, see xpad_pad_group_flush */
+	g_signal_connect_swapped (xpad_settings (), "notify", G_CALLBACK (xpad_pad_group_settings_notify), group);
+	g_signal_connect_swapped (xpad_settings (), "change-buttons", G_CALLBACK (xpad_pad_group_change_buttons), group);
+}
+
+/**
+ * Applies all settings changes gathered since the last frame.  The shared
+ * style is updated once, then each pad only redoes the parts that changed.
+ */
+static void
+xpad_pad_group_flush (XpadPadGroup *group)
+{
+	guint changes = group->priv->pending_changes;
+	GSList *i;
+	
+	group->priv->pending_changes = 0;
+	
+	if (changes & XPAD_SETTINGS_CHANGE_STYLE)
+		xpad_style_sync_global ();
+	if (changes & XPAD_SETTINGS_CHANGE_BUTTONS)
+		xpad_toolbar_reload_layout ();
+	
+	for (i = group->priv->pads; i; i = i->next)
+		xpad_pad_apply_settings (XPAD_PAD (i->data), changes);
+}
+
+static gboolean
+xpad_pad_group_flush_idle (XpadPadGroup *group)
+{
+	group->priv->flush_idle = 0;
+	xpad_pad_group_flush (group);
+	return FALSE;
+}
+
+static gboolean
+xpad_pad_group_flush_tick (GtkWidget *widget, GdkFrameClock *clock, XpadPadGroup *group)
+{
+	xpad_pad_group_flush (group);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+xpad_pad_group_flush_tick_removed (XpadPadGroup *group)
+{
+	group->priv->flush_tick = 0;
+	group->priv->flush_widget = NULL;
+	
+	/* The widget went away before its next frame */
+	if (group->priv->pending_changes && !group->priv->flush_idle)
+		group->priv->flush_idle = g_idle_add_full (GDK_PRIORITY_REDRAW, (GSourceFunc) xpad_pad_group_flush_idle, group, NULL);
+}
+
+static void
+xpad_pad_group_queue_changes (XpadPadGroup *group, guint changes)
+{
+	GSList *i;
+	
+	group->priv->pending_changes |= changes;
+	
+	if (group->priv->flush_tick || group->priv->flush_idle)
+		return;
+	
+	/* Ride on the frame clock of any mapped pad; with none on screen there
+	   is nothing to paint, so an idle at redraw priority does the same */
+	for (i = group->priv->pads; i; i = i->next)
+	{
+		if (gtk_widget_get_mapped (GTK_WIDGET (i->data)))
+		{
+			group->priv->flush_widget = GTK_WIDGET (i->data);
+			group->priv->flush_tick = gtk_widget_add_tick_callback (group->priv->flush_widget,
+				(GtkTickCallback) xpad_pad_group_flush_tick, group,
+				(GDestroyNotify) xpad_pad_group_flush_tick_removed);
+			return;
+		}
+	}
+	
+	group->priv->flush_idle = g_idle_add_full (GDK_PRIORITY_REDRAW, (GSourceFunc) xpad_pad_group_flush_idle, group, NULL);
+}
+
+static void
+xpad_pad_group_settings_notify (XpadPadGroup *group, GParamSpec *pspec)
+{
+	static const struct
+	{
+		const gchar *name;
+		guint change;
+	} changes[] = {
+		{ "has-decorations", XPAD_SETTINGS_CHANGE_DECORATIONS },
+		{ "has-toolbar", XPAD_SETTINGS_CHANGE_TOOLBAR },
+		{ "autohide-toolbar", XPAD_SETTINGS_CHANGE_AUTOHIDE },
+		{ "has-scrollbar", XPAD_SETTINGS_CHANGE_SCROLLBAR },
+		{ "edit-lock", XPAD_SETTINGS_CHANGE_EDIT_LOCK },
+		{ "fontname", XPAD_SETTINGS_CHANGE_STYLE },
+		{ "text-color", XPAD_SETTINGS_CHANGE_STYLE },
+		{ "back-color", XPAD_SETTINGS_CHANGE_STYLE }
+	};
+	const gchar *name = g_param_spec_get_name (pspec);
+	guint i;
+	
+	for (i = 0; i < G_N_ELEMENTS (changes); i++)
+	{
+		if (strcmp (name, changes[i].name) == 0)
+		{
+			xpad_pad_group_queue_changes (group, changes[i].change);
+			return;
+		}
+	}
+}
+
+static void
+xpad_pad_group_change_buttons (XpadPadGroup *group)
+{
+	xpad_pad_group_queue_changes (group, XPAD_SETTINGS_CHANGE_BUTTONS);
 }
 
 
@@ -116,6 +268,7 @@ xpad_pad_group_add (XpadPadGroup *group, GtkWidget *pad)
 	g_object_ref_sink(GTK_OBJECT(pad));
 	
 	group->priv->pads = g_slist_append (group->priv->pads, XPAD_PAD (pad));
+	xpad_pad_group_update_id (group, pad, 0);
 	g_signal_connect_swapped (pad, "destroy", G_CALLBACK (xpad_pad_group_remove), group);
 	
 	g_signal_emit (group, signals[PAD_ADDED], 0, pad);
@@ -126,7 +279,11 @@ xpad_pad_group_add (XpadPadGroup *group, GtkWidget *pad)
 void
 xpad_pad_group_remove (XpadPadGroup *group, GtkWidget *pad)
 {
+	guint64 id = xpad_pad_get_id (XPAD_PAD (pad));
+	
 	group->priv->pads = g_slist_remove (group->priv->pads, XPAD_PAD (pad));
+	if (id && group->priv->ids && g_hash_table_lookup (group->priv->ids, &id) == pad)
+		g_hash_table_remove (group->priv->ids, &id);
 	
 	g_signal_emit (group, signals[PAD_REMOVED], 0, pad);
 	
@@ -134,6 +291,42 @@ xpad_pad_group_remove (XpadPadGroup *group, GtkWidget *pad)
 }
 
 
+/* Files pad under its current ID instead of old_id, see xpad_pad_group_lookup */
+void
+xpad_pad_group_update_id (XpadPadGroup *group, GtkWidget *pad, guint64 old_id)
+{
+	guint64 id = xpad_pad_get_id (XPAD_PAD (pad));
+	guint64 *key;
+	GtkWidget *other;
+	
+	if (old_id && g_hash_table_lookup (group->priv->ids, &old_id) == pad)
+		g_hash_table_remove (group->priv->ids, &old_id);
+	
+	if (!id)
+		return;
+	
+	/* The pad already filed there keeps the ID */
+	other = g_hash_table_lookup (group->priv->ids, &id);
+	if (other && other != pad)
+	{
+		g_warning ("Two pads have the ID %" G_GUINT64_FORMAT, id);
+		return;
+	}
+	
+	key = g_new (guint64, 1);
+	*key = id;
+	g_hash_table_replace (group->priv->ids, key, pad);
+}
+
+
+/* The pad with this ID, or NULL */
+GtkWidget *
+xpad_pad_group_lookup (XpadPadGroup *group, guint64 id)
+{
+	return g_hash_table_lookup (group->priv->ids, &id);
+}
+
+
 /* Deletes all the current pads in the group */
 static void
 xpad_pad_group_destroy_pads (XpadPadGroup *group)
@@ -169,6 +362,15 @@ xpad_pad_group_close_all (XpadPadGroup *group)
 }
 
 
+/* Writes out every pad's deferred saves, for use right before quitting */
+void
+xpad_pad_group_flush_pending (XpadPadGroup *group)
+{
+	if (group)
+		g_slist_foreach (group->priv->pads, (GFunc) xpad_pad_flush_pending, NULL);
+}
+
+
 void
 xpad_pad_group_show_all (XpadPadGroup *group)
 {
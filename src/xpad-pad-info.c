@@ -0,0 +1,356 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <string.h>
+#include "fio.h"
+#include "xpad-pad-info.h"
+
+/**
+ * Info files are "key value" lines, read and written through
+ * fio_get_values_from_file and fio_set_values_to_file.  Colors are kept
+ * as 16-bit channels, a leftover from GdkColor.
+ */
+
+/* What a pad is given when its info file says nothing */
+#define DEFAULT_WIDTH 200
+#define DEFAULT_HEIGHT 200
+
+/* Pad IDs are handed out from blocks reserved in this file, so making
+   a pad costs a file write only once every ID_BLOCK pads */
+#define ID_FILE "next-id"
+#define ID_BLOCK 256
+
+static gboolean ids_loaded = FALSE;
+static guint64 next_id = 1;
+static guint64 reserved_id = 1;   /* first ID not yet reserved on disk */
+
+/* Fills info with the values of an info file that has none, which are
+   also what the preferences start out with */
+void
+xpad_pad_info_init (XpadPadInfo *info)
+{
+	info->id = 0;
+	info->x = 0;
+	info->y = 0;
+	info->width = DEFAULT_WIDTH;
+	info->height = DEFAULT_HEIGHT;
+	info->follow_font = TRUE;
+	info->follow_color = TRUE;
+	info->sticky = FALSE;
+	info->hidden = FALSE;
+	info->text.red = info->text.green = info->text.blue = 0.0;
+	info->text.alpha = 1.0;
+	info->back = info->text;
+	info->fontname = NULL;
+	info->contentname = NULL;
+	info->followname = NULL;
+	info->follow_lines = 0;
+}
+
+void
+xpad_pad_info_clear (XpadPadInfo *info)
+{
+	g_free (info->fontname);
+	g_free (info->contentname);
+	g_free (info->followname);
+	info->fontname = NULL;
+	info->contentname = NULL;
+	info->followname = NULL;
+}
+
+/* Parses an info file over the values already in info */
+gboolean
+xpad_pad_info_read (const gchar *infoname, XpadPadInfo *info)
+{
+	gboolean locked = FALSE;
+	guint16 text[3] = { 0, 0, 0 }, back[3] = { 0, 0, 0 };
+	gchar *oldcontentprefix;
+	
+	if (fio_get_values_from_file (infoname, 
+		"t|id", &info->id,
+		"i|width", &info->width,
+		"i|height", &info->height,
+		"i|x", &info->x,
+		"i|y", &info->y,
+		"b|locked", &locked,
+		"b|follow_font", &info->follow_font,
+		"b|follow_color", &info->follow_color,
+		"b|sticky", &info->sticky,
+		"b|hidden", &info->hidden,
+		"h|back_red", &back[0],
+		"h|back_green", &back[1],
+		"h|back_blue", &back[2],
+		"h|text_red", &text[0],
+		"h|text_green", &text[1],
+		"h|text_blue", &text[2],
+		"s|fontname", &info->fontname,
+		"s|content", &info->contentname,
+		"s|follow", &info->followname,
+		"i|follow_lines", &info->follow_lines,
+		NULL))
+		return FALSE;
+	
+	/* Pads that follow nothing write an empty name */
+	if (info->followname && !*info->followname)
+	{
+		g_free (info->followname);
+		info->followname = NULL;
+	}
+	
+	/* obsolete setting, no longer written as of xpad-2.0-b2 */
+	if (locked)
+	{
+		info->follow_font = FALSE;
+		info->follow_color = FALSE;
+	}
+	
+	info->text.red = text[0] / 65535.0;
+	info->text.green = text[1] / 65535.0;
+	info->text.blue = text[2] / 65535.0;
+	info->back.red = back[0] / 65535.0;
+	info->back.green = back[1] / 65535.0;
+	info->back.blue = back[2] / 65535.0;
+	
+	/* Special check for contentname being absolute.  A while back,
+		xpad had absolute pathnames, pointing to ~/.xpad/content-*.
+		Now, files are kept in ~/.config/xpad, so using old config
+		files with a new xpad will break pads.  We check to see if
+		contentname is old pointer and then make it relative. */
+	oldcontentprefix = g_build_filename (g_get_home_dir (), ".xpad", "content-", NULL);
+	if (info->contentname && g_str_has_prefix (info->contentname, oldcontentprefix))
+	{
+		gchar *oldcontent = info->contentname;
+		info->contentname = g_path_get_basename (oldcontent);
+		g_free (oldcontent);
+	}
+	g_free (oldcontentprefix);
+	
+	return TRUE;
+}
+
+/* The info file for info.  Must be g_free'd. */
+static gchar *
+info_format (const XpadPadInfo *info)
+{
+	return fio_format_values (
+		"t|id", info->id,
+		"i|width", info->width,
+		"i|height", info->height,
+		"i|x", info->x,
+		"i|y", info->y,
+		"b|follow_font", info->follow_font,
+		"b|follow_color", info->follow_color,
+		"b|sticky", info->sticky,
+		"b|hidden", info->hidden,
+		"h|back_red", (guint16) (info->back.red * 65535),
+		"h|back_green", (guint16) (info->back.green * 65535),
+		"h|back_blue", (guint16) (info->back.blue * 65535),
+		"h|text_red", (guint16) (info->text.red * 65535),
+		"h|text_green", (guint16) (info->text.green * 65535),
+		"h|text_blue", (guint16) (info->text.blue * 65535),
+		"s|fontname", info->fontname ? info->fontname : "",
+		"s|content", info->contentname ? info->contentname : "",
+		"s|follow", info->followname ? info->followname : "",
+		"i|follow_lines", info->follow_lines,
+		NULL);
+}
+
+/* Writes info out whole, replacing the file */
+gboolean
+xpad_pad_info_write (const gchar *infoname, const XpadPadInfo *info)
+{
+	gchar *contents = info_format (info);
+	gboolean ok = fio_set_file (infoname, contents);
+	
+	g_free (contents);
+	
+	return ok;
+}
+
+/* Writes the info file of a pad saved for the first time.  If a file of
+   that name is there already, it belongs to another pad, and nothing is
+   written; see xpad_pad_id_taken. */
+gboolean
+xpad_pad_info_create (const gchar *infoname, const XpadPadInfo *info, gboolean *exists)
+{
+	gchar *contents = info_format (info);
+	gboolean ok = fio_create_file (infoname, contents, exists);
+	
+	g_free (contents);
+	
+	return ok;
+}
+
+/* The highest ID in the name of an info file.  Only names are read, so
+   this stays cheap with thousands of pads. */
+static guint64
+highest_named_id (void)
+{
+	GDir *dir;
+	const gchar *name;
+	guint64 highest = 0;
+	
+	dir = g_dir_open (fio_get_config_dir (), 0, NULL);
+	if (!dir)
+		return 0;
+	
+	while ((name = g_dir_read_name (dir)))
+	{
+		guint64 id;
+		
+		/* Names from before pads had IDs are shorter */
+		if (strncmp (name, "info-", 5) != 0 || strlen (name) != 5 + 16)
+			continue;
+		
+		if (g_ascii_string_to_unsigned (name + 5, 16, 0, G_MAXUINT64, &id, NULL))
+			highest = MAX (highest, id);
+	}
+	
+	g_dir_close (dir);
+	
+	return highest;
+}
+
+/**
+ * The high half of every ID is drawn at random once per config dir, so
+ * pads made by two installs that never saw each other's IDs don't clash
+ * when their files meet.  An ID file from before that gets its half
+ * now; IDs only have to go up.  Files named from IDs handed out by
+ * anyone else raise the counter past theirs.
+ */
+static void
+load_ids (void)
+{
+	gchar *contents, *end = NULL;
+	
+	if (ids_loaded)
+		return;
+	ids_loaded = TRUE;
+	
+	next_id = 0;
+	contents = fio_get_file (ID_FILE);
+	if (contents)
+		next_id = g_ascii_strtoull (contents, &end, 10);
+	if (contents && end == contents)
+		next_id = 0;
+	g_free (contents);
+	
+	if (next_id >> 32 == 0)
+	{
+		guint32 salt = g_random_int ();
+		
+		next_id |= (guint64) (salt ? salt : 1) << 32;
+	}
+	
+	next_id = MAX (next_id, highest_named_id () + 1);
+	reserved_id = next_id;
+}
+
+/**
+ * Returns an ID no pad in the config dir has had before.  IDs only go up
+ * and are never reused, so one that is gone stays gone.  0 means "none".
+ *
+ * Nothing is looked up on disk but once a block of IDs.  Should another
+ * program have handed out the same ID anyway, the first file written
+ * under it is created, not replaced, so the clash shows there; see
+ * xpad_pad_id_taken.
+ */
+guint64
+xpad_pad_id_new (void)
+{
+	load_ids ();
+	
+	if (next_id >= reserved_id)
+	{
+		gchar *value;
+		
+		reserved_id = next_id + ID_BLOCK;
+		value = g_strdup_printf ("%" G_GUINT64_FORMAT "\n", reserved_id);
+		/* Imports reserve IDs in the middle of a batch, but a truncated
+		   ID file would hand out the same ones again */
+		fio_set_file_durable (ID_FILE, value);
+		g_free (value);
+	}
+	
+	return next_id++;
+}
+
+/* Returns a new ID in place of id, whose files turned out to belong to a
+   pad from elsewhere.  IDs are then taken from past every one named in
+   the config dir, so a block handed out twice is only found once. */
+guint64
+xpad_pad_id_taken (guint64 id)
+{
+	xpad_pad_id_seen (id);
+	next_id = MAX (next_id, highest_named_id () + 1);
+	
+	return xpad_pad_id_new ();
+}
+
+/* Notes an ID read from disk, so new ones stay clear of it even if the
+   ID file was lost or copied from elsewhere */
+void
+xpad_pad_id_seen (guint64 id)
+{
+	load_ids ();
+	
+	if (id >= next_id)
+		next_id = id + 1;
+}
+
+/* Notes the ID of every pad in the config dir, which a program that
+   makes pads without having loaded the others must do first */
+void
+xpad_pad_id_scan (void)
+{
+	GDir *dir;
+	const gchar *name;
+	
+	dir = g_dir_open (fio_get_config_dir (), 0, NULL);
+	if (!dir)
+		return;
+	
+	while ((name = g_dir_read_name (dir)))
+	{
+		guint64 id = 0;
+		
+		if (strncmp (name, "info-", 5) != 0)
+			continue;
+		
+		fio_get_values_from_file (name, "t|id", &id, NULL);
+		if (id)
+			xpad_pad_id_seen (id);
+	}
+	
+	g_dir_close (dir);
+}
+
+/* File name for the pad with this ID, e.g. "info-000000000000002a".  It
+   is longer than the names mkstemp made before pads had IDs, so the two
+   can't clash. */
+gchar *
+xpad_pad_id_to_name (const gchar *prefix, guint64 id)
+{
+	return g_strdup_printf ("%s%016" G_GINT64_MODIFIER "x", prefix, id);
+}
+
+/* Reads an ID as the user writes it, in decimal */
+gboolean
+xpad_pad_id_parse (const gchar *str, guint64 *id)
+{
+	return str && g_ascii_string_to_unsigned (str, 10, 1, G_MAXUINT64, id, NULL);
+}
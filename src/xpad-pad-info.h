@@ -0,0 +1,62 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_PAD_INFO_H__
+#define __XPAD_PAD_INFO_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct
+{
+	gdouble red, green, blue, alpha;
+} XpadColor;
+
+/* The values kept in a pad's info file */
+typedef struct
+{
+	guint64 id;
+	gint x, y, width, height;
+	gboolean follow_font;
+	gboolean follow_color;
+	gboolean sticky;
+	gboolean hidden;
+	XpadColor text;
+	XpadColor back;
+	gchar *fontname;
+	gchar *contentname;
+	gchar *followname;
+	gint follow_lines;
+} XpadPadInfo;
+
+void     xpad_pad_info_init  (XpadPadInfo *info);
+gboolean xpad_pad_info_read  (const gchar *infoname, XpadPadInfo *info);
+gboolean xpad_pad_info_write (const gchar *infoname, const XpadPadInfo *info);
+gboolean xpad_pad_info_create (const gchar *infoname, const XpadPadInfo *info, gboolean *exists);
+void     xpad_pad_info_clear (XpadPadInfo *info);
+
+guint64  xpad_pad_id_new     (void);
+guint64  xpad_pad_id_taken   (guint64 id);
+void     xpad_pad_id_seen    (guint64 id);
+void     xpad_pad_id_scan    (void);
+gchar   *xpad_pad_id_to_name (const gchar *prefix, guint64 id);
+gboolean xpad_pad_id_parse   (const gchar *str, guint64 *id);
+
+G_END_DECLS
+
+#endif /* __XPAD_PAD_INFO_H__ */
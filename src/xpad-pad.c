@@ -29,21 +29,44 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "fio.h"
 #include "help.h"
 #include "xpad-app.h"
+#include "xpad-clipboard.h"
+#include "xpad-find-bar.h"
+#include "xpad-follow.h"
+#include "xpad-metrics.h"
 #include "xpad-pad.h"
 #include "xpad-pad-properties.h"
 #include "xpad-preferences.h"
+#include "xpad-search-window.h"
 #include "xpad-settings.h"
 #include "xpad-text-buffer.h"
 #include "xpad-text-view.h"
+#include "xpad-timer.h"
 #include "xpad-toolbar.h"
+#include "xpad-trace.h"
 #include "xpad-tray.h"
 
 G_DEFINE_TYPE(XpadPad, xpad_pad, GTK_TYPE_WINDOW)
 #define XPAD_PAD_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), XPAD_TYPE_PAD, XpadPadPrivate))
 
+/* Milliseconds before an autohidden toolbar goes away after the pointer leaves */
+#define TOOLBAR_HIDE_DELAY 1000
+
+/* Milliseconds of quiet before typing or moving is written to disk */
+#define SAVE_DELAY 500
+
+/* Milliseconds queued edits wait for company, about one frame */
+#define EDIT_DELAY 16
+
+/* Lines a followed file keeps when no limit was asked for */
+#define FOLLOW_LINES 1000
+
+/* Bytes of a followed file read ahead of the buffer, at most */
+#define FOLLOW_BYTES (256 * 1024)
+
 struct XpadPadPrivate 
 {
 	/* saved values */
+	guint64 id;
 	gint x, y, width, height;
 	gboolean location_valid;
 	gchar *infoname;
@@ -53,10 +76,11 @@ struct XpadPadPrivate
 	/* selected child widgets */
 	GtkWidget *textview;
 	GtkWidget *scrollbar;
+	GtkWidget *find_bar;
 	
 	/* toolbar stuff */
 	GtkWidget *toolbar;
-	guint toolbar_timeout;
+	XpadTimer toolbar_timer;
 	gint toolbar_height;
 	gboolean toolbar_expanded;
 	gboolean toolbar_pad_resized;
@@ -64,9 +88,22 @@ struct XpadPadPrivate
 	/* properties window */
 	GtkWidget *properties;
 	
-	/* menus */
-	GtkWidget *menu;
-	GtkWidget *highlight_menu;
+	/* deferred writes */
+	XpadTimer content_timer;
+	XpadTimer info_timer;
+	
+	/* edits queued by scripts, applied together */
+	XpadTimer edit_timer;
+	GString *queued_prepend;
+	GString *queued_append;
+	gboolean queued_replace;
+	guint queued_max_lines;
+	gboolean trim_from_end;
+	
+	/* the file the text comes from, for pads that follow one */
+	XpadFollow *follow;
+	gchar *followname;
+	guint follow_lines;
 	
 	XpadPadGroup *group;
 };
@@ -81,12 +118,13 @@ enum
 {
   PROP_0,
   PROP_GROUP,
+  PROP_STICKY,
   LAST_PROP
 };
 
 static void load_info (XpadPad *pad, gboolean *show);
-static GtkWidget *menu_get_popup_highlight (XpadPad *pad, GtkAccelGroup *accel_group);
-static GtkWidget *menu_get_popup_no_highlight (XpadPad *pad, GtkAccelGroup *accel_group);
+static void menu_install_actions (GtkWidgetClass *widget_class);
+static GActionGroup *menu_get_settings_actions (void);
 static void xpad_pad_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void xpad_pad_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 static void xpad_pad_dispose (GObject *object);
@@ -96,18 +134,19 @@ static void xpad_pad_size_allocate (GtkWidget *widget, int width, int height, in
 static void xpad_pad_toolbar_size_allocate (XpadPad *pad, GtkAllocation *event);
 static void xpad_pad_window_state_changed (XpadPad *pad);
 static gboolean xpad_pad_close_request (GtkWindow *window, XpadPad *pad);
-static gboolean xpad_pad_popup_menu (XpadPad *pad);
-static void xpad_pad_popup_deactivate (GtkWidget *menu, XpadPad *pad);
+static void xpad_pad_popup_menu (XpadPad *pad);
 static void xpad_pad_button_pressed (GtkGestureClick *gesture, int n_press, double x, double y, XpadPad *pad);
 static void xpad_pad_text_view_button_pressed (GtkGestureClick *gesture, int n_press, double x, double y, XpadPad *pad);
 static void xpad_pad_text_changed (XpadPad *pad, GtkTextBuffer *buffer);
+static void xpad_pad_apply_edits (XpadPad *pad);
 static void xpad_pad_notify_has_scrollbar (XpadPad *pad);
 static void xpad_pad_notify_has_decorations (XpadPad *pad);
 static void xpad_pad_notify_has_toolbar (XpadPad *pad);
 static void xpad_pad_notify_autohide_toolbar (XpadPad *pad);
 static void xpad_pad_hide_toolbar (XpadPad *pad);
+static void toolbar_timeout (XpadPad *pad);
 static void xpad_pad_show_toolbar (XpadPad *pad);
-static void xpad_pad_popup (XpadPad *pad, GdkEvent *event);
+static void xpad_pad_popup (XpadPad *pad, GtkWidget *widget, double x, double y);
 static void xpad_pad_spawn (XpadPad *pad);
 static void xpad_pad_clear (XpadPad *pad);
 static void xpad_pad_undo (XpadPad *pad);
@@ -116,6 +155,7 @@ static void xpad_pad_cut (XpadPad *pad);
 static void xpad_pad_copy (XpadPad *pad);
 static void xpad_pad_paste (XpadPad *pad);
 static void xpad_pad_delete (XpadPad *pad);
+static void xpad_pad_find (XpadPad *pad);
 static void xpad_pad_dialog_emit_response (GtkWidget *widget, gpointer user_data);
 static void xpad_pad_open_properties (XpadPad *pad);
 static void xpad_pad_open_preferences (XpadPad *pad);
@@ -123,18 +163,29 @@ static void xpad_pad_quit (XpadPad *pad);
 static void xpad_pad_close_all (XpadPad *pad);
 static void xpad_pad_sync_title (XpadPad *pad);
 static void xpad_pad_set_group (XpadPad *pad, XpadPadGroup *group);
+static void xpad_pad_set_sticky (XpadPad *pad, gboolean sticky);
 static gboolean xpad_pad_leave_notify_event (GtkWidget *pad, GdkEventCrossing *event);
 static gboolean xpad_pad_enter_notify_event (GtkWidget *pad, GdkEventCrossing *event);
 static void xpad_pad_toolbar_popup (GtkWidget *toolbar, GtkMenu *menu, XpadPad *pad);
 static void xpad_pad_toolbar_popdown (GtkWidget *toolbar, GtkMenu *menu, XpadPad *pad);
+static void xpad_pad_toolbar_map (XpadPad *pad);
+static void xpad_pad_toolbar_unmap (XpadPad *pad);
 static XpadPadGroup *xpad_pad_get_group (XpadPad *pad);
+static void xpad_pad_set_id (XpadPad *pad, guint64 id);
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* The one popover that shows the shared menu models, parented to whichever pad opened it last */
+static GtkWidget *menu_popover = NULL;
+
 GtkWidget *
 xpad_pad_new (XpadPadGroup *group)
 {
-	return GTK_WIDGET (g_object_new (XPAD_TYPE_PAD, "group", group, NULL));
+	GtkWidget *pad = GTK_WIDGET (g_object_new (XPAD_TYPE_PAD, "group", group, NULL));
+	
+	xpad_pad_set_id (XPAD_PAD (pad), xpad_pad_id_new ());
+	
+	return pad;
 }
 
 GtkWidget *
@@ -144,8 +195,35 @@ xpad_pad_new_with_info (XpadPadGroup *group, const gchar *info_filename, gboolea
 	
 	XPAD_PAD (pad)->priv->infoname = g_strdup (info_filename);
 	load_info (XPAD_PAD (pad), show);
+	if (!XPAD_PAD (pad)->priv->id)
+		xpad_pad_set_id (XPAD_PAD (pad), xpad_pad_id_new ());
 	xpad_pad_load_content (XPAD_PAD (pad));
-	gtk_window_set_role (GTK_WINDOW (pad), XPAD_PAD (pad)->priv->infoname);
+	
+	return pad;
+}
+
+/* Builds a pad from values that were parsed on an earlier run, see xpad-snapshot */
+GtkWidget *
+xpad_pad_new_with_cached_info (XpadPadGroup *group, const gchar *info_filename, const XpadPadInfo *info,
+                               const gchar *text, GVariant *spans, gboolean *show)
+{
+	GtkWidget *pad = GTK_WIDGET (g_object_new (XPAD_TYPE_PAD, "group", group, NULL));
+	GtkTextBuffer *buffer;
+	
+	XPAD_PAD (pad)->priv->infoname = g_strdup (info_filename);
+	info_apply (XPAD_PAD (pad), info, show);
+	
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (XPAD_PAD (pad)->priv->textview));
+	
+	xpad_text_buffer_freeze_undo (XPAD_TEXT_BUFFER (buffer));
+	g_signal_handlers_block_by_func (buffer, xpad_pad_text_changed, pad);
+	
+	xpad_text_buffer_set_text_with_spans (XPAD_TEXT_BUFFER (buffer), text, spans);
+	
+	g_signal_handlers_unblock_by_func (buffer, xpad_pad_text_changed, pad);
+	xpad_text_buffer_thaw_undo (XPAD_TEXT_BUFFER (buffer));
+	
+	xpad_pad_sync_title (XPAD_PAD (pad));
 	
 	return pad;
 }
@@ -169,12 +247,13 @@ xpad_pad_new_from_file (XpadPadGroup *group, const gchar *filename)
 		GtkTextBuffer *buffer;
 		
 		pad = GTK_WIDGET (g_object_new (XPAD_TYPE_PAD, "group", group, NULL));
+		xpad_pad_set_id (XPAD_PAD (pad), xpad_pad_id_new ());
 		buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (XPAD_PAD (pad)->priv->textview));
 
 		xpad_text_buffer_freeze_undo (XPAD_TEXT_BUFFER (buffer));
 		g_signal_handlers_block_by_func (buffer, xpad_pad_text_changed, pad);
 		
-		xpad_text_buffer_set_text_with_tags (XPAD_TEXT_BUFFER (buffer), content ? content : "");
+		xpad_text_buffer_set_text_with_tags (XPAD_TEXT_BUFFER (buffer), content ? content : "", -1);
 		g_free (content);
 		
 		g_signal_handlers_unblock_by_func (buffer, xpad_pad_text_changed, pad);
@@ -186,15 +265,59 @@ xpad_pad_new_from_file (XpadPadGroup *group, const gchar *filename)
 	return pad;
 }
 
+static void
+xpad_pad_follow_text (const gchar *text, gboolean replace, XpadPad *pad)
+{
+	xpad_pad_queue_edit (pad, replace ? XPAD_PAD_EDIT_REPLACE : XPAD_PAD_EDIT_APPEND, text, pad->priv->follow_lines);
+}
+
+/* A followed pad shows the file and nothing else, so it takes no typing */
+static void
+xpad_pad_set_follow (XpadPad *pad, const gchar *filename, guint max_lines)
+{
+	xpad_follow_free (pad->priv->follow);
+	g_free (pad->priv->followname);
+	
+	pad->priv->followname = g_strdup (filename);
+	pad->priv->follow_lines = max_lines ? max_lines : FOLLOW_LINES;
+	pad->priv->follow = filename ?
+		xpad_follow_new (filename, FOLLOW_BYTES, (XpadFollowFunc) xpad_pad_follow_text, pad) : NULL;
+	
+	gtk_text_view_set_editable (GTK_TEXT_VIEW (pad->priv->textview), filename == NULL);
+	xpad_pad_sync_title (pad);
+}
+
+/**
+ * Like xpad_pad_new_from_file, but keeps reading the file as it grows,
+ * the way tail -f does.  Only the last max_lines lines are kept, or
+ * FOLLOW_LINES if max_lines is 0.  The text is not saved with the pad;
+ * after a restart the pad reads the file again.
+ */
+GtkWidget *
+xpad_pad_new_following (XpadPadGroup *group, const gchar *filename, guint max_lines)
+{
+	GtkWidget *pad = GTK_WIDGET (g_object_new (XPAD_TYPE_PAD, "group", group, NULL));
+	
+	xpad_pad_set_id (XPAD_PAD (pad), xpad_pad_id_new ());
+	xpad_pad_set_follow (XPAD_PAD (pad), filename, max_lines);
+	
+	/* The info file is what brings it back, written once it is shown */
+	xpad_timer_schedule (&XPAD_PAD (pad)->priv->info_timer, SAVE_DELAY);
+	
+	return pad;
+}
+
 static void
 xpad_pad_class_init (XpadPadClass *klass)
 {
 	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
 	
 	gobject_class->dispose = xpad_pad_dispose;
 	gobject_class->finalize = xpad_pad_finalize;
 	gobject_class->set_property = xpad_pad_set_property;
 	gobject_class->get_property = xpad_pad_get_property;
+	widget_class->size_allocate = xpad_pad_size_allocate;
 	
 	signals[CLOSED] =
 		g_signal_new ("closed",
@@ -215,6 +338,17 @@ xpad_pad_class_init (XpadPadClass *klass)
 																			 "Pad group for this pad",
 																			 G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
 	
+	g_object_class_install_property (gobject_class,
+												PROP_STICKY,
+												g_param_spec_boolean ("sticky",
+																			 "Sticky",
+																			 "Whether the pad is shown on all workspaces",
+																			 FALSE,
+																			 G_PARAM_READWRITE));
+	
+	/* Actions are shared by every pad, the menus only refer to them by name */
+	menu_install_actions (widget_class);
+	
 	g_type_class_add_private (gobject_class, sizeof (XpadPadPrivate));
 }
 
@@ -222,11 +356,11 @@ static void
 xpad_pad_init (XpadPad *pad)
 {
 	GtkWidget *vbox;
-	GtkAccelGroup *accel_group;
-	GtkClipboard *clipboard;
+	gint64 span = xpad_trace_begin ();
 	
 	pad->priv = XPAD_PAD_GET_PRIVATE (pad);
 	
+	pad->priv->id = 0;
 	pad->priv->x = 0;
 	pad->priv->y = 0;
 	pad->priv->location_valid = FALSE;
@@ -237,12 +371,24 @@ xpad_pad_init (XpadPad *pad)
 	pad->priv->sticky = xpad_settings_get_sticky (xpad_settings ());
 	pad->priv->textview = NULL;
 	pad->priv->scrollbar = NULL;
+	pad->priv->find_bar = NULL;
 	pad->priv->toolbar = NULL;
-	pad->priv->toolbar_timeout = 0;
+	xpad_timer_init (&pad->priv->toolbar_timer, (XpadTimerFunc) toolbar_timeout, pad);
 	pad->priv->toolbar_height = 0;
 	pad->priv->toolbar_expanded = FALSE;
 	pad->priv->toolbar_pad_resized = TRUE;
 	pad->priv->properties = NULL;
+	xpad_timer_init (&pad->priv->content_timer, (XpadTimerFunc) xpad_pad_save_content, pad);
+	xpad_timer_init (&pad->priv->info_timer, (XpadTimerFunc) xpad_pad_save_info, pad);
+	xpad_timer_init (&pad->priv->edit_timer, (XpadTimerFunc) xpad_pad_apply_edits, pad);
+	pad->priv->queued_prepend = NULL;
+	pad->priv->queued_append = NULL;
+	pad->priv->queued_replace = FALSE;
+	pad->priv->queued_max_lines = 0;
+	pad->priv->trim_from_end = FALSE;
+	pad->priv->follow = NULL;
+	pad->priv->followname = NULL;
+	pad->priv->follow_lines = 0;
 	pad->priv->group = NULL;
 
 	XpadTextView *text_view = g_object_new (XPAD_TYPE_TEXT_VIEW,
@@ -263,32 +409,19 @@ xpad_pad_init (XpadPad *pad)
 		"child", pad->priv->textview,
 		NULL));
 	
-	pad->priv->toolbar = GTK_WIDGET ( xpad_toolbar_new (pad));
-	
-	accel_group = gtk_accel_group_new ();
-	gtk_window_add_accel_group (GTK_WINDOW (pad), accel_group);
-	g_object_unref (G_OBJECT (accel_group));
-	pad->priv->menu = menu_get_popup_no_highlight (pad, accel_group);
-	pad->priv->highlight_menu = menu_get_popup_highlight (pad, accel_group);
-	gtk_accel_group_connect (accel_group, GDK_KEY_Q, GDK_CONTROL_MASK, 0,
-								 g_cclosure_new_swap (G_CALLBACK (xpad_pad_quit), pad, NULL));
-
+	gtk_widget_insert_action_group (GTK_WIDGET (pad), "settings", menu_get_settings_actions ());
 	
 	vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
 	gtk_widget_set_hexpand (vbox, TRUE);
 	gtk_widget_set_vexpand (vbox, TRUE);
 	gtk_box_append (GTK_BOX (vbox), pad->priv->scrollbar);
-	gtk_box_append (GTK_BOX (vbox), pad->priv->toolbar);
 	gtk_widget_set_vexpand (pad->priv->scrollbar, TRUE);
 
 	gtk_window_set_child (GTK_WINDOW (pad), vbox);
 	
 	xpad_pad_notify_has_scrollbar (pad);
 	xpad_pad_notify_has_selection (pad);
-	xpad_pad_notify_clipboard_owner_changed (pad);
 	xpad_pad_notify_undo_redo_changed (pad);
-
-	clipboard = gdk_display_get_clipboard (gdk_display_get_default ());
 	
 	/* Set up event controllers for GTK4 */
 	GtkGesture *click_gesture = gtk_gesture_click_new ();
@@ -306,38 +439,12 @@ xpad_pad_init (XpadPad *pad)
 	g_signal_connect_swapped (motion_controller, "leave", G_CALLBACK (xpad_pad_leave_notify_event), pad);
 	gtk_widget_add_controller (GTK_WIDGET (pad), motion_controller);
 	
-	g_signal_connect_swapped (pad->priv->textview, "popup-menu", G_CALLBACK (xpad_pad_popup_menu), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "size-allocate", G_CALLBACK (xpad_pad_toolbar_size_allocate), pad);
 	g_signal_connect (pad, "close-request", G_CALLBACK (xpad_pad_close_request), pad);
-	g_signal_connect (pad, "popup-menu", G_CALLBACK (xpad_pad_popup_menu), NULL);
 	g_signal_connect (pad, "show", G_CALLBACK (xpad_pad_show), NULL);
 	g_signal_connect_swapped (gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview)), "changed", G_CALLBACK (xpad_pad_text_changed), pad);
 	
-	g_signal_connect_swapped (xpad_settings (), "notify::has-decorations", G_CALLBACK (xpad_pad_notify_has_decorations), pad);
-	g_signal_connect_swapped (xpad_settings (), "notify::has-toolbar", G_CALLBACK (xpad_pad_notify_has_toolbar), pad);
-	g_signal_connect_swapped (xpad_settings (), "notify::autohide-toolbar", G_CALLBACK (xpad_pad_notify_autohide_toolbar), pad);
-	g_signal_connect_swapped (xpad_settings (), "notify::has-scrollbar", G_CALLBACK (xpad_pad_notify_has_scrollbar), pad);
 	g_signal_connect_swapped (gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview)), "notify::has-selection", G_CALLBACK (xpad_pad_notify_has_selection), pad);
-	g_signal_connect_swapped (clipboard, "changed", G_CALLBACK (xpad_pad_notify_clipboard_owner_changed), pad);
-	
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-new", G_CALLBACK (xpad_pad_spawn), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-clear", G_CALLBACK (xpad_pad_clear), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-close", G_CALLBACK (xpad_pad_close), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-undo", G_CALLBACK (xpad_pad_undo), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-redo", G_CALLBACK (xpad_pad_redo), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-cut", G_CALLBACK (xpad_pad_cut), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-copy", G_CALLBACK (xpad_pad_copy), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-paste", G_CALLBACK (xpad_pad_paste), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-delete", G_CALLBACK (xpad_pad_delete), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-properties", G_CALLBACK (xpad_pad_open_properties), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-preferences", G_CALLBACK (xpad_pad_open_preferences), pad);
-	g_signal_connect_swapped (pad->priv->toolbar, "activate-quit", G_CALLBACK (xpad_pad_close_all), pad);
 	
-	g_signal_connect (pad->priv->toolbar, "popup", G_CALLBACK (xpad_pad_toolbar_popup), pad);
-	g_signal_connect (pad->priv->toolbar, "popdown", G_CALLBACK (xpad_pad_toolbar_popdown), pad);
-	
-	g_signal_connect (pad->priv->menu, "deactivate", G_CALLBACK (xpad_pad_popup_deactivate), pad);
-	g_signal_connect (pad->priv->highlight_menu, "deactivate", G_CALLBACK (xpad_pad_popup_deactivate), pad);
 	
 	if (pad->priv->sticky)
 		gtk_window_stick (GTK_WINDOW (pad));
@@ -348,8 +455,9 @@ xpad_pad_init (XpadPad *pad)
 	
 	gtk_widget_set_visible (vbox, TRUE);
 	
-	gtk_widget_set_visible (pad->priv->toolbar, FALSE);
 	xpad_pad_notify_has_toolbar (pad);
+	
+	xpad_trace_end (span, "xpad_pad_init", NULL);
 }
 
 static void
@@ -378,17 +486,20 @@ xpad_pad_dispose (GObject *object)
 {
 	XpadPad *pad = XPAD_PAD (object);
 	
-	if (pad->priv->toolbar_timeout)
-	{
-		g_source_remove (pad->priv->toolbar_timeout);
-		pad->priv->toolbar_timeout = 0;
-	}
+	xpad_timer_cancel (&pad->priv->toolbar_timer);
+	xpad_follow_free (pad->priv->follow);
+	pad->priv->follow = NULL;
+	xpad_pad_flush_pending (pad);
+	xpad_clipboard_unwatch ((XpadClipboardFunc) xpad_pad_notify_clipboard_owner_changed, pad);
 	
 	if (pad->priv->properties)
 		gtk_widget_destroy (pad->priv->properties);
 	
-	gtk_widget_destroy (pad->priv->menu);
-	gtk_widget_destroy (pad->priv->highlight_menu);
+	if (menu_popover && gtk_widget_get_parent (menu_popover) == GTK_WIDGET (pad))
+	{
+		gtk_popover_popdown (GTK_POPOVER (menu_popover));
+		gtk_widget_unparent (menu_popover);
+	}
 	
 	G_OBJECT_CLASS (xpad_pad_parent_class)->dispose (object);
 }
@@ -400,12 +511,27 @@ xpad_pad_finalize (GObject *object)
 	
 	g_free (pad->priv->infoname);
 	g_free (pad->priv->contentname);
+	g_free (pad->priv->followname);
+	if (pad->priv->queued_append)
+	{
+		g_string_free (pad->priv->queued_prepend, TRUE);
+		g_string_free (pad->priv->queued_append, TRUE);
+	}
 	
 	g_signal_handlers_disconnect_matched (xpad_settings (), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, pad);
 	
 	G_OBJECT_CLASS (xpad_pad_parent_class)->finalize (object);
 }
 
+static void
+xpad_pad_size_allocate (GtkWidget *widget, int width, int height, int baseline)
+{
+	GTK_WIDGET_CLASS (xpad_pad_parent_class)->size_allocate (widget, width, height, baseline);
+	
+	if (menu_popover && gtk_widget_get_parent (menu_popover) == widget)
+		gtk_popover_present (GTK_POPOVER (menu_popover));
+}
+
 static void
 xpad_pad_notify_has_scrollbar (XpadPad *pad)
 {
@@ -468,9 +594,47 @@ xpad_pad_text_and_toolbar_height (XpadPad *pad)
 	return y + pad->priv->toolbar_height + gtk_container_get_border_width(GTK_CONTAINER(pad->priv->textview));
 }
 
+/**
+ * Most pads autohide their toolbar and never show it, so it is only built
+ * the first time it is revealed.
+ */
+static void
+xpad_pad_ensure_toolbar (XpadPad *pad)
+{
+	if (pad->priv->toolbar)
+		return;
+	
+	pad->priv->toolbar = GTK_WIDGET (xpad_toolbar_new (pad));
+	gtk_widget_set_visible (pad->priv->toolbar, FALSE);
+	gtk_box_append (GTK_BOX (gtk_widget_get_parent (pad->priv->scrollbar)), pad->priv->toolbar);
+	
+	g_signal_connect_swapped (pad->priv->toolbar, "size-allocate", G_CALLBACK (xpad_pad_toolbar_size_allocate), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-new", G_CALLBACK (xpad_pad_spawn), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-clear", G_CALLBACK (xpad_pad_clear), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-close", G_CALLBACK (xpad_pad_close), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-undo", G_CALLBACK (xpad_pad_undo), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-redo", G_CALLBACK (xpad_pad_redo), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-cut", G_CALLBACK (xpad_pad_cut), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-copy", G_CALLBACK (xpad_pad_copy), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-paste", G_CALLBACK (xpad_pad_paste), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-delete", G_CALLBACK (xpad_pad_delete), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-properties", G_CALLBACK (xpad_pad_open_properties), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-preferences", G_CALLBACK (xpad_pad_open_preferences), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "activate-quit", G_CALLBACK (xpad_pad_close_all), pad);
+	g_signal_connect (pad->priv->toolbar, "popup", G_CALLBACK (xpad_pad_toolbar_popup), pad);
+	g_signal_connect (pad->priv->toolbar, "popdown", G_CALLBACK (xpad_pad_toolbar_popdown), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "map", G_CALLBACK (xpad_pad_toolbar_map), pad);
+	g_signal_connect_swapped (pad->priv->toolbar, "unmap", G_CALLBACK (xpad_pad_toolbar_unmap), pad);
+	
+	xpad_pad_notify_has_selection (pad);
+	xpad_pad_notify_undo_redo_changed (pad);
+}
+
 static void
 xpad_pad_show_toolbar (XpadPad *pad)
 {
+	xpad_pad_ensure_toolbar (pad);
+	
 	if (!gtk_widget_get_visible (pad->priv->toolbar))
 	{
 		GtkRequisition req;
@@ -499,7 +663,7 @@ xpad_pad_show_toolbar (XpadPad *pad)
 static void
 xpad_pad_hide_toolbar (XpadPad *pad)
 {
-	if (gtk_widget_get_visible (pad->priv->toolbar))
+	if (pad->priv->toolbar && gtk_widget_get_visible (pad->priv->toolbar))
 	{
 		gtk_widget_set_visible (pad->priv->toolbar, FALSE);
 		
@@ -522,17 +686,12 @@ xpad_pad_notify_has_toolbar (XpadPad *pad)
 		xpad_pad_hide_toolbar (pad);
 }
 
-static gboolean
+static void
 toolbar_timeout (XpadPad *pad)
 {
-	if (pad->priv->toolbar_timeout &&
-		 xpad_settings_get_autohide_toolbar (xpad_settings ()) &&
+	if (xpad_settings_get_autohide_toolbar (xpad_settings ()) &&
 		 xpad_settings_get_has_toolbar (xpad_settings ()))
 		xpad_pad_hide_toolbar (pad);
-	
-	pad->priv->toolbar_timeout = 0;
-	
-	return FALSE;
 }
 
 static void
@@ -541,8 +700,8 @@ xpad_pad_notify_autohide_toolbar (XpadPad *pad)
 	if (xpad_settings_get_autohide_toolbar (xpad_settings ()))
 	{
 		/* Likely not to be in pad when turning setting on */
-		if (!pad->priv->toolbar_timeout)
-			pad->priv->toolbar_timeout = g_timeout_add (1000, (GSourceFunc) toolbar_timeout, pad);
+		if (!xpad_timer_is_pending (&pad->priv->toolbar_timer))
+			xpad_timer_schedule (&pad->priv->toolbar_timer, TOOLBAR_HIDE_DELAY);
 	}
 	else
 	{
@@ -551,6 +710,26 @@ xpad_pad_notify_autohide_toolbar (XpadPad *pad)
 	}
 }
 
+/* Called by the pad group once per frame with the settings that changed */
+void
+xpad_pad_apply_settings (XpadPad *pad, guint changes)
+{
+	if (changes & XPAD_SETTINGS_CHANGE_DECORATIONS)
+		xpad_pad_notify_has_decorations (pad);
+	if (changes & XPAD_SETTINGS_CHANGE_TOOLBAR)
+		xpad_pad_notify_has_toolbar (pad);
+	if (changes & XPAD_SETTINGS_CHANGE_AUTOHIDE)
+		xpad_pad_notify_autohide_toolbar (pad);
+	if (changes & XPAD_SETTINGS_CHANGE_SCROLLBAR)
+		xpad_pad_notify_has_scrollbar (pad);
+	if (changes & XPAD_SETTINGS_CHANGE_EDIT_LOCK)
+		xpad_text_view_notify_edit_lock (XPAD_TEXT_VIEW (pad->priv->textview));
+	/* Unrealized toolbars catch up when they are next mapped */
+	if ((changes & XPAD_SETTINGS_CHANGE_BUTTONS) &&
+	    pad->priv->toolbar && gtk_widget_get_realized (pad->priv->toolbar))
+		xpad_toolbar_change_buttons (XPAD_TOOLBAR (pad->priv->toolbar));
+}
+
 void
 xpad_pad_notify_has_selection (XpadPad *pad)
 {
@@ -559,12 +738,13 @@ xpad_pad_notify_has_selection (XpadPad *pad)
 	GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
 	gboolean has_selection = gtk_text_buffer_get_has_selection (buffer);
 
-	XpadToolbar *toolbar = NULL;
-	toolbar = XPAD_TOOLBAR (pad->priv->toolbar);
-	g_return_if_fail (toolbar);
-
-	xpad_toolbar_enable_cut_button (toolbar, has_selection);
-	xpad_toolbar_enable_copy_button (toolbar, has_selection);
+	if (pad->priv->toolbar)
+	{
+		xpad_toolbar_enable_cut_button (XPAD_TOOLBAR (pad->priv->toolbar), has_selection);
+		xpad_toolbar_enable_copy_button (XPAD_TOOLBAR (pad->priv->toolbar), has_selection);
+	}
+	gtk_widget_action_set_enabled (GTK_WIDGET (pad), "pad.cut", has_selection);
+	gtk_widget_action_set_enabled (GTK_WIDGET (pad), "pad.copy", has_selection);
 }
 
 void
@@ -572,14 +752,25 @@ xpad_pad_notify_clipboard_owner_changed (XpadPad *pad)
 {
 	g_return_if_fail (pad);
 
-	XpadToolbar *toolbar = NULL;
-	toolbar = XPAD_TOOLBAR (pad->priv->toolbar);
-	g_return_if_fail (toolbar);
+	gboolean has_text = xpad_clipboard_has_text ();
+
+	if (pad->priv->toolbar)
+		xpad_toolbar_enable_paste_button (XPAD_TOOLBAR (pad->priv->toolbar), has_text);
+	gtk_widget_action_set_enabled (GTK_WIDGET (pad), "pad.paste", has_text);
+}
+
+/* Only a pad whose toolbar is on screen follows the clipboard */
+static void
+xpad_pad_toolbar_map (XpadPad *pad)
+{
+	xpad_clipboard_watch ((XpadClipboardFunc) xpad_pad_notify_clipboard_owner_changed, pad);
+	xpad_pad_notify_clipboard_owner_changed (pad);
+}
 
-	GdkClipboard *clipboard = gdk_display_get_clipboard (gdk_display_get_default ());
-	gdk_clipboard_read_text_async (clipboard, NULL, NULL, NULL);
-	/* For simplicity, always enable paste button in GTK4 */
-	xpad_toolbar_enable_paste_button (toolbar, TRUE);
+static void
+xpad_pad_toolbar_unmap (XpadPad *pad)
+{
+	xpad_clipboard_unwatch ((XpadClipboardFunc) xpad_pad_notify_clipboard_owner_changed, pad);
 }
 
 void
@@ -591,12 +782,13 @@ xpad_pad_notify_undo_redo_changed (XpadPad *pad)
 	buffer = XPAD_TEXT_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview)));
 	g_return_if_fail (buffer);
 
-	XpadToolbar *toolbar = NULL;
-	toolbar = XPAD_TOOLBAR (pad->priv->toolbar);
-	g_return_if_fail (toolbar);
-
-	xpad_toolbar_enable_undo_button (toolbar, xpad_text_buffer_undo_available (buffer));
-	xpad_toolbar_enable_redo_button (toolbar, xpad_text_buffer_redo_available (buffer));
+	if (pad->priv->toolbar)
+	{
+		xpad_toolbar_enable_undo_button (XPAD_TOOLBAR (pad->priv->toolbar), xpad_text_buffer_undo_available (buffer));
+		xpad_toolbar_enable_redo_button (XPAD_TOOLBAR (pad->priv->toolbar), xpad_text_buffer_redo_available (buffer));
+	}
+	gtk_widget_action_set_enabled (GTK_WIDGET (pad), "pad.undo", xpad_text_buffer_undo_available (buffer));
+	gtk_widget_action_set_enabled (GTK_WIDGET (pad), "pad.redo", xpad_text_buffer_redo_available (buffer));
 }
 
 static void
@@ -605,7 +797,7 @@ xpad_pad_enter_notify_event (XpadPad *pad)
 	if (xpad_settings_get_has_toolbar (xpad_settings ()) &&
 		 xpad_settings_get_autohide_toolbar (xpad_settings ()))
 	{
-		pad->priv->toolbar_timeout = 0;
+		xpad_timer_cancel (&pad->priv->toolbar_timer);
 		xpad_pad_show_toolbar (pad);
 	}
 }
@@ -616,8 +808,8 @@ xpad_pad_leave_notify_event (XpadPad *pad)
 	if (xpad_settings_get_has_toolbar (xpad_settings ()) &&
 		 xpad_settings_get_autohide_toolbar (xpad_settings ()))
 	{
-		if (!XPAD_PAD (pad)->priv->toolbar_timeout)
-			XPAD_PAD (pad)->priv->toolbar_timeout = g_timeout_add (1000, (GSourceFunc) toolbar_timeout, pad);
+		if (!xpad_timer_is_pending (&XPAD_PAD (pad)->priv->toolbar_timer))
+			xpad_timer_schedule (&XPAD_PAD (pad)->priv->toolbar_timer, TOOLBAR_HIDE_DELAY);
 	}
 	
 	return FALSE;
@@ -655,6 +847,7 @@ xpad_pad_close (XpadPad *pad)
 	if (pad->priv->properties)
 		gtk_widget_destroy (pad->priv->properties);
 	
+	xpad_pad_flush_pending (pad);
 	xpad_pad_save_info (pad);
 	
 	g_signal_emit (pad, signals[CLOSED], 0);
@@ -741,6 +934,12 @@ xpad_pad_delete (XpadPad *pad)
 			return;
 	}
 	
+	/* Dispose flushes whatever is still pending, which would write the
+	   files straight back */
+	xpad_timer_cancel (&pad->priv->edit_timer);
+	xpad_timer_cancel (&pad->priv->content_timer);
+	xpad_timer_cancel (&pad->priv->info_timer);
+	
 	if (pad->priv->infoname)
 		fio_remove_file (pad->priv->infoname);
 	if (pad->priv->contentname)
@@ -776,19 +975,11 @@ static void
 prop_notify_follow_font (XpadPad *pad)
 {
 	XpadPadProperties *prop = XPAD_PAD_PROPERTIES (pad->priv->properties);
-	
-	xpad_text_view_set_follow_font_style (XPAD_TEXT_VIEW (pad->priv->textview), xpad_pad_properties_get_follow_font_style (prop));
+	XpadTextView *view = XPAD_TEXT_VIEW (pad->priv->textview);
 	
 	if (!xpad_pad_properties_get_follow_font_style (prop))
-	{
-		const gchar *font = xpad_pad_properties_get_fontname (prop);
-		PangoFontDescription *fontdesc;
-		
-		fontdesc = font ? pango_font_description_from_string (font) : NULL;
-		gtk_widget_modify_font (pad->priv->textview, fontdesc);
-		if (fontdesc)
-			pango_font_description_free (fontdesc);
-	}
+		xpad_text_view_set_fontname (view, xpad_pad_properties_get_fontname (prop));
+	xpad_text_view_set_follow_font_style (view, xpad_pad_properties_get_follow_font_style (prop));
 	
 	xpad_pad_save_info (pad);
 }
@@ -797,14 +988,14 @@ static void
 prop_notify_follow_color (XpadPad *pad)
 {
 	XpadPadProperties *prop = XPAD_PAD_PROPERTIES (pad->priv->properties);
-	
-	xpad_text_view_set_follow_color_style (XPAD_TEXT_VIEW (pad->priv->textview), xpad_pad_properties_get_follow_color_style (prop));
+	XpadTextView *view = XPAD_TEXT_VIEW (pad->priv->textview);
 	
 	if (!xpad_pad_properties_get_follow_color_style (prop))
 	{
-		gtk_widget_modify_base (pad->priv->textview, GTK_STATE_NORMAL, xpad_pad_properties_get_back_color (prop));
-		gtk_widget_modify_text (pad->priv->textview, GTK_STATE_NORMAL, xpad_pad_properties_get_text_color (prop));
+		xpad_text_view_set_back_color (view, xpad_pad_properties_get_back_color (prop));
+		xpad_text_view_set_text_color (view, xpad_pad_properties_get_text_color (prop));
 	}
+	xpad_text_view_set_follow_color_style (view, xpad_pad_properties_get_follow_color_style (prop));
 	
 	xpad_pad_save_info (pad);
 }
@@ -813,24 +1004,8 @@ static void
 prop_notify_text (XpadPad *pad)
 {
 	XpadPadProperties *prop = XPAD_PAD_PROPERTIES (pad->priv->properties);
-	const GdkRGBA *color = xpad_pad_properties_get_text_color (prop);
 	
-	if (color)
-	{
-		gchar *css_string = g_strdup_printf (
-			"textview { color: rgba(%d,%d,%d,%.2f); }",
-			(int)(color->red * 255), (int)(color->green * 255),
-			(int)(color->blue * 255), color->alpha
-		);
-		
-		GtkCssProvider *provider = gtk_css_provider_new ();
-		gtk_css_provider_load_from_string (provider, css_string);
-		gtk_style_context_add_provider (gtk_widget_get_style_context (pad->priv->textview),
-		                                 GTK_STYLE_PROVIDER (provider),
-		                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-		g_object_unref (provider);
-		g_free (css_string);
-	}
+	xpad_text_view_set_text_color (XPAD_TEXT_VIEW (pad->priv->textview), xpad_pad_properties_get_text_color (prop));
 	
 	xpad_pad_save_info (pad);
 }
@@ -839,24 +1014,8 @@ static void
 prop_notify_back (XpadPad *pad)
 {
 	XpadPadProperties *prop = XPAD_PAD_PROPERTIES (pad->priv->properties);
-	const GdkRGBA *color = xpad_pad_properties_get_back_color (prop);
 	
-	if (color)
-	{
-		gchar *css_string = g_strdup_printf (
-			"textview { background-color: rgba(%d,%d,%d,%.2f); }",
-			(int)(color->red * 255), (int)(color->green * 255),
-			(int)(color->blue * 255), color->alpha
-		);
-		
-		GtkCssProvider *provider = gtk_css_provider_new ();
-		gtk_css_provider_load_from_string (provider, css_string);
-		gtk_style_context_add_provider (gtk_widget_get_style_context (pad->priv->textview),
-		                                 GTK_STYLE_PROVIDER (provider),
-		                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-		g_object_unref (provider);
-		g_free (css_string);
-	}
+	xpad_text_view_set_back_color (XPAD_TEXT_VIEW (pad->priv->textview), xpad_pad_properties_get_back_color (prop));
 	
 	xpad_pad_save_info (pad);
 }
@@ -866,28 +1025,7 @@ prop_notify_font (XpadPad *pad)
 {
 	XpadPadProperties *prop = XPAD_PAD_PROPERTIES (pad->priv->properties);
 	
-	const gchar *font = xpad_pad_properties_get_fontname (prop);
-	PangoFontDescription *fontdesc;
-	
-	fontdesc = font ? pango_font_description_from_string (font) : NULL;
-	
-	if (fontdesc)
-	{
-		gchar *css_string = g_strdup_printf (
-			"textview { font-family: %s; font-size: %dpt; }",
-			pango_font_description_get_family (fontdesc),
-			pango_font_description_get_size (fontdesc) / PANGO_SCALE
-		);
-		
-		GtkCssProvider *provider = gtk_css_provider_new ();
-		gtk_css_provider_load_from_string (provider, css_string);
-		gtk_style_context_add_provider (gtk_widget_get_style_context (pad->priv->textview),
-		                                 GTK_STYLE_PROVIDER (provider),
-		                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-		g_object_unref (provider);
-		g_free (css_string);
-		pango_font_description_free (fontdesc);
-	}
+	xpad_text_view_set_fontname (XPAD_TEXT_VIEW (pad->priv->textview), xpad_pad_properties_get_fontname (prop));
 	
 	xpad_pad_save_info (pad);
 }
@@ -949,7 +1087,16 @@ xpad_pad_open_preferences (XpadPad *pad)
 static void
 xpad_pad_quit (XpadPad *pad)
 {
-	gtk_main_quit ();
+	xpad_app_quit ();
+}
+
+/* Writes out any content or geometry still waiting on its timer */
+void
+xpad_pad_flush_pending (XpadPad *pad)
+{
+	xpad_timer_flush (&pad->priv->edit_timer);
+	xpad_timer_flush (&pad->priv->content_timer);
+	xpad_timer_flush (&pad->priv->info_timer);
 }
 
 static void
@@ -958,8 +1105,10 @@ xpad_pad_text_changed (XpadPad *pad, GtkTextBuffer *buffer)
 	/* set title */
 	xpad_pad_sync_title (pad);
 	
-	/* record change */
-	xpad_pad_save_content (pad);
+	/* record change, once typing pauses */
+	if (xpad_timer_is_pending (&pad->priv->content_timer))
+		xpad_metrics_add (XPAD_METRIC_SAVES_ELIDED, 1);
+	xpad_timer_schedule (&pad->priv->content_timer, SAVE_DELAY);
 }
 
 static gboolean
@@ -984,16 +1133,16 @@ xpad_pad_configure_event (XpadPad *pad, GdkEventConfigure *event)
 	pad->priv->height = event->height;
 	pad->priv->location_valid = TRUE;
 	
-	xpad_pad_save_info (pad);
+	/* Geometry is committed once the pad stops moving */
+	if (xpad_timer_is_pending (&pad->priv->info_timer))
+		xpad_metrics_add (XPAD_METRIC_SAVES_ELIDED, 1);
+	xpad_timer_schedule (&pad->priv->info_timer, SAVE_DELAY);
 	
 	/* Sometimes when moving, if the toolbar tries to hide itself,
 		the window manager will not resize it correctly.  So, we make
 		sure not to end the timeout while moving. */
-	if (pad->priv->toolbar_timeout)
-	{
-		g_source_remove (pad->priv->toolbar_timeout);
-		pad->priv->toolbar_timeout = g_timeout_add (1000, (GSourceFunc) toolbar_timeout, pad);
-	}
+	if (xpad_timer_is_pending (&pad->priv->toolbar_timer))
+		xpad_timer_schedule (&pad->priv->toolbar_timer, TOOLBAR_HIDE_DELAY);
 	
 	return FALSE;
 }
@@ -1005,12 +1154,10 @@ xpad_pad_close_request (GtkWindow *window, XpadPad *pad)
 	return TRUE;
 }
 
-static gboolean
+static void
 xpad_pad_popup_menu (XpadPad *pad)
 {
-	xpad_pad_popup (pad, NULL);
-	
-	return TRUE;
+	xpad_pad_popup (pad, NULL, 0, 0);
 }
 
 static void
@@ -1057,7 +1204,7 @@ xpad_pad_text_view_button_pressed (GtkGestureClick *gesture, int n_press, double
 		}
 		else
 		{
-			xpad_pad_popup (pad, event);
+			xpad_pad_popup (pad, pad->priv->textview, x, y);
 		}
 		break;
 	}
@@ -1106,7 +1253,7 @@ xpad_pad_button_pressed (GtkGestureClick *gesture, int n_press, double x, double
 		}
 		else
 		{
-			xpad_pad_popup (pad, event);
+			xpad_pad_popup (pad, GTK_WIDGET (pad), x, y);
 		}
 		break;
 	}
@@ -1119,6 +1266,15 @@ xpad_pad_sync_title (XpadPad *pad)
 	GtkTextIter s, e;
 	gchar *content, *end;
 	
+	/* A followed pad is named after its file, not its ever-changing text */
+	if (pad->priv->followname)
+	{
+		content = g_path_get_basename (pad->priv->followname);
+		gtk_window_set_title (GTK_WINDOW (pad), content);
+		g_free (content);
+		return;
+	}
+	
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
 	gtk_text_buffer_get_bounds (buffer, &s, &e);
 	content = gtk_text_buffer_get_text (buffer, &s, &e, FALSE);
@@ -1145,6 +1301,26 @@ xpad_pad_get_group (XpadPad *pad)
 	return pad->priv->group;
 }
 
+/* Gives the pad its ID, which also names its window role and, once it
+   is first saved, its files */
+static void
+xpad_pad_set_id (XpadPad *pad, guint64 id)
+{
+	guint64 old_id = pad->priv->id;
+	gchar *role;
+	
+	if (id == old_id)
+		return;
+	
+	pad->priv->id = id;
+	if (pad->priv->group)
+		xpad_pad_group_update_id (pad->priv->group, GTK_WIDGET (pad), old_id);
+	
+	role = g_strdup_printf ("pad-%" G_GUINT64_FORMAT, id);
+	gtk_window_set_role (GTK_WINDOW (pad), role);
+	g_free (role);
+}
+
 static void
 xpad_pad_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
 {
@@ -1158,6 +1334,10 @@ xpad_pad_set_property (GObject *object, guint prop_id, const GValue *value, GPar
 		xpad_pad_set_group (pad, g_value_get_pointer (value));
 		break;
 	
+	case PROP_STICKY:
+		xpad_pad_set_sticky (pad, g_value_get_boolean (value));
+		break;
+	
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -1177,6 +1357,10 @@ xpad_pad_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec
 		g_value_set_pointer (value, xpad_pad_get_group (pad));
 		break;
 	
+	case PROP_STICKY:
+		g_value_set_boolean (value, pad->priv->sticky);
+		break;
+	
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -1188,26 +1372,37 @@ xpad_pad_load_content (XpadPad *pad)
 {
 	g_return_if_fail (pad);
 
-	gchar *content;
+	GBytes *content;
+	const gchar *data = NULL;
+	gsize size = 0;
 	GtkTextBuffer *buffer;
+	gint64 span;
 	
 	if (!pad->priv->contentname)
 		return;
 	
-	content = fio_get_file (pad->priv->contentname);
+	/* Parsed from the file as loaded, without a NUL-terminated copy first */
+	span = xpad_trace_begin ();
+	content = fio_get_file_bytes (pad->priv->contentname);
+	if (content)
+		data = g_bytes_get_data (content, &size);
 	
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
 	
 	xpad_text_buffer_freeze_undo (XPAD_TEXT_BUFFER (buffer));
 	g_signal_handlers_block_by_func (buffer, xpad_pad_text_changed, pad);
 	
-	xpad_text_buffer_set_text_with_tags (XPAD_TEXT_BUFFER (buffer), content ? content : "");
-	g_free (content);
+	xpad_text_buffer_set_text_with_tags (XPAD_TEXT_BUFFER (buffer), data ? data : "", size);
+	if (content)
+		g_bytes_unref (content);
 	
 	g_signal_handlers_unblock_by_func (buffer, xpad_pad_text_changed, pad);
 	xpad_text_buffer_thaw_undo (XPAD_TEXT_BUFFER (buffer));
 
-	xpad_pad_text_changed(pad, buffer);
+	/* What was just read needs no saving, only a title */
+	xpad_pad_sync_title (pad);
+	
+	xpad_trace_end (span, "xpad_pad_load_content", pad->priv->contentname);
 }
 
 void
@@ -1217,163 +1412,510 @@ xpad_pad_save_content (XpadPad *pad)
 
 	gchar *content;
 	GtkTextBuffer *buffer;
+	gint64 begin;
+	gboolean named = FALSE;
+	
+	/* This write covers any pending deferred one */
+	xpad_timer_cancel (&pad->priv->content_timer);
+	
+	if (pad->priv->followname)
+		return;
 	
-	/* create content file if it doesn't exist yet */
+	/* The first save of the info names both files */
+	if (!pad->priv->infoname)
+		xpad_pad_save_info (pad);
+	
+	/* name the content file after the pad if it has none yet */
 	if (!pad->priv->contentname)
 	{
-		pad->priv->contentname = fio_unique_name ("content-");
-		if (!pad->priv->contentname)
-			return;
+		pad->priv->contentname = xpad_pad_id_to_name ("content-", pad->priv->id);
+		named = TRUE;
 	}
 	
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
+	begin = g_get_monotonic_time ();
 	content = xpad_text_buffer_get_text_with_tags (XPAD_TEXT_BUFFER (buffer));
+	xpad_metrics_record (XPAD_HISTOGRAM_SERIALIZE_TIME, g_get_monotonic_time () - begin);
+	xpad_trace_end (begin, "serialize content", pad->priv->contentname);
 	
-	fio_set_file (pad->priv->contentname, content);
+	fio_set_file_compressed (pad->priv->contentname, content);
 	
 	g_free (content);
+	
+	/* A pad that stopped following has an info file naming no content */
+	if (named && pad->priv->infoname)
+		xpad_pad_save_info (pad);
 }
 
-static void
-load_info (XpadPad *pad, gboolean *show)
+/**
+ * Picks up a content file another program changed.  The new text is
+ * merged into the buffer, so the cursor and undo history stay.
+ *
+ * Typing that was not written yet is not merged over: the pad keeps what
+ * the user sees and saves it at once, and the other program's version
+ * goes to the content file's backup, with a message saying so.
+ */
+void
+xpad_pad_reload_content (XpadPad *pad)
 {
-	gboolean locked = FALSE, follow_font = TRUE, follow_color = TRUE;
-	gboolean hidden = FALSE;
-	GdkColor text = {0}, back = {0};
-	gchar *fontname = NULL, *oldcontentprefix;
+	gchar *content;
+	GtkTextBuffer *buffer;
 	
-	if (!pad->priv->infoname)
-		return;
+	g_return_if_fail (pad);
 	
-	if (fio_get_values_from_file (pad->priv->infoname, 
-		"i|width", &pad->priv->width,
-		"i|height", &pad->priv->height,
-		"i|x", &pad->priv->x,
-		"i|y", &pad->priv->y,
-		"b|locked", &locked,
-		"b|follow_font", &follow_font,
-		"b|follow_color", &follow_color,
-		"b|sticky", &pad->priv->sticky,
-		"b|hidden", &hidden,
-		"h|back_red", &back.red,
-		"h|back_green", &back.green,
-		"h|back_blue", &back.blue,
-		"h|text_red", &text.red,
-		"h|text_green", &text.green,
-		"h|text_blue", &text.blue,
-		"s|fontname", &fontname,
-		"s|content", &pad->priv->contentname,
-		NULL))
+	if (!pad->priv->contentname)
 		return;
 	
-	pad->priv->location_valid = TRUE;
-	if (xpad_settings_get_has_toolbar (xpad_settings ()) &&
-		 !xpad_settings_get_autohide_toolbar (xpad_settings ()))
-	{
-		pad->priv->toolbar_height = 0;
-		xpad_pad_hide_toolbar (pad);
-		xpad_pad_show_toolbar (pad); /* these will resize pad at correct height */
-	}
-	else
-		gtk_window_resize (GTK_WINDOW (pad), pad->priv->width, pad->priv->height);
-	gtk_window_move (GTK_WINDOW (pad), pad->priv->x, pad->priv->y);
-	
-	xpad_text_view_set_follow_font_style (XPAD_TEXT_VIEW (pad->priv->textview), follow_font);
-	xpad_text_view_set_follow_color_style (XPAD_TEXT_VIEW (pad->priv->textview), follow_color);
-	
-	/* obsolete setting, no longer written as of xpad-2.0-b2 */
-	if (locked)
-	{
-		xpad_text_view_set_follow_font_style (XPAD_TEXT_VIEW (pad->priv->textview), FALSE);
-		xpad_text_view_set_follow_color_style (XPAD_TEXT_VIEW (pad->priv->textview), FALSE);
-	}
+	content = fio_get_file (pad->priv->contentname);
+	if (!content)
+		return;
 	
-	if (!xpad_text_view_get_follow_color_style (XPAD_TEXT_VIEW (pad->priv->textview)))
+	if (xpad_timer_is_pending (&pad->priv->content_timer))
 	{
-		gtk_widget_modify_text (pad->priv->textview, GTK_STATE_NORMAL, &text);
-		gtk_widget_modify_base (pad->priv->textview, GTK_STATE_NORMAL, &back);
+		gchar *backup = g_strconcat (pad->priv->contentname, "~", NULL);
+		gchar *path = g_build_filename (fio_get_config_dir (), backup, NULL);
+		gchar *primary, *secondary;
+		
+		fio_set_file_compressed (backup, content);
+		xpad_pad_save_content (pad);
+		
+		primary = g_strdup_printf (_("'%s' was changed by another program while you were typing."),
+			gtk_window_get_title (GTK_WINDOW (pad)));
+		secondary = g_strdup_printf (_("Your text was kept.  The other version is in %s."), path);
+		xpad_app_error (GTK_WINDOW (pad), primary, secondary);
+		
+		g_free (secondary);
+		g_free (primary);
+		g_free (path);
+		g_free (backup);
+		g_free (content);
+		return;
 	}
 	
-	if (!xpad_text_view_get_follow_font_style (XPAD_TEXT_VIEW (pad->priv->textview)))
-	{
-		PangoFontDescription *font_desc = pango_font_description_from_string (fontname);
-		gtk_widget_modify_font (pad->priv->textview, font_desc);
-		pango_font_description_free (font_desc);
-	}
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
 	
-	if (pad->priv->sticky)
-		gtk_window_stick (GTK_WINDOW (pad));
-	else
-		gtk_window_unstick (GTK_WINDOW (pad));
+	g_signal_handlers_block_by_func (buffer, xpad_pad_text_changed, pad);
+	xpad_text_buffer_merge_text_with_tags (XPAD_TEXT_BUFFER (buffer), content);
+	g_signal_handlers_unblock_by_func (buffer, xpad_pad_text_changed, pad);
 	
-	/* Special check for contentname being absolute.  A while back,
-		xpad had absolute pathnames, pointing to ~/.xpad/content-*.
-		Now, files are kept in ~/.config/xpad, so using old config
-		files with a new xpad will break pads.  We check to see if
-		contentname is old pointer and then make it relative. */
-	oldcontentprefix = g_build_filename (g_get_home_dir (), ".xpad", "content-", NULL);
-	if (g_str_has_prefix (pad->priv->contentname, oldcontentprefix))
-	{
-		gchar *oldcontent = pad->priv->contentname;
-		pad->priv->contentname = g_path_get_basename (oldcontent);
-		g_free (oldcontent);
-	}
-	g_free (oldcontentprefix);
+	g_free (content);
 	
-	if (show)
-		*show = !hidden;
+	xpad_pad_sync_title (pad);
 }
 
-void
-xpad_pad_save_info (XpadPad *pad)
+/* Plain text of the pad, without tag markup.  Must be g_free'd. */
+gchar *
+xpad_pad_get_text (XpadPad *pad)
 {
-	gint height;
-	GtkStyle *style;
-	gchar *fontname;
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
 	
-	/* Must create pad info file if it doesn't exist yet */
-	if (!pad->priv->infoname)
-	{
-		pad->priv->infoname = fio_unique_name ("info-");
-		if (!pad->priv->infoname)
-			return;
-		gtk_window_set_role (GTK_WINDOW (pad), pad->priv->infoname);
-	}
-	/* create content file if it doesn't exist yet */
-	if (!pad->priv->contentname)
-	{
-		pad->priv->contentname = fio_unique_name ("content-");
-		if (!pad->priv->contentname)
-			return;
-	}
+	g_return_val_if_fail (pad, NULL);
 	
-	height = pad->priv->height;
-	if (GTK_WIDGET_VISIBLE (pad->priv->toolbar) && pad->priv->toolbar_expanded)
-		height -= pad->priv->toolbar_height;
-	
-	style = gtk_widget_get_style (pad->priv->textview);
-	fontname = pango_font_description_to_string (style->font_desc);
-	
-	fio_set_values_to_file (pad->priv->infoname,
-		"i|width", pad->priv->width,
-		"i|height", height,
-		"i|x", pad->priv->x,
-		"i|y", pad->priv->y,
-		"b|follow_font", xpad_text_view_get_follow_font_style (XPAD_TEXT_VIEW (pad->priv->textview)),
-		"b|follow_color", xpad_text_view_get_follow_color_style (XPAD_TEXT_VIEW (pad->priv->textview)),
-		"b|sticky", pad->priv->sticky,
-		"b|hidden", !GTK_WIDGET_VISIBLE (pad),
-		"h|back_red", style->base[GTK_STATE_NORMAL].red,
-		"h|back_green", style->base[GTK_STATE_NORMAL].green,
-		"h|back_blue", style->base[GTK_STATE_NORMAL].blue,
-		"h|text_red", style->text[GTK_STATE_NORMAL].red,
-		"h|text_green", style->text[GTK_STATE_NORMAL].green,
-		"h|text_blue", style->text[GTK_STATE_NORMAL].blue,
-		"s|fontname", fontname,
-		"s|content", pad->priv->contentname,
-		NULL);
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
+	gtk_text_buffer_get_bounds (buffer, &start, &end);
 	
-	g_free (fontname);
+	return gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+}
+
+/* Formatting of the pad's text, see xpad_text_buffer_get_tag_spans */
+GVariant *
+xpad_pad_get_tag_spans (XpadPad *pad)
+{
+	g_return_val_if_fail (pad, NULL);
+	
+	return xpad_text_buffer_get_tag_spans (XPAD_TEXT_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview))));
+}
+
+/* The pad's ID, which stays the same for as long as the pad exists */
+guint64
+xpad_pad_get_id (XpadPad *pad)
+{
+	g_return_val_if_fail (pad, 0);
+	
+	return pad->priv->id;
+}
+
+/* Name of the info file relative to the config dir, or NULL if the pad
+   was never saved */
+const gchar *
+xpad_pad_get_info_filename (XpadPad *pad)
+{
+	g_return_val_if_fail (pad, NULL);
+	
+	return pad->priv->infoname;
+}
+
+/* Name of the content file relative to the config dir, or NULL if the pad
+   was never saved */
+const gchar *
+xpad_pad_get_content_filename (XpadPad *pad)
+{
+	g_return_val_if_fail (pad, NULL);
+	
+	return pad->priv->contentname;
+}
+
+/* Brings the pad up with the cursor at the given line and character */
+void
+xpad_pad_show_line (XpadPad *pad, gint line, gint line_offset)
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter iter;
+	
+	g_return_if_fail (pad);
+	
+	gtk_window_present (GTK_WINDOW (pad));
+	
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
+	gtk_text_buffer_get_iter_at_line_offset (buffer, &iter, line, line_offset);
+	gtk_text_buffer_place_cursor (buffer, &iter);
+	gtk_text_view_scroll_to_iter (GTK_TEXT_VIEW (pad->priv->textview), &iter, 0.1, FALSE, 0.0, 0.0);
+}
+
+/**
+ * Queues text from a script.  Everything queued within a frame is put in
+ * the buffer at once, outside the undo history, and a steady stream is
+ * saved every SAVE_DELAY instead of never, so scripts can push lines as
+ * fast as they like.  A non-zero max_lines then keeps only that many
+ * lines, dropping the oldest: those at the top, or at the bottom when the
+ * last edit was a prepend.
+ */
+void
+xpad_pad_queue_edit (XpadPad *pad, XpadPadEdit edit, const gchar *text, guint max_lines)
+{
+	g_return_if_fail (pad);
+	
+	if (!pad->priv->queued_append)
+	{
+		pad->priv->queued_prepend = g_string_new (NULL);
+		pad->priv->queued_append = g_string_new (NULL);
+	}
+	
+	switch (edit)
+	{
+	case XPAD_PAD_EDIT_APPEND:
+		g_string_append (pad->priv->queued_append, text);
+		break;
+	case XPAD_PAD_EDIT_PREPEND:
+		g_string_prepend (pad->priv->queued_prepend, text);
+		break;
+	case XPAD_PAD_EDIT_REPLACE:
+		/* Earlier edits in this frame would be thrown away anyway */
+		pad->priv->queued_replace = TRUE;
+		g_string_truncate (pad->priv->queued_prepend, 0);
+		g_string_assign (pad->priv->queued_append, text);
+		break;
+	}
+	
+	pad->priv->queued_max_lines = max_lines;
+	pad->priv->trim_from_end = (edit == XPAD_PAD_EDIT_PREPEND);
+	xpad_metrics_add (XPAD_METRIC_EDITS_QUEUED, 1);
+	
+	if (!xpad_timer_is_pending (&pad->priv->edit_timer))
+		xpad_timer_schedule (&pad->priv->edit_timer, EDIT_DELAY);
+}
+
+/* Drops lines beyond max_lines once there are more than slack of them, so
+   a steady stream is trimmed in chunks.  Returns TRUE if text before the
+   end went. */
+static gboolean
+xpad_pad_trim_lines (GtkTextBuffer *buffer, guint max_lines, guint slack, gboolean from_end)
+{
+	GtkTextIter start, end;
+	gint lines;
+	
+	/* A final newline does not start another line of text */
+	lines = gtk_text_buffer_get_line_count (buffer);
+	gtk_text_buffer_get_end_iter (buffer, &end);
+	if (lines > 1 && gtk_text_iter_starts_line (&end))
+		lines--;
+	
+	if (max_lines == 0 || lines <= (gint) (max_lines + slack))
+		return FALSE;
+	
+	if (from_end)
+		gtk_text_buffer_get_iter_at_line (buffer, &start, max_lines);
+	else
+	{
+		gtk_text_buffer_get_start_iter (buffer, &start);
+		gtk_text_buffer_get_iter_at_line (buffer, &end, lines - max_lines);
+	}
+	gtk_text_buffer_delete (buffer, &start, &end);
+	
+	return !from_end;
+}
+
+static void
+xpad_pad_apply_edits (XpadPad *pad)
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter start, end;
+	gboolean moved;
+	
+	if (!pad->priv->queued_append)
+		return;
+	
+	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
+	
+	/* Anything but appending shifts the text the undo history points into */
+	moved = pad->priv->queued_replace || pad->priv->queued_prepend->len > 0;
+	
+	xpad_text_buffer_freeze_undo (XPAD_TEXT_BUFFER (buffer));
+	g_signal_handlers_block_by_func (buffer, xpad_pad_text_changed, pad);
+	
+	if (pad->priv->queued_replace)
+	{
+		gtk_text_buffer_get_bounds (buffer, &start, &end);
+		gtk_text_buffer_delete (buffer, &start, &end);
+	}
+	if (pad->priv->queued_prepend->len > 0)
+	{
+		gtk_text_buffer_get_start_iter (buffer, &start);
+		gtk_text_buffer_insert (buffer, &start, pad->priv->queued_prepend->str, pad->priv->queued_prepend->len);
+	}
+	if (pad->priv->queued_append->len > 0)
+	{
+		gtk_text_buffer_get_end_iter (buffer, &end);
+		gtk_text_buffer_insert (buffer, &end, pad->priv->queued_append->str, pad->priv->queued_append->len);
+	}
+	if (xpad_pad_trim_lines (buffer, pad->priv->queued_max_lines,
+		pad->priv->follow ? pad->priv->queued_max_lines / 8 : 0, pad->priv->trim_from_end))
+		moved = TRUE;
+	
+	g_signal_handlers_unblock_by_func (buffer, xpad_pad_text_changed, pad);
+	xpad_text_buffer_thaw_undo (XPAD_TEXT_BUFFER (buffer));
+	
+	if (moved)
+		xpad_text_buffer_clear_undo (XPAD_TEXT_BUFFER (buffer));
+	
+	g_string_truncate (pad->priv->queued_prepend, 0);
+	g_string_truncate (pad->priv->queued_append, 0);
+	pad->priv->queued_replace = FALSE;
+	xpad_metrics_add (XPAD_METRIC_EDIT_BATCHES, 1);
+	
+	xpad_pad_sync_title (pad);
+	
+	/* Followed text lives in its file, not in ours */
+	if (pad->priv->follow)
+		return;
+	
+	/* Unlike typing, a stream is not waited out */
+	if (xpad_timer_is_pending (&pad->priv->content_timer))
+		xpad_metrics_add (XPAD_METRIC_SAVES_ELIDED, 1);
+	else
+		xpad_timer_schedule (&pad->priv->content_timer, SAVE_DELAY);
+}
+
+/* Fills info with what a fresh pad starts out with, as the preferences say */
+void
+xpad_pad_info_init_new (XpadPadInfo *info)
+{
+	xpad_pad_info_init (info);
+	info->width = xpad_settings_get_width (xpad_settings ());
+	info->height = xpad_settings_get_height (xpad_settings ());
+	info->sticky = xpad_settings_get_sticky (xpad_settings ());
+}
+
+static void
+info_apply (XpadPad *pad, const XpadPadInfo *info, gboolean *show)
+{
+	GtkWidget *other = NULL;
+	
+	if (info->id)
+	{
+		xpad_pad_id_seen (info->id);
+		if (pad->priv->group)
+			other = xpad_pad_group_lookup (pad->priv->group, info->id);
+	}
+	
+	if (info->id && (!other || other == GTK_WIDGET (pad)))
+		xpad_pad_set_id (pad, info->id);
+	else if (info->id || !pad->priv->id)
+	{
+		/* Saved before pads had IDs, or a copy of another pad's info
+		   file, so it gets an ID of its own now and keeps it */
+		if (!pad->priv->id)
+			xpad_pad_set_id (pad, xpad_pad_id_new ());
+		xpad_timer_schedule (&pad->priv->info_timer, SAVE_DELAY);
+	}
+	
+	pad->priv->x = info->x;
+	pad->priv->y = info->y;
+	pad->priv->width = info->width;
+	pad->priv->height = info->height;
+	pad->priv->sticky = info->sticky;
+	if (info->contentname)
+	{
+		g_free (pad->priv->contentname);
+		pad->priv->contentname = g_strdup (info->contentname);
+	}
+	
+	pad->priv->location_valid = TRUE;
+	if (xpad_settings_get_has_toolbar (xpad_settings ()) &&
+		 !xpad_settings_get_autohide_toolbar (xpad_settings ()))
+	{
+		pad->priv->toolbar_height = 0;
+		xpad_pad_hide_toolbar (pad);
+		xpad_pad_show_toolbar (pad); /* these will resize pad at correct height */
+	}
+	else
+		gtk_window_resize (GTK_WINDOW (pad), pad->priv->width, pad->priv->height);
+	gtk_window_move (GTK_WINDOW (pad), pad->priv->x, pad->priv->y);
+	
+	xpad_text_view_set_follow_font_style (XPAD_TEXT_VIEW (pad->priv->textview), info->follow_font);
+	xpad_text_view_set_follow_color_style (XPAD_TEXT_VIEW (pad->priv->textview), info->follow_color);
+	
+	if (!info->follow_color)
+	{
+		GdkRGBA text = { info->text.red, info->text.green, info->text.blue, 1.0 };
+		GdkRGBA back = { info->back.red, info->back.green, info->back.blue, 1.0 };
+		
+		xpad_text_view_set_text_color (XPAD_TEXT_VIEW (pad->priv->textview), &text);
+		xpad_text_view_set_back_color (XPAD_TEXT_VIEW (pad->priv->textview), &back);
+	}
+	
+	if (!info->follow_font)
+		xpad_text_view_set_fontname (XPAD_TEXT_VIEW (pad->priv->textview), info->fontname);
+	
+	if (pad->priv->sticky)
+		gtk_window_stick (GTK_WINDOW (pad));
+	else
+		gtk_window_unstick (GTK_WINDOW (pad));
+	
+	if (g_strcmp0 (info->followname, pad->priv->followname) != 0)
+		xpad_pad_set_follow (pad, info->followname, MAX (info->follow_lines, 0));
+	
+	if (show)
+		*show = !info->hidden;
+}
+
+static void
+load_info (XpadPad *pad, gboolean *show)
+{
+	XpadPadInfo info;
+	
+	if (!pad->priv->infoname)
+		return;
+	
+	xpad_pad_info_init_new (&info);
+	if (xpad_pad_info_read (pad->priv->infoname, &info))
+		info_apply (pad, &info, show);
+	xpad_pad_info_clear (&info);
+}
+
+/* Picks up an info file another program changed */
+void
+xpad_pad_reload_info (XpadPad *pad)
+{
+	gchar *contentname;
+	gboolean show;
+	
+	g_return_if_fail (pad);
+	
+	xpad_timer_cancel (&pad->priv->info_timer);
+	
+	contentname = g_strdup (pad->priv->contentname);
+	show = GTK_WIDGET_VISIBLE (pad);
+	
+	load_info (pad, &show);
+	
+	if (g_strcmp0 (contentname, pad->priv->contentname) != 0)
+		xpad_pad_reload_content (pad);
+	g_free (contentname);
+	
+	gtk_widget_set_visible (GTK_WIDGET (pad), show);
+}
+
+/* Another program handed out this pad's ID too and saved its pad first,
+   so this one moves to a new ID and the file names that go with it */
+static void
+xpad_pad_id_clash (XpadPad *pad)
+{
+	gchar *contentname = xpad_pad_id_to_name ("content-", pad->priv->id);
+	
+	xpad_pad_set_id (pad, xpad_pad_id_taken (pad->priv->id));
+	
+	g_free (pad->priv->infoname);
+	pad->priv->infoname = xpad_pad_id_to_name ("info-", pad->priv->id);
+	if (!g_strcmp0 (pad->priv->contentname, contentname))
+	{
+		g_free (pad->priv->contentname);
+		pad->priv->contentname = xpad_pad_id_to_name ("content-", pad->priv->id);
+	}
+	
+	g_free (contentname);
+}
+
+/* Fills info with what xpad_pad_save_info writes.  The strings are the
+   pad's own, so info must not be cleared and lives only as long as they
+   do. */
+void
+xpad_pad_get_info (XpadPad *pad, XpadPadInfo *info)
+{
+	XpadTextView *view = XPAD_TEXT_VIEW (pad->priv->textview);
+	const GdkRGBA *text, *back;
+	const gchar *fontname;
+	GdkRGBA black = { 0.0, 0.0, 0.0, 1.0 }, white = { 1.0, 1.0, 1.0, 1.0 };
+	
+	info->id = pad->priv->id;
+	info->x = pad->priv->x;
+	info->y = pad->priv->y;
+	info->width = pad->priv->width;
+	info->height = pad->priv->height;
+	if (pad->priv->toolbar && GTK_WIDGET_VISIBLE (pad->priv->toolbar) && pad->priv->toolbar_expanded)
+		info->height -= pad->priv->toolbar_height;
+	
+	/* The pad's own style, kept even while it follows the global one */
+	text = xpad_text_view_get_text_color (view) ? xpad_text_view_get_text_color (view) : &black;
+	back = xpad_text_view_get_back_color (view) ? xpad_text_view_get_back_color (view) : &white;
+	fontname = xpad_text_view_get_fontname (view) ? xpad_text_view_get_fontname (view) : xpad_settings_get_fontname (xpad_settings ());
+	
+	info->follow_font = xpad_text_view_get_follow_font_style (view);
+	info->follow_color = xpad_text_view_get_follow_color_style (view);
+	info->sticky = pad->priv->sticky;
+	info->hidden = !GTK_WIDGET_VISIBLE (pad);
+	info->text = (XpadColor) { text->red, text->green, text->blue, 1.0 };
+	info->back = (XpadColor) { back->red, back->green, back->blue, 1.0 };
+	info->fontname = (gchar *) fontname;
+	info->contentname = pad->priv->contentname;
+	info->followname = pad->priv->followname;
+	info->follow_lines = pad->priv->follow_lines;
+}
+
+void
+xpad_pad_save_info (XpadPad *pad)
+{
+	XpadPadInfo info;
+	gboolean first, exists;
+	gint64 span;
+	
+	xpad_timer_cancel (&pad->priv->info_timer);
+	
+	/* Files are named after the pad the first time it is saved.  A
+	   followed pad writes no content file, so it names none until it
+	   stops following. */
+	first = !pad->priv->infoname;
+	if (first)
+		pad->priv->infoname = xpad_pad_id_to_name ("info-", pad->priv->id);
+	if (!pad->priv->contentname && !pad->priv->followname)
+		pad->priv->contentname = xpad_pad_id_to_name ("content-", pad->priv->id);
+	
+	xpad_pad_get_info (pad, &info);
+	
+	span = xpad_trace_begin ();
+	if (!first)
+		xpad_pad_info_write (pad->priv->infoname, &info);
+	else
+	{
+		while (!xpad_pad_info_create (pad->priv->infoname, &info, &exists) && exists)
+		{
+			xpad_pad_id_clash (pad);
+			info.id = pad->priv->id;
+			info.contentname = pad->priv->contentname;
+		}
+	}
+	xpad_trace_end (span, "xpad_pad_save_info", pad->priv->infoname);
 }
 
 static void
@@ -1423,28 +1965,16 @@ xpad_pad_cut (XpadPad *pad)
 {
 	gtk_text_buffer_cut_clipboard (
 		gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview)),
-		gtk_clipboard_get (GDK_SELECTION_CLIPBOARD),
+		gtk_widget_get_clipboard (pad->priv->textview),
 		TRUE);
 }
 
-static void
-menu_cut (XpadPad *pad)
-{
-	xpad_pad_cut (pad);
-}
-
 void
 xpad_pad_copy (XpadPad *pad)
 {
 	gtk_text_buffer_copy_clipboard (
 		gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview)),
-		gtk_clipboard_get (GDK_SELECTION_CLIPBOARD));
-}
-
-static void
-menu_copy (XpadPad *pad)
-{
-	xpad_pad_copy (pad);
+		gtk_widget_get_clipboard (pad->priv->textview));
 }
 
 void
@@ -1452,17 +1982,11 @@ xpad_pad_paste (XpadPad *pad)
 {
 	gtk_text_buffer_paste_clipboard (
 		gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview)),
-		gtk_clipboard_get (GDK_SELECTION_CLIPBOARD),
+		gtk_widget_get_clipboard (pad->priv->textview),
 		NULL,
 		TRUE);
 }
 
-static void
-menu_paste (XpadPad *pad)
-{
-	xpad_pad_paste (pad);
-}
-
 void
 xpad_pad_undo (XpadPad *pad)
 {
@@ -1473,12 +1997,6 @@ xpad_pad_undo (XpadPad *pad)
 	xpad_text_buffer_undo (buffer);
 }
 
-static void
-menu_undo (XpadPad *pad)
-{
-	xpad_pad_undo (pad);
-}
-
 void
 xpad_pad_redo (XpadPad *pad)
 {
@@ -1489,10 +2007,24 @@ xpad_pad_redo (XpadPad *pad)
 	xpad_text_buffer_redo (buffer);
 }
 
+/* The find bar is only built the first time it is asked for */
 static void
-menu_redo (XpadPad *pad)
+xpad_pad_find (XpadPad *pad)
 {
-	xpad_pad_redo (pad);
+	if (!pad->priv->find_bar)
+	{
+		pad->priv->find_bar = xpad_find_bar_new (GTK_TEXT_VIEW (pad->priv->textview));
+		gtk_box_insert_child_after (GTK_BOX (gtk_widget_get_parent (pad->priv->scrollbar)),
+			pad->priv->find_bar, pad->priv->scrollbar);
+	}
+	
+	xpad_find_bar_open (XPAD_FIND_BAR (pad->priv->find_bar));
+}
+
+static void
+menu_find_all (XpadPad *pad)
+{
+	xpad_search_window_open ();
 }
 
 static void
@@ -1533,12 +2065,6 @@ xpad_pad_close_all (XpadPad *pad)
 		xpad_pad_quit (pad);
 }
 
-static void
-menu_show (XpadPad *pad)
-{
-	gtk_window_present (GTK_WINDOW (pad));
-}
-
 static void
 menu_toggle_tag (XpadPad *pad, const gchar *name)
 {
@@ -1574,36 +2100,25 @@ menu_strikethrough (XpadPad *pad)
 }
 
 static void
-menu_sticky (XpadPad *pad, GtkCheckMenuItem *check)
+xpad_pad_set_sticky (XpadPad *pad, gboolean sticky)
 {
-	if (gtk_check_menu_item_get_active (check))
+	if (pad->priv->sticky == sticky)
+		return;
+	
+	pad->priv->sticky = sticky;
+	
+	if (sticky)
 		gtk_window_stick (GTK_WINDOW (pad));
 	else
 		gtk_window_unstick (GTK_WINDOW (pad));
+	
+	g_object_notify (G_OBJECT (pad), "sticky");
 }
 
 static void
-menu_toolbar (XpadPad *pad, GtkCheckMenuItem *check)
-{
-	xpad_settings_set_has_toolbar (xpad_settings (), gtk_check_menu_item_get_active (check));
-}
-
-static void
-menu_scrollbar (XpadPad *pad, GtkCheckMenuItem *check)
-{
-	xpad_settings_set_has_scrollbar (xpad_settings (), gtk_check_menu_item_get_active (check));
-}
-
-static void
-menu_autohide (XpadPad *pad, GtkCheckMenuItem *check)
-{
-	xpad_settings_set_autohide_toolbar (xpad_settings (), gtk_check_menu_item_get_active (check));
-}
-
-static void
-menu_decorated (XpadPad *pad, GtkCheckMenuItem *check)
+menu_help (XpadPad *pad)
 {
-	xpad_settings_set_has_decorations (xpad_settings (), gtk_check_menu_item_get_active (check));
+	show_help ();
 }
 
 static gint
@@ -1620,265 +2135,272 @@ menu_title_compare (GtkWindow *a, GtkWindow *b)
 	return rv;
 }
 
-#define MENU_ADD(mnemonic, image, key, mask, callback) {\
-	item = gtk_image_menu_item_new_with_mnemonic (mnemonic);\
-	if (image) {\
-		GtkWidget *imgwidget = gtk_image_new_from_stock (image, GTK_ICON_SIZE_MENU);\
-		gtk_image_menu_item_set_image (GTK_IMAGE_MENU_ITEM (item), imgwidget);\
-	}\
-	g_signal_connect_swapped (item, "activate", G_CALLBACK (callback), pad);\
-	if (key)\
-		gtk_widget_add_accelerator(item, "activate", accel_group, key, mask, GTK_ACCEL_VISIBLE);\
-	gtk_container_add (GTK_CONTAINER (menu), item);\
-	gtk_widget_show (item);\
-	}
-
-#define MENU_ADD_STOCK(stock, callback) {\
-	item = gtk_image_menu_item_new_from_stock (stock, accel_group);\
-	g_signal_connect_swapped (item, "activate", G_CALLBACK (callback), pad);\
-	gtk_container_add (GTK_CONTAINER (menu), item);\
-	gtk_widget_show (item);\
-	}
-
-#define MENU_ADD_STOCK_WITH_ACCEL(stock, callback, key, mask) {\
-	item = gtk_image_menu_item_new_from_stock (stock, accel_group);\
-	g_signal_connect_swapped (item, "activate", G_CALLBACK (callback), pad);\
-	if (key)\
-		gtk_widget_add_accelerator(item, "activate", accel_group, key, mask, GTK_ACCEL_VISIBLE);\
-	gtk_container_add (GTK_CONTAINER (menu), item);\
-	gtk_widget_show (item);\
-	}
-
-#define MENU_ADD_CHECK(mnemonic, active, callback) {\
-	item = gtk_check_menu_item_new_with_mnemonic (mnemonic);\
-	gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (item), active);\
-	g_signal_connect_swapped (item, "toggled", G_CALLBACK (callback), pad);\
-	gtk_container_add (GTK_CONTAINER (menu), item);\
-	gtk_widget_show (item);\
-	}
+/**
+ * Every pad action is installed once on the class.  The menu models below
+ * and the key bindings only name them, so a pad carries no menu widgets,
+ * accelerators or closures of its own.
+ */
+static const struct
+{
+	const gchar *name;
+	const gchar *accel;
+	void (*func) (XpadPad *pad);
+} pad_actions[] =
+{
+	{ "pad.new", NULL, xpad_pad_spawn },
+	{ "pad.properties", NULL, xpad_pad_open_properties },
+	{ "pad.close", NULL, xpad_pad_close },
+	{ "pad.delete", NULL, xpad_pad_delete },
+	{ "pad.undo", "<Control>z", xpad_pad_undo },
+	{ "pad.redo", "<Control>r", xpad_pad_redo },
+	{ "pad.cut", NULL, xpad_pad_cut },
+	{ "pad.copy", NULL, xpad_pad_copy },
+	{ "pad.paste", NULL, xpad_pad_paste },
+	{ "pad.find", "<Control>f", xpad_pad_find },
+	{ "pad.preferences", NULL, xpad_pad_open_preferences },
+	{ "pad.show-all", NULL, menu_show_all },
+	{ "pad.close-all", NULL, xpad_pad_close_all },
+	{ "pad.find-all", "<Control><Shift>f", menu_find_all },
+	{ "pad.help", "F1", menu_help },
+	{ "pad.about", NULL, menu_about },
+	{ "pad.bold", "<Control>b", menu_bold },
+	{ "pad.italic", "<Control>i", menu_italic },
+	{ "pad.underline", "<Control>u", menu_underline },
+	{ "pad.strikethrough", NULL, menu_strikethrough },
+	{ "pad.menu", "<Shift>F10", xpad_pad_popup_menu },
+	{ "pad.quit", "<Control>q", xpad_pad_quit },
+};
 
-#define MENU_ADD_SEP() {\
-	item = gtk_separator_menu_item_new ();\
-	gtk_container_add (GTK_CONTAINER (menu), item);\
-	gtk_widget_show (item);\
+static void
+menu_activate_action (GtkWidget *widget, const char *action_name, GVariant *parameter)
+{
+	guint i;
+	
+	for (i = 0; i < G_N_ELEMENTS (pad_actions); i++)
+	{
+		if (strcmp (pad_actions[i].name, action_name) == 0)
+		{
+			pad_actions[i].func (XPAD_PAD (widget));
+			return;
+		}
 	}
+}
 
-static GtkWidget *
-menu_get_popup_no_highlight (XpadPad *pad, GtkAccelGroup *accel_group)
+/* The notes list targets pads by ID; the pad may be gone since */
+static void
+menu_activate_show_pad (GtkWidget *widget, const char *action_name, GVariant *parameter)
 {
-	GtkWidget *uppermenu, *menu, *item;
-	
-	uppermenu = gtk_menu_new ();
-	gtk_menu_set_accel_group (GTK_MENU (uppermenu), accel_group);
+	XpadPad *pad = XPAD_PAD (widget);
+	GtkWidget *target;
 	
-	item = gtk_menu_item_new_with_mnemonic (_("_Pad"));
-	gtk_container_add (GTK_CONTAINER (uppermenu), item);
-	gtk_widget_show (item);
+	if (!pad->priv->group)
+		return;
 	
-	menu = gtk_menu_new ();
-	gtk_menu_item_set_submenu (GTK_MENU_ITEM (item), menu);
+	target = xpad_pad_group_lookup (pad->priv->group, g_variant_get_uint64 (parameter));
+	if (target)
+		gtk_window_present (GTK_WINDOW (target));
+}
+
+static void
+menu_install_actions (GtkWidgetClass *widget_class)
+{
+	guint i, key;
+	GdkModifierType mods;
 	
-	MENU_ADD_STOCK (GTK_STOCK_NEW, xpad_pad_spawn);
-	MENU_ADD_SEP ();
-	MENU_ADD_CHECK (_("Show on _All Workspaces"), pad->priv->sticky, menu_sticky);
-	g_object_set_data (G_OBJECT (uppermenu), "sticky", item);
-	MENU_ADD_STOCK (GTK_STOCK_PROPERTIES, xpad_pad_open_properties);
-	MENU_ADD_SEP ();
-	MENU_ADD_STOCK (GTK_STOCK_CLOSE, xpad_pad_close);
-	MENU_ADD_STOCK (GTK_STOCK_DELETE, xpad_pad_delete);
+	for (i = 0; i < G_N_ELEMENTS (pad_actions); i++)
+	{
+		gtk_widget_class_install_action (widget_class, pad_actions[i].name, NULL, menu_activate_action);
+		
+		if (pad_actions[i].accel && gtk_accelerator_parse (pad_actions[i].accel, &key, &mods))
+			gtk_widget_class_add_binding_action (widget_class, key, mods, pad_actions[i].name, NULL);
+	}
 	
+	gtk_widget_class_add_binding_action (widget_class, GDK_KEY_Menu, 0, "pad.menu", NULL);
+	gtk_widget_class_install_action (widget_class, "pad.show-pad", "t", menu_activate_show_pad);
+	gtk_widget_class_install_property_action (widget_class, "pad.sticky", "sticky");
+}
+
+/* The global view toggles act on the settings directly, one group for all pads */
+static GActionGroup *
+menu_get_settings_actions (void)
+{
+	static GSimpleActionGroup *group = NULL;
+	const gchar *names[] = { "has-toolbar", "autohide-toolbar", "has-scrollbar", "has-decorations" };
+	guint i;
 	
-	item = gtk_menu_item_new_with_mnemonic (_("_Edit"));
-	gtk_container_add (GTK_CONTAINER (uppermenu), item);
-	gtk_widget_show (item);
+	if (group)
+		return G_ACTION_GROUP (group);
 	
-	menu = gtk_menu_new ();
-	gtk_menu_item_set_submenu (GTK_MENU_ITEM (item), menu);
-	 
-	MENU_ADD_STOCK_WITH_ACCEL (GTK_STOCK_UNDO, menu_undo, GDK_Z, GDK_CONTROL_MASK);
-	g_object_set_data (G_OBJECT (uppermenu), "undo", item);
-	 
-	MENU_ADD_STOCK_WITH_ACCEL (GTK_STOCK_REDO, menu_redo, GDK_R, GDK_CONTROL_MASK);
-	g_object_set_data (G_OBJECT (uppermenu), "redo", item);
-
-	MENU_ADD_SEP();
+	group = g_simple_action_group_new ();
+	for (i = 0; i < G_N_ELEMENTS (names); i++)
+	{
+		GPropertyAction *action = g_property_action_new (names[i], xpad_settings (), names[i]);
+		g_action_map_add_action (G_ACTION_MAP (group), G_ACTION (action));
+		g_object_unref (action);
+	}
 	
-	MENU_ADD_STOCK (GTK_STOCK_PASTE, menu_paste);
-	g_object_set_data (G_OBJECT (uppermenu), "paste", item);
+	return G_ACTION_GROUP (group);
+}
 
-	MENU_ADD_SEP ();
+static GMenuModel *pad_menu = NULL;
+static GMenuModel *highlight_menu = NULL;
+static GMenu *notes_section = NULL;
 
-	MENU_ADD_STOCK (GTK_STOCK_PREFERENCES, xpad_pad_open_preferences);
-	
-	
-	item = gtk_menu_item_new_with_mnemonic (_("_View"));
-	gtk_container_add (GTK_CONTAINER (uppermenu), item);
-	gtk_widget_show (item);
-	
-	menu = gtk_menu_new ();
-	gtk_menu_item_set_submenu (GTK_MENU_ITEM (item), menu);
-	
-	MENU_ADD_CHECK (_("_Toolbar"), xpad_settings_get_has_toolbar (xpad_settings ()), menu_toolbar);
-	MENU_ADD_CHECK (_("_Autohide Toolbar"), xpad_settings_get_autohide_toolbar (xpad_settings ()), menu_autohide);
-	gtk_widget_set_sensitive (item, xpad_settings_get_has_toolbar (xpad_settings ()));
-	MENU_ADD_CHECK (_("_Scrollbar"), xpad_settings_get_has_scrollbar (xpad_settings ()), menu_scrollbar);
-	MENU_ADD_CHECK (_("_Window Decorations"), xpad_settings_get_has_decorations (xpad_settings ()), menu_decorated);
-	
-	
-	item = gtk_menu_item_new_with_mnemonic (_("_Notes"));
-	gtk_container_add (GTK_CONTAINER (uppermenu), item);
-	gtk_widget_show (item);
-	
-	menu = gtk_menu_new ();
-	gtk_menu_item_set_submenu (GTK_MENU_ITEM (item), menu);
-	g_object_set_data (G_OBJECT (uppermenu), "notes-menu", menu);
-	
-	MENU_ADD (_("_Show All"), NULL, 0, 0, menu_show_all);
-	MENU_ADD (_("_Close All"), NULL, 0, 0, xpad_pad_close_all);
-	
-	/* The rest of the notes menu will get set up in the prep function below */
-	
-	item = gtk_menu_item_new_with_mnemonic (_("_Help"));
-	gtk_container_add (GTK_CONTAINER (uppermenu), item);
-	gtk_widget_show (item);
-	
-	menu = gtk_menu_new ();
-	gtk_menu_item_set_submenu (GTK_MENU_ITEM (item), menu);
+static void
+menu_append (GMenu *menu, const gchar *label, const gchar *action)
+{
+	GMenuItem *item = g_menu_item_new (label, action);
+	guint i;
 	
-	MENU_ADD (_("_Contents"), GTK_STOCK_HELP, GDK_F1, 0, show_help);
-	MENU_ADD (_("_About"), GTK_STOCK_ABOUT, 0, 0, menu_about);
+	for (i = 0; i < G_N_ELEMENTS (pad_actions); i++)
+	{
+		if (pad_actions[i].accel && strcmp (pad_actions[i].name, action) == 0)
+			g_menu_item_set_attribute (item, "accel", "s", pad_actions[i].accel);
+	}
 	
-	return uppermenu;
+	g_menu_append_item (menu, item);
+	g_object_unref (item);
 }
 
-static void
-menu_prep_popup_no_highlight (XpadPad *current_pad, GtkWidget *uppermenu)
+/* Appends a new section to menu and returns it; menu keeps the reference */
+static GMenu *
+menu_add_section (GMenu *menu)
 {
-	GtkWidget *menu, *item;
-
-	GtkClipboard *clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
-
-	XpadTextBuffer *buffer = XPAD_TEXT_BUFFER (gtk_text_view_get_buffer (GTK_TEXT_VIEW (current_pad->priv->textview)));
+	GMenu *section = g_menu_new ();
 	
-	item = g_object_get_data (G_OBJECT (uppermenu), "paste");
-	if (item)
-		gtk_widget_set_sensitive (item, gtk_clipboard_wait_is_text_available (clipboard));
-
-	item = g_object_get_data (G_OBJECT (uppermenu), "undo");
-	if (item)
-		gtk_widget_set_sensitive (item, xpad_text_buffer_undo_available (buffer));
+	g_menu_append_section (menu, NULL, G_MENU_MODEL (section));
+	g_object_unref (section);
+	
+	return section;
+}
 
-	item = g_object_get_data (G_OBJECT (uppermenu), "redo");
-	if (item)
-		gtk_widget_set_sensitive (item, xpad_text_buffer_redo_available (buffer));
+static GMenu *
+menu_add_submenu (GMenu *menu, const gchar *label)
+{
+	GMenu *submenu = g_menu_new ();
 	
-	item = g_object_get_data (G_OBJECT (uppermenu), "sticky");
-	if (item) {
-		g_signal_handlers_block_by_func (item, menu_sticky, current_pad);
-		gtk_check_menu_item_set_active (GTK_CHECK_MENU_ITEM (item), current_pad->priv->sticky);
-		g_signal_handlers_unblock_by_func (item, menu_sticky, current_pad);
-	}
+	g_menu_append_submenu (menu, label, G_MENU_MODEL (submenu));
+	g_object_unref (submenu);
 	
-	menu = g_object_get_data (G_OBJECT (uppermenu), "notes-menu");
-	if (menu)
-	{
-		gint n = 1;
-		gchar *key;
-		
-		/* Remove old menu */
-		item = g_object_get_data (G_OBJECT (menu), "notes-sep");
-		while (item)
-		{
-			gtk_container_remove (GTK_CONTAINER (menu), item);
-			key = g_strdup_printf ("notes-%i", n++);
-			item = g_object_get_data (G_OBJECT (menu), key);
-			g_free (key);
-		}
-	}
-	if (menu && current_pad->priv->group)
-	{
-		GSList *pads, *l;
-		gint n;
-		GtkAccelGroup *accel_group = gtk_menu_get_accel_group (GTK_MENU (uppermenu));
-		
-		MENU_ADD_SEP ();
-		g_object_set_data (G_OBJECT (menu), "notes-sep", item);
-		
-		/**
-		 * Order pads according to title.
-		 */
-		pads = xpad_pad_group_get_pads (current_pad->priv->group);
-		
-		pads = g_slist_sort (pads, (GCompareFunc) menu_title_compare);
-		
-		/**
-		 * Populate list of windows.
-		 */
-		for (l = pads, n = 1; l; l = l->next, n++)
-		{
-			gchar *title;
-			gchar *tmp_title;
-			gchar *key;
-			GtkWidget *pad = GTK_WIDGET (l->data);
-			
-			key = g_strdup_printf ("notes-%i", n);
-			tmp_title = g_strdup (gtk_window_get_title (GTK_WINDOW (pad)));
-			str_replace_tokens (&tmp_title, '_', "__");
-			if (n < 10)
-				title = g_strdup_printf ("_%i. %s", n, tmp_title);
-			else
-				title = g_strdup_printf ("%i. %s", n, tmp_title);
-			g_free (tmp_title);
-			
-			MENU_ADD (title, NULL, 0, 0, menu_show);
-			g_object_set_data (G_OBJECT (menu), key, item);
-			
-			g_free (title);
-			g_free (key);
-		}
-		g_slist_free (pads);
-	}
+	return submenu;
 }
 
-static GtkWidget *
-menu_get_popup_highlight (XpadPad *pad, GtkAccelGroup *accel_group)
+static void
+menu_build_models (void)
 {
-	GtkWidget *menu, *item;
-	
-	menu = gtk_menu_new ();
-	gtk_menu_set_accel_group (GTK_MENU (menu), accel_group);
+	GMenu *menu, *submenu, *section;
 	
-	MENU_ADD_STOCK (GTK_STOCK_CUT, menu_cut);
-	MENU_ADD_STOCK (GTK_STOCK_COPY, menu_copy);
-	MENU_ADD_STOCK (GTK_STOCK_PASTE, menu_paste);
-	g_object_set_data (G_OBJECT (menu), "paste", item);
-	MENU_ADD_SEP ();
-	MENU_ADD_STOCK_WITH_ACCEL (GTK_STOCK_BOLD, menu_bold, GDK_b, GDK_CONTROL_MASK);
-	MENU_ADD_STOCK_WITH_ACCEL (GTK_STOCK_ITALIC, menu_italic, GDK_i, GDK_CONTROL_MASK);
-	MENU_ADD_STOCK_WITH_ACCEL (GTK_STOCK_UNDERLINE, menu_underline, GDK_u, GDK_CONTROL_MASK);
-	MENU_ADD_STOCK (GTK_STOCK_STRIKETHROUGH, menu_strikethrough);
+	if (pad_menu)
+		return;
 	
-	return menu;
+	menu = g_menu_new ();
+	
+	submenu = menu_add_submenu (menu, _("_Pad"));
+	section = menu_add_section (submenu);
+	menu_append (section, _("_New"), "pad.new");
+	section = menu_add_section (submenu);
+	menu_append (section, _("Show on _All Workspaces"), "pad.sticky");
+	menu_append (section, _("_Properties"), "pad.properties");
+	section = menu_add_section (submenu);
+	menu_append (section, _("_Close"), "pad.close");
+	menu_append (section, _("_Delete"), "pad.delete");
+	
+	submenu = menu_add_submenu (menu, _("_Edit"));
+	section = menu_add_section (submenu);
+	menu_append (section, _("_Undo"), "pad.undo");
+	menu_append (section, _("_Redo"), "pad.redo");
+	section = menu_add_section (submenu);
+	menu_append (section, _("_Paste"), "pad.paste");
+	section = menu_add_section (submenu);
+	menu_append (section, _("_Find"), "pad.find");
+	section = menu_add_section (submenu);
+	menu_append (section, _("_Preferences"), "pad.preferences");
+	
+	submenu = menu_add_submenu (menu, _("_View"));
+	menu_append (submenu, _("_Toolbar"), "settings.has-toolbar");
+	menu_append (submenu, _("_Autohide Toolbar"), "settings.autohide-toolbar");
+	menu_append (submenu, _("_Scrollbar"), "settings.has-scrollbar");
+	menu_append (submenu, _("_Window Decorations"), "settings.has-decorations");
+	
+	submenu = menu_add_submenu (menu, _("_Notes"));
+	section = menu_add_section (submenu);
+	menu_append (section, _("_Show All"), "pad.show-all");
+	menu_append (section, _("_Close All"), "pad.close-all");
+	menu_append (section, _("_Find in All Pads..."), "pad.find-all");
+	/* Filled in each time the menu pops up */
+	notes_section = menu_add_section (submenu);
+	
+	submenu = menu_add_submenu (menu, _("_Help"));
+	menu_append (submenu, _("_Contents"), "pad.help");
+	menu_append (submenu, _("_About"), "pad.about");
+	
+	pad_menu = G_MENU_MODEL (menu);
+	
+	menu = g_menu_new ();
+	
+	section = menu_add_section (menu);
+	menu_append (section, _("Cu_t"), "pad.cut");
+	menu_append (section, _("_Copy"), "pad.copy");
+	menu_append (section, _("_Paste"), "pad.paste");
+	section = menu_add_section (menu);
+	menu_append (section, _("_Bold"), "pad.bold");
+	menu_append (section, _("_Italic"), "pad.italic");
+	menu_append (section, _("_Underline"), "pad.underline");
+	menu_append (section, _("_Strikethrough"), "pad.strikethrough");
+	
+	highlight_menu = G_MENU_MODEL (menu);
 }
 
 static void
-menu_prep_popup_highlight (XpadPad *pad, GtkWidget *menu)
+menu_prep_notes (XpadPad *current_pad)
 {
-	GtkWidget *item;
-	GtkClipboard *clipboard;
+	GSList *pads, *l;
+	gint n;
 	
-	clipboard = gtk_clipboard_get (GDK_SELECTION_CLIPBOARD);
+	g_menu_remove_all (notes_section);
+	
+	if (!current_pad->priv->group)
+		return;
 	
-	item = g_object_get_data (G_OBJECT (menu), "paste");
-	if (item)
-		gtk_widget_set_sensitive (item, gtk_clipboard_wait_is_text_available (clipboard));
+	/**
+	 * Order pads according to title.
+	 */
+	pads = xpad_pad_group_get_pads (current_pad->priv->group);
+	
+	pads = g_slist_sort (pads, (GCompareFunc) menu_title_compare);
+	
+	/**
+	 * Populate list of windows.
+	 */
+	for (l = pads, n = 1; l; l = l->next, n++)
+	{
+		GMenuItem *item;
+		gchar *title;
+		gchar *tmp_title;
+		
+		tmp_title = g_strdup (gtk_window_get_title (GTK_WINDOW (l->data)));
+		str_replace_tokens (&tmp_title, '_', "__");
+		if (n < 10)
+			title = g_strdup_printf ("_%i. %s", n, tmp_title);
+		else
+			title = g_strdup_printf ("%i. %s", n, tmp_title);
+		g_free (tmp_title);
+		
+		item = g_menu_item_new (title, NULL);
+		g_menu_item_set_action_and_target (item, "pad.show-pad", "t", xpad_pad_get_id (XPAD_PAD (l->data)));
+		g_menu_append_item (notes_section, item);
+		g_object_unref (item);
+		
+		g_free (title);
+	}
+	g_slist_free (pads);
 }
 
 static void
 menu_popup (GtkWidget *menu, XpadPad *pad)
 {
 	g_signal_handlers_block_matched (pad, G_SIGNAL_MATCH_FUNC, 0, 0, NULL, (gpointer) xpad_pad_leave_notify_event, NULL);
-	pad->priv->toolbar_timeout = 0;
+	xpad_timer_cancel (&pad->priv->toolbar_timer);
 }
 
 static void
@@ -1895,15 +2417,18 @@ menu_popdown (GtkWidget *menu, XpadPad *pad)
 	rect.width = 1;
 	rect.height = 1;
 	
-	if (!pad->priv->toolbar_timeout &&
+	if (!xpad_timer_is_pending (&pad->priv->toolbar_timer) &&
 		 !gtk_widget_intersect (GTK_WIDGET (pad), &rect, NULL))
-		pad->priv->toolbar_timeout = g_timeout_add (1000, (GSourceFunc) toolbar_timeout, pad);
+		xpad_timer_schedule (&pad->priv->toolbar_timer, TOOLBAR_HIDE_DELAY);
 }
 
 static void
-xpad_pad_popup_deactivate (GtkWidget *menu, XpadPad *pad)
+menu_popover_closed (GtkPopover *popover)
 {
-	menu_popdown (GTK_WIDGET (menu), pad);
+	GtkWidget *parent = gtk_widget_get_parent (GTK_WIDGET (popover));
+	
+	if (parent && XPAD_IS_PAD (parent))
+		menu_popdown (GTK_WIDGET (popover), XPAD_PAD (parent));
 }
 
 static void
@@ -1918,32 +2443,62 @@ xpad_pad_toolbar_popdown (GtkWidget *toolbar, GtkMenu *menu, XpadPad *pad)
 	menu_popdown (GTK_WIDGET (menu), pad);
 }
 
+/**
+ * Pops up the shared menu on pad.  x and y are relative to widget, which
+ * may be NULL to pop up at the pad itself (keyboard invocation).
+ */
 static void
-xpad_pad_popup (XpadPad *pad, GdkEventButton *event)
+xpad_pad_popup (XpadPad *pad, GtkWidget *widget, double x, double y)
 {
 	GtkTextBuffer *buffer;
-	GtkWidget *menu;
+	GMenuModel *model;
+	graphene_point_t point;
+	
+	menu_build_models ();
 	
 	buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (pad->priv->textview));
 	
+	xpad_pad_notify_clipboard_owner_changed (pad);
+	
 	if (gtk_text_buffer_get_selection_bounds (buffer, NULL, NULL))
 	{
-		menu = pad->priv->highlight_menu;
-		menu_prep_popup_highlight (pad, menu);
+		model = highlight_menu;
 	}
 	else
 	{
-		menu = pad->priv->menu;
-		menu_prep_popup_no_highlight (pad, menu);
+		model = pad_menu;
+		menu_prep_notes (pad);
 	}
 	
-	if (!menu)
-		return;
+	if (!menu_popover)
+	{
+		menu_popover = gtk_popover_menu_new_from_model (NULL);
+		g_object_ref_sink (menu_popover);
+		gtk_popover_set_has_arrow (GTK_POPOVER (menu_popover), FALSE);
+		gtk_widget_set_halign (menu_popover, GTK_ALIGN_START);
+		g_signal_connect (menu_popover, "closed", G_CALLBACK (menu_popover_closed), NULL);
+	}
 	
-	menu_popup (GTK_WIDGET (menu), pad);
+	if (gtk_widget_get_parent (menu_popover) != GTK_WIDGET (pad))
+	{
+		if (gtk_widget_get_parent (menu_popover))
+		{
+			gtk_popover_popdown (GTK_POPOVER (menu_popover));
+			gtk_widget_unparent (menu_popover);
+		}
+		gtk_widget_set_parent (menu_popover, GTK_WIDGET (pad));
+	}
+	
+	gtk_popover_menu_set_menu_model (GTK_POPOVER_MENU (menu_popover), model);
 	
-	if (event)
-		gtk_menu_popup (GTK_MENU (menu), NULL, NULL, NULL, NULL, event->button, event->time);
+	if (widget && gtk_widget_compute_point (widget, GTK_WIDGET (pad), &GRAPHENE_POINT_INIT (x, y), &point))
+	{
+		GdkRectangle rect = { (gint) point.x, (gint) point.y, 1, 1 };
+		gtk_popover_set_pointing_to (GTK_POPOVER (menu_popover), &rect);
+	}
 	else
-		gtk_menu_popup (GTK_MENU (menu), NULL, NULL, NULL, NULL, 0, gtk_get_current_event_time ());
+		gtk_popover_set_pointing_to (GTK_POPOVER (menu_popover), NULL);
+	
+	menu_popup (menu_popover, pad);
+	gtk_popover_popup (GTK_POPOVER (menu_popover));
 }
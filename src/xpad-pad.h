@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <gtk/gtk.h>
 #include "xpad-pad-group.h"
+#include "xpad-pad-info.h"
 
 G_BEGIN_DECLS
 
@@ -53,18 +54,44 @@ struct XpadPadClass
    void (*closed) (XpadPad *pad);
 };
 
+/* How text queued with xpad_pad_queue_edit lands in the pad */
+typedef enum
+{
+	XPAD_PAD_EDIT_APPEND,
+	XPAD_PAD_EDIT_PREPEND,
+	XPAD_PAD_EDIT_REPLACE
+} XpadPadEdit;
+
 GType xpad_pad_get_type (void);
 
 GtkWidget *xpad_pad_new (XpadPadGroup *group);
 GtkWidget *xpad_pad_new_with_info (XpadPadGroup *group, const gchar *info_filename, gboolean *show);
+GtkWidget *xpad_pad_new_with_cached_info (XpadPadGroup *group, const gchar *info_filename, const XpadPadInfo *info,
+                                          const gchar *text, GVariant *spans, gboolean *show);
 GtkWidget *xpad_pad_new_from_file (XpadPadGroup *group, const gchar *filename);
+GtkWidget *xpad_pad_new_following (XpadPadGroup *group, const gchar *filename, guint max_lines);
 void xpad_pad_close (XpadPad *pad);
 void xpad_pad_toggle (XpadPad *pad);
+void xpad_pad_get_info (XpadPad *pad, XpadPadInfo *info);
 void xpad_pad_save_info (XpadPad *pad);
 
 void xpad_pad_load_content (XpadPad *pad);
 void xpad_pad_save_content (XpadPad *pad);
+void xpad_pad_flush_pending (XpadPad *pad);
+void xpad_pad_reload_info (XpadPad *pad);
+void xpad_pad_reload_content (XpadPad *pad);
+
+gchar *xpad_pad_get_text (XpadPad *pad);
+GVariant *xpad_pad_get_tag_spans (XpadPad *pad);
+guint64 xpad_pad_get_id (XpadPad *pad);
+const gchar *xpad_pad_get_info_filename (XpadPad *pad);
+const gchar *xpad_pad_get_content_filename (XpadPad *pad);
+void xpad_pad_show_line (XpadPad *pad, gint line, gint line_offset);
+void xpad_pad_queue_edit (XpadPad *pad, XpadPadEdit edit, const gchar *text, guint max_lines);
+
+void xpad_pad_info_init_new (XpadPadInfo *info);
 
+void xpad_pad_apply_settings (XpadPad *pad, guint changes);
 void xpad_pad_notify_has_selection (XpadPad *pad);
 void xpad_pad_notify_clipboard_owner_changed (XpadPad *pad);
 void xpad_pad_notify_undo_redo_changed (XpadPad *pad);
@@ -306,6 +306,9 @@ change_color_check (GtkToggleButton *button, XpadPreferences *pref)
 	g_signal_handler_block (xpad_settings (), pref->priv->notify_back_handler);
 	g_signal_handler_block (xpad_settings (), pref->priv->notify_text_handler);
 	
+	/* Both colors change together, so pads restyle and the file is written once */
+	xpad_settings_begin (xpad_settings ());
+	
 	if (!gtk_toggle_button_get_active (button))
 	{
 		xpad_settings_set_text_color (xpad_settings (), NULL);
@@ -320,6 +323,8 @@ change_color_check (GtkToggleButton *button, XpadPreferences *pref)
 		xpad_settings_set_back_color (xpad_settings (), &color);
 	}
 	
+	xpad_settings_commit (xpad_settings ());
+	
 	gtk_widget_set_sensitive (pref->priv->colorbox, gtk_toggle_button_get_active (button));
 	
 	g_signal_handler_unblock (xpad_settings (), pref->priv->notify_back_handler);
@@ -0,0 +1,710 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+#include "xpad-protocol.h"
+
+/**
+ * The control socket other xpad invocations use to reach the running one.
+ *
+ * Every message is a 4-byte big-endian length followed by that many bytes
+ * of serialized GVariant.  A request is (id, command, target, argument,
+ * max lines) and is answered by (id, status, text) with the same id.  A client may send any
+ * number of requests on one connection without waiting; they are run in
+ * order and answered in order.  No message is longer than
+ * XPAD_PROTOCOL_MAX_MESSAGE; an answer with more text than one message
+ * holds comes as several (id, XPAD_STATUS_MORE, text) messages before its
+ * final one.  A command may stream a long answer the same way;
+ * the next request waits until that is done, and each part is only
+ * produced once the previous one has been written, so a slow reader
+ * holds the server to one part at a time.
+ *
+ * Arguments too long for one message are cut into XPAD_COMMAND_PART
+ * requests, each adding its argument to what the next request on the
+ * connection gets as its own.  They are answered like any other request
+ * and never reach the command function.
+ *
+ * The server side is asynchronous throughout, so a client that stalls
+ * halfway through a message holds up nobody but itself.
+ */
+
+#define REQUEST_TYPE "(uussu)"
+#define RESPONSE_TYPE "(uus)"
+
+typedef struct
+{
+	XpadCommandFunc func;
+	gpointer user_data;
+} Server;
+
+typedef struct
+{
+	Server *server;
+	GSocketConnection *connection;
+	guint8 header[4];
+	guint8 *body;
+	guint32 body_size;
+	GQueue writes;
+	gboolean reading;
+	gboolean writing;
+	XpadReply *reply;   /* the answer being streamed, if any */
+	GString *parts;     /* XPAD_COMMAND_PART arguments so far */
+} Client;
+
+struct XpadReply
+{
+	guint32 id;
+	XpadReplyFunc func;
+	gpointer user_data;
+	GDestroyNotify destroy;
+	guint idle;
+};
+
+/* Connections made while requests are held, see xpad_protocol_hold */
+static gboolean held = FALSE;
+static GQueue held_clients = G_QUEUE_INIT;
+
+static void client_read_header (Client *client);
+static void client_write_next (Client *client);
+
+/* Adds nothing and fails if message is too long for the other side */
+static gboolean
+append_frame (GByteArray *frames, GVariant *message)
+{
+	gsize len = g_variant_get_size (message);
+	guint32 size;
+	
+	if (len > XPAD_PROTOCOL_MAX_MESSAGE)
+		return FALSE;
+	
+	size = GUINT32_TO_BE ((guint32) len);
+	g_byte_array_append (frames, (const guint8 *) &size, sizeof (size));
+	g_byte_array_append (frames, g_variant_get_data (message), len);
+	
+	return TRUE;
+}
+
+/* How much of len bytes of text goes in one message: all of it, or at
+   most XPAD_PROTOCOL_MAX_TEXT bytes ending between two characters */
+gsize
+xpad_protocol_text_part (const gchar *text, gsize len)
+{
+	const gchar *cut;
+	
+	if (len <= XPAD_PROTOCOL_MAX_TEXT)
+		return len;
+	
+	cut = text + XPAD_PROTOCOL_MAX_TEXT;
+	while (cut > text && ((guchar) *cut & 0xc0) == 0x80)
+		cut--;
+	
+	return cut > text ? (gsize) (cut - text) : XPAD_PROTOCOL_MAX_TEXT;
+}
+
+static guint32
+frame_size (const guint8 *header)
+{
+	guint32 size;
+	
+	memcpy (&size, header, sizeof (size));
+	return GUINT32_FROM_BE (size);
+}
+
+/* Takes ownership of data, which must come from g_malloc */
+static GVariant *
+message_new (const gchar *type, gpointer data, gsize size)
+{
+	return g_variant_ref_sink (g_variant_new_from_data (G_VARIANT_TYPE (type), data, size, FALSE, g_free, data));
+}
+
+/* Server */
+
+static void
+reply_free (XpadReply *reply)
+{
+	if (reply->idle)
+		g_source_remove (reply->idle);
+	if (reply->destroy)
+		reply->destroy (reply->user_data);
+	g_free (reply);
+}
+
+/**
+ * Makes the answer to the running command a stream.  func is called for
+ * each part whenever the client has taken the previous one, until it
+ * returns FALSE, and destroy is called on user_data after that or when
+ * the client goes away.
+ */
+void
+xpad_reply_stream (XpadReply *reply, XpadReplyFunc func, gpointer user_data, GDestroyNotify destroy)
+{
+	g_return_if_fail (reply && !reply->func);
+	
+	reply->func = func;
+	reply->user_data = user_data;
+	reply->destroy = destroy;
+}
+
+/* Drops the client once it has nothing left to read or write */
+static void
+client_release (Client *client)
+{
+	if (client->reading || client->writing)
+		return;
+	
+	g_io_stream_close_async (G_IO_STREAM (client->connection), G_PRIORITY_DEFAULT, NULL, NULL, NULL);
+	g_object_unref (client->connection);
+	g_queue_clear_full (&client->writes, (GDestroyNotify) g_bytes_unref);
+	if (client->parts)
+		g_string_free (client->parts, TRUE);
+	g_free (client->body);
+	g_free (client);
+}
+
+/* Queues text as the answer to id, in MORE parts ahead of the one with
+   status if it does not fit in one message */
+static void
+client_queue (Client *client, guint32 id, XpadStatus status, const gchar *text)
+{
+	gsize len = strlen (text);
+	
+	do
+	{
+		GByteArray *frame = g_byte_array_new ();
+		GVariant *response;
+		gsize part = xpad_protocol_text_part (text, len);
+		gchar *piece = g_strndup (text, part);
+		
+		response = g_variant_ref_sink (g_variant_new (RESPONSE_TYPE, id, part < len ? XPAD_STATUS_MORE : status, piece));
+		if (!append_frame (frame, response))
+			g_warning ("Answer to request %u too long for one message", id);
+		g_variant_unref (response);
+		g_free (piece);
+		
+		g_queue_push_tail (&client->writes, g_byte_array_free_to_bytes (frame));
+		text += part;
+		len -= part;
+	}
+	while (len > 0);
+}
+
+/* Gets the next part of a streamed answer.  Parts that come out empty
+   are retried from an idle, so the command can work in small steps. */
+static gboolean
+client_pump (gpointer data)
+{
+	Client *client = data;
+	XpadReply *reply = client->reply;
+	GString *output = g_string_new (NULL);
+	gboolean more;
+	
+	reply->idle = 0;
+	more = reply->func (output, reply->user_data);
+	if (output->len > 0)
+		client_queue (client, reply->id, XPAD_STATUS_MORE, output->str);
+	g_string_free (output, TRUE);
+	
+	if (!more)
+	{
+		client_queue (client, reply->id, XPAD_STATUS_OK, "");
+		client->reply = NULL;
+		reply_free (reply);
+		client_read_header (client);
+	}
+	else if (g_queue_is_empty (&client->writes))
+		reply->idle = g_idle_add (client_pump, client);
+	
+	client_write_next (client);
+	
+	return G_SOURCE_REMOVE;
+}
+
+static void
+client_stop_reading (Client *client)
+{
+	client->reading = FALSE;
+	client_release (client);
+}
+
+static void
+client_write_done (GObject *stream, GAsyncResult *result, gpointer data)
+{
+	Client *client = data;
+	
+	client->writing = FALSE;
+	
+	if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (stream), result, NULL, NULL))
+	{
+		/* Nobody is listening any more */
+		g_queue_clear_full (&client->writes, (GDestroyNotify) g_bytes_unref);
+		if (client->reply)
+		{
+			/* No read is in flight while streaming */
+			reply_free (client->reply);
+			client->reply = NULL;
+			client->reading = FALSE;
+		}
+		client_release (client);
+		return;
+	}
+	
+	client_write_next (client);
+}
+
+static void
+client_write_next (Client *client)
+{
+	GBytes *bytes;
+	
+	if (client->writing)
+		return;
+	
+	bytes = g_queue_pop_head (&client->writes);
+	if (!bytes)
+	{
+		if (client->reply && !client->reply->idle)
+			client_pump (client);
+		else
+			client_release (client);
+		return;
+	}
+	
+	client->writing = TRUE;
+	/* The stream holds on to nothing, so the bytes ride along with the call */
+	g_object_set_data_full (G_OBJECT (client->connection), "xpad-write", bytes, (GDestroyNotify) g_bytes_unref);
+	g_output_stream_write_all_async (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
+		g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes),
+		G_PRIORITY_DEFAULT, NULL, client_write_done, client);
+}
+
+/* Returns TRUE if the answer is streamed, in which case reading the
+   next request waits until it is done */
+static gboolean
+client_handle (Client *client, GVariant *request)
+{
+	XpadRequest req;
+	XpadReply *reply;
+	guint32 id, command;
+	const gchar *target, *arg;
+	GString *output = g_string_new (NULL);
+	XpadStatus status;
+	gboolean streamed;
+	
+	g_variant_get (request, "(uu&s&su)", &id, &command, &target, &arg, &req.max_lines);
+	
+	if (command == XPAD_COMMAND_PART)
+	{
+		if (!client->parts)
+			client->parts = g_string_new (NULL);
+		g_string_append (client->parts, arg);
+		
+		client_queue (client, id, XPAD_STATUS_OK, "");
+		client_write_next (client);
+		g_string_free (output, TRUE);
+		
+		return FALSE;
+	}
+	
+	if (client->parts)
+	{
+		g_string_append (client->parts, arg);
+		arg = client->parts->str;
+	}
+	
+	req.command = command;
+	req.target = *target ? (gchar *) target : NULL;
+	req.arg = *arg ? (gchar *) arg : NULL;
+	
+	reply = g_new0 (XpadReply, 1);
+	reply->id = id;
+	status = client->server->func (&req, output, reply, client->server->user_data);
+	
+	if (client->parts)
+	{
+		g_string_free (client->parts, TRUE);
+		client->parts = NULL;
+	}
+	
+	streamed = reply->func != NULL;
+	if (streamed)
+	{
+		if (output->len > 0)
+			client_queue (client, id, XPAD_STATUS_MORE, output->str);
+		client->reply = reply;
+	}
+	else
+	{
+		client_queue (client, id, status, output->str);
+		g_free (reply);
+	}
+	g_string_free (output, TRUE);
+	
+	client_write_next (client);
+	
+	return streamed;
+}
+
+static void
+client_body_read (GObject *stream, GAsyncResult *result, gpointer data)
+{
+	Client *client = data;
+	GVariant *request;
+	gsize read = 0;
+	
+	if (!g_input_stream_read_all_finish (G_INPUT_STREAM (stream), result, &read, NULL) ||
+	    read < client->body_size)
+	{
+		client_stop_reading (client);
+		return;
+	}
+	
+	request = message_new (REQUEST_TYPE, client->body, client->body_size);
+	client->body = NULL;
+	
+	if (!client_handle (client, request))
+		client_read_header (client);
+	g_variant_unref (request);
+}
+
+static void
+client_header_read (GObject *stream, GAsyncResult *result, gpointer data)
+{
+	Client *client = data;
+	gsize read = 0;
+	
+	/* A clean end of the connection lands here too */
+	if (!g_input_stream_read_all_finish (G_INPUT_STREAM (stream), result, &read, NULL) ||
+	    read < sizeof (client->header))
+	{
+		client_stop_reading (client);
+		return;
+	}
+	
+	client->body_size = frame_size (client->header);
+	if (client->body_size > XPAD_PROTOCOL_MAX_MESSAGE)
+	{
+		client_stop_reading (client);
+		return;
+	}
+	
+	client->body = g_malloc (client->body_size);
+	g_input_stream_read_all_async (G_INPUT_STREAM (stream), client->body, client->body_size,
+		G_PRIORITY_DEFAULT, NULL, client_body_read, client);
+}
+
+static void
+client_read_header (Client *client)
+{
+	client->reading = TRUE;
+	g_input_stream_read_all_async (g_io_stream_get_input_stream (G_IO_STREAM (client->connection)),
+		client->header, sizeof (client->header),
+		G_PRIORITY_DEFAULT, NULL, client_header_read, client);
+}
+
+static gboolean
+server_incoming (GSocketService *service, GSocketConnection *connection, GObject *source, Server *server)
+{
+	Client *client = g_new0 (Client, 1);
+	
+	client->server = server;
+	client->connection = g_object_ref (connection);
+	g_queue_init (&client->writes);
+	
+	if (held)
+		g_queue_push_tail (&held_clients, client);
+	else
+		client_read_header (client);
+	
+	return TRUE;
+}
+
+/**
+ * While held, connections are accepted but nothing is read from them, so
+ * their clients wait for an answer as they would for a slow command.
+ * Releasing the hold starts reading, in the order the clients connected.
+ */
+void
+xpad_protocol_hold (gboolean hold)
+{
+	Client *client;
+	
+	held = hold;
+	
+	while (!held && (client = g_queue_pop_head (&held_clients)))
+		client_read_header (client);
+}
+
+/**
+ * Starts answering requests on the unix socket at path, replacing any
+ * stale socket file there.  func runs every command, on the main context.
+ */
+gboolean
+xpad_protocol_serve (const gchar *path, XpadCommandFunc func, gpointer user_data, GError **error)
+{
+	GSocketService *service;
+	GSocketAddress *address;
+	Server *server;
+	gboolean ok;
+	
+	g_unlink (path);
+	
+	service = g_socket_service_new ();
+	address = g_unix_socket_address_new (path);
+	ok = g_socket_listener_add_address (G_SOCKET_LISTENER (service), address,
+		G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, error);
+	g_object_unref (address);
+	
+	if (!ok)
+	{
+		g_object_unref (service);
+		return FALSE;
+	}
+	
+	/* Lives as long as xpad does */
+	server = g_new (Server, 1);
+	server->func = func;
+	server->user_data = user_data;
+	
+	g_signal_connect (service, "incoming", G_CALLBACK (server_incoming), server);
+	g_socket_service_start (service);
+	
+	return TRUE;
+}
+
+/* Client */
+
+static GVariant *
+read_message (GInputStream *in, const gchar *type)
+{
+	guint8 header[4];
+	gpointer body;
+	guint32 size;
+	gsize read = 0;
+	
+	if (!g_input_stream_read_all (in, header, sizeof (header), &read, NULL, NULL) || read < sizeof (header))
+		return NULL;
+	
+	size = frame_size (header);
+	if (size > XPAD_PROTOCOL_MAX_MESSAGE)
+		return NULL;
+	
+	body = g_malloc (size);
+	if (!g_input_stream_read_all (in, body, size, &read, NULL, NULL) || read < size)
+	{
+		g_free (body);
+		return NULL;
+	}
+	
+	return message_new (type, body, size);
+}
+
+struct XpadProtocolClient
+{
+	GSocketConnection *connection;
+	guint32 next_id;
+};
+
+/* Returns NULL if nobody is listening at path */
+XpadProtocolClient *
+xpad_protocol_client_new (const gchar *path)
+{
+	XpadProtocolClient *client;
+	GSocketClient *socket_client;
+	GSocketAddress *address;
+	GSocketConnection *connection;
+	
+	socket_client = g_socket_client_new ();
+	address = g_unix_socket_address_new (path);
+	connection = g_socket_client_connect (socket_client, G_SOCKET_CONNECTABLE (address), NULL, NULL);
+	g_object_unref (address);
+	g_object_unref (socket_client);
+	
+	if (!connection)
+		return NULL;
+	
+	client = g_new (XpadProtocolClient, 1);
+	client->connection = connection;
+	client->next_id = 1;
+	
+	return client;
+}
+
+void
+xpad_protocol_client_free (XpadProtocolClient *client)
+{
+	if (!client)
+		return;
+	
+	g_io_stream_close (G_IO_STREAM (client->connection), NULL, NULL);
+	g_object_unref (client->connection);
+	g_free (client);
+}
+
+/* GVariant strings must be UTF-8, which file names and piped text need not be */
+static gchar *
+make_valid (const gchar *str)
+{
+	return g_utf8_make_valid (str ? str : "", -1);
+}
+
+/* Adds a request with len bytes of text as its argument */
+static gboolean
+client_frame (XpadProtocolClient *client, GByteArray *frames, guint32 command, const gchar *target,
+              const gchar *text, gsize len, guint max_lines, GError **error)
+{
+	gchar *arg = g_strndup (text, len);
+	GVariant *request = g_variant_ref_sink (g_variant_new (REQUEST_TYPE, client->next_id++,
+		command, target, arg, max_lines));
+	gboolean fits = append_frame (frames, request);
+	
+	g_variant_unref (request);
+	g_free (arg);
+	
+	if (!fits)
+		g_set_error (error, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+			"Request too long to send to the running xpad");
+	
+	return fits;
+}
+
+static gboolean
+client_send (XpadProtocolClient *client, GByteArray *frames, GError **error)
+{
+	gboolean ok = g_output_stream_write_all (g_io_stream_get_output_stream (G_IO_STREAM (client->connection)),
+		frames->data, frames->len, NULL, NULL, error);
+	
+	g_byte_array_set_size (frames, 0);
+	
+	return ok;
+}
+
+/* Reads the whole answer to one request of command, writing its text to
+   out, and sets status to how it ended */
+static gboolean
+client_answer (XpadProtocolClient *client, guint32 command, FILE *out, guint32 *status, GError **error)
+{
+	GInputStream *in = g_io_stream_get_input_stream (G_IO_STREAM (client->connection));
+	
+	/* Long and streamed answers come in parts, all but the last marked MORE */
+	*status = XPAD_STATUS_MORE;
+	while (*status == XPAD_STATUS_MORE)
+	{
+		GVariant *response = read_message (in, RESPONSE_TYPE);
+		const gchar *text;
+		guint32 id;
+		
+		if (!response)
+		{
+			*status = XPAD_STATUS_OK;
+			if (command == XPAD_COMMAND_QUIT)
+				return TRUE;
+			
+			g_set_error (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED,
+				"Lost the connection to the running xpad");
+			return FALSE;
+		}
+		
+		g_variant_get (response, "(uu&s)", &id, status, &text);
+		fputs (text, out);
+		g_variant_unref (response);
+	}
+	
+	return TRUE;
+}
+
+/**
+ * Sends the requests, in one go where it can, then writes the answers'
+ * text to out as it arrives.  Fails if the server went away before
+ * answering all of them, except while waiting for the answer to
+ * XPAD_COMMAND_QUIT, which it never sends.
+ *
+ * An argument longer than XPAD_PROTOCOL_MAX_TEXT goes ahead of its request
+ * as XPAD_COMMAND_PART requests, each carrying the next piece, which the
+ * server joins up with the argument of the request that follows them.
+ */
+gboolean
+xpad_protocol_client_call (XpadProtocolClient *client, const XpadRequest *requests, guint n_requests,
+                           FILE *out, GError **error)
+{
+	GByteArray *frames = g_byte_array_new ();
+	guint answered = 0, i;
+	guint32 status;
+	gboolean ok = TRUE;
+	
+	for (i = 0; ok && i < n_requests; i++)
+	{
+		gchar *target = make_valid (requests[i].target);
+		gchar *arg = make_valid (requests[i].arg);
+		const gchar *rest = arg;
+		gsize len = strlen (arg);
+		gsize part = xpad_protocol_text_part (rest, len);
+		
+		if (part < len)
+		{
+			guint n_parts = 0;
+			
+			/* A server that does not know about parts would run the request
+			   on its last piece alone, so they go on their own and must all be
+			   taken before the request itself is sent */
+			ok = client_send (client, frames, error);
+			for (; ok && answered < i; answered++)
+			{
+				ok = client_answer (client, requests[answered].command, out, &status, error);
+				if (ok && status == XPAD_STATUS_UNKNOWN_COMMAND)
+					fputs ("The running xpad does not know this command.\n", out);
+			}
+			
+			for (; ok && part < len; n_parts++)
+			{
+				ok = client_frame (client, frames, XPAD_COMMAND_PART, "", rest, part, 0, error);
+				rest += part;
+				len -= part;
+				part = xpad_protocol_text_part (rest, len);
+			}
+			
+			ok = ok && client_send (client, frames, error);
+			for (; ok && n_parts > 0; n_parts--)
+			{
+				ok = client_answer (client, XPAD_COMMAND_PART, out, &status, error);
+				if (ok && status != XPAD_STATUS_OK)
+				{
+					g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+						"The running xpad cannot take text this long");
+					ok = FALSE;
+				}
+			}
+		}
+		
+		ok = ok && client_frame (client, frames, requests[i].command, target, rest, len, requests[i].max_lines, error);
+		g_free (target);
+		g_free (arg);
+	}
+	
+	ok = ok && client_send (client, frames, error);
+	g_byte_array_unref (frames);
+	
+	for (; ok && answered < n_requests; answered++)
+	{
+		ok = client_answer (client, requests[answered].command, out, &status, error);
+		if (ok && status == XPAD_STATUS_UNKNOWN_COMMAND)
+			fputs ("The running xpad does not know this command.\n", out);
+	}
+	
+	return ok;
+}
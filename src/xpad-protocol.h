@@ -0,0 +1,98 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_PROTOCOL_H__
+#define __XPAD_PROTOCOL_H__
+
+#include <stdio.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Never renumber, running instances of other versions may send these */
+typedef enum
+{
+	XPAD_COMMAND_NEW = 1,
+	XPAD_COMMAND_NEW_FROM_FILE,
+	XPAD_COMMAND_SHOW,
+	XPAD_COMMAND_HIDE,
+	XPAD_COMMAND_TOGGLE,
+	XPAD_COMMAND_QUIT,
+	XPAD_COMMAND_SESSION_ID,
+	XPAD_COMMAND_STATS,
+	XPAD_COMMAND_APPEND,
+	XPAD_COMMAND_PREPEND,
+	XPAD_COMMAND_REPLACE,
+	XPAD_COMMAND_FOLLOW,
+	XPAD_COMMAND_EXPORT,
+	XPAD_COMMAND_IMPORT,
+	XPAD_COMMAND_PART     /* handled by the protocol, see xpad-protocol.c */
+} XpadCommand;
+
+/* The longest message either side accepts */
+#define XPAD_PROTOCOL_MAX_MESSAGE (1 << 20)
+
+/* Longer text goes in several messages.  The bound leaves room for the
+   rest of a message and for invalid UTF-8 growing as it is replaced. */
+#define XPAD_PROTOCOL_MAX_TEXT (256 * 1024)
+
+typedef enum
+{
+	XPAD_STATUS_OK,
+	XPAD_STATUS_FAILED,
+	XPAD_STATUS_UNKNOWN_COMMAND,
+	XPAD_STATUS_MORE    /* part of a streamed answer, the rest follows */
+} XpadStatus;
+
+typedef struct
+{
+	XpadCommand command;
+	gchar *target;      /* the pad to edit, by ID, else info file name or title */
+	gchar *arg;
+	guint max_lines;    /* for edits, 0 for no limit */
+} XpadRequest;
+
+typedef struct XpadProtocolClient XpadProtocolClient;
+typedef struct XpadReply XpadReply;
+
+/**
+ * Runs one command on the server.  Text meant for the client goes to
+ * output.  Answers too big to build in one go are handed to
+ * xpad_reply_stream instead; reply is NULL when the command does not come
+ * from a client.
+ */
+typedef XpadStatus (*XpadCommandFunc) (const XpadRequest *request, GString *output, XpadReply *reply, gpointer user_data);
+
+/* Appends the next part of a streamed answer to output.  Returns FALSE
+   after the last part. */
+typedef gboolean (*XpadReplyFunc) (GString *output, gpointer user_data);
+
+void xpad_reply_stream (XpadReply *reply, XpadReplyFunc func, gpointer user_data, GDestroyNotify destroy);
+
+gsize    xpad_protocol_text_part (const gchar *text, gsize len);
+
+gboolean xpad_protocol_serve (const gchar *path, XpadCommandFunc func, gpointer user_data, GError **error);
+void     xpad_protocol_hold  (gboolean hold);
+
+XpadProtocolClient *xpad_protocol_client_new  (const gchar *path);
+gboolean            xpad_protocol_client_call (XpadProtocolClient *client, const XpadRequest *requests, guint n_requests,
+                                               FILE *out, GError **error);
+void                xpad_protocol_client_free (XpadProtocolClient *client);
+
+G_END_DECLS
+
+#endif /* __XPAD_PROTOCOL_H__ */
@@ -0,0 +1,400 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include "fio.h"
+#include "xpad-regex-search.h"
+
+/**
+ * Regex search over many texts at once.
+ *
+ * Every text (or content file) is one job on a shared thread pool.  Workers
+ * only touch their own job and the compiled GRegex, which is safe to share
+ * between threads.  Matches are batched and handed to the main context the
+ * search was started from, so callbacks always run on the UI thread.
+ */
+
+/* Matches collected before a batch is sent to the main context */
+#define BATCH_SIZE 32
+
+/* Stop reporting after this many matching lines in one text */
+#define MAX_MATCHES_PER_SOURCE 500
+
+/* Excerpts are cut down to this many characters */
+#define EXCERPT_CHARS 120
+
+/* Tags in content files are wrapped in this private use character (U+E000) */
+#define TAG_CHAR_UTF8 "\xee\x80\x80"
+
+struct XpadRegexSearch
+{
+	gint ref_count;
+	gint freed;
+	gint pending;
+
+	GRegex *regex;
+	GPtrArray *jobs;
+
+	GCancellable *cancellable;
+	GMainContext *context;
+	XpadRegexMatchFunc match_func;
+	XpadRegexDoneFunc done_func;
+	gpointer user_data;
+};
+
+typedef struct
+{
+	XpadRegexSearch *search;
+	gpointer source;
+	gchar *text;
+	gchar *filename;
+} SearchJob;
+
+typedef struct
+{
+	XpadRegexSearch *search;
+	GArray *matches;
+} SearchBatch;
+
+static GThreadPool *search_pool = NULL;
+
+static void search_worker (gpointer data, gpointer user_data);
+
+static XpadRegexSearch *
+search_ref (XpadRegexSearch *search)
+{
+	g_atomic_int_inc (&search->ref_count);
+	return search;
+}
+
+static void
+search_unref (XpadRegexSearch *search)
+{
+	if (!g_atomic_int_dec_and_test (&search->ref_count))
+		return;
+
+	g_regex_unref (search->regex);
+	if (search->jobs)
+		g_ptr_array_free (search->jobs, TRUE);
+	if (search->cancellable)
+		g_object_unref (search->cancellable);
+	if (search->context)
+		g_main_context_unref (search->context);
+	g_free (search);
+}
+
+static gboolean
+search_cancelled (XpadRegexSearch *search)
+{
+	return g_atomic_int_get (&search->freed) ||
+		(search->cancellable && g_cancellable_is_cancelled (search->cancellable));
+}
+
+static void
+job_free (SearchJob *job)
+{
+	g_free (job->text);
+	g_free (job->filename);
+	g_free (job);
+}
+
+XpadRegexSearch *
+xpad_regex_search_new (const gchar *pattern, gboolean case_sensitive, GError **error)
+{
+	XpadRegexSearch *search;
+	GRegex *regex;
+	GRegexCompileFlags flags = G_REGEX_OPTIMIZE | G_REGEX_MULTILINE;
+
+	if (!case_sensitive)
+		flags |= G_REGEX_CASELESS;
+
+	regex = g_regex_new (pattern, flags, 0, error);
+	if (!regex)
+		return NULL;
+
+	search = g_new0 (XpadRegexSearch, 1);
+	search->ref_count = 1;
+	search->regex = regex;
+	search->jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) job_free);
+
+	return search;
+}
+
+/**
+ * Stops delivering results and releases the search.  Workers that are
+ * still running notice on their next match and drop what they have.
+ */
+void
+xpad_regex_search_free (XpadRegexSearch *search)
+{
+	if (!search)
+		return;
+
+	g_atomic_int_set (&search->freed, TRUE);
+	search_unref (search);
+}
+
+/* Takes ownership of text */
+void
+xpad_regex_search_add_text (XpadRegexSearch *search, gpointer source, gchar *text)
+{
+	SearchJob *job;
+
+	g_return_if_fail (search->jobs);
+
+	job = g_new0 (SearchJob, 1);
+	job->source = source;
+	job->text = text;
+	g_ptr_array_add (search->jobs, job);
+}
+
+/* The file is read on the worker thread */
+void
+xpad_regex_search_add_file (XpadRegexSearch *search, gpointer source, const gchar *filename)
+{
+	SearchJob *job;
+
+	g_return_if_fail (search->jobs);
+
+	job = g_new0 (SearchJob, 1);
+	job->source = source;
+	job->filename = g_strdup (filename);
+	g_ptr_array_add (search->jobs, job);
+}
+
+static gboolean
+search_deliver_done (gpointer data)
+{
+	XpadRegexSearch *search = data;
+
+	if (!search_cancelled (search) && search->done_func)
+		search->done_func (search, search->user_data);
+
+	return FALSE;
+}
+
+static void
+search_job_finished (XpadRegexSearch *search)
+{
+	if (g_atomic_int_dec_and_test (&search->pending))
+		g_main_context_invoke_full (search->context, G_PRIORITY_DEFAULT,
+			search_deliver_done, search_ref (search), (GDestroyNotify) search_unref);
+}
+
+void
+xpad_regex_search_start (XpadRegexSearch *search, GCancellable *cancellable,
+                         XpadRegexMatchFunc match_func, XpadRegexDoneFunc done_func,
+                         gpointer user_data)
+{
+	GPtrArray *jobs;
+	guint i;
+
+	g_return_if_fail (search->jobs);
+
+	if (!search_pool)
+		search_pool = g_thread_pool_new (search_worker, NULL, g_get_num_processors (), FALSE, NULL);
+
+	search->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+	search->context = g_main_context_ref_thread_default ();
+	search->match_func = match_func;
+	search->done_func = done_func;
+	search->user_data = user_data;
+
+	jobs = search->jobs;
+	search->jobs = NULL;
+
+	/* One extra count so done can't fire before every job is queued */
+	g_atomic_int_set (&search->pending, jobs->len + 1);
+
+	for (i = 0; i < jobs->len; i++)
+	{
+		SearchJob *job = g_ptr_array_index (jobs, i);
+		job->search = search_ref (search);
+		g_thread_pool_push (search_pool, job, NULL);
+	}
+
+	/* jobs are owned by the pool now */
+	g_ptr_array_set_free_func (jobs, NULL);
+	g_ptr_array_free (jobs, TRUE);
+
+	search_job_finished (search);
+}
+
+static gboolean
+search_deliver_batch (gpointer data)
+{
+	SearchBatch *batch = data;
+	guint i;
+
+	if (search_cancelled (batch->search) || !batch->search->match_func)
+		return FALSE;
+
+	for (i = 0; i < batch->matches->len; i++)
+		batch->search->match_func (batch->search, &g_array_index (batch->matches, XpadRegexMatch, i), batch->search->user_data);
+
+	return FALSE;
+}
+
+static void
+search_batch_free (SearchBatch *batch)
+{
+	guint i;
+
+	for (i = 0; i < batch->matches->len; i++)
+		g_free (g_array_index (batch->matches, XpadRegexMatch, i).excerpt);
+
+	g_array_free (batch->matches, TRUE);
+	search_unref (batch->search);
+	g_free (batch);
+}
+
+static void
+search_flush (XpadRegexSearch *search, GArray **matches)
+{
+	SearchBatch *batch;
+
+	if (!*matches || (*matches)->len == 0)
+		return;
+
+	batch = g_new (SearchBatch, 1);
+	batch->search = search_ref (search);
+	batch->matches = *matches;
+	*matches = NULL;
+
+	g_main_context_invoke_full (search->context, G_PRIORITY_DEFAULT,
+		search_deliver_batch, batch, (GDestroyNotify) search_batch_free);
+}
+
+/* Drops the tag markup stored in content files, in place */
+static void
+strip_tags (gchar *text)
+{
+	gchar *read = text, *write = text, *tag, *close;
+
+	while ((tag = strstr (read, TAG_CHAR_UTF8)))
+	{
+		memmove (write, read, tag - read);
+		write += tag - read;
+
+		close = strstr (tag + strlen (TAG_CHAR_UTF8), TAG_CHAR_UTF8);
+		if (!close)
+		{
+			*write = '\0';
+			return;
+		}
+		read = close + strlen (TAG_CHAR_UTF8);
+	}
+
+	memmove (write, read, strlen (read) + 1);
+}
+
+static gchar *
+make_excerpt (const gchar *line, gsize len)
+{
+	gchar *excerpt = g_strndup (line, len);
+
+	if (g_utf8_strlen (excerpt, -1) > EXCERPT_CHARS)
+	{
+		gchar *cut = g_utf8_offset_to_pointer (excerpt, EXCERPT_CHARS);
+		*cut = '\0';
+	}
+
+	return excerpt;
+}
+
+static void
+search_worker (gpointer data, gpointer user_data)
+{
+	SearchJob *job = data;
+	XpadRegexSearch *search = job->search;
+	GArray *matches = NULL;
+	GMatchInfo *info = NULL;
+	gchar *text = job->text;
+	const gchar *line_start;
+	gsize len;
+	gint pos = 0, line = 0, found = 0;
+
+	if (search_cancelled (search))
+		goto out;
+
+	if (!text && job->filename)
+	{
+		if (!(text = fio_get_file (job->filename)))
+			goto out;
+		strip_tags (text);
+		job->text = text;
+	}
+
+	if (!text || !g_utf8_validate (text, -1, NULL))
+		goto out;
+
+	len = strlen (text);
+	line_start = text;
+
+	while (found < MAX_MATCHES_PER_SOURCE &&
+	       g_regex_match_full (search->regex, text, len, pos, 0, &info, NULL))
+	{
+		XpadRegexMatch match;
+		const gchar *p, *line_end;
+		gint start;
+
+		if (search_cancelled (search))
+			break;
+
+		g_match_info_fetch_pos (info, 0, &start, NULL);
+		g_match_info_free (info);
+		info = NULL;
+
+		/* Count lines incrementally from the previous match */
+		for (p = line_start; (p = memchr (p, '\n', text + start - p)); p++)
+		{
+			line++;
+			line_start = p + 1;
+		}
+
+		line_end = strchr (text + start, '\n');
+		if (!line_end)
+			line_end = text + len;
+
+		match.source = job->source;
+		match.line = line;
+		match.line_offset = g_utf8_pointer_to_offset (line_start, text + start);
+		match.excerpt = make_excerpt (line_start, line_end - line_start);
+
+		if (!matches)
+			matches = g_array_sized_new (FALSE, FALSE, sizeof (XpadRegexMatch), BATCH_SIZE);
+		g_array_append_val (matches, match);
+		found++;
+
+		if (matches->len >= BATCH_SIZE)
+			search_flush (search, &matches);
+
+		/* One result per line is enough, continue on the next one */
+		if (line_end >= text + len)
+			break;
+		pos = line_end - text + 1;
+	}
+
+	if (info)
+		g_match_info_free (info);
+
+	search_flush (search, &matches);
+
+out:
+	search_job_finished (search);
+	job_free (job);
+	search_unref (search);
+}
@@ -0,0 +1,50 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_REGEX_SEARCH_H__
+#define __XPAD_REGEX_SEARCH_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct XpadRegexSearch XpadRegexSearch;
+typedef struct XpadRegexMatch XpadRegexMatch;
+
+struct XpadRegexMatch
+{
+	gpointer source;
+	gint line;          /* 0-based line of the match */
+	gint line_offset;   /* character offset of the match inside that line */
+	gchar *excerpt;     /* the matching line, possibly shortened */
+};
+
+typedef void (*XpadRegexMatchFunc) (XpadRegexSearch *search, const XpadRegexMatch *match, gpointer user_data);
+typedef void (*XpadRegexDoneFunc)  (XpadRegexSearch *search, gpointer user_data);
+
+XpadRegexSearch *xpad_regex_search_new      (const gchar *pattern, gboolean case_sensitive, GError **error);
+void             xpad_regex_search_free     (XpadRegexSearch *search);
+
+void             xpad_regex_search_add_text (XpadRegexSearch *search, gpointer source, gchar *text);
+void             xpad_regex_search_add_file (XpadRegexSearch *search, gpointer source, const gchar *filename);
+
+void             xpad_regex_search_start    (XpadRegexSearch *search, GCancellable *cancellable,
+                                             XpadRegexMatchFunc match_func, XpadRegexDoneFunc done_func,
+                                             gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __XPAD_REGEX_SEARCH_H__ */
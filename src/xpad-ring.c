@@ -0,0 +1,97 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <string.h>
+#include "xpad-ring.h"
+
+void
+xpad_ring_init (XpadRing *ring, gsize capacity)
+{
+	ring->data = g_malloc (capacity);
+	ring->capacity = capacity;
+	ring->start = 0;
+	ring->len = 0;
+}
+
+void
+xpad_ring_clear (XpadRing *ring)
+{
+	g_free (ring->data);
+	ring->data = NULL;
+	ring->capacity = ring->start = ring->len = 0;
+}
+
+/* Returns TRUE if older bytes had to make room */
+gboolean
+xpad_ring_push (XpadRing *ring, const guint8 *data, gsize n)
+{
+	gboolean dropped = FALSE;
+	gsize end, first;
+	
+	if (n >= ring->capacity)
+	{
+		dropped = ring->len > 0 || n > ring->capacity;
+		memcpy (ring->data, data + n - ring->capacity, ring->capacity);
+		ring->start = 0;
+		ring->len = ring->capacity;
+		return dropped;
+	}
+	
+	if (ring->len + n > ring->capacity)
+	{
+		gsize drop = ring->len + n - ring->capacity;
+		
+		ring->start = (ring->start + drop) % ring->capacity;
+		ring->len -= drop;
+		dropped = TRUE;
+	}
+	
+	end = (ring->start + ring->len) % ring->capacity;
+	first = MIN (n, ring->capacity - end);
+	memcpy (ring->data + end, data, first);
+	memcpy (ring->data, data + first, n - first);
+	ring->len += n;
+	
+	return dropped;
+}
+
+/* Moves the first n bytes out of the ring into dest */
+void
+xpad_ring_take (XpadRing *ring, guint8 *dest, gsize n)
+{
+	gsize first = MIN (n, ring->capacity - ring->start);
+	
+	memcpy (dest, ring->data + ring->start, first);
+	memcpy (dest + first, ring->data, n - first);
+	ring->start = (ring->start + n) % ring->capacity;
+	ring->len -= n;
+}
+
+/* Bytes up to and including the last newline, or 0 if there is none */
+gsize
+xpad_ring_whole_lines (const XpadRing *ring)
+{
+	gsize i;
+	
+	for (i = ring->len; i > 0; i--)
+	{
+		if (ring->data[(ring->start + i - 1) % ring->capacity] == '\n')
+			return i;
+	}
+	
+	return 0;
+}
@@ -0,0 +1,42 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_RING_H__
+#define __XPAD_RING_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A fixed amount of bytes, the newest kept when more come than fit */
+typedef struct
+{
+	guint8 *data;
+	gsize capacity;
+	gsize start;
+	gsize len;
+} XpadRing;
+
+void     xpad_ring_init        (XpadRing *ring, gsize capacity);
+void     xpad_ring_clear       (XpadRing *ring);
+gboolean xpad_ring_push        (XpadRing *ring, const guint8 *data, gsize n);
+void     xpad_ring_take        (XpadRing *ring, guint8 *dest, gsize n);
+gsize    xpad_ring_whole_lines (const XpadRing *ring);
+
+G_END_DECLS
+
+#endif /* __XPAD_RING_H__ */
@@ -0,0 +1,290 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "../config.h"
+#include <glib/gi18n.h>
+#include "xpad-app.h"
+#include "xpad-pad.h"
+#include "xpad-pad-group.h"
+#include "xpad-regex-search.h"
+#include "xpad-search-window.h"
+
+G_DEFINE_TYPE(XpadSearchWindow, xpad_search_window, GTK_TYPE_WINDOW)
+#define XPAD_SEARCH_WINDOW_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), XPAD_TYPE_SEARCH_WINDOW, XpadSearchWindowPrivate))
+
+struct XpadSearchWindowPrivate
+{
+	GtkWidget *entry;
+	GtkWidget *match_case;
+	GtkWidget *list;
+	GtkWidget *status;
+
+	XpadRegexSearch *search;
+	GCancellable *cancellable;
+	GSList *pads;
+	GHashTable *matched_pads;
+	guint n_matches;
+};
+
+static void xpad_search_window_dispose (GObject *object);
+static void xpad_search_window_start (XpadSearchWindow *window);
+static void xpad_search_window_cancel (XpadSearchWindow *window);
+static void xpad_search_window_row_activated (GtkListBox *list, GtkListBoxRow *row, XpadSearchWindow *window);
+
+static GtkWidget *_xpad_search_window = NULL;
+
+void
+xpad_search_window_open (void)
+{
+	if (_xpad_search_window)
+	{
+		gtk_window_present (GTK_WINDOW (_xpad_search_window));
+	}
+	else
+	{
+		_xpad_search_window = GTK_WIDGET (g_object_new (XPAD_TYPE_SEARCH_WINDOW, NULL));
+		g_signal_connect_swapped (_xpad_search_window, "destroy", G_CALLBACK (g_nullify_pointer), &_xpad_search_window);
+		gtk_widget_set_visible (_xpad_search_window, TRUE);
+	}
+}
+
+static void
+xpad_search_window_class_init (XpadSearchWindowClass *klass)
+{
+	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+	gobject_class->dispose = xpad_search_window_dispose;
+
+	g_type_class_add_private (gobject_class, sizeof (XpadSearchWindowPrivate));
+}
+
+static void
+xpad_search_window_init (XpadSearchWindow *window)
+{
+	GtkWidget *vbox, *hbox, *scrolled;
+
+	window->priv = XPAD_SEARCH_WINDOW_GET_PRIVATE (window);
+
+	window->priv->search = NULL;
+	window->priv->cancellable = NULL;
+	window->priv->pads = NULL;
+	window->priv->matched_pads = g_hash_table_new (NULL, NULL);
+	window->priv->n_matches = 0;
+
+	gtk_window_set_title (GTK_WINDOW (window), _("Find in All Pads"));
+	gtk_window_set_default_size (GTK_WINDOW (window), 480, 360);
+
+	vbox = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
+	gtk_widget_set_margin_start (vbox, 12);
+	gtk_widget_set_margin_end (vbox, 12);
+	gtk_widget_set_margin_top (vbox, 12);
+	gtk_widget_set_margin_bottom (vbox, 12);
+
+	hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 6);
+	window->priv->entry = gtk_search_entry_new ();
+	gtk_widget_set_hexpand (window->priv->entry, TRUE);
+	gtk_widget_set_tooltip_text (window->priv->entry, _("Regular expression"));
+	window->priv->match_case = gtk_check_button_new_with_mnemonic (_("Match _case"));
+	gtk_box_append (GTK_BOX (hbox), window->priv->entry);
+	gtk_box_append (GTK_BOX (hbox), window->priv->match_case);
+	gtk_box_append (GTK_BOX (vbox), hbox);
+
+	window->priv->list = gtk_list_box_new ();
+	gtk_list_box_set_selection_mode (GTK_LIST_BOX (window->priv->list), GTK_SELECTION_BROWSE);
+	gtk_list_box_set_activate_on_single_click (GTK_LIST_BOX (window->priv->list), FALSE);
+	scrolled = gtk_scrolled_window_new ();
+	gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (scrolled), window->priv->list);
+	gtk_widget_set_vexpand (scrolled, TRUE);
+	gtk_box_append (GTK_BOX (vbox), scrolled);
+
+	window->priv->status = gtk_label_new (NULL);
+	gtk_widget_set_halign (window->priv->status, GTK_ALIGN_START);
+	gtk_box_append (GTK_BOX (vbox), window->priv->status);
+
+	gtk_window_set_child (GTK_WINDOW (window), vbox);
+
+	g_signal_connect_swapped (window->priv->entry, "search-changed", G_CALLBACK (xpad_search_window_start), window);
+	g_signal_connect_swapped (window->priv->entry, "stop-search", G_CALLBACK (gtk_window_close), window);
+	g_signal_connect_swapped (window->priv->match_case, "toggled", G_CALLBACK (xpad_search_window_start), window);
+	g_signal_connect (window->priv->list, "row-activated", G_CALLBACK (xpad_search_window_row_activated), window);
+}
+
+static void
+xpad_search_window_dispose (GObject *object)
+{
+	XpadSearchWindow *window = XPAD_SEARCH_WINDOW (object);
+
+	xpad_search_window_cancel (window);
+
+	if (window->priv->matched_pads)
+	{
+		g_hash_table_destroy (window->priv->matched_pads);
+		window->priv->matched_pads = NULL;
+	}
+
+	G_OBJECT_CLASS (xpad_search_window_parent_class)->dispose (object);
+}
+
+/* Drops the running search and the pad references it holds */
+static void
+xpad_search_window_cancel (XpadSearchWindow *window)
+{
+	if (window->priv->cancellable)
+	{
+		g_cancellable_cancel (window->priv->cancellable);
+		g_object_unref (window->priv->cancellable);
+		window->priv->cancellable = NULL;
+	}
+
+	if (window->priv->search)
+	{
+		xpad_regex_search_free (window->priv->search);
+		window->priv->search = NULL;
+	}
+
+	g_slist_free_full (window->priv->pads, g_object_unref);
+	window->priv->pads = NULL;
+}
+
+static void
+xpad_search_window_set_status (XpadSearchWindow *window, gboolean done)
+{
+	guint n_pads = g_hash_table_size (window->priv->matched_pads);
+	gchar *pads, *text;
+
+	if (!done && window->priv->n_matches == 0)
+	{
+		gtk_label_set_text (GTK_LABEL (window->priv->status), _("Searching..."));
+		return;
+	}
+
+	pads = g_strdup_printf (ngettext ("%u pad", "%u pads", n_pads), n_pads);
+	text = g_strdup_printf (ngettext ("%u matching line in %s", "%u matching lines in %s", window->priv->n_matches),
+		window->priv->n_matches, pads);
+	gtk_label_set_text (GTK_LABEL (window->priv->status), text);
+	g_free (text);
+	g_free (pads);
+}
+
+static void
+xpad_search_window_match (XpadRegexSearch *search, const XpadRegexMatch *match, XpadSearchWindow *window)
+{
+	GtkWidget *row, *label;
+	const gchar *title;
+	gchar *markup;
+	guint64 *id;
+
+	title = gtk_window_get_title (GTK_WINDOW (match->source));
+	markup = g_markup_printf_escaped ("<b>%s</b>:%d: %s", title ? title : "", match->line + 1, match->excerpt);
+
+	label = gtk_label_new (NULL);
+	gtk_label_set_markup (GTK_LABEL (label), markup);
+	gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+	gtk_widget_set_halign (label, GTK_ALIGN_START);
+	g_free (markup);
+
+	row = gtk_list_box_row_new ();
+	gtk_list_box_row_set_child (GTK_LIST_BOX_ROW (row), label);
+	/* Rows name their pad by ID, so a pad closed meanwhile is just gone */
+	id = g_new (guint64, 1);
+	*id = xpad_pad_get_id (XPAD_PAD (match->source));
+	g_object_set_data_full (G_OBJECT (row), "pad-id", id, g_free);
+	g_object_set_data (G_OBJECT (row), "line", GINT_TO_POINTER (match->line));
+	g_object_set_data (G_OBJECT (row), "line-offset", GINT_TO_POINTER (match->line_offset));
+	gtk_list_box_append (GTK_LIST_BOX (window->priv->list), row);
+
+	g_hash_table_add (window->priv->matched_pads, match->source);
+	window->priv->n_matches++;
+	xpad_search_window_set_status (window, FALSE);
+}
+
+static void
+xpad_search_window_done (XpadRegexSearch *search, XpadSearchWindow *window)
+{
+	xpad_search_window_set_status (window, TRUE);
+}
+
+static void
+xpad_search_window_start (XpadSearchWindow *window)
+{
+	GtkWidget *child;
+	GSList *l;
+	GError *error = NULL;
+	const gchar *pattern;
+
+	xpad_search_window_cancel (window);
+
+	while ((child = gtk_widget_get_first_child (window->priv->list)))
+		gtk_list_box_remove (GTK_LIST_BOX (window->priv->list), child);
+	g_hash_table_remove_all (window->priv->matched_pads);
+	window->priv->n_matches = 0;
+
+	pattern = gtk_editable_get_text (GTK_EDITABLE (window->priv->entry));
+	if (!pattern || !*pattern)
+	{
+		gtk_label_set_text (GTK_LABEL (window->priv->status), "");
+		return;
+	}
+
+	window->priv->search = xpad_regex_search_new (pattern,
+		gtk_check_button_get_active (GTK_CHECK_BUTTON (window->priv->match_case)), &error);
+	if (!window->priv->search)
+	{
+		gtk_label_set_text (GTK_LABEL (window->priv->status), error->message);
+		g_error_free (error);
+		return;
+	}
+
+	window->priv->pads = xpad_pad_group_get_pads (xpad_app_get_pad_group ());
+	for (l = window->priv->pads; l; l = l->next)
+	{
+		XpadPad *pad = XPAD_PAD (g_object_ref (l->data));
+		const gchar *filename = xpad_pad_get_content_filename (pad);
+
+		/* Pads that were never shown are matched straight from their
+		   content file, so their buffers are not copied here */
+		if (!gtk_widget_get_realized (GTK_WIDGET (pad)) && filename)
+		{
+			gchar *path = g_build_filename (xpad_app_get_config_dir (), filename, NULL);
+			xpad_regex_search_add_file (window->priv->search, pad, path);
+			g_free (path);
+		}
+		else
+			xpad_regex_search_add_text (window->priv->search, pad, xpad_pad_get_text (pad));
+	}
+
+	xpad_search_window_set_status (window, FALSE);
+
+	window->priv->cancellable = g_cancellable_new ();
+	xpad_regex_search_start (window->priv->search, window->priv->cancellable,
+		(XpadRegexMatchFunc) xpad_search_window_match,
+		(XpadRegexDoneFunc) xpad_search_window_done,
+		window);
+}
+
+static void
+xpad_search_window_row_activated (GtkListBox *list, GtkListBoxRow *row, XpadSearchWindow *window)
+{
+	guint64 *id = g_object_get_data (G_OBJECT (row), "pad-id");
+	GtkWidget *pad = xpad_pad_group_lookup (xpad_app_get_pad_group (), *id);
+
+	if (!pad)
+		return;
+
+	xpad_pad_show_line (XPAD_PAD (pad),
+		GPOINTER_TO_INT (g_object_get_data (G_OBJECT (row), "line")),
+		GPOINTER_TO_INT (g_object_get_data (G_OBJECT (row), "line-offset")));
+}
@@ -0,0 +1,53 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_SEARCH_WINDOW_H__
+#define __XPAD_SEARCH_WINDOW_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define XPAD_TYPE_SEARCH_WINDOW          (xpad_search_window_get_type ())
+#define XPAD_SEARCH_WINDOW(o)            (G_TYPE_CHECK_INSTANCE_CAST ((o), XPAD_TYPE_SEARCH_WINDOW, XpadSearchWindow))
+#define XPAD_SEARCH_WINDOW_CLASS(k)      (G_TYPE_CHECK_CLASS_CAST((k), XPAD_TYPE_SEARCH_WINDOW, XpadSearchWindowClass))
+#define XPAD_IS_SEARCH_WINDOW(o)         (G_TYPE_CHECK_INSTANCE_TYPE ((o), XPAD_TYPE_SEARCH_WINDOW))
+#define XPAD_IS_SEARCH_WINDOW_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), XPAD_TYPE_SEARCH_WINDOW))
+#define XPAD_SEARCH_WINDOW_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), XPAD_TYPE_SEARCH_WINDOW, XpadSearchWindowClass))
+
+typedef struct XpadSearchWindowClass XpadSearchWindowClass;
+typedef struct XpadSearchWindowPrivate XpadSearchWindowPrivate;
+typedef struct XpadSearchWindow XpadSearchWindow;
+
+struct XpadSearchWindow
+{
+	/* private */
+	GtkWindow parent;
+	XpadSearchWindowPrivate *priv;
+};
+
+struct XpadSearchWindowClass
+{
+	GtkWindowClass parent_class;
+};
+
+GType xpad_search_window_get_type (void);
+
+void xpad_search_window_open (void);
+
+G_END_DECLS
+
+#endif /* __XPAD_SEARCH_WINDOW_H__ */
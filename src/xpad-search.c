@@ -0,0 +1,199 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include "xpad-search.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define XPAD_SEARCH_HAVE_SSE2 1
+#endif
+
+/**
+ * Substring matcher used by the find bar.
+ *
+ * Case-insensitive matching only folds ASCII letters.  Both the needle and
+ * the haystack are UTF-8, so a match can never start in the middle of a
+ * multibyte character and byte offsets map cleanly back to characters.
+ */
+struct XpadSearchPattern
+{
+	gchar *needle;
+	gsize len;
+	glong n_chars;
+	gboolean case_sensitive;
+
+	/* first and last byte of the needle in both cases, for the prefilter */
+	guchar first_lo, first_hi;
+	guchar last_lo, last_hi;
+};
+
+XpadSearchPattern *
+xpad_search_pattern_new (const gchar *needle, gboolean case_sensitive)
+{
+	XpadSearchPattern *pattern;
+
+	g_return_val_if_fail (needle && *needle, NULL);
+
+	pattern = g_new0 (XpadSearchPattern, 1);
+	pattern->needle = g_strdup (needle);
+	pattern->len = strlen (needle);
+	pattern->n_chars = g_utf8_strlen (needle, -1);
+	pattern->case_sensitive = case_sensitive;
+
+	if (case_sensitive)
+	{
+		pattern->first_lo = pattern->first_hi = (guchar) needle[0];
+		pattern->last_lo = pattern->last_hi = (guchar) needle[pattern->len - 1];
+	}
+	else
+	{
+		pattern->first_lo = (guchar) g_ascii_tolower (needle[0]);
+		pattern->first_hi = (guchar) g_ascii_toupper (needle[0]);
+		pattern->last_lo = (guchar) g_ascii_tolower (needle[pattern->len - 1]);
+		pattern->last_hi = (guchar) g_ascii_toupper (needle[pattern->len - 1]);
+	}
+
+	return pattern;
+}
+
+void
+xpad_search_pattern_free (XpadSearchPattern *pattern)
+{
+	if (!pattern)
+		return;
+
+	g_free (pattern->needle);
+	g_free (pattern);
+}
+
+gsize
+xpad_search_pattern_get_length (const XpadSearchPattern *pattern)
+{
+	return pattern->len;
+}
+
+glong
+xpad_search_pattern_get_chars (const XpadSearchPattern *pattern)
+{
+	return pattern->n_chars;
+}
+
+static inline gboolean
+match_at (const XpadSearchPattern *pattern, const gchar *p)
+{
+	gsize i;
+
+	if (pattern->case_sensitive)
+		return memcmp (p, pattern->needle, pattern->len) == 0;
+
+	/* g_ascii_strncasecmp would stop early on an embedded NUL */
+	for (i = 0; i < pattern->len; i++)
+		if (g_ascii_tolower (p[i]) != g_ascii_tolower (pattern->needle[i]))
+			return FALSE;
+
+	return TRUE;
+}
+
+static const gchar *
+find_scalar (const XpadSearchPattern *pattern, const gchar *haystack, gsize len)
+{
+	const gchar *p, *end;
+
+	if (len < pattern->len)
+		return NULL;
+
+	end = haystack + len - pattern->len + 1;
+
+	if (pattern->case_sensitive)
+	{
+		/* memchr is already vectorized by the C library */
+		for (p = haystack; p < end; p++)
+		{
+			p = memchr (p, pattern->first_lo, end - p);
+			if (!p)
+				return NULL;
+			if (match_at (pattern, p))
+				return p;
+		}
+		return NULL;
+	}
+
+	for (p = haystack; p < end; p++)
+	{
+		guchar c = (guchar) *p;
+		if ((c == pattern->first_lo || c == pattern->first_hi) && match_at (pattern, p))
+			return p;
+	}
+
+	return NULL;
+}
+
+#ifdef XPAD_SEARCH_HAVE_SSE2
+/* Compares the first and the last byte of the needle against 16 candidate
+   positions at once and only verifies positions where both agree. */
+static const gchar *
+find_sse2 (const XpadSearchPattern *pattern, const gchar *haystack, gsize len)
+{
+	const __m128i first_lo = _mm_set1_epi8 ((gchar) pattern->first_lo);
+	const __m128i first_hi = _mm_set1_epi8 ((gchar) pattern->first_hi);
+	const __m128i last_lo = _mm_set1_epi8 ((gchar) pattern->last_lo);
+	const __m128i last_hi = _mm_set1_epi8 ((gchar) pattern->last_hi);
+	const gsize last = pattern->len - 1;
+	gsize i;
+
+	for (i = 0; i + last + 16 <= len; i += 16)
+	{
+		__m128i head = _mm_loadu_si128 ((const __m128i *) (haystack + i));
+		__m128i tail = _mm_loadu_si128 ((const __m128i *) (haystack + i + last));
+		__m128i match_head = _mm_or_si128 (_mm_cmpeq_epi8 (head, first_lo), _mm_cmpeq_epi8 (head, first_hi));
+		__m128i match_tail = _mm_or_si128 (_mm_cmpeq_epi8 (tail, last_lo), _mm_cmpeq_epi8 (tail, last_hi));
+		gulong mask = (gulong) _mm_movemask_epi8 (_mm_and_si128 (match_head, match_tail));
+
+		while (mask)
+		{
+			gint bit = g_bit_nth_lsf (mask, -1);
+
+			if (match_at (pattern, haystack + i + bit))
+				return haystack + i + bit;
+
+			mask &= mask - 1;
+		}
+	}
+
+	/* Not enough bytes left for a full vector */
+	return find_scalar (pattern, haystack + i, len - i);
+}
+#endif
+
+/**
+ * Returns a pointer to the first occurrence of pattern inside the len bytes
+ * at haystack, or NULL.
+ */
+const gchar *
+xpad_search_find (const XpadSearchPattern *pattern, const gchar *haystack, gsize len)
+{
+	g_return_val_if_fail (pattern, NULL);
+
+	if (!haystack || len < pattern->len)
+		return NULL;
+
+#ifdef XPAD_SEARCH_HAVE_SSE2
+	return find_sse2 (pattern, haystack, len);
+#else
+	return find_scalar (pattern, haystack, len);
+#endif
+}
@@ -0,0 +1,35 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_SEARCH_H__
+#define __XPAD_SEARCH_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct XpadSearchPattern XpadSearchPattern;
+
+XpadSearchPattern *xpad_search_pattern_new        (const gchar *needle, gboolean case_sensitive);
+void               xpad_search_pattern_free       (XpadSearchPattern *pattern);
+gsize              xpad_search_pattern_get_length (const XpadSearchPattern *pattern);
+glong              xpad_search_pattern_get_chars  (const XpadSearchPattern *pattern);
+
+const gchar       *xpad_search_find               (const XpadSearchPattern *pattern, const gchar *haystack, gsize len);
+
+G_END_DECLS
+
+#endif /* __XPAD_SEARCH_H__ */
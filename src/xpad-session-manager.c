@@ -366,7 +366,7 @@ xpad_session_manager_die (SmcConn smc_conn, SmPointer client_data)
 	xpad_saving = FALSE;
 	xpad_interact_style = SmInteractStyleAny;
 	
-	gtk_main_quit ();
+	xpad_app_quit ();
 }
 
 static void
@@ -18,8 +18,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 */
 
+#include <stdlib.h>
 #include <string.h>
 #include "xpad-settings.h"
+#include "xpad-metrics.h"
+#include "xpad-timer.h"
+#include "xpad-trace.h"
 #include "fio.h"
 
 G_DEFINE_TYPE(XpadSettings, xpad_settings, G_TYPE_OBJECT)
@@ -27,6 +31,9 @@ G_DEFINE_TYPE(XpadSettings, xpad_settings, G_TYPE_OBJECT)
 
 #define DEFAULTS_FILENAME	"default-style"
 
+/* Changes made within this many milliseconds of each other share one write */
+#define SAVE_DELAY 500
+
 struct XpadSettingsPrivate 
 {
 	guint width;
@@ -42,6 +49,11 @@ struct XpadSettingsPrivate
 	GdkRGBA *text;
 	gchar *fontname;
 	GSList *toolbar_buttons;
+	
+	XpadTimer save_timer;
+	gboolean dirty;
+	gboolean reloading;
+	guint transaction_depth;
 };
 
 enum
@@ -68,14 +80,77 @@ enum
   LAST_PROP
 };
 
-static void load_from_file (XpadSettings *settings, const gchar *filename);
+typedef enum
+{
+	SETTING_BOOLEAN,
+	SETTING_UINT,
+	SETTING_STRING,
+	SETTING_COLOR
+} SettingType;
+
+/**
+ * One row per setting, indexed by property id.  The property, its default,
+ * and its line in the settings file all come from here.
+ *
+ * Strings are stored as "NULL" when unset.  Colors are written the way
+ * older versions wrote GdkColors: key_red, key_green and key_blue as 16 bit
+ * channels plus use_key, so existing files keep loading.
+ */
+typedef struct
+{
+	const gchar *name;
+	const gchar *nick;
+	const gchar *blurb;
+	const gchar *key;
+	SettingType type;
+	glong offset;
+	guint default_value;           /* booleans and uints */
+	const gchar *default_string;   /* strings, and colors in gdk_rgba_parse syntax */
+} SettingSchema;
+
+#define SETTING_OFFSET(field) G_STRUCT_OFFSET (XpadSettingsPrivate, field)
+
+static const SettingSchema settings_schema[LAST_PROP] =
+{
+	[PROP_WIDTH] = { "width", "Default Width of Pads", "Window width of pads on creation",
+		"width", SETTING_UINT, SETTING_OFFSET (width), 200, NULL },
+	[PROP_HEIGHT] = { "height", "Default Height of Pads", "Window height of pads on creation",
+		"height", SETTING_UINT, SETTING_OFFSET (height), 200, NULL },
+	[PROP_HAS_DECORATIONS] = { "has-decorations", "Has Decorations", "Whether pads have window decorations",
+		"decorations", SETTING_BOOLEAN, SETTING_OFFSET (has_decorations), TRUE, NULL },
+	[PROP_CONFIRM_DESTROY] = { "confirm-destroy", "Confirm Destroy", "Whether destroying a pad requires user confirmation",
+		"confirm_destroy", SETTING_BOOLEAN, SETTING_OFFSET (confirm_destroy), TRUE, NULL },
+	[PROP_STICKY] = { "sticky", "Default Stickiness", "Whether pads are sticky on creation",
+		"sticky_on_start", SETTING_BOOLEAN, SETTING_OFFSET (sticky), FALSE, NULL },
+	[PROP_EDIT_LOCK] = { "edit-lock", "Edit Lock", "Whether edit lock mode is enabled",
+		"edit_lock", SETTING_BOOLEAN, SETTING_OFFSET (edit_lock), FALSE, NULL },
+	[PROP_HAS_TOOLBAR] = { "has-toolbar", "Has Toolbar", "Whether pads have toolbars",
+		"toolbar", SETTING_BOOLEAN, SETTING_OFFSET (has_toolbar), TRUE, NULL },
+	[PROP_AUTOHIDE_TOOLBAR] = { "autohide-toolbar", "Autohide Toolbar", "Whether toolbars hide when not used",
+		"auto_hide_toolbar", SETTING_BOOLEAN, SETTING_OFFSET (autohide_toolbar), TRUE, NULL },
+	[PROP_HAS_SCROLLBAR] = { "has-scrollbar", "Has Scrollbar", "Whether pads have scrollbars",
+		"scrollbar", SETTING_BOOLEAN, SETTING_OFFSET (has_scrollbar), TRUE, NULL },
+	/* A pleasant light yellow color, similar to commercial sticky notes */
+	[PROP_BACK_COLOR] = { "back-color", "Back Color", "Default color of pad background",
+		"back", SETTING_COLOR, SETTING_OFFSET (back), 0, "#ffee99" },
+	[PROP_TEXT_COLOR] = { "text-color", "Text Color", "Default color of pad text",
+		"text", SETTING_COLOR, SETTING_OFFSET (text), 0, "#000000" },
+	[PROP_FONTNAME] = { "fontname", "Font Name", "Default name of pad font",
+		"fontname", SETTING_STRING, SETTING_OFFSET (fontname), 0, NULL }
+};
+
+#define SETTING_FIELD(priv, schema) G_STRUCT_MEMBER_P ((priv), (schema)->offset)
+
+static void load_from_file (XpadSettingsPrivate *priv, const gchar *filename);
 static void save_to_file (XpadSettings *settings, const gchar *filename);
+static void xpad_settings_save (XpadSettings *settings);
 static void xpad_settings_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void xpad_settings_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
 static void xpad_settings_finalize (GObject *object);
 
 static XpadSettings *_xpad_settings = NULL;
 static guint signals[LAST_SIGNAL] = { 0 };
+static GParamSpec *pspecs[LAST_PROP] = { NULL };
 
 XpadSettings *
 xpad_settings (void)
@@ -91,6 +166,8 @@ static void
 xpad_settings_class_init (XpadSettingsClass *klass)
 {
 	GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+	GParamFlags flags = G_PARAM_READWRITE | G_PARAM_EXPLICIT_NOTIFY | G_PARAM_STATIC_STRINGS;
+	guint i;
 	
 	gobject_class->finalize = xpad_settings_finalize;
 	gobject_class->set_property = xpad_settings_set_property;
@@ -98,105 +175,32 @@ xpad_settings_class_init (XpadSettingsClass *klass)
 	
 	/* Properties */
 	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_WIDTH,
-	                                 g_param_spec_uint ("width",
-	                                                    "Default Width of Pads",
-	                                                    "Window width of pads on creation",
-	                                                    0,
-	                                                    G_MAXUINT,
-	                                                    200,
-	                                                    G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_HEIGHT,
-	                                 g_param_spec_uint ("height",
-	                                                    "Default Height of Pads",
-	                                                    "Window height of pads on creation",
-	                                                    0,
-	                                                    G_MAXUINT,
-	                                                    200,
-	                                                    G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_HAS_DECORATIONS,
-	                                 g_param_spec_boolean ("has_decorations",
-	                                                       "Has Decorations",
-	                                                       "Whether pads have window decorations",
-	                                                       TRUE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_CONFIRM_DESTROY,
-	                                 g_param_spec_boolean ("confirm_destroy",
-	                                                       "Confirm Destroy",
-	                                                       "Whether destroying a pad requires user confirmation",
-	                                                       TRUE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_STICKY,
-	                                 g_param_spec_boolean ("sticky",
-	                                                       "Default Stickiness",
-	                                                       "Whether pads are sticky on creation",
-	                                                       FALSE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_EDIT_LOCK,
-	                                 g_param_spec_boolean ("edit_lock",
-	                                                       "Edit Lock",
-	                                                       "Whether edit lock mode is enabled",
-	                                                       FALSE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_HAS_TOOLBAR,
-	                                 g_param_spec_boolean ("has_toolbar",
-	                                                       "Has Toolbar",
-	                                                       "Whether pads have toolbars",
-	                                                       TRUE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_AUTOHIDE_TOOLBAR,
-	                                 g_param_spec_boolean ("autohide_toolbar",
-	                                                       "Autohide Toolbar",
-	                                                       "Whether toolbars hide when not used",
-	                                                       TRUE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_HAS_SCROLLBAR,
-	                                 g_param_spec_boolean ("has_scrollbar",
-	                                                       "Has Scrollbar",
-	                                                       "Whether pads have scrollbars",
-	                                                       FALSE,
-	                                                       G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_FONTNAME,
-	                                 g_param_spec_string ("fontname",
-	                                                      "Font Name",
-	                                                      "Default name of pad font",
-	                                                      NULL,
-	                                                      G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_TEXT_COLOR,
-	                                 g_param_spec_boxed ("text_color",
-	                                                     "Text Color",
-	                                                     "Default color of pad text",
-	                                                     GDK_TYPE_RGBA,
-	                                                     G_PARAM_READWRITE));
-	
-	g_object_class_install_property (gobject_class,
-	                                 PROP_BACK_COLOR,
-	                                 g_param_spec_boxed ("back_color",
-	                                                     "Back Color",
-	                                                     "Default color of pad background",
-	                                                     GDK_TYPE_RGBA,
-	                                                     G_PARAM_READWRITE));
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
+	{
+		const SettingSchema *schema = &settings_schema[i];
+		
+		switch (schema->type)
+		{
+		case SETTING_BOOLEAN:
+			pspecs[i] = g_param_spec_boolean (schema->name, schema->nick, schema->blurb,
+			                                  schema->default_value, flags);
+			break;
+		case SETTING_UINT:
+			pspecs[i] = g_param_spec_uint (schema->name, schema->nick, schema->blurb,
+			                               0, G_MAXUINT, schema->default_value, flags);
+			break;
+		case SETTING_STRING:
+			pspecs[i] = g_param_spec_string (schema->name, schema->nick, schema->blurb,
+			                                 schema->default_string, flags);
+			break;
+		case SETTING_COLOR:
+			pspecs[i] = g_param_spec_boxed (schema->name, schema->nick, schema->blurb,
+			                                GDK_TYPE_RGBA, flags);
+			break;
+		}
+	}
+	
+	g_object_class_install_properties (gobject_class, LAST_PROP, pspecs);
 	
 	/* Signals */
 	
@@ -214,42 +218,103 @@ xpad_settings_class_init (XpadSettingsClass *klass)
 static void
 xpad_settings_init (XpadSettings *settings)
 {
-	GdkRGBA back, text;
+	guint i;
 	
 	settings->priv = XPAD_SETTINGS_GET_PRIVATE (settings);
 	
-	/* A pleasant light yellow color, similar to 
-	   commercial sticky notes. */
-	back.red = 1.0;
-	back.green = 0.9333;
-	back.blue = 0.6;
-	back.alpha = 1.0;
-	settings->priv->back = gdk_rgba_copy (&back);
-	
-	/* Black */
-	text.red = 0.0;
-	text.green = 0.0;
-	text.blue = 0.0;
-	text.alpha = 1.0;
-	settings->priv->text = gdk_rgba_copy (&text);
-	
-	settings->priv->width = 200;
-	settings->priv->height = 200;
-	settings->priv->has_decorations = TRUE;
-	settings->priv->confirm_destroy = TRUE;
-	settings->priv->sticky = FALSE;
-	settings->priv->edit_lock = FALSE;
-	settings->priv->fontname = NULL;
-	settings->priv->has_toolbar = TRUE;
-	settings->priv->autohide_toolbar = TRUE;
-	settings->priv->has_scrollbar = TRUE;
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
+	{
+		const SettingSchema *schema = &settings_schema[i];
+		gpointer field = SETTING_FIELD (settings->priv, schema);
+		GdkRGBA color;
+		
+		switch (schema->type)
+		{
+		case SETTING_BOOLEAN:
+			*(gboolean *) field = schema->default_value ? TRUE : FALSE;
+			break;
+		case SETTING_UINT:
+			*(guint *) field = schema->default_value;
+			break;
+		case SETTING_STRING:
+			*(gchar **) field = g_strdup (schema->default_string);
+			break;
+		case SETTING_COLOR:
+			if (schema->default_string && gdk_rgba_parse (&color, schema->default_string))
+				*(GdkRGBA **) field = gdk_rgba_copy (&color);
+			else
+				*(GdkRGBA **) field = NULL;
+			break;
+		}
+	}
 	
 	settings->priv->toolbar_buttons = NULL;
 	settings->priv->toolbar_buttons = g_slist_append (settings->priv->toolbar_buttons, g_strdup ("New"));
 	settings->priv->toolbar_buttons = g_slist_append (settings->priv->toolbar_buttons, g_strdup ("Delete"));
 	settings->priv->toolbar_buttons = g_slist_append (settings->priv->toolbar_buttons, g_strdup ("Close"));
 	
-	load_from_file (settings, DEFAULTS_FILENAME);
+	xpad_timer_init (&settings->priv->save_timer, (XpadTimerFunc) xpad_settings_save, settings);
+	settings->priv->dirty = FALSE;
+	settings->priv->reloading = FALSE;
+	settings->priv->transaction_depth = 0;
+	
+	load_from_file (settings->priv, DEFAULTS_FILENAME);
+}
+
+/* Frees the schema values and toolbar buttons held in priv */
+static void
+values_clear (XpadSettingsPrivate *priv)
+{
+	guint i;
+	
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
+	{
+		gpointer field = SETTING_FIELD (priv, &settings_schema[i]);
+		
+		if (settings_schema[i].type == SETTING_STRING)
+			g_free (*(gchar **) field);
+		else if (settings_schema[i].type == SETTING_COLOR && *(GdkRGBA **) field)
+			gdk_rgba_free (*(GdkRGBA **) field);
+	}
+	
+	g_slist_free_full (priv->toolbar_buttons, g_free);
+	priv->toolbar_buttons = NULL;
+}
+
+/* Deep copy of the schema values and toolbar buttons from src */
+static void
+values_copy (XpadSettingsPrivate *dest, const XpadSettingsPrivate *src)
+{
+	const GSList *l;
+	guint i;
+	
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
+	{
+		const SettingSchema *schema = &settings_schema[i];
+		gpointer to = SETTING_FIELD (dest, schema);
+		gconstpointer from = SETTING_FIELD ((XpadSettingsPrivate *) src, schema);
+		
+		switch (schema->type)
+		{
+		case SETTING_BOOLEAN:
+			*(gboolean *) to = *(const gboolean *) from;
+			break;
+		case SETTING_UINT:
+			*(guint *) to = *(const guint *) from;
+			break;
+		case SETTING_STRING:
+			*(gchar **) to = g_strdup (*(gchar * const *) from);
+			break;
+		case SETTING_COLOR:
+			*(GdkRGBA **) to = *(GdkRGBA * const *) from ? gdk_rgba_copy (*(GdkRGBA * const *) from) : NULL;
+			break;
+		}
+	}
+	
+	dest->toolbar_buttons = NULL;
+	for (l = src->toolbar_buttons; l; l = l->next)
+		dest->toolbar_buttons = g_slist_prepend (dest->toolbar_buttons, g_strdup (l->data));
+	dest->toolbar_buttons = g_slist_reverse (dest->toolbar_buttons);
 }
 
 static void
@@ -257,58 +322,217 @@ xpad_settings_finalize (GObject *object)
 {
 	XpadSettings *settings = XPAD_SETTINGS (object);
 	
-	g_slist_free (settings->priv->toolbar_buttons);
-	gdk_rgba_free (settings->priv->text);
-	gdk_rgba_free (settings->priv->back);
-	g_free (settings->priv->fontname);
+	xpad_settings_flush (settings);
+	values_clear (settings->priv);
 	
 	G_OBJECT_CLASS (xpad_settings_parent_class)->finalize (object);
 }
 
-void xpad_settings_set_width (XpadSettings *settings, guint width)
+static void
+xpad_settings_save (XpadSettings *settings)
 {
-	if (settings->priv->width == width)
-		return;
+	save_to_file (settings, DEFAULTS_FILENAME);
+}
+
+/* Marks the settings dirty; the file is written once things settle down */
+static void
+xpad_settings_queue_save (XpadSettings *settings)
+{
+	if (settings->priv->dirty)
+		xpad_metrics_add (XPAD_METRIC_SAVES_ELIDED, 1);
+	settings->priv->dirty = TRUE;
 	
-	settings->priv->width = width;
+	if (settings->priv->transaction_depth == 0)
+		xpad_timer_schedule (&settings->priv->save_timer, SAVE_DELAY);
+}
+
+/**
+ * Groups several changes into one.  Notifications are held back and the
+ * file is not written until the matching xpad_settings_commit.
+ * Transactions nest.
+ */
+void
+xpad_settings_begin (XpadSettings *settings)
+{
+	if (settings->priv->transaction_depth++ == 0)
+		xpad_timer_cancel (&settings->priv->save_timer);
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
+	g_object_freeze_notify (G_OBJECT (settings));
+}
+
+void
+xpad_settings_commit (XpadSettings *settings)
+{
+	g_return_if_fail (settings->priv->transaction_depth > 0);
+	
+	if (--settings->priv->transaction_depth == 0 && settings->priv->dirty)
+		xpad_timer_schedule (&settings->priv->save_timer, SAVE_DELAY);
 	
-	g_object_notify (G_OBJECT (settings), "width");
+	g_object_thaw_notify (G_OBJECT (settings));
 }
 
-guint xpad_settings_get_width (XpadSettings *settings)
+/* Writes out a save that is still waiting on its timer */
+void
+xpad_settings_flush (XpadSettings *settings)
 {
-	return settings->priv->width;
+	if (settings->priv->dirty)
+		save_to_file (settings, DEFAULTS_FILENAME);
 }
 
-void xpad_settings_set_height (XpadSettings *settings, guint height)
+static void
+setting_changed (XpadSettings *settings, guint prop_id)
+{
+	/* Values read back from the file are already on disk */
+	if (!settings->priv->reloading)
+		xpad_settings_queue_save (settings);
+	g_object_notify_by_pspec (G_OBJECT (settings), pspecs[prop_id]);
+}
+
+static void
+setting_set_boolean (XpadSettings *settings, guint prop_id, gboolean value)
 {
-	if (settings->priv->height == height)
+	gboolean *field = SETTING_FIELD (settings->priv, &settings_schema[prop_id]);
+	
+	value = value ? TRUE : FALSE;
+	if (*field == value)
 		return;
 	
-	settings->priv->height = height;
+	*field = value;
+	setting_changed (settings, prop_id);
+}
+
+static void
+setting_set_uint (XpadSettings *settings, guint prop_id, guint value)
+{
+	guint *field = SETTING_FIELD (settings->priv, &settings_schema[prop_id]);
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
+	if (*field == value)
+		return;
 	
-	g_object_notify (G_OBJECT (settings), "height");
+	*field = value;
+	setting_changed (settings, prop_id);
 }
 
-guint xpad_settings_get_height (XpadSettings *settings)
+static void
+setting_set_string (XpadSettings *settings, guint prop_id, const gchar *value)
 {
-	return settings->priv->height;
+	gchar **field = SETTING_FIELD (settings->priv, &settings_schema[prop_id]);
+	
+	if (g_strcmp0 (*field, value) == 0)
+		return;
+	
+	g_free (*field);
+	*field = g_strdup (value);
+	setting_changed (settings, prop_id);
 }
 
-void xpad_settings_set_has_decorations (XpadSettings *settings, gboolean decorations)
+static void
+setting_set_color (XpadSettings *settings, guint prop_id, const GdkRGBA *value)
 {
-	if (settings->priv->has_decorations == decorations)
+	GdkRGBA **field = SETTING_FIELD (settings->priv, &settings_schema[prop_id]);
+	
+	if (*field == value || (*field && value && gdk_rgba_equal (*field, value)))
 		return;
 	
-	settings->priv->has_decorations = decorations;
+	if (*field)
+		gdk_rgba_free (*field);
+	*field = value ? gdk_rgba_copy (value) : NULL;
+	setting_changed (settings, prop_id);
+}
+
+static void
+toolbar_buttons_changed (XpadSettings *settings)
+{
+	if (!settings->priv->reloading)
+		xpad_settings_queue_save (settings);
+	g_signal_emit (settings, signals[CHANGE_BUTTONS], 0);
+}
+
+static gboolean
+toolbar_buttons_equal (const GSList *a, const GSList *b)
+{
+	for (; a && b; a = a->next, b = b->next)
+		if (strcmp (a->data, b->data) != 0)
+			return FALSE;
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
+	return !a && !b;
+}
+
+/**
+ * Reads the settings file again after another program changed it.  Only
+ * the values that differ are notified, as one batch.
+ */
+void
+xpad_settings_reload (XpadSettings *settings)
+{
+	XpadSettingsPrivate loaded;
+	guint i;
+	
+	values_copy (&loaded, settings->priv);
+	load_from_file (&loaded, DEFAULTS_FILENAME);
+	
+	settings->priv->reloading = TRUE;
+	xpad_settings_begin (settings);
+	
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
+	{
+		gpointer field = SETTING_FIELD (&loaded, &settings_schema[i]);
+		
+		switch (settings_schema[i].type)
+		{
+		case SETTING_BOOLEAN:
+			setting_set_boolean (settings, i, *(gboolean *) field);
+			break;
+		case SETTING_UINT:
+			setting_set_uint (settings, i, *(guint *) field);
+			break;
+		case SETTING_STRING:
+			setting_set_string (settings, i, *(gchar **) field);
+			break;
+		case SETTING_COLOR:
+			setting_set_color (settings, i, *(GdkRGBA **) field);
+			break;
+		}
+	}
+	
+	if (!toolbar_buttons_equal (settings->priv->toolbar_buttons, loaded.toolbar_buttons))
+	{
+		GSList *buttons = settings->priv->toolbar_buttons;
+		
+		settings->priv->toolbar_buttons = loaded.toolbar_buttons;
+		loaded.toolbar_buttons = buttons;
+		toolbar_buttons_changed (settings);
+	}
+	
+	xpad_settings_commit (settings);
+	settings->priv->reloading = FALSE;
 	
-	g_object_notify (G_OBJECT (settings), "has_decorations");
+	values_clear (&loaded);
+}
+
+void xpad_settings_set_width (XpadSettings *settings, guint width)
+{
+	setting_set_uint (settings, PROP_WIDTH, width);
+}
+
+guint xpad_settings_get_width (XpadSettings *settings)
+{
+	return settings->priv->width;
+}
+
+void xpad_settings_set_height (XpadSettings *settings, guint height)
+{
+	setting_set_uint (settings, PROP_HEIGHT, height);
+}
+
+guint xpad_settings_get_height (XpadSettings *settings)
+{
+	return settings->priv->height;
+}
+
+void xpad_settings_set_has_decorations (XpadSettings *settings, gboolean decorations)
+{
+	setting_set_boolean (settings, PROP_HAS_DECORATIONS, decorations);
 }
 
 gboolean xpad_settings_get_has_decorations (XpadSettings *settings)
@@ -318,14 +542,7 @@ gboolean xpad_settings_get_has_decorations (XpadSettings *settings)
 
 void xpad_settings_set_confirm_destroy (XpadSettings *settings, gboolean confirm)
 {
-	if (settings->priv->confirm_destroy == confirm)
-		return;
-	
-	settings->priv->confirm_destroy = confirm;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "confirm_destroy");
+	setting_set_boolean (settings, PROP_CONFIRM_DESTROY, confirm);
 }
 
 gboolean xpad_settings_get_confirm_destroy (XpadSettings *settings)
@@ -335,14 +552,7 @@ gboolean xpad_settings_get_confirm_destroy (XpadSettings *settings)
 
 void xpad_settings_set_edit_lock (XpadSettings *settings, gboolean lock)
 {
-	if (settings->priv->edit_lock == lock)
-		return;
-	
-	settings->priv->edit_lock = lock;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "edit_lock");
+	setting_set_boolean (settings, PROP_EDIT_LOCK, lock);
 }
 
 gboolean xpad_settings_get_edit_lock (XpadSettings *settings)
@@ -352,14 +562,7 @@ gboolean xpad_settings_get_edit_lock (XpadSettings *settings)
 
 void xpad_settings_set_has_toolbar (XpadSettings *settings, gboolean toolbar)
 {
-	if (settings->priv->has_toolbar == toolbar)
-		return;
-	
-	settings->priv->has_toolbar = toolbar;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "has_toolbar");
+	setting_set_boolean (settings, PROP_HAS_TOOLBAR, toolbar);
 }
 
 gboolean xpad_settings_get_has_toolbar (XpadSettings *settings)
@@ -369,14 +572,7 @@ gboolean xpad_settings_get_has_toolbar (XpadSettings *settings)
 
 void xpad_settings_set_sticky (XpadSettings *settings, gboolean sticky)
 {
-	if (settings->priv->sticky == sticky)
-		return;
-	
-	settings->priv->sticky = sticky;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "sticky");
+	setting_set_boolean (settings, PROP_STICKY, sticky);
 }
 
 gboolean xpad_settings_get_sticky (XpadSettings *settings)
@@ -386,14 +582,7 @@ gboolean xpad_settings_get_sticky (XpadSettings *settings)
 
 void xpad_settings_set_autohide_toolbar (XpadSettings *settings, gboolean hide)
 {
-	if (settings->priv->autohide_toolbar == hide)
-		return;
-	
-	settings->priv->autohide_toolbar = hide;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "autohide_toolbar");
+	setting_set_boolean (settings, PROP_AUTOHIDE_TOOLBAR, hide);
 }
 
 gboolean xpad_settings_get_autohide_toolbar (XpadSettings *settings)
@@ -403,14 +592,7 @@ gboolean xpad_settings_get_autohide_toolbar (XpadSettings *settings)
 
 void xpad_settings_set_has_scrollbar (XpadSettings *settings, gboolean scrollbar)
 {
-	if (settings->priv->has_scrollbar == scrollbar)
-		return;
-	
-	settings->priv->has_scrollbar = scrollbar;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "has_scrollbar");
+	setting_set_boolean (settings, PROP_HAS_SCROLLBAR, scrollbar);
 }
 
 gboolean xpad_settings_get_has_scrollbar (XpadSettings *settings)
@@ -422,9 +604,7 @@ void xpad_settings_add_toolbar_button (XpadSettings *settings, const gchar *butt
 {
 	settings->priv->toolbar_buttons = g_slist_append (settings->priv->toolbar_buttons, g_strdup (button));
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_signal_emit (settings, signals[CHANGE_BUTTONS], 0);
+	toolbar_buttons_changed (settings);
 }
 
 gboolean xpad_settings_move_toolbar_button (XpadSettings *settings, gint button, gint new)
@@ -446,9 +626,7 @@ gboolean xpad_settings_move_toolbar_button (XpadSettings *settings, gint button,
 	settings->priv->toolbar_buttons = g_slist_delete_link (settings->priv->toolbar_buttons, element);
 	settings->priv->toolbar_buttons = g_slist_insert (settings->priv->toolbar_buttons, data, new);
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_signal_emit (settings, signals[CHANGE_BUTTONS], 0);
+	toolbar_buttons_changed (settings);
 	
 	return TRUE;
 }
@@ -470,9 +648,7 @@ gboolean xpad_settings_remove_toolbar_button (XpadSettings *settings, gint butto
 	
 	xpad_settings_remove_toolbar_list_element (settings, element);
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_signal_emit (settings, signals[CHANGE_BUTTONS], 0);
+	toolbar_buttons_changed (settings);
 	
 	return TRUE;
 }
@@ -482,17 +658,10 @@ gboolean xpad_settings_remove_all_toolbar_buttons (XpadSettings *settings)
 	if (settings->priv->toolbar_buttons == NULL)
 		return FALSE;
 
-	while (settings->priv->toolbar_buttons)
-	{
-		g_free (settings->priv->toolbar_buttons->data);
-		settings->priv->toolbar_buttons = 
-			g_slist_delete_link (settings->priv->toolbar_buttons,
-					settings->priv->toolbar_buttons);
-	}
-
+	g_slist_free_full (settings->priv->toolbar_buttons, g_free);
 	settings->priv->toolbar_buttons = NULL;
 
-	g_signal_emit (settings, signals[CHANGE_BUTTONS], 0);
+	toolbar_buttons_changed (settings);
 
 	return TRUE;
 }
@@ -508,9 +677,7 @@ gboolean xpad_settings_remove_last_toolbar_button (XpadSettings *settings)
 	
 	xpad_settings_remove_toolbar_list_element (settings, element);
 	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_signal_emit (settings, signals[CHANGE_BUTTONS], 0);
+	toolbar_buttons_changed (settings);
 	
 	return TRUE;
 }
@@ -522,17 +689,7 @@ const GSList *xpad_settings_get_toolbar_buttons (XpadSettings *settings)
 
 void xpad_settings_set_back_color (XpadSettings *settings, const GdkRGBA *back)
 {
-	if (settings->priv->back)
-		gdk_rgba_free (settings->priv->back);
-	
-	if (back)
-		settings->priv->back = gdk_rgba_copy (back);
-	else
-		settings->priv->back = NULL;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "back_color");
+	setting_set_color (settings, PROP_BACK_COLOR, back);
 }
 
 const GdkRGBA *xpad_settings_get_back_color (XpadSettings *settings)
@@ -542,17 +699,7 @@ const GdkRGBA *xpad_settings_get_back_color (XpadSettings *settings)
 
 void xpad_settings_set_text_color (XpadSettings *settings, const GdkRGBA *text)
 {
-	if (settings->priv->text)
-		gdk_rgba_free (settings->priv->text);
-	
-	if (text)
-		settings->priv->text = gdk_rgba_copy (text);
-	else
-		settings->priv->text = NULL;
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "text_color");
+	setting_set_color (settings, PROP_TEXT_COLOR, text);
 }
 
 const GdkRGBA *xpad_settings_get_text_color (XpadSettings *settings)
@@ -562,12 +709,7 @@ const GdkRGBA *xpad_settings_get_text_color (XpadSettings *settings)
 
 void xpad_settings_set_fontname (XpadSettings *settings, const gchar *fontname)
 {
-	g_free (settings->priv->fontname);
-	settings->priv->fontname = g_strdup (fontname);
-	
-	save_to_file (settings, DEFAULTS_FILENAME);
-	
-	g_object_notify (G_OBJECT (settings), "fontname");
+	setting_set_string (settings, PROP_FONTNAME, fontname);
 }
 
 const gchar *xpad_settings_get_fontname (XpadSettings *settings)
@@ -578,62 +720,27 @@ const gchar *xpad_settings_get_fontname (XpadSettings *settings)
 static void
 xpad_settings_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
 {
-	XpadSettings *settings;
-	
-	settings = XPAD_SETTINGS (object);
+	XpadSettings *settings = XPAD_SETTINGS (object);
 	
-	switch (prop_id)
+	if (prop_id == PROP_0 || prop_id >= LAST_PROP)
 	{
-	case PROP_HEIGHT:
-		xpad_settings_set_height (settings, g_value_get_uint (value));
-		break;
-	
-	case PROP_WIDTH:
-		xpad_settings_set_width (settings, g_value_get_uint (value));
-		break;
-	
-	case PROP_HAS_DECORATIONS:
-		xpad_settings_set_has_decorations (settings, g_value_get_boolean (value));
-		break;
-	
-	case PROP_CONFIRM_DESTROY:
-		xpad_settings_set_confirm_destroy (settings, g_value_get_boolean (value));
-		break;
-	
-	case PROP_STICKY:
-		xpad_settings_set_sticky (settings, g_value_get_boolean (value));
-		break;
-	
-	case PROP_EDIT_LOCK:
-		xpad_settings_set_edit_lock (settings, g_value_get_boolean (value));
-		break;
-	
-	case PROP_HAS_TOOLBAR:
-		xpad_settings_set_has_toolbar (settings, g_value_get_boolean (value));
-		break;
-	
-	case PROP_AUTOHIDE_TOOLBAR:
-		xpad_settings_set_autohide_toolbar (settings, g_value_get_boolean (value));
-		break;
-	
-	case PROP_HAS_SCROLLBAR:
-		xpad_settings_set_has_scrollbar (settings, g_value_get_boolean (value));
-		break;
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		return;
+	}
 	
-	case PROP_BACK_COLOR:
-		xpad_settings_set_back_color (settings, g_value_get_boxed (value));
+	switch (settings_schema[prop_id].type)
+	{
+	case SETTING_BOOLEAN:
+		setting_set_boolean (settings, prop_id, g_value_get_boolean (value));
 		break;
-	
-	case PROP_TEXT_COLOR:
-		xpad_settings_set_text_color (settings, g_value_get_boxed (value));
+	case SETTING_UINT:
+		setting_set_uint (settings, prop_id, g_value_get_uint (value));
 		break;
-	
-	case PROP_FONTNAME:
-		xpad_settings_set_fontname (settings, g_value_get_string (value));
+	case SETTING_STRING:
+		setting_set_string (settings, prop_id, g_value_get_string (value));
 		break;
-	
-	default:
-		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	case SETTING_COLOR:
+		setting_set_color (settings, prop_id, g_value_get_boxed (value));
 		break;
 	}
 }
@@ -641,197 +748,199 @@ xpad_settings_set_property (GObject *object, guint prop_id, const GValue *value,
 static void
 xpad_settings_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
 {
-	XpadSettings *settings;
-	
-	settings = XPAD_SETTINGS (object);
+	XpadSettings *settings = XPAD_SETTINGS (object);
+	gpointer field;
 	
-	switch (prop_id)
+	if (prop_id == PROP_0 || prop_id >= LAST_PROP)
 	{
-	case PROP_HEIGHT:
-		g_value_set_uint (value, xpad_settings_get_height (settings));
-		break;
-	
-	case PROP_WIDTH:
-		g_value_set_uint (value, xpad_settings_get_width (settings));
-		break;
-	
-	case PROP_HAS_DECORATIONS:
-		g_value_set_boolean (value, xpad_settings_get_has_decorations (settings));
-		break;
-	
-	case PROP_CONFIRM_DESTROY:
-		g_value_set_boolean (value, xpad_settings_get_confirm_destroy (settings));
-		break;
-	
-	case PROP_STICKY:
-		g_value_set_boolean (value, xpad_settings_get_sticky (settings));
-		break;
-	
-	case PROP_EDIT_LOCK:
-		g_value_set_boolean (value, xpad_settings_get_edit_lock (settings));
-		break;
-	
-	case PROP_HAS_TOOLBAR:
-		g_value_set_boolean (value, xpad_settings_get_has_toolbar (settings));
-		break;
-	
-	case PROP_AUTOHIDE_TOOLBAR:
-		g_value_set_boolean (value, xpad_settings_get_autohide_toolbar (settings));
-		break;
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+		return;
+	}
 	
-	case PROP_HAS_SCROLLBAR:
-		g_value_set_boolean (value, xpad_settings_get_has_scrollbar (settings));
-		break;
+	field = SETTING_FIELD (settings->priv, &settings_schema[prop_id]);
 	
-	case PROP_BACK_COLOR:
-		g_value_set_static_boxed (value, xpad_settings_get_back_color (settings));
+	switch (settings_schema[prop_id].type)
+	{
+	case SETTING_BOOLEAN:
+		g_value_set_boolean (value, *(gboolean *) field);
 		break;
-	
-	case PROP_TEXT_COLOR:
-		g_value_set_static_boxed (value, xpad_settings_get_text_color (settings));
+	case SETTING_UINT:
+		g_value_set_uint (value, *(guint *) field);
 		break;
-	
-	case PROP_FONTNAME:
-		g_value_set_string (value, xpad_settings_get_fontname (settings));
+	case SETTING_STRING:
+		g_value_set_string (value, *(gchar **) field);
 		break;
-	
-	default:
-		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+	case SETTING_COLOR:
+		g_value_set_static_boxed (value, *(GdkRGBA **) field);
 		break;
 	}
 }
 
 static void
-load_from_file (XpadSettings *settings, const gchar *filename)
-{
-	/**
-	 * We need to set up int values for all these to take the value from the file.
-	 * These will be assigned back to the appropriate values after load.
-	 */
-	gchar *buttons = NULL;
-	GdkColor text = {0}, back = {0};
-	gboolean use_text, use_back;
-	
-	use_text = settings->priv->text ? TRUE : FALSE;
-	if (settings->priv->text)
-		text = *settings->priv->text;
-	
-	use_back = settings->priv->back ? TRUE : FALSE;
-	if (settings->priv->back)
-		back = *settings->priv->back;
-	
-	if (fio_get_values_from_file (filename, 
-		"b|decorations", &settings->priv->has_decorations,
-		"u|height", &settings->priv->height,
-		"u|width", &settings->priv->width,
-		"b|confirm_destroy", &settings->priv->confirm_destroy,
-		"b|edit_lock", &settings->priv->edit_lock,
-		"b|sticky_on_start", &settings->priv->sticky,
-		"h|back_red", &back.red,
-		"h|back_green", &back.green,
-		"h|back_blue", &back.blue,
-		"b|use_back", &use_back,
-		"h|text_red", &text.red,
-		"h|text_green", &text.green,
-		"h|text_blue", &text.blue,
-		"b|use_text", &use_text,
-		"s|fontname", &settings->priv->fontname,
-		"b|toolbar", &settings->priv->has_toolbar,
-		"b|auto_hide_toolbar", &settings->priv->autohide_toolbar,
-		"b|scrollbar", &settings->priv->has_scrollbar,
-		"s|buttons", &buttons,
-		NULL))
+load_color (GHashTable *values, const gchar *key, GdkRGBA **field)
+{
+	static const gchar *channels[] = { "red", "green", "blue" };
+	const gchar *use, *channel;
+	gdouble rgb[3] = { 0.0, 0.0, 0.0 };
+	GdkRGBA color;
+	gchar *name;
+	guint i;
+	
+	name = g_strconcat ("use_", key, NULL);
+	use = g_hash_table_lookup (values, name);
+	g_free (name);
+	
+	/* Files from before this setting existed keep the default */
+	if (!use)
 		return;
 	
-	if (use_text)
+	if (*field)
 	{
-		gdk_color_free (settings->priv->text);
-		settings->priv->text = gdk_color_copy (&text);
+		rgb[0] = (*field)->red;
+		rgb[1] = (*field)->green;
+		rgb[2] = (*field)->blue;
+		gdk_rgba_free (*field);
+		*field = NULL;
 	}
 	
-	if (use_back)
+	if (!atoi (use))
+		return;
+	
+	for (i = 0; i < G_N_ELEMENTS (channels); i++)
 	{
-		gdk_color_free (settings->priv->back);
-		settings->priv->back = gdk_color_copy (&back);
+		name = g_strconcat (key, "_", channels[i], NULL);
+		channel = g_hash_table_lookup (values, name);
+		g_free (name);
+		
+		if (channel)
+			rgb[i] = (guint16) strtoul (channel, NULL, 0) / 65535.0;
 	}
 	
-	if (settings->priv->fontname &&
-	    strcmp (settings->priv->fontname, "NULL") == 0)
+	color.red = rgb[0];
+	color.green = rgb[1];
+	color.blue = rgb[2];
+	color.alpha = 1.0;
+	*field = gdk_rgba_copy (&color);
+}
+
+static void
+load_from_file (XpadSettingsPrivate *priv, const gchar *filename)
+{
+	GHashTable *values;
+	const gchar *value;
+	guint i;
+	
+	values = fio_get_values (filename);
+	if (!values)
+		return;
+	
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
 	{
-		g_free (settings->priv->fontname);
-		settings->priv->fontname = NULL;
+		const SettingSchema *schema = &settings_schema[i];
+		gpointer field = SETTING_FIELD (priv, schema);
+		
+		if (schema->type == SETTING_COLOR)
+		{
+			load_color (values, schema->key, field);
+			continue;
+		}
+		
+		value = g_hash_table_lookup (values, schema->key);
+		if (!value)
+			continue;
+		
+		switch (schema->type)
+		{
+		case SETTING_BOOLEAN:
+			*(gboolean *) field = atoi (value) ? TRUE : FALSE;
+			break;
+		case SETTING_UINT:
+			*(guint *) field = (guint) strtoul (value, NULL, 0);
+			break;
+		case SETTING_STRING:
+			g_free (*(gchar **) field);
+			*(gchar **) field = strcmp (value, "NULL") == 0 ? NULL : g_strdup (value);
+			break;
+		case SETTING_COLOR:
+			break;
+		}
 	}
 	
-	if (buttons)
+	value = g_hash_table_lookup (values, "buttons");
+	if (value)
 	{
-		gint i;
+		gint n;
 		gchar **button_names;
 		
-		button_names = g_strsplit (buttons, ",", 0);
+		button_names = g_strsplit (value, ",", 0);
 		
-		while (settings->priv->toolbar_buttons)
-		{
-			g_free (settings->priv->toolbar_buttons->data);
-			settings->priv->toolbar_buttons = 
-				g_slist_delete_link (settings->priv->toolbar_buttons,
-				settings->priv->toolbar_buttons);
-		}
+		g_slist_free_full (priv->toolbar_buttons, g_free);
+		priv->toolbar_buttons = NULL;
 		
-		for (i = 0; button_names[i]; ++i)
+		for (n = 0; button_names[n]; ++n)
 		{
-			settings->priv->toolbar_buttons = 
-				g_slist_append (settings->priv->toolbar_buttons,
-				g_strstrip (button_names[i])); /* takes ownership of string */
+			priv->toolbar_buttons = 
+				g_slist_append (priv->toolbar_buttons,
+				g_strstrip (button_names[n])); /* takes ownership of string */
 		}
 		
 		g_free (button_names);
-		g_free (buttons);
 	}
+	
+	g_hash_table_destroy (values);
 }
 
+static void
+save_color (GString *out, const gchar *key, const GdkRGBA *color)
+{
+	g_string_append_printf (out, "%s_red %u\n", key, color ? (guint) (color->red * 65535 + 0.5) : 0);
+	g_string_append_printf (out, "%s_green %u\n", key, color ? (guint) (color->green * 65535 + 0.5) : 0);
+	g_string_append_printf (out, "%s_blue %u\n", key, color ? (guint) (color->blue * 65535 + 0.5) : 0);
+	g_string_append_printf (out, "use_%s %i\n", key, color ? 1 : 0);
+}
 
+/* Writes every setting in one go; fio_set_file replaces the file atomically */
 static void
 save_to_file (XpadSettings *settings, const gchar *filename)
 {
-	gchar *buttons = g_strdup ("");
+	GString *out = g_string_new (NULL);
 	GSList *tmp;
+	guint i;
+	gint64 begin = g_get_monotonic_time ();
 	
-	tmp = settings->priv->toolbar_buttons;
+	xpad_timer_cancel (&settings->priv->save_timer);
+	settings->priv->dirty = FALSE;
 	
-	while (tmp)
+	for (i = PROP_0 + 1; i < LAST_PROP; i++)
 	{
-		gchar *tmpstr = buttons;
-		
-		if (tmp->next)
-			buttons = g_strconcat (buttons, tmp->data, ", ", NULL);
-		else
-			buttons = g_strconcat (buttons, tmp->data, NULL);
+		const SettingSchema *schema = &settings_schema[i];
+		gpointer field = SETTING_FIELD (settings->priv, schema);
 		
-		g_free (tmpstr);
-		tmp = tmp->next;
+		switch (schema->type)
+		{
+		case SETTING_BOOLEAN:
+			g_string_append_printf (out, "%s %i\n", schema->key, *(gboolean *) field);
+			break;
+		case SETTING_UINT:
+			g_string_append_printf (out, "%s %u\n", schema->key, *(guint *) field);
+			break;
+		case SETTING_STRING:
+			g_string_append_printf (out, "%s %s\n", schema->key, *(gchar **) field ? *(gchar **) field : "NULL");
+			break;
+		case SETTING_COLOR:
+			save_color (out, schema->key, *(GdkRGBA **) field);
+			break;
+		}
 	}
 	
-	fio_set_values_to_file (filename, 
-		"b|decorations", settings->priv->has_decorations,
-		"u|height", settings->priv->height,
-		"u|width", settings->priv->width,
-		"b|confirm_destroy", settings->priv->confirm_destroy,
-		"b|edit_lock", settings->priv->edit_lock,
-		"b|sticky_on_start", settings->priv->sticky,
-		"h|back_red", settings->priv->back ? settings->priv->back->red : 0,
-		"h|back_green", settings->priv->back ? settings->priv->back->green : 0,
-		"h|back_blue", settings->priv->back ? settings->priv->back->blue : 0,
-		"b|use_back", settings->priv->back ? TRUE : FALSE,
-		"h|text_red", settings->priv->text ? settings->priv->text->red : 0,
-		"h|text_green", settings->priv->text ? settings->priv->text->green : 0,
-		"h|text_blue", settings->priv->text ? settings->priv->text->blue : 0,
-		"b|use_text", settings->priv->text ? TRUE : FALSE,
-		"s|fontname", settings->priv->fontname ? settings->priv->fontname : "NULL",
-		"b|toolbar", settings->priv->has_toolbar,
-		"b|auto_hide_toolbar", settings->priv->autohide_toolbar,
-		"b|scrollbar", settings->priv->has_scrollbar,
-		"s|buttons", buttons,
-		NULL);
-	
-	g_free (buttons);
+	g_string_append (out, "buttons ");
+	for (tmp = settings->priv->toolbar_buttons; tmp; tmp = tmp->next)
+		g_string_append_printf (out, "%s%s", (gchar *) tmp->data, tmp->next ? ", " : "");
+	g_string_append_c (out, '\n');
+	xpad_metrics_record (XPAD_HISTOGRAM_SERIALIZE_TIME, g_get_monotonic_time () - begin);
+	xpad_trace_end (begin, "serialize settings", NULL);
+	
+	fio_set_file (filename, out->str);
+	
+	g_string_free (out, TRUE);
 }
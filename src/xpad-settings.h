@@ -32,6 +32,18 @@ G_BEGIN_DECLS
 #define XPAD_IS_SETTINGS_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), XPAD_TYPE_SETTINGS))
 #define XPAD_SETTINGS_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), XPAD_TYPE_SETTINGS, XpadSettingsClass))
 
+/* Settings that pads react to, gathered into a mask by the pad group */
+typedef enum
+{
+	XPAD_SETTINGS_CHANGE_DECORATIONS = 1 << 0,
+	XPAD_SETTINGS_CHANGE_TOOLBAR     = 1 << 1,
+	XPAD_SETTINGS_CHANGE_AUTOHIDE    = 1 << 2,
+	XPAD_SETTINGS_CHANGE_SCROLLBAR   = 1 << 3,
+	XPAD_SETTINGS_CHANGE_EDIT_LOCK   = 1 << 4,
+	XPAD_SETTINGS_CHANGE_STYLE       = 1 << 5,
+	XPAD_SETTINGS_CHANGE_BUTTONS     = 1 << 6
+} XpadSettingsChange;
+
 typedef struct XpadSettingsClass XpadSettingsClass;
 typedef struct XpadSettingsPrivate XpadSettingsPrivate;
 typedef struct XpadSettings XpadSettings;
@@ -54,6 +66,11 @@ GType xpad_settings_get_type (void);
 
 XpadSettings *xpad_settings (void);
 
+void xpad_settings_begin (XpadSettings *settings);
+void xpad_settings_commit (XpadSettings *settings);
+void xpad_settings_flush (XpadSettings *settings);
+void xpad_settings_reload (XpadSettings *settings);
+
 void xpad_settings_set_width (XpadSettings *settings, guint width);
 guint xpad_settings_get_width (XpadSettings *settings);
 
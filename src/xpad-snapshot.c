@@ -0,0 +1,308 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string.h>
+#include "fio.h"
+#include "xpad-app.h"
+#include "xpad-pad.h"
+#include "xpad-snapshot.h"
+#include "xpad-trace.h"
+
+/**
+ * A cache of every pad as it was parsed, written in one file at clean
+ * shutdown so the next start doesn't have to read each pad's files.
+ *
+ * The file is one serialized GVariant that is mapped, not read, on
+ * startup.  Each entry carries the modification time and size of the info
+ * and content file it came from; a pad is only restored from the cache
+ * while both still match, anything else is parsed as usual.  So a stale or
+ * missing snapshot costs nothing but the parsing it was meant to save.
+ */
+
+#define SNAPSHOT_FILENAME "snapshot"
+
+/* Bump whenever ENTRY_TYPE changes */
+#define SNAPSHOT_VERSION 2
+
+/* info name, info mtime and size, content mtime and size, the parsed
+   info, the plain text and its tag spans */
+#define INFO_TYPE "(iiiibbbb(ddd)(ddd)sst)"
+#define ENTRY_TYPE "(sxtxt" INFO_TYPE "sa(sii))"
+#define SNAPSHOT_TYPE "(ua" ENTRY_TYPE ")"
+
+/* ENTRY_TYPE with the spans passed as a ready GVariant */
+#define ENTRY_FORMAT "(sxtxt" INFO_TYPE "s@a(sii))"
+
+struct XpadSnapshot
+{
+	GMappedFile *file;
+	GVariant *root;
+	GHashTable *entries;
+};
+
+/* Modification time in microseconds and size of a file in the config dir.
+   Files that don't exist get an mtime of -1. */
+static void
+file_stamp (const gchar *name, gint64 *mtime, guint64 *size)
+{
+	GFileInfo *info = NULL;
+	
+	*mtime = -1;
+	*size = 0;
+	
+	if (name && *name)
+	{
+		gchar *path = g_build_filename (xpad_app_get_config_dir (), name, NULL);
+		GFile *file = g_file_new_for_path (path);
+		
+		info = g_file_query_info (file,
+			G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," G_FILE_ATTRIBUTE_STANDARD_SIZE,
+			G_FILE_QUERY_INFO_NONE, NULL, NULL);
+		
+		g_object_unref (file);
+		g_free (path);
+	}
+	
+	if (info)
+	{
+		*mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+			g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+		*size = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+}
+
+static gboolean
+file_unchanged (const gchar *name, gint64 mtime, guint64 size)
+{
+	gint64 current_mtime;
+	guint64 current_size;
+	
+	file_stamp (name, &current_mtime, &current_size);
+	
+	return current_mtime == mtime && current_size == size;
+}
+
+XpadSnapshot *
+xpad_snapshot_load (void)
+{
+	XpadSnapshot *snapshot;
+	GMappedFile *file;
+	GVariant *root, *entries, *entry;
+	GVariantIter iter;
+	gchar *path;
+	guint32 version;
+	
+	path = g_build_filename (xpad_app_get_config_dir (), SNAPSHOT_FILENAME, NULL);
+	file = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+	
+	if (!file)
+		return NULL;
+	
+	root = g_variant_new_from_bytes (G_VARIANT_TYPE (SNAPSHOT_TYPE), g_mapped_file_get_bytes (file), FALSE);
+	g_variant_ref_sink (root);
+	
+	g_variant_get_child (root, 0, "u", &version);
+	if (version != SNAPSHOT_VERSION)
+	{
+		g_variant_unref (root);
+		g_mapped_file_unref (file);
+		return NULL;
+	}
+	
+	snapshot = g_new (XpadSnapshot, 1);
+	snapshot->file = file;
+	snapshot->root = root;
+	snapshot->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GDestroyNotify) g_variant_unref);
+	
+	/* Keys point into the mapped entries they belong to */
+	entries = g_variant_get_child_value (root, 1);
+	g_variant_iter_init (&iter, entries);
+	while ((entry = g_variant_iter_next_value (&iter)))
+	{
+		const gchar *name;
+		
+		g_variant_get_child (entry, 0, "&s", &name);
+		g_hash_table_replace (snapshot->entries, (gpointer) name, entry);
+	}
+	g_variant_unref (entries);
+	
+	return snapshot;
+}
+
+void
+xpad_snapshot_free (XpadSnapshot *snapshot)
+{
+	if (!snapshot)
+		return;
+	
+	g_hash_table_destroy (snapshot->entries);
+	g_variant_unref (snapshot->root);
+	g_mapped_file_unref (snapshot->file);
+	g_free (snapshot);
+}
+
+/**
+ * Where the pad for info_filename was and whether it was hidden when the
+ * snapshot was written.  Only a hint for the order pads are loaded in,
+ * nothing is checked against the files.
+ */
+gboolean
+xpad_snapshot_peek (XpadSnapshot *snapshot, const gchar *info_filename, gint *x, gint *y, gboolean *hidden)
+{
+	GVariant *entry, *info_value;
+	
+	if (!snapshot)
+		return FALSE;
+	
+	entry = g_hash_table_lookup (snapshot->entries, info_filename);
+	if (!entry)
+		return FALSE;
+	
+	info_value = g_variant_get_child_value (entry, 5);
+	g_variant_get_child (info_value, 0, "i", x);
+	g_variant_get_child (info_value, 1, "i", y);
+	g_variant_get_child (info_value, 7, "b", hidden);
+	g_variant_unref (info_value);
+	
+	return TRUE;
+}
+
+/**
+ * Builds the pad for info_filename from the snapshot, or returns NULL if
+ * the snapshot has no entry for it or its files changed since.
+ */
+GtkWidget *
+xpad_snapshot_restore_pad (XpadSnapshot *snapshot, XpadPadGroup *group, const gchar *info_filename, gboolean *show)
+{
+	GVariant *entry, *info_value, *spans;
+	const gchar *name, *text, *fontname, *contentname;
+	gint64 info_mtime, content_mtime;
+	guint64 info_size, content_size;
+	XpadPadInfo info;
+	GtkWidget *pad = NULL;
+	
+	if (!snapshot)
+		return NULL;
+	
+	entry = g_hash_table_lookup (snapshot->entries, info_filename);
+	if (!entry)
+		return NULL;
+	
+	g_variant_get (entry, "(&sxtxt@" INFO_TYPE "&s@a(sii))",
+		&name, &info_mtime, &info_size, &content_mtime, &content_size, &info_value, &text, &spans);
+	
+	/* Followed pads are never cached, so what is not stored stays unset */
+	xpad_pad_info_init (&info);
+	g_variant_get (info_value, "(iiiibbbb(ddd)(ddd)&s&st)",
+		&info.x, &info.y, &info.width, &info.height,
+		&info.follow_font, &info.follow_color, &info.sticky, &info.hidden,
+		&info.text.red, &info.text.green, &info.text.blue,
+		&info.back.red, &info.back.green, &info.back.blue,
+		&fontname, &contentname, &info.id);
+	info.text.alpha = info.back.alpha = 1.0;
+	info.fontname = (gchar *) fontname;
+	info.contentname = *contentname ? (gchar *) contentname : NULL;
+	
+	if (file_unchanged (info_filename, info_mtime, info_size) &&
+	    file_unchanged (contentname, content_mtime, content_size))
+		pad = xpad_pad_new_with_cached_info (group, info_filename, &info, text, spans, show);
+	
+	g_variant_unref (info_value);
+	g_variant_unref (spans);
+	
+	return pad;
+}
+
+/* A color as the info file keeps it, to 16 bits a channel */
+static XpadColor
+color_as_saved (const XpadColor *color)
+{
+	XpadColor saved;
+	
+	saved.red = (guint16) (color->red * 65535) / 65535.0;
+	saved.green = (guint16) (color->green * 65535) / 65535.0;
+	saved.blue = (guint16) (color->blue * 65535) / 65535.0;
+	saved.alpha = color->alpha;
+	
+	return saved;
+}
+
+/**
+ * Records every saved pad for the next start.  Call after pending saves
+ * were flushed, so the files on disk match what the pads hold: each
+ * entry is then built from the pad's own values, as xpad_pad_save_info
+ * wrote them, and the files are only looked at for their stamps.
+ */
+void
+xpad_snapshot_save (XpadPadGroup *group)
+{
+	GVariantBuilder builder;
+	GVariant *snapshot;
+	GSList *pads, *l;
+	gint64 span = xpad_trace_begin ();
+	
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" ENTRY_TYPE));
+	
+	pads = xpad_pad_group_get_pads (group);
+	for (l = pads; l; l = l->next)
+	{
+		XpadPad *pad = XPAD_PAD (l->data);
+		const gchar *infoname = xpad_pad_get_info_filename (pad);
+		gint64 info_mtime, content_mtime;
+		guint64 info_size, content_size;
+		XpadPadInfo info;
+		XpadColor text_color, back_color;
+		gchar *text;
+		
+		if (!infoname)
+			continue;
+		
+		/* Followed pads read their file again anyway */
+		xpad_pad_get_info (pad, &info);
+		if (info.followname)
+			continue;
+		
+		/* The values the next start would read */
+		text_color = color_as_saved (&info.text);
+		back_color = color_as_saved (&info.back);
+		
+		file_stamp (infoname, &info_mtime, &info_size);
+		file_stamp (info.contentname, &content_mtime, &content_size);
+		text = xpad_pad_get_text (pad);
+		
+		g_variant_builder_add (&builder, ENTRY_FORMAT,
+			infoname, info_mtime, info_size, content_mtime, content_size,
+			info.x, info.y, info.width, info.height,
+			info.follow_font, info.follow_color, info.sticky, info.hidden,
+			text_color.red, text_color.green, text_color.blue,
+			back_color.red, back_color.green, back_color.blue,
+			info.fontname ? info.fontname : "",
+			info.contentname ? info.contentname : "",
+			info.id,
+			text,
+			xpad_pad_get_tag_spans (pad));
+		
+		g_free (text);
+	}
+	g_slist_free (pads);
+	
+	snapshot = g_variant_ref_sink (g_variant_new ("(u@a" ENTRY_TYPE ")", SNAPSHOT_VERSION, g_variant_builder_end (&builder)));
+	xpad_trace_end (span, "serialize snapshot", NULL);
+	fio_set_file_data (SNAPSHOT_FILENAME, g_variant_get_data (snapshot), g_variant_get_size (snapshot));
+	g_variant_unref (snapshot);
+}
@@ -0,0 +1,38 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_SNAPSHOT_H__
+#define __XPAD_SNAPSHOT_H__
+
+#include <gtk/gtk.h>
+#include "xpad-pad-group.h"
+
+G_BEGIN_DECLS
+
+typedef struct XpadSnapshot XpadSnapshot;
+
+XpadSnapshot *xpad_snapshot_load        (void);
+gboolean      xpad_snapshot_peek        (XpadSnapshot *snapshot, const gchar *info_filename,
+                                         gint *x, gint *y, gboolean *hidden);
+GtkWidget    *xpad_snapshot_restore_pad (XpadSnapshot *snapshot, XpadPadGroup *group,
+                                         const gchar *info_filename, gboolean *show);
+void          xpad_snapshot_free        (XpadSnapshot *snapshot);
+
+void          xpad_snapshot_save        (XpadPadGroup *group);
+
+G_END_DECLS
+
+#endif /* __XPAD_SNAPSHOT_H__ */
@@ -0,0 +1,499 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include <string.h>
+#include "fio.h"
+#include "xpad-json.h"
+#include "xpad-store.h"
+
+/**
+ * Read-only access to the pads saved in the config dir, straight from
+ * their info and content files.  Nothing here touches a widget or a text
+ * buffer, so it works for pads that were never shown, and pads are read
+ * one at a time, so going through all of them costs the memory of one.
+ */
+
+/* Tags in content files are wrapped in this private use character (U+E000) */
+#define TAG_CHAR_UTF8 "\xee\x80\x80"
+#define TAG_CHAR_LEN 3
+
+struct XpadStore
+{
+	GDir *dir;
+	gchar *infoname;
+	XpadStorePad pad;
+	gboolean have_pad;
+};
+
+typedef struct
+{
+	gchar *name;
+	gint start;
+} OpenTag;
+
+static gboolean
+is_info_name (const gchar *name)
+{
+	return g_str_has_prefix (name, "info-") && !g_str_has_suffix (name, "~");
+}
+
+static gboolean
+is_content_name (const gchar *name)
+{
+	return g_str_has_prefix (name, "content-") && !g_str_has_suffix (name, "~");
+}
+
+/* Where the next tag character is in [p, end), or NULL */
+static const gchar *
+find_tag_char (const gchar *p, const gchar *end)
+{
+	while (p < end && (p = memchr (p, TAG_CHAR_UTF8[0], end - p)))
+	{
+		if (end - p >= TAG_CHAR_LEN && memcmp (p, TAG_CHAR_UTF8, TAG_CHAR_LEN) == 0)
+			return p;
+		p++;
+	}
+
+	return NULL;
+}
+
+/**
+ * Reads len bytes of content file markup, or all of it if len is -1.
+ * text_func gets the plain text between the tags, in order, as pieces
+ * of content itself, which need not be NUL-terminated, so it can be a
+ * mapped file.  span_func gets each tag span in characters of plain text
+ * once its end is known, by which time its text has been passed on.
+ * This is the one reader of the markup.  Empty tags name nothing and are
+ * skipped.
+ */
+void
+xpad_store_parse_content_runs (const gchar *content, gssize len,
+                               XpadStoreTextFunc text_func, XpadStoreSpanFunc span_func, gpointer user_data)
+{
+	GList *open = NULL, *l;
+	const gchar *p = content ? content : "", *end, *tag, *close;
+	glong offset = 0;
+
+	end = p + (len < 0 || !content ? strlen (p) : (gsize) len);
+
+	while ((tag = find_tag_char (p, end)))
+	{
+		if (tag > p)
+			text_func (p, tag - p, user_data);
+		offset += g_utf8_strlen (p, tag - p);
+
+		tag += TAG_CHAR_LEN;
+		close = find_tag_char (tag, end);
+		if (!close)
+		{
+			p = end;
+			break;
+		}
+
+		if (close > tag && *tag != '/')
+		{
+			OpenTag *open_tag = g_new (OpenTag, 1);
+			open_tag->name = g_strndup (tag, close - tag);
+			open_tag->start = offset;
+			open = g_list_prepend (open, open_tag);
+		}
+		else if (close > tag)
+		{
+			for (l = open; l; l = l->next)
+			{
+				OpenTag *open_tag = l->data;
+
+				if (strlen (open_tag->name) == (gsize) (close - tag - 1) &&
+				    !g_ascii_strncasecmp (open_tag->name, tag + 1, close - tag - 1))
+				{
+					if (offset > open_tag->start)
+						span_func (open_tag->name, open_tag->start, offset, user_data);
+					g_free (open_tag->name);
+					g_free (open_tag);
+					open = g_list_delete_link (open, l);
+					break;
+				}
+			}
+		}
+
+		p = close + TAG_CHAR_LEN;
+	}
+
+	if (end > p)
+		text_func (p, end - p, user_data);
+	offset += g_utf8_strlen (p, end - p);
+
+	/* Tags left open run to the end */
+	for (l = open; l; l = l->next)
+	{
+		OpenTag *open_tag = l->data;
+
+		if (offset > open_tag->start)
+			span_func (open_tag->name, open_tag->start, offset, user_data);
+		g_free (open_tag->name);
+		g_free (open_tag);
+	}
+	g_list_free (open);
+}
+
+/* What xpad_store_parse_content collects */
+typedef struct
+{
+	GString *plain;
+	GVariantBuilder spans;
+} Parsed;
+
+static void
+collect_text (const gchar *text, gsize len, Parsed *parsed)
+{
+	g_string_append_len (parsed->plain, text, len);
+}
+
+static void
+collect_span (const gchar *name, gint start, gint end, Parsed *parsed)
+{
+	g_variant_builder_add (&parsed->spans, "(sii)", name, start, end);
+}
+
+/* Splits content file markup into plain text and the a(sii) spans of
+   xpad_text_buffer_get_tag_spans; see xpad_store_parse_content_runs */
+void
+xpad_store_parse_content (const gchar *content, gssize len, gchar **text, GVariant **spans)
+{
+	Parsed parsed;
+
+	parsed.plain = g_string_sized_new (content && len > 0 ? (gsize) len : 0);
+	g_variant_builder_init (&parsed.spans, G_VARIANT_TYPE ("a(sii)"));
+
+	xpad_store_parse_content_runs (content, len,
+		(XpadStoreTextFunc) collect_text, (XpadStoreSpanFunc) collect_span, &parsed);
+
+	*text = g_string_free (parsed.plain, FALSE);
+	*spans = g_variant_ref_sink (g_variant_builder_end (&parsed.spans));
+}
+
+XpadStore *
+xpad_store_open (void)
+{
+	XpadStore *store;
+	GDir *dir;
+
+	dir = g_dir_open (fio_get_config_dir (), 0, NULL);
+	if (!dir)
+		return NULL;
+
+	store = g_new0 (XpadStore, 1);
+	store->dir = dir;
+
+	return store;
+}
+
+static void
+store_clear_pad (XpadStore *store)
+{
+	if (!store->have_pad)
+		return;
+
+	xpad_pad_info_clear (&store->pad.info);
+	g_free (store->pad.text);
+	g_variant_unref (store->pad.spans);
+	g_free (store->infoname);
+	store->infoname = NULL;
+	store->have_pad = FALSE;
+}
+
+/**
+ * Reads the next saved pad into pad, which stays valid until the next
+ * call.  Returns FALSE after the last one.  Pads come in directory order.
+ */
+gboolean
+xpad_store_next (XpadStore *store, XpadStorePad *pad)
+{
+	const gchar *name;
+
+	store_clear_pad (store);
+
+	while ((name = g_dir_read_name (store->dir)))
+	{
+		GBytes *content;
+		const gchar *data = NULL;
+		gsize size = 0;
+
+		if (!is_info_name (name))
+			continue;
+
+		xpad_pad_info_init (&store->pad.info);
+		if (!xpad_pad_info_read (name, &store->pad.info))
+		{
+			xpad_pad_info_clear (&store->pad.info);
+			continue;
+		}
+
+		content = store->pad.info.contentname ? fio_get_file_bytes (store->pad.info.contentname) : NULL;
+		if (content)
+			data = g_bytes_get_data (content, &size);
+		xpad_store_parse_content (data, size, &store->pad.text, &store->pad.spans);
+		if (content)
+			g_bytes_unref (content);
+
+		store->infoname = g_strdup (name);
+		store->pad.infoname = store->infoname;
+		store->have_pad = TRUE;
+
+		*pad = store->pad;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+void
+xpad_store_close (XpadStore *store)
+{
+	if (!store)
+		return;
+
+	store_clear_pad (store);
+	g_dir_close (store->dir);
+	g_free (store);
+}
+
+/* The content files some info file points to, as a set */
+GHashTable *
+xpad_store_get_content_names (void)
+{
+	GHashTable *names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	GDir *dir = g_dir_open (fio_get_config_dir (), 0, NULL);
+	const gchar *name;
+
+	while (dir && (name = g_dir_read_name (dir)))
+	{
+		XpadPadInfo info;
+
+		if (!is_info_name (name))
+			continue;
+
+		xpad_pad_info_init (&info);
+		if (xpad_pad_info_read (name, &info) && info.contentname && *info.contentname)
+		{
+			g_hash_table_add (names, info.contentname);
+			info.contentname = NULL;
+		}
+		xpad_pad_info_clear (&info);
+	}
+
+	if (dir)
+		g_dir_close (dir);
+
+	return names;
+}
+
+static guint
+verify_content (const gchar *infoname, const XpadPadInfo *info, XpadStoreProblemFunc func, gpointer user_data)
+{
+	gchar *content;
+	gboolean valid;
+
+	if (!info->contentname || !*info->contentname)
+	{
+		func (infoname, "names no content file", user_data);
+		return 1;
+	}
+
+	if (!(content = fio_get_file (info->contentname)))
+	{
+		func (infoname, "its content file is missing", user_data);
+		return 1;
+	}
+
+	valid = g_utf8_validate (content, -1, NULL);
+	g_free (content);
+	if (!valid)
+	{
+		func (info->contentname, "is not valid UTF-8", user_data);
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Checks every file in the config dir and calls func with the file at
+ * fault for each problem found.  Followed pads keep no content file, so
+ * theirs is not looked for.  Returns how many problems there were.
+ */
+guint
+xpad_store_verify (XpadStoreProblemFunc func, gpointer user_data)
+{
+	GHashTable *used = xpad_store_get_content_names ();
+	GHashTable *ids = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+	GDir *dir = g_dir_open (fio_get_config_dir (), 0, NULL);
+	const gchar *name;
+	guint problems = 0;
+
+	while (dir && (name = g_dir_read_name (dir)))
+	{
+		XpadPadInfo info;
+
+		if (is_content_name (name) && !g_hash_table_contains (used, name))
+		{
+			func (name, "no pad uses this content file", user_data);
+			problems++;
+		}
+
+		if (!is_info_name (name))
+			continue;
+
+		xpad_pad_info_init (&info);
+		if (!xpad_pad_info_read (name, &info))
+		{
+			func (name, "cannot be read", user_data);
+			problems++;
+		}
+		else if (!info.followname)
+			problems += verify_content (name, &info, func, user_data);
+
+		if (info.id && g_hash_table_contains (ids, &info.id))
+		{
+			func (name, "has the same ID as another pad", user_data);
+			problems++;
+		}
+		else if (info.id)
+		{
+			guint64 *id = g_new (guint64, 1);
+			*id = info.id;
+			g_hash_table_add (ids, id);
+		}
+		xpad_pad_info_clear (&info);
+	}
+
+	if (dir)
+		g_dir_close (dir);
+	g_hash_table_destroy (ids);
+	g_hash_table_destroy (used);
+
+	return problems;
+}
+
+/* The title the pad would show: its file for followed pads, else its
+   first line.  Must be g_free'd. */
+gchar *
+xpad_store_get_title (const XpadStorePad *pad)
+{
+	const gchar *end;
+	gchar *title;
+
+	if (pad->info.followname)
+		return g_path_get_basename (pad->info.followname);
+
+	end = strchr (pad->text, '\n');
+	title = end ? g_strndup (pad->text, end - pad->text) : g_strdup (pad->text);
+
+	return g_strstrip (title);
+}
+
+/* Pads are named by ID, by info file, or else by title */
+gboolean
+xpad_store_pad_matches (const XpadStorePad *pad, const gchar *name)
+{
+	guint64 id;
+	gchar *title;
+	gboolean match;
+
+	if (xpad_pad_id_parse (name, &id) && id == pad->info.id)
+		return TRUE;
+	if (!strcmp (pad->infoname, name))
+		return TRUE;
+
+	title = xpad_store_get_title (pad);
+	match = !strcmp (title, name);
+	g_free (title);
+
+	return match;
+}
+
+static void
+append_json_color (GString *out, const XpadColor *color)
+{
+	g_string_append_printf (out, "\"#%02x%02x%02x\"",
+		(guint) (color->red * 255 + 0.5), (guint) (color->green * 255 + 0.5), (guint) (color->blue * 255 + 0.5));
+}
+
+/* Appends pad as one line of JSON, newline included.  Colors and font are
+   null while the pad follows the global style. */
+void
+xpad_store_append_json (GString *out, const XpadStorePad *pad)
+{
+	GVariantIter iter;
+	const gchar *name;
+	gchar *title;
+	gint start, end;
+	gboolean first = TRUE;
+
+	/* Pads saved before they had IDs get theirs on the next start */
+	if (pad->info.id)
+		g_string_append_printf (out, "{\"id\":%" G_GUINT64_FORMAT, pad->info.id);
+	else
+		g_string_append (out, "{\"id\":null");
+	g_string_append (out, ",\"info\":");
+	xpad_json_append_string (out, pad->infoname);
+
+	title = xpad_store_get_title (pad);
+	g_string_append (out, ",\"title\":");
+	xpad_json_append_string (out, title);
+	g_free (title);
+
+	g_string_append_printf (out, ",\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,\"hidden\":%s,\"sticky\":%s",
+		pad->info.x, pad->info.y, pad->info.width, pad->info.height,
+		pad->info.hidden ? "true" : "false", pad->info.sticky ? "true" : "false");
+
+	g_string_append (out, ",\"text_color\":");
+	if (pad->info.follow_color)
+		g_string_append (out, "null");
+	else
+		append_json_color (out, &pad->info.text);
+	g_string_append (out, ",\"back_color\":");
+	if (pad->info.follow_color)
+		g_string_append (out, "null");
+	else
+		append_json_color (out, &pad->info.back);
+	g_string_append (out, ",\"font\":");
+	if (pad->info.follow_font || !pad->info.fontname)
+		g_string_append (out, "null");
+	else
+		xpad_json_append_string (out, pad->info.fontname);
+
+	if (pad->info.followname)
+	{
+		g_string_append (out, ",\"follow\":");
+		xpad_json_append_string (out, pad->info.followname);
+	}
+
+	g_string_append (out, ",\"text\":");
+	xpad_json_append_string (out, pad->text);
+
+	g_string_append (out, ",\"spans\":[");
+	g_variant_iter_init (&iter, pad->spans);
+	while (g_variant_iter_next (&iter, "(&sii)", &name, &start, &end))
+	{
+		g_string_append (out, first ? "{\"tag\":" : ",{\"tag\":");
+		xpad_json_append_string (out, name);
+		g_string_append_printf (out, ",\"start\":%d,\"end\":%d}", start, end);
+		first = FALSE;
+	}
+	g_string_append (out, "]}\n");
+}
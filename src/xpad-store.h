@@ -0,0 +1,60 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_STORE_H__
+#define __XPAD_STORE_H__
+
+#include "xpad-pad-info.h"
+
+G_BEGIN_DECLS
+
+typedef struct XpadStore XpadStore;
+
+/* One saved pad, as read back by xpad_store_next */
+typedef struct
+{
+	const gchar *infoname;   /* its info file */
+	XpadPadInfo info;
+	gchar *text;             /* plain, without tag markup */
+	GVariant *spans;         /* a(sii), see xpad_text_buffer_get_tag_spans */
+} XpadStorePad;
+
+/* Called by xpad_store_parse_content_runs for each run of plain text,
+   len bytes of the content, and each tag span, in characters */
+typedef void (*XpadStoreTextFunc) (const gchar *text, gsize len, gpointer user_data);
+typedef void (*XpadStoreSpanFunc) (const gchar *name, gint start, gint end, gpointer user_data);
+
+/* Called by xpad_store_verify with the file at fault and what is wrong */
+typedef void (*XpadStoreProblemFunc) (const gchar *name, const gchar *problem, gpointer user_data);
+
+XpadStore *xpad_store_open  (void);
+gboolean   xpad_store_next  (XpadStore *store, XpadStorePad *pad);
+void       xpad_store_close (XpadStore *store);
+
+void       xpad_store_parse_content      (const gchar *content, gssize len, gchar **text, GVariant **spans);
+void       xpad_store_parse_content_runs (const gchar *content, gssize len,
+                                          XpadStoreTextFunc text_func, XpadStoreSpanFunc span_func, gpointer user_data);
+gchar     *xpad_store_get_title     (const XpadStorePad *pad);
+gboolean   xpad_store_pad_matches   (const XpadStorePad *pad, const gchar *name);
+void       xpad_store_append_json   (GString *out, const XpadStorePad *pad);
+
+GHashTable *xpad_store_get_content_names (void);
+guint       xpad_store_verify            (XpadStoreProblemFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __XPAD_STORE_H__ */
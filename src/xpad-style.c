@@ -0,0 +1,197 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "xpad-style.h"
+#include "xpad-metrics.h"
+#include "xpad-settings.h"
+
+/**
+ * Text view styles are plain CSS classes backed by display-level providers.
+ *
+ * Views that follow the global style carry XPAD_STYLE_GLOBAL_*_CLASS and
+ * share one provider, which the pad group reloads in place when the
+ * preferences change.  Every distinct per-pad (text, back, font)
+ * combination gets one interned, refcounted provider with its own class,
+ * so switching a pad's style is just swapping a class name on the widget.
+ */
+struct XpadStyle
+{
+	gint ref_count;
+	gchar *key;
+	gchar *css_class;
+	GtkCssProvider *provider;
+};
+
+static GHashTable *styles = NULL;
+static GtkCssProvider *global_provider = NULL;
+static guint next_style_id = 0;
+
+static void
+append_color_rules (GString *css, const gchar *css_class, const GdkRGBA *text, const GdkRGBA *back)
+{
+	gchar *color;
+
+	if (!text && !back)
+		return;
+
+	g_string_append_printf (css, "textview.%s, textview.%s text {", css_class, css_class);
+	if (text)
+	{
+		color = gdk_rgba_to_string (text);
+		g_string_append_printf (css, " color: %s;", color);
+		g_free (color);
+	}
+	if (back)
+	{
+		color = gdk_rgba_to_string (back);
+		g_string_append_printf (css, " background-color: %s;", color);
+		g_free (color);
+	}
+	g_string_append (css, " }\n");
+}
+
+static void
+append_font_rules (GString *css, const gchar *css_class, const gchar *fontname)
+{
+	PangoFontDescription *fontdesc;
+
+	fontdesc = fontname ? pango_font_description_from_string (fontname) : NULL;
+	if (!fontdesc)
+		return;
+
+	g_string_append_printf (css, "textview.%s {", css_class);
+	if (pango_font_description_get_family (fontdesc))
+		g_string_append_printf (css, " font-family: \"%s\";", pango_font_description_get_family (fontdesc));
+	if (pango_font_description_get_size (fontdesc))
+		g_string_append_printf (css, " font-size: %dpt;", pango_font_description_get_size (fontdesc) / PANGO_SCALE);
+	g_string_append (css, " }\n");
+
+	pango_font_description_free (fontdesc);
+}
+
+/* Reloads the shared provider from the current preferences */
+void
+xpad_style_sync_global (void)
+{
+	GString *css = g_string_new (NULL);
+
+	append_color_rules (css, XPAD_STYLE_GLOBAL_COLOR_CLASS,
+		xpad_settings_get_text_color (xpad_settings ()),
+		xpad_settings_get_back_color (xpad_settings ()));
+	append_font_rules (css, XPAD_STYLE_GLOBAL_FONT_CLASS, xpad_settings_get_fontname (xpad_settings ()));
+
+	gtk_css_provider_load_from_string (global_provider, css->str);
+	g_string_free (css, TRUE);
+}
+
+/* Sets up the shared provider for the global style.  Safe to call more than once. */
+void
+xpad_style_init (void)
+{
+	if (global_provider)
+		return;
+
+	styles = g_hash_table_new (g_str_hash, g_str_equal);
+
+	global_provider = gtk_css_provider_new ();
+	xpad_metrics_add (XPAD_METRIC_CSS_PROVIDERS, 1);
+	gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+		GTK_STYLE_PROVIDER (global_provider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
+	xpad_style_sync_global ();
+}
+
+/**
+ * Returns a new reference to the style for these values, creating it if
+ * needed.  NULL values are left to the global style.  Returns NULL when
+ * nothing is overridden.
+ */
+XpadStyle *
+xpad_style_lookup (const GdkRGBA *text, const GdkRGBA *back, const gchar *fontname)
+{
+	XpadStyle *style;
+	gchar *text_str, *back_str, *key;
+	GString *css;
+
+	if (!text && !back && !fontname)
+		return NULL;
+
+	xpad_style_init ();
+
+	text_str = text ? gdk_rgba_to_string (text) : NULL;
+	back_str = back ? gdk_rgba_to_string (back) : NULL;
+	key = g_strdup_printf ("%s|%s|%s", text_str ? text_str : "", back_str ? back_str : "", fontname ? fontname : "");
+	g_free (text_str);
+	g_free (back_str);
+
+	style = g_hash_table_lookup (styles, key);
+	if (style)
+	{
+		g_free (key);
+		return xpad_style_ref (style);
+	}
+
+	style = g_new0 (XpadStyle, 1);
+	style->ref_count = 1;
+	style->key = key;
+	style->css_class = g_strdup_printf ("xpad-style-%u", ++next_style_id);
+
+	css = g_string_new (NULL);
+	append_color_rules (css, style->css_class, text, back);
+	append_font_rules (css, style->css_class, fontname);
+
+	/* One step above the global provider, so a pad's own choice wins */
+	style->provider = gtk_css_provider_new ();
+	xpad_metrics_add (XPAD_METRIC_CSS_PROVIDERS, 1);
+	gtk_css_provider_load_from_string (style->provider, css->str);
+	gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+		GTK_STYLE_PROVIDER (style->provider), GTK_STYLE_PROVIDER_PRIORITY_APPLICATION + 1);
+	g_string_free (css, TRUE);
+
+	g_hash_table_insert (styles, style->key, style);
+
+	return style;
+}
+
+XpadStyle *
+xpad_style_ref (XpadStyle *style)
+{
+	g_return_val_if_fail (style, NULL);
+
+	style->ref_count++;
+	return style;
+}
+
+void
+xpad_style_unref (XpadStyle *style)
+{
+	if (!style || --style->ref_count > 0)
+		return;
+
+	g_hash_table_remove (styles, style->key);
+	gtk_style_context_remove_provider_for_display (gdk_display_get_default (), GTK_STYLE_PROVIDER (style->provider));
+
+	g_object_unref (style->provider);
+	xpad_metrics_add (XPAD_METRIC_CSS_PROVIDERS, -1);
+	g_free (style->css_class);
+	g_free (style->key);
+	g_free (style);
+}
+
+const gchar *
+xpad_style_get_class (XpadStyle *style)
+{
+	return style->css_class;
+}
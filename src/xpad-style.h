@@ -0,0 +1,40 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_STYLE_H__
+#define __XPAD_STYLE_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* CSS classes carried by text views that follow the global style */
+#define XPAD_STYLE_GLOBAL_FONT_CLASS  "xpad-global-font"
+#define XPAD_STYLE_GLOBAL_COLOR_CLASS "xpad-global-color"
+
+typedef struct XpadStyle XpadStyle;
+
+void         xpad_style_init        (void);
+void         xpad_style_sync_global (void);
+
+XpadStyle   *xpad_style_lookup      (const GdkRGBA *text, const GdkRGBA *back, const gchar *fontname);
+XpadStyle   *xpad_style_ref         (XpadStyle *style);
+void         xpad_style_unref       (XpadStyle *style);
+const gchar *xpad_style_get_class   (XpadStyle *style);
+
+G_END_DECLS
+
+#endif /* __XPAD_STYLE_H__ */
@@ -17,9 +17,11 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#include <string.h>
 #include "xpad-text-buffer.h"
 #include "xpad-undo.h"
 #include "xpad-pad.h"
+#include "xpad-store.h"
 
 G_DEFINE_TYPE(XpadTextBuffer, xpad_text_buffer, GTK_TYPE_TEXT_BUFFER)
 #define XPAD_TEXT_BUFFER_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), XPAD_TYPE_TEXT_BUFFER, XpadTextBufferPrivate))
@@ -141,65 +143,207 @@ xpad_text_buffer_init (XpadTextBuffer *buffer)
 	buffer->priv->undo = xpad_undo_new (buffer);
 }
 
-void
-xpad_text_buffer_set_text_with_tags (XpadTextBuffer *buffer, const gchar *text)
+/* Lays the a(sii) spans of xpad_text_buffer_get_tag_spans over text
+   already in buffer */
+static void
+apply_spans (GtkTextBuffer *buffer, GVariant *spans)
 {
 	GtkTextIter start, end;
-	GList *tags = NULL;
-	gchar **tokens;
-	gint count;
-	gchar tag_char_utf8[7] = {0};
+	GVariantIter iter;
+	const gchar *name;
+	gint on, off;
 	
+	g_variant_iter_init (&iter, spans);
+	while (g_variant_iter_next (&iter, "(&sii)", &name, &on, &off))
+	{
+		gtk_text_buffer_get_iter_at_offset (buffer, &start, on);
+		gtk_text_buffer_get_iter_at_offset (buffer, &end, off);
+		gtk_text_buffer_apply_tag_by_name (buffer, name, &start, &end);
+	}
+}
+
+/* Where load_markup has got to */
+typedef struct
+{
+	GtkTextBuffer *buffer;
+	GtkTextIter end;
+} MarkupLoad;
+
+static void
+load_text (const gchar *text, gsize len, MarkupLoad *load)
+{
+	gtk_text_buffer_insert (load->buffer, &load->end, text, len);
+}
+
+/* The span's text is in by now, see xpad_store_parse_content_runs */
+static void
+load_span (const gchar *name, gint on, gint off, MarkupLoad *load)
+{
+	GtkTextIter start, end;
+	
+	gtk_text_buffer_get_iter_at_offset (load->buffer, &start, on);
+	gtk_text_buffer_get_iter_at_offset (load->buffer, &end, off);
+	gtk_text_buffer_apply_tag_by_name (load->buffer, name, &start, &end);
+}
+
+/* Replaces the contents of buffer with markup.  The text goes into the
+   buffer straight from markup, with no plain copy of it in between. */
+static void
+load_markup (GtkTextBuffer *buffer, const gchar *markup, gssize len)
+{
+	MarkupLoad load;
+	
+	load.buffer = buffer;
+	gtk_text_buffer_set_text (buffer, "", 0);
+	gtk_text_buffer_get_end_iter (buffer, &load.end);
+	xpad_store_parse_content_runs (markup, len,
+		(XpadStoreTextFunc) load_text, (XpadStoreSpanFunc) load_span, &load);
+}
+
+/* Replaces the contents with len bytes of text in content file markup,
+   or all of it if len is -1.  xpad_store_parse_content_runs reads the
+   markup. */
+void
+xpad_text_buffer_set_text_with_tags (XpadTextBuffer *buffer, const gchar *text, gssize len)
+{
 	if (!text)
 		return;
 	
 	gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (buffer));
+	load_markup (GTK_TEXT_BUFFER (buffer), text, len);
+	gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (buffer));
+}
+
+/* Lengths in characters of the common start and end of a and b.  The
+   two never overlap. */
+static void
+common_affixes (const gchar *a, const gchar *b, gint *prefix, gint *suffix)
+{
+	const gchar *a_end = a + strlen (a), *b_end = b + strlen (b);
 	
-	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &start, &end);
-	gtk_text_buffer_delete (GTK_TEXT_BUFFER (buffer), &start, &end);
-	gtk_text_buffer_get_bounds (GTK_TEXT_BUFFER (buffer), &start, &end);
+	*prefix = 0;
+	while (*a && g_utf8_get_char (a) == g_utf8_get_char (b))
+	{
+		a = g_utf8_next_char (a);
+		b = g_utf8_next_char (b);
+		(*prefix)++;
+	}
 	
-	g_unichar_to_utf8 (TAG_CHAR, tag_char_utf8);
+	*suffix = 0;
+	while (a_end > a && b_end > b)
+	{
+		const gchar *prev_a = g_utf8_prev_char (a_end), *prev_b = g_utf8_prev_char (b_end);
+		
+		if (g_utf8_get_char (prev_a) != g_utf8_get_char (prev_b))
+			break;
+		
+		a_end = prev_a;
+		b_end = prev_b;
+		(*suffix)++;
+	}
+}
+
+typedef struct
+{
+	GtkTextBuffer *target;
+	GtkTextBuffer *source;
+	GtkTextTag *skip;
+} TagSync;
+
+/* Lays tag over target exactly where it is in source, which holds the same text */
+static void
+sync_tag (GtkTextTag *tag, TagSync *sync)
+{
+	GtkTextIter iter, start, end;
+	gint on;
+	
+	if (tag == sync->skip)
+		return;
 	
-	tokens = g_strsplit (text, tag_char_utf8, 0);
+	gtk_text_buffer_get_bounds (sync->target, &start, &end);
+	gtk_text_buffer_remove_tag (sync->target, tag, &start, &end);
 	
-	for (count = 0; tokens[count]; count++)
+	gtk_text_buffer_get_start_iter (sync->source, &iter);
+	if (!gtk_text_iter_has_tag (&iter, tag) && !gtk_text_iter_forward_to_tag_toggle (&iter, tag))
+		return;
+	
+	do
 	{
-		if (count % 2 == 0)
-		{
-			gint offset;
-			GList *j;
-			
-			offset = gtk_text_iter_get_offset (&end);
-			gtk_text_buffer_insert (GTK_TEXT_BUFFER (buffer), &end, tokens[count], -1);
-			gtk_text_buffer_get_iter_at_offset (GTK_TEXT_BUFFER (buffer), &start, offset);
-			
-			for (j = tags; j; j = j->next)
-			{
-				gtk_text_buffer_apply_tag_by_name (GTK_TEXT_BUFFER (buffer), j->data, &start, &end);
-			}
-		}
-		else
-		{
-			if (tokens[count][0] != '/')
-			{
-				tags = g_list_prepend (tags, tokens[count]);
-			}
-			else
-			{
-				GList *element = g_list_find_custom (tags, &(tokens[count][1]), (GCompareFunc) g_ascii_strcasecmp);
-				
-				if (element)
-				{
-					tags = g_list_delete_link (tags, element);
-				}
-			}
-		}
+		on = gtk_text_iter_get_offset (&iter);
+		gtk_text_iter_forward_to_tag_toggle (&iter, tag);
+		
+		gtk_text_buffer_get_iter_at_offset (sync->target, &start, on);
+		gtk_text_buffer_get_iter_at_offset (sync->target, &end, gtk_text_iter_get_offset (&iter));
+		gtk_text_buffer_apply_tag (sync->target, tag, &start, &end);
+	}
+	while (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+}
+
+/**
+ * Brings the buffer to text, given in content file markup, by replacing
+ * only the span that differs.  Marks outside that span stay where they
+ * are, so the cursor and selection survive, and the replacement is one
+ * more step in the undo history instead of clearing it.
+ */
+void
+xpad_text_buffer_merge_text_with_tags (XpadTextBuffer *buffer, const gchar *text)
+{
+	GtkTextBuffer *target = GTK_TEXT_BUFFER (buffer), *source;
+	GtkTextTagTable *table;
+	GtkTextIter start, end, source_start, source_end;
+	gchar *old_text, *new_text;
+	gint prefix, suffix, old_len, new_len;
+	TagSync sync;
+	
+	if (!text)
+		return;
+	
+	old_text = xpad_text_buffer_get_text_with_tags (buffer);
+	if (strcmp (old_text, text) == 0)
+	{
+		g_free (old_text);
+		return;
 	}
+	g_free (old_text);
 	
-	gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (buffer));
+	/* Parse the new content next to ours, sharing the tag table */
+	table = gtk_text_buffer_get_tag_table (target);
+	source = gtk_text_buffer_new (table);
+	load_markup (source, text, -1);
+	
+	gtk_text_buffer_get_bounds (target, &start, &end);
+	old_text = gtk_text_buffer_get_text (target, &start, &end, TRUE);
+	gtk_text_buffer_get_bounds (source, &source_start, &source_end);
+	new_text = gtk_text_buffer_get_text (source, &source_start, &source_end, TRUE);
 	
-	g_strfreev (tokens);
+	common_affixes (old_text, new_text, &prefix, &suffix);
+	old_len = gtk_text_buffer_get_char_count (target);
+	new_len = gtk_text_buffer_get_char_count (source);
+	
+	gtk_text_buffer_begin_user_action (target);
+	
+	if (prefix + suffix < old_len || prefix + suffix < new_len)
+	{
+		gtk_text_buffer_get_iter_at_offset (target, &start, prefix);
+		gtk_text_buffer_get_iter_at_offset (target, &end, old_len - suffix);
+		gtk_text_buffer_delete (target, &start, &end);
+		
+		gtk_text_buffer_get_iter_at_offset (source, &source_start, prefix);
+		gtk_text_buffer_get_iter_at_offset (source, &source_end, new_len - suffix);
+		gtk_text_buffer_insert_range (target, &start, &source_start, &source_end);
+	}
+	
+	/* Formatting may have changed outside that span too */
+	sync.target = target;
+	sync.source = source;
+	sync.skip = gtk_text_tag_table_lookup (table, XPAD_TEXT_BUFFER_SEARCH_TAG);
+	gtk_text_tag_table_foreach (table, (GtkTextTagTableForeach) sync_tag, &sync);
+	
+	gtk_text_buffer_end_user_action (target);
+	
+	g_free (old_text);
+	g_free (new_text);
+	g_object_unref (source);
 }
 
 
@@ -211,8 +355,10 @@ xpad_text_buffer_get_text_with_tags (XpadTextBuffer *buffer)
 	gchar tag_char_utf8[7] = {0};
 	gchar *text = g_strdup (""), *oldtext = NULL, *tmp;
 	gboolean done = FALSE;
+	GtkTextTag *search_tag;
 	
 	gtk_text_buffer_get_start_iter (GTK_TEXT_BUFFER (buffer), &start);
+	search_tag = gtk_text_tag_table_lookup (gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (buffer)), XPAD_TEXT_BUFFER_SEARCH_TAG);
 	
 	g_unichar_to_utf8 (TAG_CHAR, tag_char_utf8);
 	
@@ -230,6 +376,8 @@ xpad_text_buffer_get_text_with_tags (XpadTextBuffer *buffer)
 		for (i = tags; i; i = i->next)
 		{
 			gchar *name;
+			if (i->data == search_tag)
+				continue;
 			g_object_get (G_OBJECT (i->data), "name", &name, NULL);
 			oldtext = text;
 			text = g_strconcat (text, tag_char_utf8, name, tag_char_utf8, NULL);
@@ -242,6 +390,8 @@ xpad_text_buffer_get_text_with_tags (XpadTextBuffer *buffer)
 		for (i = tags; i; i = i->next)
 		{
 			gchar *name;
+			if (i->data == search_tag)
+				continue;
 			g_object_get (G_OBJECT (i->data), "name", &name, NULL);
 			oldtext = text;
 			text = g_strconcat (text, tag_char_utf8, "/", name, tag_char_utf8, NULL);
@@ -259,6 +409,75 @@ xpad_text_buffer_get_text_with_tags (XpadTextBuffer *buffer)
 	return text;
 }
 
+typedef struct
+{
+	GtkTextBuffer *buffer;
+	GtkTextTag *skip;
+	GVariantBuilder *builder;
+} SpanCollect;
+
+static void
+collect_spans (GtkTextTag *tag, SpanCollect *collect)
+{
+	GtkTextIter iter;
+	gchar *name;
+	gint on;
+	
+	if (tag == collect->skip)
+		return;
+	
+	gtk_text_buffer_get_start_iter (collect->buffer, &iter);
+	if (!gtk_text_iter_has_tag (&iter, tag) && !gtk_text_iter_forward_to_tag_toggle (&iter, tag))
+		return;
+	
+	g_object_get (G_OBJECT (tag), "name", &name, NULL);
+	
+	do
+	{
+		on = gtk_text_iter_get_offset (&iter);
+		gtk_text_iter_forward_to_tag_toggle (&iter, tag);
+		g_variant_builder_add (collect->builder, "(sii)", name, on, gtk_text_iter_get_offset (&iter));
+	}
+	while (gtk_text_iter_forward_to_tag_toggle (&iter, tag));
+	
+	g_free (name);
+}
+
+/**
+ * The formatting of the buffer as an a(sii) of tag name, start and end
+ * character offset.  Find bar highlights are left out, as in
+ * xpad_text_buffer_get_text_with_tags.
+ */
+GVariant *
+xpad_text_buffer_get_tag_spans (XpadTextBuffer *buffer)
+{
+	GtkTextTagTable *table = gtk_text_buffer_get_tag_table (GTK_TEXT_BUFFER (buffer));
+	GVariantBuilder builder;
+	SpanCollect collect;
+	
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(sii)"));
+	
+	collect.buffer = GTK_TEXT_BUFFER (buffer);
+	collect.skip = gtk_text_tag_table_lookup (table, XPAD_TEXT_BUFFER_SEARCH_TAG);
+	collect.builder = &builder;
+	gtk_text_tag_table_foreach (table, (GtkTextTagTableForeach) collect_spans, &collect);
+	
+	return g_variant_builder_end (&builder);
+}
+
+/* Replaces the contents with plain text and the spans from
+   xpad_text_buffer_get_tag_spans, skipping the markup parser */
+void
+xpad_text_buffer_set_text_with_spans (XpadTextBuffer *buffer, const gchar *text, GVariant *spans)
+{
+	gtk_text_buffer_begin_user_action (GTK_TEXT_BUFFER (buffer));
+	
+	gtk_text_buffer_set_text (GTK_TEXT_BUFFER (buffer), text, -1);
+	apply_spans (GTK_TEXT_BUFFER (buffer), spans);
+	
+	gtk_text_buffer_end_user_action (GTK_TEXT_BUFFER (buffer));
+}
+
 void
 xpad_text_buffer_insert_text (XpadTextBuffer *buffer, gint pos, const gchar *text, gint len)
 {
@@ -379,6 +598,12 @@ create_tag_table (void)
 	gtk_text_tag_table_add (table, tag);
 	g_object_unref (tag);
 	
+	/* Find bar highlights; never written out, see xpad_text_buffer_get_text_with_tags */
+	tag = GTK_TEXT_TAG (g_object_new (GTK_TYPE_TEXT_TAG, "name", XPAD_TEXT_BUFFER_SEARCH_TAG,
+		"background", "#fce94f", "foreground", "#000000", NULL));
+	gtk_text_tag_table_add (table, tag);
+	g_object_unref (tag);
+	
 	return table;
 }
 
@@ -416,6 +641,11 @@ void xpad_text_buffer_thaw_undo (XpadTextBuffer *buffer)
 	xpad_undo_thaw (buffer->priv->undo);
 }
 
+void xpad_text_buffer_clear_undo (XpadTextBuffer *buffer)
+{
+	xpad_undo_clear (buffer->priv->undo);
+}
+
 XpadPad *xpad_text_buffer_get_pad (XpadTextBuffer *buffer)
 {
 	if (buffer == NULL)
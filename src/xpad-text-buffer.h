@@ -32,6 +32,9 @@ G_BEGIN_DECLS
 #define XPAD_IS_TEXT_BUFFER_CLASS(k)   (G_TYPE_CHECK_CLASS_TYPE ((k), XPAD_TYPE_TEXT_BUFFER))
 #define XPAD_TEXT_BUFFER_GET_CLASS(o)  (G_TYPE_INSTANCE_GET_CLASS ((o), XPAD_TYPE_TEXT_BUFFER, XpadTextBufferClass))
 
+/* Name of the tag the find bar uses to highlight matches */
+#define XPAD_TEXT_BUFFER_SEARCH_TAG "search-match"
+
 typedef struct XpadTextBufferClass XpadTextBufferClass;
 typedef struct XpadTextBufferPrivate XpadTextBufferPrivate;
 typedef struct XpadTextBuffer XpadTextBuffer;
@@ -53,8 +56,11 @@ GType xpad_text_buffer_get_type (void);
 
 XpadTextBuffer *xpad_text_buffer_new (XpadPad *pad);
 
-void xpad_text_buffer_set_text_with_tags (XpadTextBuffer *buffer, const gchar *text);
+void xpad_text_buffer_set_text_with_tags (XpadTextBuffer *buffer, const gchar *text, gssize len);
 gchar *xpad_text_buffer_get_text_with_tags (XpadTextBuffer *buffer);
+void xpad_text_buffer_merge_text_with_tags (XpadTextBuffer *buffer, const gchar *text);
+GVariant *xpad_text_buffer_get_tag_spans (XpadTextBuffer *buffer);
+void xpad_text_buffer_set_text_with_spans (XpadTextBuffer *buffer, const gchar *text, GVariant *spans);
 
 void xpad_text_buffer_insert_text (XpadTextBuffer *buffer, gint pos, const gchar *text, gint len);
 void xpad_text_buffer_delete_range (XpadTextBuffer *buffer, gint start, gint end);
@@ -66,6 +72,7 @@ void xpad_text_buffer_undo (XpadTextBuffer *buffer);
 void xpad_text_buffer_redo (XpadTextBuffer *buffer);
 void xpad_text_buffer_freeze_undo (XpadTextBuffer *buffer);
 void xpad_text_buffer_thaw_undo (XpadTextBuffer *buffer);
+void xpad_text_buffer_clear_undo (XpadTextBuffer *buffer);
 
 XpadPad *xpad_text_buffer_get_pad (XpadTextBuffer *buffer);
 void xpad_text_buffer_set_pad (XpadTextBuffer *buffer, XpadPad *pad);
@@ -19,6 +19,7 @@
 #include "xpad-text-view.h"
 #include "xpad-text-buffer.h"
 #include "xpad-settings.h"
+#include "xpad-style.h"
 
 G_DEFINE_TYPE(XpadTextView, xpad_text_view, GTK_TYPE_TEXT_VIEW)
 #define XPAD_TEXT_VIEW_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), XPAD_TYPE_TEXT_VIEW, XpadTextViewPrivate))
@@ -27,10 +28,15 @@ struct XpadTextViewPrivate
 {
 	gboolean follow_font_style;
 	gboolean follow_color_style;
-	gulong notify_text_handler;
-	gulong notify_back_handler;
-	gulong notify_font_handler;
 	XpadTextBuffer *buffer;
+	
+	/* the pad's own style, used when not following the global one */
+	gboolean has_text_color;
+	gboolean has_back_color;
+	GdkRGBA text_color;
+	GdkRGBA back_color;
+	gchar *fontname;
+	XpadStyle *style;
 };
 
 static void xpad_text_view_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
@@ -39,11 +45,8 @@ static void xpad_text_view_realize (XpadTextView *widget);
 static void xpad_text_view_finalize (GObject *object);
 static void xpad_text_view_button_pressed (GtkGestureClick *gesture, int n_press, double x, double y, XpadTextView *view);
 static gboolean xpad_text_view_focus_out (GtkEventControllerFocus *controller, XpadTextView *view);
-static void xpad_text_view_notify_edit_lock (XpadTextView *view);
 static void xpad_text_view_notify_editable (XpadTextView *view);
-static void xpad_text_view_notify_fontname (XpadTextView *view);
-static void xpad_text_view_notify_text_color (XpadTextView *view);
-static void xpad_text_view_notify_back_color (XpadTextView *view);
+static void xpad_text_view_update_style (XpadTextView *view);
 
 enum
 {
@@ -98,6 +101,10 @@ xpad_text_view_init (XpadTextView *view)
 	
 	view->priv->follow_font_style = TRUE;
 	view->priv->follow_color_style = TRUE;
+	view->priv->has_text_color = FALSE;
+	view->priv->has_back_color = FALSE;
+	view->priv->fontname = NULL;
+	view->priv->style = NULL;
 	
 	view->priv->buffer = xpad_text_buffer_new (NULL);
 	gtk_text_view_set_buffer (GTK_TEXT_VIEW (view), GTK_TEXT_BUFFER (view->priv->buffer));
@@ -124,14 +131,10 @@ xpad_text_view_init (XpadTextView *view)
 	
 	g_signal_connect (view, "realize", G_CALLBACK (xpad_text_view_realize), NULL);
 	g_signal_connect (view, "notify::editable", G_CALLBACK (xpad_text_view_notify_editable), NULL);
-	g_signal_connect_swapped (xpad_settings (), "notify::edit-lock", G_CALLBACK (xpad_text_view_notify_edit_lock), view);
-	view->priv->notify_font_handler = g_signal_connect_swapped (xpad_settings (), "notify::fontname", G_CALLBACK (xpad_text_view_notify_fontname), view);
-	view->priv->notify_text_handler = g_signal_connect_swapped (xpad_settings (), "notify::text-color", G_CALLBACK (xpad_text_view_notify_text_color), view);
-	view->priv->notify_back_handler = g_signal_connect_swapped (xpad_settings (), "notify::back-color", G_CALLBACK (xpad_text_view_notify_back_color), view);
-	
-	xpad_text_view_notify_text_color (view);
-	xpad_text_view_notify_back_color (view);
-	xpad_text_view_notify_fontname (view);
+	/* Global font and colors come from one shared provider, see xpad-style.c */
+	xpad_style_init ();
+	gtk_widget_add_css_class (GTK_WIDGET (view), XPAD_STYLE_GLOBAL_FONT_CLASS);
+	gtk_widget_add_css_class (GTK_WIDGET (view), XPAD_STYLE_GLOBAL_COLOR_CLASS);
 }
 
 static void
@@ -145,7 +148,13 @@ xpad_text_view_finalize (GObject *object)
 		view->priv->buffer = NULL;
 	}
 	
-	g_signal_handlers_disconnect_matched (xpad_settings (), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, view);
+	if (view->priv->style)
+	{
+		xpad_style_unref (view->priv->style);
+		view->priv->style = NULL;
+	}
+	
+	g_free (view->priv->fontname);
 	
 	G_OBJECT_CLASS (xpad_text_view_parent_class)->finalize (object);
 }
@@ -194,7 +203,7 @@ xpad_text_view_button_pressed (GtkGestureClick *gesture, int n_press, double x,
 	}
 }
 
-static void
+void
 xpad_text_view_notify_edit_lock (XpadTextView *view)
 {
 	/* chances are good that they don't have the text view focused while it changed, so make non-editable if edit lock turned on */
@@ -213,74 +222,84 @@ xpad_text_view_notify_editable (XpadTextView *view)
 	gtk_widget_set_cursor_from_name (GTK_WIDGET (view), cursor_name);
 }
 
-/* Adjust colors using CSS for GTK4 */
+/* Swaps the view over to the interned style matching its current settings */
 static void
-xpad_text_view_apply_colors (XpadTextView *view)
+xpad_text_view_update_style (XpadTextView *view)
 {
-	const GdkRGBA *text_color = xpad_settings_get_text_color (xpad_settings ());
-	const GdkRGBA *back_color = xpad_settings_get_back_color (xpad_settings ());
+	gboolean own_color = !view->priv->follow_color_style;
+	XpadStyle *style;
+	
+	style = xpad_style_lookup (
+		own_color && view->priv->has_text_color ? &view->priv->text_color : NULL,
+		own_color && view->priv->has_back_color ? &view->priv->back_color : NULL,
+		view->priv->follow_font_style || !view->priv->fontname || !*view->priv->fontname ? NULL : view->priv->fontname);
+	
+	if (style == view->priv->style)
+	{
+		xpad_style_unref (style);
+		return;
+	}
 	
-	if (text_color || back_color)
+	/* Add the new class before dropping the old one, so the view is
+	   restyled once and never falls back to the theme in between */
+	if (style)
+		gtk_widget_add_css_class (GTK_WIDGET (view), xpad_style_get_class (style));
+	if (view->priv->style)
 	{
-		gchar *css_string = g_strdup_printf (
-			"textview { color: rgba(%d,%d,%d,%.2f); background-color: rgba(%d,%d,%d,%.2f); }",
-			(int)(text_color ? text_color->red * 255 : 0),
-			(int)(text_color ? text_color->green * 255 : 0),
-			(int)(text_color ? text_color->blue * 255 : 0),
-			text_color ? text_color->alpha : 1.0,
-			(int)(back_color ? back_color->red * 255 : 0),
-			(int)(back_color ? back_color->green * 255 : 0),
-			(int)(back_color ? back_color->blue * 255 : 0),
-			back_color ? back_color->alpha : 1.0
-		);
-		
-		GtkCssProvider *provider = gtk_css_provider_new ();
-		gtk_css_provider_load_from_string (provider, css_string);
-		gtk_style_context_add_provider (gtk_widget_get_style_context (GTK_WIDGET (view)),
-		                                 GTK_STYLE_PROVIDER (provider),
-		                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-		g_object_unref (provider);
-		g_free (css_string);
+		gtk_widget_remove_css_class (GTK_WIDGET (view), xpad_style_get_class (view->priv->style));
+		xpad_style_unref (view->priv->style);
 	}
+	
+	view->priv->style = style;
 }
 
-static void
-xpad_text_view_notify_fontname (XpadTextView *view)
+void
+xpad_text_view_set_text_color (XpadTextView *view, const GdkRGBA *color)
 {
-	const gchar *font = xpad_settings_get_fontname (xpad_settings ());
-	PangoFontDescription *fontdesc;
+	view->priv->has_text_color = color != NULL;
+	if (color)
+		view->priv->text_color = *color;
 	
-	fontdesc = font ? pango_font_description_from_string (font) : NULL;
+	xpad_text_view_update_style (view);
+}
+
+const GdkRGBA *
+xpad_text_view_get_text_color (XpadTextView *view)
+{
+	return view->priv->has_text_color ? &view->priv->text_color : NULL;
+}
+
+void
+xpad_text_view_set_back_color (XpadTextView *view, const GdkRGBA *color)
+{
+	view->priv->has_back_color = color != NULL;
+	if (color)
+		view->priv->back_color = *color;
 	
-	if (fontdesc)
-	{
-		gchar *css_string = g_strdup_printf (
-			"textview { font-family: %s; font-size: %dpt; }",
-			pango_font_description_get_family (fontdesc),
-			pango_font_description_get_size (fontdesc) / PANGO_SCALE
-		);
-		
-		GtkCssProvider *provider = gtk_css_provider_new ();
-		gtk_css_provider_load_from_string (provider, css_string);
-		gtk_style_context_add_provider (gtk_widget_get_style_context (GTK_WIDGET (view)),
-		                                 GTK_STYLE_PROVIDER (provider),
-		                                 GTK_STYLE_PROVIDER_PRIORITY_APPLICATION);
-		g_object_unref (provider);
-		g_free (css_string);
-		pango_font_description_free (fontdesc);
-	}
+	xpad_text_view_update_style (view);
 }
 
-static void
-xpad_text_view_notify_text_color (XpadTextView *view)
+const GdkRGBA *
+xpad_text_view_get_back_color (XpadTextView *view)
 {
-	xpad_text_view_apply_colors (view);
+	return view->priv->has_back_color ? &view->priv->back_color : NULL;
 }
 
-static void
-xpad_text_view_notify_back_color (XpadTextView *view)
+void
+xpad_text_view_set_fontname (XpadTextView *view, const gchar *fontname)
 {
-	xpad_text_view_apply_colors (view);
+	gchar *old = view->priv->fontname;
+	
+	view->priv->fontname = g_strdup (fontname);
+	g_free (old);
+	
+	xpad_text_view_update_style (view);
+}
+
+const gchar *
+xpad_text_view_get_fontname (XpadTextView *view)
+{
+	return view->priv->fontname;
 }
 
 void
@@ -289,17 +308,13 @@ xpad_text_view_set_follow_font_style (XpadTextView *view, gboolean follow)
 	if (follow != view->priv->follow_font_style)
 	{
 		if (follow)
-		{
-			g_signal_handler_unblock (xpad_settings (), view->priv->notify_font_handler);
-			xpad_text_view_notify_fontname (view);
-		}
+			gtk_widget_add_css_class (GTK_WIDGET (view), XPAD_STYLE_GLOBAL_FONT_CLASS);
 		else
-		{
-			g_signal_handler_block (xpad_settings (), view->priv->notify_font_handler);
-		}
+			gtk_widget_remove_css_class (GTK_WIDGET (view), XPAD_STYLE_GLOBAL_FONT_CLASS);
 	}
 	
 	view->priv->follow_font_style = follow;
+	xpad_text_view_update_style (view);
 	
 	g_object_notify (G_OBJECT (view), "follow_font_style");
 }
@@ -316,20 +331,13 @@ xpad_text_view_set_follow_color_style (XpadTextView *view, gboolean follow)
 	if (follow != view->priv->follow_color_style)
 	{
 		if (follow)
-		{
-			g_signal_handler_unblock (xpad_settings (), view->priv->notify_text_handler);
-			g_signal_handler_unblock (xpad_settings (), view->priv->notify_back_handler);
-			xpad_text_view_notify_text_color (view);
-			xpad_text_view_notify_back_color (view);
-		}
+			gtk_widget_add_css_class (GTK_WIDGET (view), XPAD_STYLE_GLOBAL_COLOR_CLASS);
 		else
-		{
-			g_signal_handler_block (xpad_settings (), view->priv->notify_text_handler);
-			g_signal_handler_block (xpad_settings (), view->priv->notify_back_handler);
-		}
+			gtk_widget_remove_css_class (GTK_WIDGET (view), XPAD_STYLE_GLOBAL_COLOR_CLASS);
 	}
 	
 	view->priv->follow_color_style = follow;
+	xpad_text_view_update_style (view);
 	
 	g_object_notify (G_OBJECT (view), "follow_color_style");
 }
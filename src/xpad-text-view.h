@@ -57,6 +57,15 @@ gboolean xpad_text_view_get_follow_font_style (XpadTextView *view);
 void xpad_text_view_set_follow_color_style (XpadTextView *view, gboolean follow);
 gboolean xpad_text_view_get_follow_color_style (XpadTextView *view);
 
+void xpad_text_view_set_text_color (XpadTextView *view, const GdkRGBA *color);
+const GdkRGBA *xpad_text_view_get_text_color (XpadTextView *view);
+void xpad_text_view_set_back_color (XpadTextView *view, const GdkRGBA *color);
+const GdkRGBA *xpad_text_view_get_back_color (XpadTextView *view);
+void xpad_text_view_set_fontname (XpadTextView *view, const gchar *fontname);
+const gchar *xpad_text_view_get_fontname (XpadTextView *view);
+
+void xpad_text_view_notify_edit_lock (XpadTextView *view);
+
 XpadPad *xpad_text_view_get_pad (XpadTextView *view);
 void xpad_text_view_set_pad (XpadTextView *view, XpadPad *pad);
 
@@ -0,0 +1,245 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "xpad-timer.h"
+
+/**
+ * Every deferred job in xpad (toolbar autohide, debounced saves) is an
+ * XpadTimer on one hashed timing wheel, driven by a single GSource.
+ *
+ * Timers are intrusive list nodes hashed into a slot by their expiry tick,
+ * so arming, re-arming and cancelling are O(1) and allocate nothing.
+ * The source's ready time is the next slot with a due timer; with no
+ * timers armed it is -1 and the wheel never wakes the main loop.
+ */
+
+/* Granularity of the wheel, in microseconds */
+#define TICK_USEC 16000
+
+/* Slots in the wheel, a power of two.  Timers further out than one
+   revolution (about 4 seconds) cost one extra wakeup per revolution. */
+#define N_SLOTS 256
+#define SLOT_MASK (N_SLOTS - 1)
+
+static XpadTimer slots[N_SLOTS];
+static GSource *wheel_source = NULL;
+static gint64 wheel_tick = 0;
+static guint n_armed = 0;
+
+static gboolean wheel_dispatch (GSource *source, GSourceFunc callback, gpointer user_data);
+
+static GSourceFuncs wheel_funcs =
+{
+	NULL,
+	NULL,
+	wheel_dispatch,
+	NULL
+};
+
+static void
+list_init (XpadTimer *head)
+{
+	head->prev = head->next = head;
+}
+
+static void
+list_append (XpadTimer *head, XpadTimer *timer)
+{
+	timer->prev = head->prev;
+	timer->next = head;
+	head->prev->next = timer;
+	head->prev = timer;
+}
+
+static void
+list_remove (XpadTimer *timer)
+{
+	timer->prev->next = timer->next;
+	timer->next->prev = timer->prev;
+	timer->prev = timer->next = NULL;
+}
+
+static void
+wheel_init (void)
+{
+	guint i;
+	
+	if (wheel_source)
+		return;
+	
+	for (i = 0; i < N_SLOTS; i++)
+		list_init (&slots[i]);
+	
+	wheel_tick = g_get_monotonic_time () / TICK_USEC;
+	
+	wheel_source = g_source_new (&wheel_funcs, sizeof (GSource));
+	g_source_set_name (wheel_source, "xpad timer wheel");
+	g_source_set_ready_time (wheel_source, -1);
+	g_source_attach (wheel_source, NULL);
+}
+
+/* Finds the first slot holding a timer that is due in this revolution */
+static void
+wheel_update_ready_time (void)
+{
+	gint64 tick;
+	
+	if (n_armed == 0)
+	{
+		g_source_set_ready_time (wheel_source, -1);
+		return;
+	}
+	
+	for (tick = wheel_tick + 1; tick <= wheel_tick + N_SLOTS; tick++)
+	{
+		XpadTimer *head = &slots[tick & SLOT_MASK], *timer;
+		
+		for (timer = head->next; timer != head; timer = timer->next)
+		{
+			if (timer->tick <= tick)
+			{
+				g_source_set_ready_time (wheel_source, tick * TICK_USEC);
+				return;
+			}
+		}
+	}
+	
+	/* Only far-off timers left, look again after one revolution */
+	g_source_set_ready_time (wheel_source, (wheel_tick + N_SLOTS) * TICK_USEC);
+}
+
+/* Runs the due timers of one slot and keeps the rest */
+static void
+wheel_expire_slot (XpadTimer *head, gint64 now_tick)
+{
+	XpadTimer due;
+	
+	if (head->next == head)
+		return;
+	
+	/* Move the slot aside, so callbacks can re-arm or cancel anything */
+	due.next = head->next;
+	due.prev = head->prev;
+	due.next->prev = &due;
+	due.prev->next = &due;
+	list_init (head);
+	
+	while (due.next != &due)
+	{
+		XpadTimer *timer = due.next;
+		
+		list_remove (timer);
+		
+		if (timer->tick <= now_tick)
+		{
+			n_armed--;
+			timer->func (timer->user_data);
+		}
+		else
+			list_append (head, timer);
+	}
+}
+
+static gboolean
+wheel_dispatch (GSource *source, GSourceFunc callback, gpointer user_data)
+{
+	gint64 now_tick = g_get_monotonic_time () / TICK_USEC;
+	gint64 from = wheel_tick + 1, tick;
+	
+	/* After a long sleep every slot is visited once, not once per tick */
+	if (now_tick - from >= N_SLOTS)
+		from = now_tick - N_SLOTS + 1;
+	
+	/* Advance first, so timers armed from callbacks land in the future */
+	wheel_tick = now_tick;
+	
+	for (tick = from; tick <= now_tick && n_armed > 0; tick++)
+		wheel_expire_slot (&slots[tick & SLOT_MASK], now_tick);
+	
+	wheel_update_ready_time ();
+	
+	return G_SOURCE_CONTINUE;
+}
+
+void
+xpad_timer_init (XpadTimer *timer, XpadTimerFunc func, gpointer user_data)
+{
+	timer->prev = timer->next = NULL;
+	timer->tick = 0;
+	timer->func = func;
+	timer->user_data = user_data;
+}
+
+/* Arms the timer to fire once in msec milliseconds, replacing any earlier expiry */
+void
+xpad_timer_schedule (XpadTimer *timer, guint msec)
+{
+	gint64 ready_time;
+	
+	g_return_if_fail (timer->func);
+	
+	wheel_init ();
+	
+	if (timer->next)
+	{
+		list_remove (timer);
+		n_armed--;
+	}
+	else if (n_armed == 0)
+	{
+		/* Nothing ran while idle; skip the empty ticks */
+		wheel_tick = MAX (wheel_tick, g_get_monotonic_time () / TICK_USEC);
+	}
+	
+	timer->tick = (g_get_monotonic_time () + (gint64) msec * 1000 + TICK_USEC - 1) / TICK_USEC;
+	timer->tick = MAX (timer->tick, wheel_tick + 1);
+	
+	list_append (&slots[timer->tick & SLOT_MASK], timer);
+	n_armed++;
+	
+	ready_time = g_source_get_ready_time (wheel_source);
+	if (ready_time < 0 || timer->tick * TICK_USEC < ready_time)
+		g_source_set_ready_time (wheel_source, timer->tick * TICK_USEC);
+}
+
+void
+xpad_timer_cancel (XpadTimer *timer)
+{
+	if (!timer->next)
+		return;
+	
+	list_remove (timer);
+	n_armed--;
+	
+	/* A stale ready time costs one empty dispatch, which clears it */
+}
+
+/* Runs the timer now if it is armed; used to save pending work on close */
+void
+xpad_timer_flush (XpadTimer *timer)
+{
+	if (!timer->next)
+		return;
+	
+	xpad_timer_cancel (timer);
+	timer->func (timer->user_data);
+}
+
+gboolean
+xpad_timer_is_pending (const XpadTimer *timer)
+{
+	return timer->next != NULL;
+}
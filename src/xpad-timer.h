@@ -0,0 +1,46 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef __XPAD_TIMER_H__
+#define __XPAD_TIMER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct XpadTimer XpadTimer;
+typedef void (*XpadTimerFunc) (gpointer user_data);
+
+/* Embedded in the owner's struct; initialize with xpad_timer_init before use */
+struct XpadTimer
+{
+	/* private */
+	XpadTimer *prev;
+	XpadTimer *next;
+	gint64 tick;
+	XpadTimerFunc func;
+	gpointer user_data;
+};
+
+void     xpad_timer_init       (XpadTimer *timer, XpadTimerFunc func, gpointer user_data);
+void     xpad_timer_schedule   (XpadTimer *timer, guint msec);
+void     xpad_timer_cancel     (XpadTimer *timer);
+void     xpad_timer_flush      (XpadTimer *timer);
+gboolean xpad_timer_is_pending (const XpadTimer *timer);
+
+G_END_DECLS
+
+#endif /* __XPAD_TIMER_H__ */
@@ -35,6 +35,24 @@ enum {
 	XPAD_BUTTON_TYPE_TOGGLE
 };
 
+/* Indexes into buttons[] below, keep in the same order */
+enum {
+	XPAD_BUTTON_CLEAR,
+	XPAD_BUTTON_CLOSE,
+	XPAD_BUTTON_COPY,
+	XPAD_BUTTON_CUT,
+	XPAD_BUTTON_DELETE,
+	XPAD_BUTTON_NEW,
+	XPAD_BUTTON_PASTE,
+	XPAD_BUTTON_PREFERENCES,
+	XPAD_BUTTON_PROPERTIES,
+	XPAD_BUTTON_REDO,
+	XPAD_BUTTON_QUIT,
+	XPAD_BUTTON_UNDO,
+	XPAD_BUTTON_SEP,
+	XPAD_BUTTON_COUNT
+};
+
 struct XpadToolbarPrivate
 {
 	GtkToolItem *move_button;
@@ -43,7 +61,8 @@ struct XpadToolbarPrivate
 	guint move_motion_handler;
 	guint move_button_release_handler;
 	guint move_key_press_handler;
-	GtkToolItem *tool_items;
+	GtkToolItem *items[XPAD_BUTTON_COUNT];
+	guint layout_serial;
 	XpadPad *pad;
 };
 
@@ -94,11 +113,18 @@ static const XpadToolbarButton buttons[] =
 	/*{"Minimize to Tray", "go-bottom", 1, N_("Minimize Pads to System Tray")}*/
 };
 
+/**
+ * The configured button list, resolved to descriptors once and shared by
+ * every toolbar.  A toolbar only rebuilds when its layout_serial is behind.
+ */
+static GHashTable *button_index = NULL;
+static GPtrArray *layout = NULL;
+static guint layout_serial = 0;
+
 
-static const XpadToolbarButton *xpad_toolbar_button_lookup (XpadToolbar *toolbar, const gchar *name);
+static const XpadToolbarButton *xpad_toolbar_button_lookup (const gchar *name);
 static GtkToolItem *xpad_toolbar_button_to_item (XpadToolbar *toolbar, const XpadToolbarButton *button);
 static void xpad_toolbar_button_activated (GtkToolButton *button);
-static void xpad_toolbar_change_buttons (XpadToolbar *toolbar);
 static void xpad_toolbar_finalize (GObject *object);
 static void xpad_toolbar_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec);
 static void xpad_toolbar_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec);
@@ -270,6 +296,7 @@ xpad_toolbar_init (XpadToolbar *toolbar)
 	toolbar->priv = XPAD_TOOLBAR_GET_PRIVATE (toolbar);
 
 	toolbar->priv->pad = NULL;	
+	toolbar->priv->layout_serial = 0;
 	toolbar->priv->move_motion_handler = 0;
 	toolbar->priv->move_button_release_handler = 0;
 	toolbar->priv->move_key_press_handler = 0;
@@ -280,9 +307,10 @@ xpad_toolbar_init (XpadToolbar *toolbar)
 	              "toolbar-style", GTK_TOOLBAR_ICONS,
 	              NULL);
 	
-	g_signal_connect_swapped (xpad_settings (), "change-buttons", G_CALLBACK (xpad_toolbar_change_buttons), toolbar);
-	
 	xpad_toolbar_change_buttons (toolbar);
+	
+	/* Catch up with layout changes made while we were not shown */
+	g_signal_connect (toolbar, "map", G_CALLBACK (xpad_toolbar_change_buttons), NULL);
 }
 
 static void
@@ -341,14 +369,46 @@ xpad_toolbar_get_property (GObject *object, guint prop_id, GValue *value, GParam
 }
 
 static G_CONST_RETURN XpadToolbarButton *
-xpad_toolbar_button_lookup (XpadToolbar *toolbar, const gchar *name)
+xpad_toolbar_button_lookup (const gchar *name)
 {
+	const XpadToolbarButton *button;
+	gchar *key;
 	gint i;
-	for (i = 0; i < G_N_ELEMENTS (buttons); i++)
-		if (!g_ascii_strcasecmp (name, buttons[i].name))
-			return &buttons[i];
 	
-	return NULL;
+	if (!button_index)
+	{
+		button_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+		for (i = 0; i < G_N_ELEMENTS (buttons); i++)
+			g_hash_table_insert (button_index, g_ascii_strdown (buttons[i].name, -1), (gpointer) &buttons[i]);
+	}
+	
+	/* Names in the config file are matched case-insensitively */
+	key = g_ascii_strdown (name, -1);
+	button = g_hash_table_lookup (button_index, key);
+	g_free (key);
+	
+	return button;
+}
+
+/* Re-reads the button list from the settings; toolbars pick it up when next shown */
+void
+xpad_toolbar_reload_layout (void)
+{
+	const GSList *names;
+	
+	if (layout)
+		g_ptr_array_set_size (layout, 0);
+	else
+		layout = g_ptr_array_new ();
+	
+	for (names = xpad_settings_get_toolbar_buttons (xpad_settings ()); names; names = names->next)
+	{
+		const XpadToolbarButton *button = xpad_toolbar_button_lookup (names->data);
+		if (button)
+			g_ptr_array_add (layout, (gpointer) button);
+	}
+	
+	layout_serial++;
 }
 
 static GtkToolItem *
@@ -356,10 +416,11 @@ xpad_toolbar_button_to_item (XpadToolbar *toolbar, const XpadToolbarButton *butt
 {
 	GtkToolItem *item;
 	GtkWidget *child;
+	guint id = button - buttons;
 
-	item = GTK_TOOL_ITEM (g_object_get_data (G_OBJECT (toolbar), button->name));
-	if (item)
-		return item;
+	/* Separators may appear more than once, everything else only once */
+	if (button->type != XPAD_BUTTON_TYPE_SEPARATOR && toolbar->priv->items[id])
+		return toolbar->priv->items[id];
 
 	switch (button->type)
 	{
@@ -389,7 +450,8 @@ xpad_toolbar_button_to_item (XpadToolbar *toolbar, const XpadToolbarButton *butt
 	g_object_set_data (G_OBJECT (item), "xpad-toolbar", toolbar);
 	g_object_set_data (G_OBJECT (item), "xpad-tb", (gpointer) button);
 
-	g_object_set_data (G_OBJECT (toolbar), button->name, item);
+	if (button->type != XPAD_BUTTON_TYPE_SEPARATOR)
+		toolbar->priv->items[id] = item;
 	
 	if (button->desc)
 		gtk_tool_item_set_tooltip_text (item, _(button->desc));
@@ -420,14 +482,20 @@ xpad_toolbar_button_activated (GtkToolButton *button)
 	g_signal_emit (toolbar, signals[tb->signal], 0);
 }
 
-static void
+void
 xpad_toolbar_change_buttons (XpadToolbar *toolbar)
 {
 	GList *list, *temp;
-	const GSList *slist, *stemp;
 	gint i = 0, j;
 	GtkToolItem *item;
 	
+	if (!layout)
+		xpad_toolbar_reload_layout ();
+	
+	if (toolbar->priv->layout_serial == layout_serial)
+		return;
+	toolbar->priv->layout_serial = layout_serial;
+	
 	list = gtk_container_get_children (GTK_CONTAINER (toolbar));
 	
 	for (temp = list; temp; temp = temp->next)
@@ -435,19 +503,11 @@ xpad_toolbar_change_buttons (XpadToolbar *toolbar)
 	
 	g_list_free (list);
 
-	for (j = 0; j < G_N_ELEMENTS (buttons); j++)
-		g_object_set_data (G_OBJECT (toolbar), buttons[j].name, NULL);
+	memset (toolbar->priv->items, 0, sizeof (toolbar->priv->items));
 	
-	slist = xpad_settings_get_toolbar_buttons (xpad_settings ());
-	for (stemp = slist; stemp; stemp = stemp->next)
+	for (j = 0; j < layout->len; j++)
 	{
-		const XpadToolbarButton *button;
-		
-		button = xpad_toolbar_button_lookup (toolbar, stemp->data);
-		if (!button)
-			continue;
-		
-		item = xpad_toolbar_button_to_item (toolbar, button);
+		item = xpad_toolbar_button_to_item (toolbar, g_ptr_array_index (layout, j));
 		
 		if (item)
 		{
@@ -476,6 +536,7 @@ xpad_toolbar_change_buttons (XpadToolbar *toolbar)
 	{
 		xpad_pad_notify_has_selection (toolbar->priv->pad);
 		xpad_pad_notify_clipboard_owner_changed (toolbar->priv->pad);
+		xpad_pad_notify_undo_redo_changed (toolbar->priv->pad);
 	}
 }
 
@@ -679,29 +740,22 @@ static gboolean
 xpad_toolbar_popup_context_menu (GtkToolbar *toolbar, gint x, gint y, gint button)
 {
 	GtkWidget *menu;
-	const GSList *current_buttons;
+	XpadToolbar *xpad_toolbar = XPAD_TOOLBAR (toolbar);
 	gint i;
 	
 	menu = gtk_popover_new ();
 	gtk_widget_set_parent (menu, GTK_WIDGET (toolbar));
 	GtkWidget *box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
 	
-	current_buttons = xpad_settings_get_toolbar_buttons (xpad_settings ());
-
 	gboolean is_button = FALSE;
 	
 	for (i = 0; i < G_N_ELEMENTS (buttons); i++)
 	{
-		const GSList *j;
 		GtkWidget *item;
 		
-		if (strcmp (buttons[i].name, "sep") != 0)
+		if (i != XPAD_BUTTON_SEP)
 		{
-			for (j = current_buttons; j; j = j->next)
-				if (!g_ascii_strcasecmp (j->data, buttons[i].name))
-					break;
-			
-			if (j)
+			if (xpad_toolbar->priv->items[i])
 			{
 				is_button = TRUE;
 				continue;
@@ -744,11 +798,11 @@ xpad_toolbar_popup_context_menu (GtkToolbar *toolbar, gint x, gint y, gint butto
 	return TRUE;
 }
 
+/* Buttons that are not on the toolbar are left alone, change_buttons syncs new ones */
 static void
-xpad_toolbar_enable_button (XpadToolbar *toolbar, const XpadToolbarButton *button, gboolean enable)
+xpad_toolbar_enable_button (XpadToolbar *toolbar, guint id, gboolean enable)
 {
-	g_return_if_fail (button);
-	GtkToolItem *item = xpad_toolbar_button_to_item (toolbar, button);
+	GtkToolItem *item = toolbar->priv->items[id];
 	if (item)
 		gtk_widget_set_sensitive (GTK_WIDGET (item), enable);
 }
@@ -756,35 +810,30 @@ xpad_toolbar_enable_button (XpadToolbar *toolbar, const XpadToolbarButton *butto
 void
 xpad_toolbar_enable_undo_button (XpadToolbar *toolbar, gboolean enable)
 {
-	const XpadToolbarButton *button = xpad_toolbar_button_lookup (toolbar, "Undo");
-	xpad_toolbar_enable_button (toolbar, button, enable);
+	xpad_toolbar_enable_button (toolbar, XPAD_BUTTON_UNDO, enable);
 }
 
 void
 xpad_toolbar_enable_redo_button (XpadToolbar *toolbar, gboolean enable)
 {
-	const XpadToolbarButton *button = xpad_toolbar_button_lookup (toolbar, "Redo");
-	xpad_toolbar_enable_button (toolbar, button, enable);
+	xpad_toolbar_enable_button (toolbar, XPAD_BUTTON_REDO, enable);
 }
 
 void
 xpad_toolbar_enable_cut_button (XpadToolbar *toolbar, gboolean enable)
 {
-	const XpadToolbarButton *button = xpad_toolbar_button_lookup (toolbar, "Cut");
-	xpad_toolbar_enable_button (toolbar, button, enable);
+	xpad_toolbar_enable_button (toolbar, XPAD_BUTTON_CUT, enable);
 }
 
 void
 xpad_toolbar_enable_copy_button (XpadToolbar *toolbar, gboolean enable)
 {
-	const XpadToolbarButton *button = xpad_toolbar_button_lookup (toolbar, "Copy");
-	xpad_toolbar_enable_button (toolbar, button, enable);
+	xpad_toolbar_enable_button (toolbar, XPAD_BUTTON_COPY, enable);
 }
 
 void
 xpad_toolbar_enable_paste_button (XpadToolbar *toolbar, gboolean enable)
 {
-	const XpadToolbarButton *button = xpad_toolbar_button_lookup (toolbar, "Paste");
-	xpad_toolbar_enable_button (toolbar, button, enable);
+	xpad_toolbar_enable_button (toolbar, XPAD_BUTTON_PASTE, enable);
 }
 
@@ -69,6 +69,9 @@ GType xpad_toolbar_get_type (void);
 
 GtkWidget *xpad_toolbar_new (XpadPad *pad);
 
+void xpad_toolbar_change_buttons (XpadToolbar *toolbar);
+void xpad_toolbar_reload_layout (void);
+
 void xpad_toolbar_enable_undo_button (XpadToolbar *toolbar, gboolean enable);
 void xpad_toolbar_enable_redo_button (XpadToolbar *toolbar, gboolean enable);
 void xpad_toolbar_enable_cut_button (XpadToolbar *toolbar, gboolean enable);
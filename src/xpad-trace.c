@@ -0,0 +1,143 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "../config.h"
+#include <stdio.h>
+#include <stdlib.h> /* for atexit */
+#include <unistd.h>
+#ifdef HAVE_SYSPROF
+#include <sysprof-capture.h>
+#endif
+#include "xpad-json.h"
+#include "xpad-trace.h"
+
+/**
+ * Span instrumentation for startup and the hot paths.
+ *
+ * Spans go to a file given by --trace FILE or the XPAD_TRACE environment
+ * variable, written at exit as Chrome trace-event JSON (load it in
+ * chrome://tracing or Perfetto).  When xpad runs under sysprof, every span
+ * is also sent as a capture mark.  Spans are only recorded from the main
+ * thread.
+ */
+
+typedef struct
+{
+	const gchar *name;
+	gchar *detail;
+	gint64 begin;
+	gint64 duration;
+} TraceEvent;
+
+gboolean xpad_tracing = FALSE;
+
+static gchar *trace_filename = NULL;
+static GArray *trace_events = NULL;
+#ifdef HAVE_SYSPROF
+static gboolean trace_sysprof = FALSE;
+#endif
+
+/* Called at exit, whichever way xpad leaves */
+static void
+xpad_trace_write (void)
+{
+	GString *out;
+	gint pid = getpid ();
+	guint i;
+	
+	if (!trace_events)
+		return;
+	
+	out = g_string_new ("{\"traceEvents\":[\n");
+	for (i = 0; i < trace_events->len; i++)
+	{
+		TraceEvent *event = &g_array_index (trace_events, TraceEvent, i);
+		
+		g_string_append (out, "{\"name\":");
+		xpad_json_append_string (out, event->name);
+		g_string_append_printf (out, ",\"cat\":\"xpad\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d",
+			event->begin, event->duration, pid, pid);
+		if (event->detail)
+		{
+			g_string_append (out, ",\"args\":{\"detail\":");
+			xpad_json_append_string (out, event->detail);
+			g_string_append_c (out, '}');
+		}
+		g_string_append (out, i + 1 < trace_events->len ? "},\n" : "}\n");
+		
+		g_free (event->detail);
+	}
+	g_string_append (out, "],\"displayTimeUnit\":\"ms\"}\n");
+	
+	if (!g_file_set_contents (trace_filename, out->str, out->len, NULL))
+		fprintf (stderr, "Could not write trace to %s\n", trace_filename);
+	
+	g_string_free (out, TRUE);
+	g_array_free (trace_events, TRUE);
+	trace_events = NULL;
+	xpad_tracing = FALSE;
+}
+
+/* Turns tracing on if filename, $XPAD_TRACE or sysprof ask for it.
+   Call once, as early as possible. */
+void
+xpad_trace_init (const gchar *filename)
+{
+	if (!filename)
+		filename = g_getenv ("XPAD_TRACE");
+	
+	if (filename && *filename)
+	{
+		trace_filename = g_strdup (filename);
+		trace_events = g_array_sized_new (FALSE, FALSE, sizeof (TraceEvent), 256);
+		atexit (xpad_trace_write);
+		xpad_tracing = TRUE;
+	}
+	
+#ifdef HAVE_SYSPROF
+	trace_sysprof = sysprof_collector_is_active ();
+	if (trace_sysprof)
+		xpad_tracing = TRUE;
+#endif
+}
+
+void
+xpad_trace_add (gint64 begin, const gchar *name, const gchar *detail)
+{
+	gint64 duration = g_get_monotonic_time () - begin;
+	
+	/* Spans that began before tracing was on */
+	if (!begin)
+		return;
+	
+	if (trace_events)
+	{
+		TraceEvent event;
+		
+		event.name = name;
+		event.detail = g_strdup (detail);
+		event.begin = begin;
+		event.duration = duration;
+		g_array_append_val (trace_events, event);
+	}
+	
+#ifdef HAVE_SYSPROF
+	/* Both clocks are CLOCK_MONOTONIC, sysprof counts nanoseconds */
+	if (trace_sysprof)
+		sysprof_collector_mark (begin * 1000, duration * 1000, "xpad", name, detail);
+#endif
+}
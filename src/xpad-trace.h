@@ -0,0 +1,42 @@
+/**
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#ifndef __XPAD_TRACE_H__
+#define __XPAD_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* TRUE while spans are recorded.  Read it through the macros below only. */
+extern gboolean xpad_tracing;
+
+void xpad_trace_init (const gchar *filename);
+void xpad_trace_add  (gint64 begin, const gchar *name, const gchar *detail);
+
+/**
+ * A span is the time between xpad_trace_begin and xpad_trace_end.  name
+ * must be a static string; detail may be NULL and is copied.  With
+ * tracing off, both cost a test of one global.
+ */
+#define xpad_trace_begin() (G_UNLIKELY (xpad_tracing) ? g_get_monotonic_time () : 0)
+#define xpad_trace_end(begin, name, detail) \
+	G_STMT_START { if (G_UNLIKELY (xpad_tracing)) xpad_trace_add ((begin), (name), (detail)); } G_STMT_END
+
+G_END_DECLS
+
+#endif /* __XPAD_TRACE_H__ */
@@ -22,9 +22,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "../config.h"
 #include <stdlib.h>
+#include <string.h>
 #include <glib.h>
 #include "xpad-undo.h"
+#include "xpad-metrics.h"
 #include "xpad-text-buffer.h"
+#include "xpad-trace.h"
 
 G_DEFINE_TYPE(XpadUndo, xpad_undo, G_TYPE_OBJECT)
 #define XPAD_UNDO_GET_PRIVATE(object) (G_TYPE_INSTANCE_GET_PRIVATE ((object), XPAD_TYPE_UNDO, XpadUndoPrivate))
@@ -54,6 +57,9 @@ typedef struct
 	gint n_utf8_chars;
 } UserAction;
 
+/* What an action costs in memory, as counted in XPAD_METRIC_UNDO_BYTES */
+#define ACTION_SIZE(action) ((gssize) (sizeof (UserAction) + strlen ((action)->text) + 1))
+
 static GList* xpad_undo_remove_action_elem (GList *curr);
 static void xpad_undo_clear_redo_history (XpadUndo *undo);
 static void xpad_undo_clear_history (XpadUndo *undo);
@@ -244,6 +250,25 @@ xpad_undo_end_user_action (GtkTextBuffer *buffer, XpadUndo *undo)
 		undo->priv->user_action--;
 }
 
+/* Buffers without a pad, like the ones xpad-bench drives, have nobody to tell */
+static void
+xpad_undo_notify_pad (XpadUndo *undo)
+{
+	XpadPad *pad = xpad_text_buffer_get_pad (undo->priv->buffer);
+	
+	if (pad)
+		xpad_pad_notify_undo_redo_changed (pad);
+}
+
+static void
+xpad_undo_save_pad (XpadUndo *undo)
+{
+	XpadPad *pad = xpad_text_buffer_get_pad (undo->priv->buffer);
+	
+	if (pad)
+		xpad_pad_save_content (pad);
+}
+
 /* Removes current element and returns a pointer to the previous */
 static GList*
 xpad_undo_remove_action_elem (GList *curr)
@@ -251,6 +276,7 @@ xpad_undo_remove_action_elem (GList *curr)
 	if (curr->data)
 	{
 		UserAction *action = curr->data;
+		xpad_metrics_add (XPAD_METRIC_UNDO_BYTES, -ACTION_SIZE (action));
 		g_free (action->text);
 		g_free (action);
 		if (curr->prev)
@@ -320,6 +346,7 @@ xpad_undo_insert_text (GtkTextBuffer *buffer, GtkTextIter *location, gchar *text
 						prev_action->end += len;
 						prev_action->n_utf8_chars += n_utf8_chars;
 						prev_action->merged = TRUE;
+						xpad_metrics_add (XPAD_METRIC_UNDO_BYTES, len);
 						return;
 					}
 				}
@@ -340,9 +367,10 @@ xpad_undo_insert_text (GtkTextBuffer *buffer, GtkTextIter *location, gchar *text
 			insert right after it. history_start won't change
 			since it is a left guard - not NULL */
 		GList *dummy_start = g_list_append (undo->priv->history_curr, action); // supress warning, we have left guard for start
+		xpad_metrics_add (XPAD_METRIC_UNDO_BYTES, ACTION_SIZE (action));
 		undo->priv->history_curr = g_list_next (undo->priv->history_curr);
 
-		xpad_pad_notify_undo_redo_changed (xpad_text_buffer_get_pad (undo->priv->buffer));
+		xpad_undo_notify_pad (undo);
 	}
 }
 
@@ -372,9 +400,10 @@ xpad_undo_delete_range (GtkTextBuffer *buffer, GtkTextIter *start, GtkTextIter *
 		action->merged = FALSE;
 
 		GList *dummy_start = g_list_append (undo->priv->history_curr, action); // supress warning, we have left guard for start
+		xpad_metrics_add (XPAD_METRIC_UNDO_BYTES, ACTION_SIZE (action));
 		undo->priv->history_curr = g_list_next (undo->priv->history_curr);
 
-		xpad_pad_notify_undo_redo_changed (xpad_text_buffer_get_pad (undo->priv->buffer));
+		xpad_undo_notify_pad (undo);
 	}
 }
 
@@ -397,9 +426,10 @@ xpad_undo_apply_tag (XpadUndo *undo, const gchar *name, GtkTextIter *start, GtkT
 	action->merged = FALSE;
 
 	GList *dummy_start = g_list_append (undo->priv->history_curr, action); // supress warning, we have left guard for start
+	xpad_metrics_add (XPAD_METRIC_UNDO_BYTES, ACTION_SIZE (action));
 	undo->priv->history_curr = g_list_next (undo->priv->history_curr);
 
-	xpad_pad_notify_undo_redo_changed (xpad_text_buffer_get_pad (undo->priv->buffer));
+	xpad_undo_notify_pad (undo);
 }
 
 void
@@ -421,9 +451,10 @@ xpad_undo_remove_tag (XpadUndo *undo, const gchar *name, GtkTextIter *start, Gtk
 	action->merged = FALSE;
 
 	GList *dummy_start = g_list_append (undo->priv->history_curr, action); // supress warning, we have left guard for start
+	xpad_metrics_add (XPAD_METRIC_UNDO_BYTES, ACTION_SIZE (action));
 	undo->priv->history_curr = g_list_next (undo->priv->history_curr);
 
-	xpad_pad_notify_undo_redo_changed (xpad_text_buffer_get_pad (undo->priv->buffer));
+	xpad_undo_notify_pad (undo);
 }
 
 gboolean
@@ -474,6 +505,7 @@ xpad_undo_exec_undo (XpadUndo *undo)
 	if (!xpad_undo_undo_available (undo))
 		return;
 
+	gint64 span = xpad_trace_begin ();
 	UserAction *action = undo->priv->history_curr->data;
 
 	GtkTextTagTable *table = gtk_text_buffer_get_tag_table ( GTK_TEXT_BUFFER (undo->priv->buffer));
@@ -506,7 +538,7 @@ xpad_undo_exec_undo (XpadUndo *undo)
 						tag,
 						&start,
 						&end);
-				xpad_pad_save_content (xpad_text_buffer_get_pad (undo->priv->buffer));
+				xpad_undo_save_pad (undo);
 			}
 			break;
 		case USER_ACTION_REMOVE_TAG:
@@ -516,14 +548,16 @@ xpad_undo_exec_undo (XpadUndo *undo)
 						tag,
 						&start,
 						&end);
-				xpad_pad_save_content (xpad_text_buffer_get_pad (undo->priv->buffer));
+				xpad_undo_save_pad (undo);
 			}
 			break;
 	}
 
 	undo->priv->history_curr = g_list_previous (undo->priv->history_curr);
 
-	xpad_pad_notify_undo_redo_changed (xpad_text_buffer_get_pad (undo->priv->buffer));
+	xpad_undo_notify_pad (undo);
+
+	xpad_trace_end (span, "xpad_undo_exec_undo", NULL);
 }
 
 void
@@ -532,6 +566,7 @@ xpad_undo_exec_redo (XpadUndo *undo)
 	if (!xpad_undo_redo_available (undo))
 		return;
 
+	gint64 span = xpad_trace_begin ();
 	UserAction *action = undo->priv->history_curr->next->data;
 
 	GtkTextTagTable *table = gtk_text_buffer_get_tag_table ( GTK_TEXT_BUFFER (undo->priv->buffer));
@@ -564,7 +599,7 @@ xpad_undo_exec_redo (XpadUndo *undo)
 						tag,
 						&start,
 						&end);
-				xpad_pad_save_content (xpad_text_buffer_get_pad (undo->priv->buffer));
+				xpad_undo_save_pad (undo);
 			}
 			break;
 		case USER_ACTION_REMOVE_TAG:
@@ -574,14 +609,16 @@ xpad_undo_exec_redo (XpadUndo *undo)
 						tag,
 						&start,
 						&end);
-				xpad_pad_save_content (xpad_text_buffer_get_pad (undo->priv->buffer));
+				xpad_undo_save_pad (undo);
 			}
 			break;
 	}
 
 	undo->priv->history_curr = g_list_next (undo->priv->history_curr);
 
-	xpad_pad_notify_undo_redo_changed (xpad_text_buffer_get_pad (undo->priv->buffer));
+	xpad_undo_notify_pad (undo);
+
+	xpad_trace_end (span, "xpad_undo_exec_redo", NULL);
 }
 
 void
@@ -596,3 +633,11 @@ xpad_undo_thaw (XpadUndo *undo)
 	undo->priv->frozen = FALSE;
 }
 
+/* For text that moved under the recorded offsets while frozen */
+void
+xpad_undo_clear (XpadUndo *undo)
+{
+	xpad_undo_clear_history (undo);
+	xpad_undo_notify_pad (undo);
+}
+
@@ -62,6 +62,7 @@ void xpad_undo_exec_undo (XpadUndo *undo);
 void xpad_undo_exec_redo (XpadUndo *undo);
 void xpad_undo_freeze (XpadUndo *undo);
 void xpad_undo_thaw (XpadUndo *undo);
+void xpad_undo_clear (XpadUndo *undo);
 
 void xpad_undo_apply_tag (XpadUndo *undo, const gchar *name, GtkTextIter *start, GtkTextIter *end);
 void xpad_undo_remove_tag (XpadUndo *undo, const gchar *name, GtkTextIter *start, GtkTextIter *end);